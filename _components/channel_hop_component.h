@@ -0,0 +1,99 @@
+#ifndef ESP32_CSI_CHANNEL_HOP_COMPONENT_H
+#define ESP32_CSI_CHANNEL_HOP_COMPONENT_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+
+#include "csi_component.h"
+#include "channel_scheduler_component.h"
+#include "command_component.h"
+
+/*
+ * Sweeps the channels of a table (see `channel_scheduler_component.h`) from a task of its own,
+ * so neither the Wi-Fi driver task running the CSI callback nor the writer task ever wait for a channel switch.
+ */
+
+#define CHANNEL_HOP_TASK_STACK_SIZE 2048
+// above the CSI writer, so dwell times do not stretch while it formats a burst of frames
+#define CHANNEL_HOP_TASK_PRIORITY 12
+#define CHANNEL_HOP_TASK_CORE 1
+
+channel_scheduler_t channel_scheduler;
+TaskHandle_t channel_hop_handle = NULL;
+// for tables given to `CHANNEL`
+uint32_t channel_hop_default_dwell_ms = 0;
+
+void _channel_hop_timer_cb(void *arg) {
+    xTaskNotifyGive((TaskHandle_t) arg);
+}
+
+void channel_hop_task(void *pvParameters) {
+    // the tick would add up to 1 ms to every dwell, which matters for short ones, so waits sleep on an esp_timer
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = &_channel_hop_timer_cb;
+    timer_args.arg = xTaskGetCurrentTaskHandle();
+    timer_args.name = "channel_hop";
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+
+    while (true) {
+        int entry = channel_scheduler_next(&channel_scheduler, esp_timer_get_time());
+        esp_wifi_set_channel(channel_scheduler.entries[entry].channel, WIFI_SECOND_CHAN_NONE);
+        channel_scheduler_switched(&channel_scheduler, esp_timer_get_time());
+
+        int64_t wait_us;
+        while ((wait_us = channel_scheduler_wait_us(&channel_scheduler, esp_timer_get_time())) > 0) {
+            esp_timer_stop(timer);
+            esp_timer_start_once(timer, wait_us);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+
+/*
+ * Starts sweeping the channels of `table`. False (and the channel is left alone) if the table is not valid.
+ */
+bool channel_hop_start(const char *table, uint32_t default_dwell_ms) {
+    if (!channel_scheduler_parse(&channel_scheduler, table, default_dwell_ms)) {
+        return false;
+    }
+    csi_channel_scheduler = &channel_scheduler;
+    xTaskCreatePinnedToCore(&channel_hop_task, "channel_hop", CHANNEL_HOP_TASK_STACK_SIZE, NULL,
+                            CHANNEL_HOP_TASK_PRIORITY, &channel_hop_handle, CHANNEL_HOP_TASK_CORE);
+    return true;
+}
+
+/*
+ * `CHANNEL <channel>` listens to a single channel, `CHANNEL <table>` starts sweeping the table. A running sweep owns
+ * the channel, so neither works once one has started.
+ */
+bool _channel_hop_command(const char *args, csi_format_buffer_t *reply) {
+    if (channel_hop_handle != NULL) {
+        csi_format_str(reply, "the channels are being swept");
+        return false;
+    }
+    const char *p = args;
+    uint32_t channel;
+    if (command_parse_uint(&p, CHANNEL_SCHEDULER_MAX_CHANNELS, &channel) && *p == '\0' && channel >= 1) {
+        if (esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE) != ESP_OK) {
+            csi_format_str(reply, "channel not allowed");
+            return false;
+        }
+        return true;
+    }
+    if (!channel_hop_start(args, channel_hop_default_dwell_ms)) {
+        csi_format_str(reply, "expected a channel or a channel table");
+        return false;
+    }
+    return true;
+}
+
+void channel_hop_register_command(uint32_t default_dwell_ms) {
+    channel_hop_default_dwell_ms = default_dwell_ms;
+    command_register("CHANNEL", &_channel_hop_command,
+                     "CHANNEL <channel>|<table>  listens to a channel, or sweeps a table of them");
+}
+
+#endif //ESP32_CSI_CHANNEL_HOP_COMPONENT_H
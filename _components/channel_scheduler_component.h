@@ -0,0 +1,169 @@
+#ifndef ESP32_CSI_CHANNEL_SCHEDULER_COMPONENT_H
+#define ESP32_CSI_CHANNEL_SCHEDULER_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/*
+ * Channel sweep for passive capture: which channel to listen to next, and for how long.
+ *
+ * The channel table is a comma separated list of `<channel>[:<dwell ms>[:<priority>]]`, e.g. "1,6:400:3,11".
+ * Entries without a dwell time use the default one, entries without a priority get 1.
+ * A channel with priority p is visited p times as often as one with priority 1, and visits are spread out
+ * evenly (smooth weighted round robin), so e.g. "1,6::2" gives 6,1,6,6,1,6,...
+ *
+ * Time is passed in by the caller, so the sweep can be run against a simulated clock on the host.
+ * `channel_hop_component.h` does the actual `esp_wifi_set_channel()` calls; this header only needs `<atomic>`.
+ */
+
+#define CHANNEL_SCHEDULER_MAX_CHANNELS 14
+#define CHANNEL_SCHEDULER_MIN_DWELL_MS 10
+#define CHANNEL_SCHEDULER_MAX_DWELL_MS 60000
+#define CHANNEL_SCHEDULER_MAX_PRIORITY 100
+
+typedef struct {
+    uint8_t channel;
+    uint32_t dwell_ms;
+    uint32_t priority;
+    // smooth weighted round robin state
+    int32_t current;
+
+    // Written by the task switching channels, taken by whoever reports them (see `channel_scheduler_take()`).
+    std::atomic<uint32_t> visits;
+    std::atomic<uint32_t> dwell_us;
+} channel_scheduler_entry_t;
+
+typedef struct {
+    channel_scheduler_entry_t entries[CHANNEL_SCHEDULER_MAX_CHANNELS];
+    int count;
+    int32_t total_priority;
+    // entry listened to now, -1 before the first switch
+    int active;
+    int64_t dwell_start_us;
+    int64_t deadline_us;
+} channel_scheduler_t;
+
+// Reads an unsigned number of at most `max`, advancing `*p`. False if there are no digits or it is too large.
+bool _channel_scheduler_number(const char **p, uint32_t max, uint32_t *out) {
+    const char *s = *p;
+    uint32_t v = 0;
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+        if (v > max) {
+            return false;
+        }
+    }
+    if (s == *p) {
+        return false;
+    }
+    *p = s;
+    *out = v;
+    return true;
+}
+
+/*
+ * Parses `table` (see the top of this file). False, leaving `s` empty, if it is malformed, names a channel twice
+ * or a channel outside 1-14.
+ */
+bool channel_scheduler_parse(channel_scheduler_t *s, const char *table, uint32_t default_dwell_ms) {
+    s->count = 0;
+    s->total_priority = 0;
+    s->active = -1;
+    s->dwell_start_us = 0;
+    s->deadline_us = 0;
+    const char *p = table;
+    while (*p != '\0') {
+        while (*p == ' ') {
+            p++;
+        }
+        uint32_t channel, dwell_ms = default_dwell_ms, priority = 1;
+        bool ok = s->count < CHANNEL_SCHEDULER_MAX_CHANNELS
+                  && _channel_scheduler_number(&p, CHANNEL_SCHEDULER_MAX_CHANNELS, &channel) && channel >= 1;
+        if (ok && *p == ':') {
+            p++;
+            // "6::2" keeps the default dwell time
+            if (*p != ':') {
+                ok = _channel_scheduler_number(&p, CHANNEL_SCHEDULER_MAX_DWELL_MS, &dwell_ms);
+            }
+            if (ok && *p == ':') {
+                p++;
+                ok = _channel_scheduler_number(&p, CHANNEL_SCHEDULER_MAX_PRIORITY, &priority) && priority >= 1;
+            }
+        }
+        while (ok && *p == ' ') {
+            p++;
+        }
+        ok = ok && (*p == ',' || *p == '\0') && dwell_ms >= CHANNEL_SCHEDULER_MIN_DWELL_MS
+             && dwell_ms <= CHANNEL_SCHEDULER_MAX_DWELL_MS;
+        for (int i = 0; ok && i < s->count; i++) {
+            ok = s->entries[i].channel != channel;
+        }
+        if (!ok) {
+            s->count = 0;
+            s->total_priority = 0;
+            return false;
+        }
+        channel_scheduler_entry_t *e = &s->entries[s->count++];
+        e->channel = (uint8_t) channel;
+        e->dwell_ms = dwell_ms;
+        e->priority = priority;
+        e->current = 0;
+        e->visits.store(0);
+        e->dwell_us.store(0);
+        s->total_priority += priority;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    return s->count > 0;
+}
+
+/*
+ * Ends the current dwell at `now_us` and picks the entry to listen to next, whose channel the caller
+ * then switches to before calling `channel_scheduler_switched()`.
+ */
+int channel_scheduler_next(channel_scheduler_t *s, int64_t now_us) {
+    if (s->active >= 0) {
+        int64_t dwell_us = now_us - s->dwell_start_us;
+        channel_scheduler_entry_t *e = &s->entries[s->active];
+        e->dwell_us.fetch_add(dwell_us > 0 ? (uint32_t) dwell_us : 0, std::memory_order_relaxed);
+        e->visits.fetch_add(1, std::memory_order_relaxed);
+    }
+    int best = 0;
+    for (int i = 0; i < s->count; i++) {
+        s->entries[i].current += s->entries[i].priority;
+        if (s->entries[i].current > s->entries[best].current) {
+            best = i;
+        }
+    }
+    s->entries[best].current -= s->total_priority;
+    s->active = best;
+    return best;
+}
+
+/*
+ * The channel of the entry picked by `channel_scheduler_next()` is set: its dwell starts now.
+ */
+void channel_scheduler_switched(channel_scheduler_t *s, int64_t now_us) {
+    s->dwell_start_us = now_us;
+    s->deadline_us = now_us + (int64_t) s->entries[s->active].dwell_ms * 1000;
+}
+
+/*
+ * Microseconds until the current dwell is over, 0 or less if it is over now.
+ */
+int64_t channel_scheduler_wait_us(const channel_scheduler_t *s, int64_t now_us) {
+    return s->deadline_us - now_us;
+}
+
+/*
+ * Visits and microseconds spent on `entry` in the dwells completed since the previous call, which resets them.
+ * Safe to call from another task than the one switching channels.
+ */
+void channel_scheduler_take(channel_scheduler_t *s, int entry, uint32_t *visits, uint32_t *dwell_us) {
+    *visits = s->entries[entry].visits.exchange(0, std::memory_order_relaxed);
+    *dwell_us = s->entries[entry].dwell_us.exchange(0, std::memory_order_relaxed);
+}
+
+#endif //ESP32_CSI_CHANNEL_SCHEDULER_COMPONENT_H
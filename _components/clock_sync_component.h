@@ -0,0 +1,320 @@
+#ifndef ESP32_CSI_CLOCK_SYNC_COMPONENT_H
+#define ESP32_CSI_CLOCK_SYNC_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_binary_component.h"
+
+/*
+ * Clock synchronisation between collecting nodes and a server (the AP, or `cpp_utils/csi_time_server`).
+ *
+ * A node sends a request stamped with its steady clock (t1), the server stamps its real clock when the request
+ * arrives (t2) and when the reply leaves (t3), and the node stamps the reply's arrival (t4), as in NTP. Each
+ * exchange measures the offset of the server's clock at the middle of the exchange, wrong by at most half the
+ * round trip delay. A linear regression over the last `CLOCK_SYNC_WINDOW` exchanges with the lowest delays then
+ * gives the offset and the drift of the node's clock, which `clock_model_t` extrapolates to every CSI frame.
+ *
+ * Datagrams (all integers little endian):
+ *
+ *   request: magic "CSIT" | type 1 (u8) | reserved[3] | sequence (u32) | t1 (i64)
+ *   reply:   magic "CSIT" | type 2 (u8) | flags (u8) | reserved[2] | sequence (u32) | t1 (i64) | t2 (i64) | t3 (i64)
+ *
+ * `flags` bit 0 is set if the server's real time was set, otherwise its clock counts from boot (which still gives
+ * the nodes a common time base).
+ *
+ * The sockets are in `sockets_component.h`.
+ */
+
+#define CLOCK_SYNC_PORT 2224
+#define CLOCK_SYNC_REQUEST_SIZE 20
+#define CLOCK_SYNC_REPLY_SIZE 36
+#define CLOCK_SYNC_REQUEST 1
+#define CLOCK_SYNC_REPLY 2
+#define CLOCK_SYNC_FLAG_REAL_TIME_SET 0x01
+
+// exchanges the estimate is fitted to
+#define CLOCK_SYNC_WINDOW 32
+// exchanges slower than the fastest in the window by more than half of it plus this are left out of the fit
+#define CLOCK_SYNC_DELAY_MARGIN_US 500
+// drift is only fitted to exchanges spread over at least this long, before that it is taken as unknown
+#define CLOCK_SYNC_MIN_SPAN_US 3000000
+// largest drift believed, an ESP32 crystal is specified to +-10 ppm (plus ageing and temperature)
+#define CLOCK_SYNC_MAX_DRIFT_PPM 500
+// how fast the drift itself may change between exchanges, added to the growth of the uncertainty
+#define CLOCK_SYNC_WANDER_PPB 200
+// consecutive exchanges which disagree with the estimate before it is dropped (e.g. the server's clock was set)
+#define CLOCK_SYNC_STEP_EXCHANGES 3
+
+static const uint8_t CLOCK_SYNC_MAGIC[4] = {'C', 'S', 'I', 'T'};
+
+/*
+ * A remote clock as seen from a local one: `remote = local + offset + drift * (local - local_us)`, anchored at
+ * `local_us`, and how far off that may be.
+ */
+typedef struct {
+    int64_t local_us;
+    // remote time at `local_us`
+    int64_t remote_us;
+    // remote microseconds gained per local microsecond, in units of 2^-32 (10 ppm is about 42950)
+    int64_t drift_q32;
+    // bound on the error at `local_us`, 0 if nothing is known about it
+    uint32_t uncertainty_us;
+    // growth of the bound per local microsecond away from `local_us`, in units of 2^-32
+    uint32_t uncertainty_growth_q32;
+} clock_model_t;
+
+typedef struct {
+    // middle of the exchange on the local clock
+    int64_t local_us;
+    // remote minus local
+    int64_t offset_us;
+    // round trip time without the time the server held the request
+    uint32_t delay_us;
+} clock_sync_sample_t;
+
+typedef struct {
+    clock_sync_sample_t samples[CLOCK_SYNC_WINDOW];
+    int count;
+    int next;
+    bool valid;
+    clock_model_t model;
+    // part of the model, as a double for the next fit
+    double drift;
+    bool drift_fitted;
+    int disagreeing;
+
+    // since `clock_sync_init()`
+    uint32_t exchanges;
+    uint32_t rejected;
+    uint32_t steps;
+    // of the last fit
+    int fitted;
+    uint32_t min_delay_us;
+} clock_sync_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint32_t sequence;
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+} clock_sync_message_t;
+
+int64_t _clock_sync_mul_q32(int64_t v, int64_t q32) {
+    // arithmetic shift, so negative products round down like positive ones
+    return (v * q32) >> 32;
+}
+
+/*
+ * The remote time at `local_us`. Two multiplications, so it can run for every frame.
+ */
+int64_t clock_model_remote_us(const clock_model_t *m, int64_t local_us) {
+    int64_t elapsed = local_us - m->local_us;
+    return m->remote_us + elapsed + _clock_sync_mul_q32(elapsed, m->drift_q32);
+}
+
+/*
+ * Bound on the error of `clock_model_remote_us()` at `local_us`, 0 if unknown.
+ */
+uint32_t clock_model_uncertainty_us(const clock_model_t *m, int64_t local_us) {
+    if (m->uncertainty_us == 0) {
+        return 0;
+    }
+    int64_t elapsed = local_us - m->local_us;
+    int64_t bound = m->uncertainty_us + _clock_sync_mul_q32(elapsed < 0 ? -elapsed : elapsed,
+                                                            m->uncertainty_growth_q32);
+    return bound > UINT32_MAX ? UINT32_MAX : (uint32_t) bound;
+}
+
+/*
+ * A model without drift or bound, for a clock set once (e.g. by `SETTIME`).
+ */
+void clock_model_set(clock_model_t *m, int64_t local_us, int64_t remote_us) {
+    memset(m, 0, sizeof(*m));
+    m->local_us = local_us;
+    m->remote_us = remote_us;
+}
+
+size_t clock_sync_encode_request(uint8_t *out, uint32_t sequence, int64_t t1) {
+    memcpy(out, CLOCK_SYNC_MAGIC, 4);
+    out[4] = CLOCK_SYNC_REQUEST;
+    memset(out + 5, 0, 3);
+    _csi_binary_put_u32(out + 8, sequence);
+    _csi_binary_put_u64(out + 12, (uint64_t) t1);
+    return CLOCK_SYNC_REQUEST_SIZE;
+}
+
+/*
+ * The reply to `request`, with t3 left to `clock_sync_stamp_reply()` just before it is sent. 0 if `request` is not
+ * a request.
+ */
+size_t clock_sync_encode_reply(uint8_t *out, const uint8_t *request, size_t len, int64_t t2, uint8_t flags) {
+    if (len != CLOCK_SYNC_REQUEST_SIZE || memcmp(request, CLOCK_SYNC_MAGIC, 4) != 0
+        || request[4] != CLOCK_SYNC_REQUEST) {
+        return 0;
+    }
+    memcpy(out, request, CLOCK_SYNC_REQUEST_SIZE);
+    out[4] = CLOCK_SYNC_REPLY;
+    out[5] = flags;
+    _csi_binary_put_u64(out + 20, (uint64_t) t2);
+    _csi_binary_put_u64(out + 28, 0);
+    return CLOCK_SYNC_REPLY_SIZE;
+}
+
+void clock_sync_stamp_reply(uint8_t *reply, int64_t t3) {
+    _csi_binary_put_u64(reply + 28, (uint64_t) t3);
+}
+
+/*
+ * Reads a request or reply. False if `p` is neither.
+ */
+bool clock_sync_parse(const uint8_t *p, size_t len, clock_sync_message_t *out) {
+    if (len < CLOCK_SYNC_REQUEST_SIZE || memcmp(p, CLOCK_SYNC_MAGIC, 4) != 0) {
+        return false;
+    }
+    out->type = p[4];
+    out->flags = p[5];
+    out->sequence = _csi_binary_get_u32(p + 8);
+    out->t1 = (int64_t) _csi_binary_get_u64(p + 12);
+    if (out->type == CLOCK_SYNC_REQUEST) {
+        out->t2 = out->t3 = 0;
+        return len == CLOCK_SYNC_REQUEST_SIZE;
+    }
+    if (out->type != CLOCK_SYNC_REPLY || len != CLOCK_SYNC_REPLY_SIZE) {
+        return false;
+    }
+    out->t2 = (int64_t) _csi_binary_get_u64(p + 20);
+    out->t3 = (int64_t) _csi_binary_get_u64(p + 28);
+    return true;
+}
+
+void clock_sync_init(clock_sync_t *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+/*
+ * Fits offset and drift to the exchanges in the window with the lowest delays, anchored at the newest of those.
+ */
+void _clock_sync_fit(clock_sync_t *s) {
+    uint32_t min_delay = UINT32_MAX;
+    for (int i = 0; i < s->count; i++) {
+        if (s->samples[i].delay_us < min_delay) {
+            min_delay = s->samples[i].delay_us;
+        }
+    }
+    uint32_t max_delay = min_delay + min_delay / 2 + CLOCK_SYNC_DELAY_MARGIN_US;
+
+    // centred on the anchor and its offset, so doubles keep sub-microsecond resolution
+    const clock_sync_sample_t *anchor = NULL;
+    int64_t first_us = INT64_MAX;
+    for (int i = 0; i < s->count; i++) {
+        const clock_sync_sample_t *sample = &s->samples[i];
+        if (sample->delay_us <= max_delay) {
+            anchor = anchor == NULL || sample->local_us > anchor->local_us ? sample : anchor;
+            first_us = sample->local_us < first_us ? sample->local_us : first_us;
+        }
+    }
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < s->count; i++) {
+        const clock_sync_sample_t *sample = &s->samples[i];
+        if (sample->delay_us > max_delay) {
+            continue;
+        }
+        double x = (double) (sample->local_us - anchor->local_us);
+        double y = (double) (sample->offset_us - anchor->offset_us);
+        n++;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    int64_t span_us = anchor->local_us - first_us;
+    double denominator = n * sxx - sx * sx;
+    s->drift_fitted = n >= 3 && span_us >= CLOCK_SYNC_MIN_SPAN_US && denominator > 0;
+    if (s->drift_fitted) {
+        s->drift = (n * sxy - sx * sy) / denominator;
+        double max_drift = CLOCK_SYNC_MAX_DRIFT_PPM * 1e-6;
+        s->drift = s->drift > max_drift ? max_drift : (s->drift < -max_drift ? -max_drift : s->drift);
+    }
+    double intercept = (sy - s->drift * sx) / n;
+
+    // The true offset is within half the delay of each measured one, so where the fit passes a measurement it is
+    // off by at most that plus the residual. With the drift constant the error changes linearly, so it stays
+    // within the largest of those over the span of the fit, and beyond it grows by at most twice that per span.
+    double uncertainty = 0;
+    for (int i = 0; i < s->count; i++) {
+        const clock_sync_sample_t *sample = &s->samples[i];
+        if (sample->delay_us > max_delay) {
+            continue;
+        }
+        double x = (double) (sample->local_us - anchor->local_us);
+        double residual = (double) (sample->offset_us - anchor->offset_us) - (intercept + s->drift * x);
+        double bound = (residual < 0 ? -residual : residual) + sample->delay_us / 2.0;
+        uncertainty = bound > uncertainty ? bound : uncertainty;
+    }
+    uncertainty += 1;
+    // until the drift is fitted, it can be anything believable
+    double growth = CLOCK_SYNC_WANDER_PPB * 1e-9
+                    + (s->drift_fitted ? 2 * uncertainty / span_us : CLOCK_SYNC_MAX_DRIFT_PPM * 1e-6);
+
+    clock_model_t *m = &s->model;
+    m->local_us = anchor->local_us;
+    m->remote_us = anchor->local_us + anchor->offset_us + (int64_t) (intercept + (intercept < 0 ? -0.5 : 0.5));
+    m->drift_q32 = (int64_t) (s->drift * 4294967296.0);
+    m->uncertainty_us = uncertainty > UINT32_MAX ? UINT32_MAX : (uint32_t) uncertainty;
+    m->uncertainty_growth_q32 = (uint32_t) (growth * 4294967296.0);
+    s->fitted = (int) n;
+    s->min_delay_us = min_delay;
+    s->valid = true;
+}
+
+/*
+ * Adds one exchange: t1 and t4 on the local clock, t2 and t3 on the remote one. True if `model` was updated,
+ * false if the exchange was rejected.
+ */
+bool clock_sync_add(clock_sync_t *s, int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    s->exchanges++;
+    int64_t round_trip = t4 - t1;
+    int64_t held = t3 - t2;
+    if (round_trip < 0 || held < 0 || held > round_trip || round_trip > UINT32_MAX) {
+        s->rejected++;
+        return false;
+    }
+
+    clock_sync_sample_t sample;
+    sample.local_us = t1 + round_trip / 2;
+    // ((t2 - t1) + (t3 - t4)) / 2, without overflowing on epoch times
+    sample.offset_us = (t2 - t1) + ((t3 - t2) - (t4 - t1)) / 2;
+    sample.delay_us = (uint32_t) (round_trip - held);
+
+    if (s->valid) {
+        int64_t predicted = clock_model_remote_us(&s->model, sample.local_us) - sample.local_us;
+        int64_t deviation = sample.offset_us - predicted;
+        int64_t allowed = (int64_t) clock_model_uncertainty_us(&s->model, sample.local_us) + sample.delay_us / 2;
+        if (deviation > allowed || deviation < -allowed) {
+            if (++s->disagreeing < CLOCK_SYNC_STEP_EXCHANGES) {
+                s->rejected++;
+                return false;
+            }
+            // the clocks stepped: start over from this exchange
+            s->count = 0;
+            s->next = 0;
+            s->steps++;
+        }
+    }
+    s->disagreeing = 0;
+
+    s->samples[s->next] = sample;
+    s->next = (s->next + 1) % CLOCK_SYNC_WINDOW;
+    if (s->count < CLOCK_SYNC_WINDOW) {
+        s->count++;
+    }
+    _clock_sync_fit(s);
+    return true;
+}
+
+#endif //ESP32_CSI_CLOCK_SYNC_COMPONENT_H
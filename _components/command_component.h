@@ -0,0 +1,222 @@
+#ifndef ESP32_CSI_COMMAND_COMPONENT_H
+#define ESP32_CSI_COMMAND_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_format_component.h"
+#include "command_frame_component.h"
+
+/*
+ * Runtime commands: a table of named handlers, and the request/reply format on top of `command_frame_component.h`.
+ *
+ * A framed request's payload is `<id> <NAME>[ <arguments>]`, with `id` a number chosen by the sender. The reply is a
+ * frame with the payload `<id> OK[ <text>]` or `<id> ERR <text>`, so the sender can match it to its request.
+ *
+ * Typed by hand, a command is a plain line `<NAME>[:] [<arguments>]` (e.g. `SETTIME: 1700000000` or
+ * `FILTER: ALLOW; ADD 24:0a:c4:00:00:01`), and the reply is a plain `<NAME>: OK[ <text>]` or `<NAME>: ERR <text>` line.
+ *
+ * Handlers are registered by the sub-projects (`input_component.h`).
+ */
+
+#define COMMAND_MAX_COMMANDS 16
+
+/*
+ * Runs a command. `args` is NUL terminated, without leading spaces. Text appended to `reply` follows the OK or ERR.
+ * True for OK.
+ */
+typedef bool (*command_handler_t)(const char *args, csi_format_buffer_t *reply);
+
+typedef struct {
+    const char *name;
+    command_handler_t handler;
+    // one line for `HELP`
+    const char *usage;
+} command_t;
+
+command_t commands[COMMAND_MAX_COMMANDS];
+int command_count = 0;
+
+/*
+ * Adds (or replaces) a command. `name` is upper case letters and '_' only. False if the table is full.
+ */
+bool command_register(const char *name, command_handler_t handler, const char *usage) {
+    for (int i = 0; i < command_count; i++) {
+        if (strcmp(commands[i].name, name) == 0) {
+            commands[i].handler = handler;
+            commands[i].usage = usage;
+            return true;
+        }
+    }
+    if (command_count >= COMMAND_MAX_COMMANDS) {
+        return false;
+    }
+    commands[command_count++] = {name, handler, usage};
+    return true;
+}
+
+const command_t *command_find(const char *name, size_t len) {
+    for (int i = 0; i < command_count; i++) {
+        if (strncmp(commands[i].name, name, len) == 0 && commands[i].name[len] == '\0') {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Reads an unsigned decimal number of at most `max` for a handler, advancing `*p`. False if there are no digits or it
+ * is too large.
+ */
+bool command_parse_uint(const char **p, uint32_t max, uint32_t *out) {
+    const char *s = *p;
+    uint64_t v = 0;
+    while (*s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+        if (v > max) {
+            return false;
+        }
+    }
+    if (s == *p) {
+        return false;
+    }
+    *p = s;
+    *out = (uint32_t) v;
+    return true;
+}
+
+size_t _command_name_len(const char *s) {
+    size_t n = 0;
+    while ((s[n] >= 'A' && s[n] <= 'Z') || s[n] == '_') {
+        n++;
+    }
+    return n;
+}
+
+const char *_command_skip_spaces(const char *s) {
+    while (*s == ' ') {
+        s++;
+    }
+    return s;
+}
+
+/*
+ * Runs the command named at the start of `s` (followed by the end, a space or ':'). NULL if there is none.
+ */
+const command_t *_command_run(const char *s, csi_format_buffer_t *text, bool *ok) {
+    size_t n = _command_name_len(s);
+    if (n == 0 || (s[n] != '\0' && s[n] != ' ' && s[n] != ':')) {
+        return NULL;
+    }
+    const command_t *command = command_find(s, n);
+    if (command == NULL) {
+        return NULL;
+    }
+    const char *args = s + n;
+    if (*args == ':') {
+        args++;
+    }
+    csi_format_reset(text);
+    *ok = command->handler(_command_skip_spaces(args), text);
+    // multi-line text ends without a line break, which the reply adds
+    while (text->len > 0 && text->buf[text->len - 1] == '\n') {
+        text->len--;
+    }
+    return command;
+}
+
+void _command_reply(csi_format_buffer_t *out, bool ok, const csi_format_buffer_t *text) {
+    csi_format_str(out, ok ? "OK" : "ERR");
+    if (text->len > 0) {
+        csi_format_char(out, ' ');
+        csi_format_append(out, text->buf, text->len);
+    }
+}
+
+/*
+ * Runs the request in a frame payload and writes the reply frame to `out`. `text` is scratch space.
+ */
+void command_dispatch_frame(const char *payload, size_t len, csi_format_buffer_t *text, csi_format_buffer_t *out) {
+    // the id is echoed as it was sent
+    size_t i = 0;
+    while (i < len && i < 10 && payload[i] >= '0' && payload[i] <= '9') {
+        i++;
+    }
+    bool id_ok = i > 0 && i < len && payload[i] == ' ';
+    bool ok = false;
+    const command_t *command = NULL;
+    // a NUL inside the payload would hide the rest of it from the handler
+    bool well_formed = id_ok && strlen(payload) == len;
+    if (well_formed) {
+        command = _command_run(_command_skip_spaces(payload + i), text, &ok);
+    }
+    if (command == NULL) {
+        csi_format_reset(text);
+        csi_format_str(text, well_formed ? "unknown command" : "malformed request");
+    }
+
+    // `<id> OK|ERR[ <text>]`, the text cut short if it does not fit into a frame
+    char prefix[16] = "0";
+    size_t prefix_len = id_ok ? i : 1;
+    memcpy(prefix, id_ok ? payload : "0", prefix_len);
+    const char *status = ok ? " OK" : " ERR";
+    memcpy(prefix + prefix_len, status, strlen(status));
+    prefix_len += strlen(status);
+    size_t text_len = text->len;
+    if (prefix_len + 1 + text_len > COMMAND_FRAME_MAX_PAYLOAD) {
+        text_len = COMMAND_FRAME_MAX_PAYLOAD - prefix_len - 1;
+    }
+
+    csi_format_reset(out);
+    size_t start = command_frame_begin(out, prefix_len + (text_len > 0 ? 1 + text_len : 0));
+    csi_format_append(out, prefix, prefix_len);
+    if (text_len > 0) {
+        csi_format_char(out, ' ');
+        csi_format_append(out, text->buf, text_len);
+    }
+    command_frame_end(out, start);
+}
+
+/*
+ * Runs a command typed as a plain line and writes the plain reply line to `out`. False (and `out` is empty) if the
+ * line does not start with the name of a command.
+ */
+bool command_dispatch_line(const char *line, csi_format_buffer_t *text, csi_format_buffer_t *out) {
+    csi_format_reset(out);
+    bool ok;
+    const command_t *command = _command_run(_command_skip_spaces(line), text, &ok);
+    if (command == NULL) {
+        return false;
+    }
+    csi_format_str(out, command->name);
+    csi_format_str(out, ": ");
+    _command_reply(out, ok, text);
+    csi_format_char(out, '\n');
+    return true;
+}
+
+bool _command_ping(const char *args, csi_format_buffer_t *reply) {
+    // echoed, so a sender can tell replies to back to back pings apart by content as well
+    csi_format_str(reply, args);
+    return true;
+}
+
+bool _command_help(const char *args, csi_format_buffer_t *reply) {
+    (void) args;
+    for (int i = 0; i < command_count; i++) {
+        csi_format_str(reply, commands[i].usage);
+        csi_format_char(reply, '\n');
+    }
+    return true;
+}
+
+/*
+ * Starts the table with the commands every project has.
+ */
+void command_register_builtin() {
+    command_register("PING", &_command_ping, "PING [text]  replies with the text");
+    command_register("HELP", &_command_help, "HELP  lists the commands");
+}
+
+#endif //ESP32_CSI_COMMAND_COMPONENT_H
@@ -0,0 +1,289 @@
+#ifndef ESP32_CSI_COMMAND_FRAME_COMPONENT_H
+#define ESP32_CSI_COMMAND_FRAME_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_format_component.h"
+
+/*
+ * Framing of commands sent to the ESP32 over the serial port, and of its replies:
+ *
+ *   $<length>:<payload>*<crc>\n
+ *
+ * `length` is the number of payload bytes in decimal (1 to `COMMAND_FRAME_MAX_PAYLOAD`, no leading zeros), `crc` the
+ * CRC-16/CCITT-FALSE of the payload as 4 upper case hex digits. A '\r' before the '\n' is ignored. The payload may
+ * contain any byte, since the length says where it ends. A frame which is cut short, too long or fails its CRC is
+ * dropped up to the end of its line, and the next line starts afresh.
+ *
+ * Lines which do not start with '$' are handed over as they are (without the line break), so commands can also be
+ * typed by hand into `idf.py monitor`.
+ *
+ * The parser takes the bytes as they arrive, in chunks of any size, and keeps a frame's payload in its own buffer,
+ * where it is handed to the caller: nothing is allocated or copied again.
+ */
+
+// replies can be long (e.g. a filter's MAC list), requests are short
+#define COMMAND_FRAME_MAX_PAYLOAD 2048
+// longest plain text line
+#define COMMAND_FRAME_MAX_LINE 256
+
+typedef enum {
+    COMMAND_FRAME_NONE,
+    // `payload` holds a complete, checked frame payload of `len` bytes
+    COMMAND_FRAME_PAYLOAD,
+    // `payload` holds a plain text line of `len` bytes
+    COMMAND_FRAME_LINE,
+    // a frame or line was dropped, see `error`
+    COMMAND_FRAME_ERROR,
+} command_frame_event_t;
+
+typedef enum {
+    _COMMAND_FRAME_LINE_START,
+    _COMMAND_FRAME_LENGTH,
+    _COMMAND_FRAME_PAYLOAD,
+    _COMMAND_FRAME_STAR,
+    _COMMAND_FRAME_CRC,
+    _COMMAND_FRAME_END,
+    _COMMAND_FRAME_TEXT,
+    // dropping the rest of a bad line
+    _COMMAND_FRAME_SKIP,
+} _command_frame_state_t;
+
+typedef struct {
+    _command_frame_state_t state;
+    size_t expected_len;
+    uint16_t crc;
+    uint16_t received_crc;
+    int crc_digits;
+
+    // NUL terminated, so it can be parsed as a string unless the payload itself contains a NUL
+    char payload[COMMAND_FRAME_MAX_PAYLOAD + 1];
+    size_t len;
+    const char *error;
+} command_frame_parser_t;
+
+static const uint16_t COMMAND_FRAME_CRC_TABLE[256] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD,
+        0xE1CE, 0xF1EF, 0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6, 0x9339, 0x8318, 0xB37B, 0xA35A,
+        0xD3BD, 0xC39C, 0xF3FF, 0xE3DE, 0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485, 0xA56A, 0xB54B,
+        0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D, 0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+        0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC, 0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861,
+        0x2802, 0x3823, 0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B, 0x5AF5, 0x4AD4, 0x7AB7, 0x6A96,
+        0x1A71, 0x0A50, 0x3A33, 0x2A12, 0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A, 0x6CA6, 0x7C87,
+        0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41, 0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+        0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70, 0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A,
+        0x9F59, 0x8F78, 0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F, 0x1080, 0x00A1, 0x30C2, 0x20E3,
+        0x5004, 0x4025, 0x7046, 0x6067, 0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E, 0x02B1, 0x1290,
+        0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256, 0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+        0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405, 0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E,
+        0xC71D, 0xD73C, 0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634, 0xD94C, 0xC96D, 0xF90E, 0xE92F,
+        0x99C8, 0x89E9, 0xB98A, 0xA9AB, 0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3, 0xCB7D, 0xDB5C,
+        0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A, 0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+        0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9, 0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83,
+        0x1CE0, 0x0CC1, 0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8, 0x6E17, 0x7E36, 0x4E55, 0x5E74,
+        0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+uint16_t command_frame_crc(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *) data;
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t) (crc << 8) ^ COMMAND_FRAME_CRC_TABLE[(crc >> 8) ^ p[i]];
+    }
+    return crc;
+}
+
+void command_frame_parser_reset(command_frame_parser_t *p) {
+    p->state = _COMMAND_FRAME_LINE_START;
+    p->len = 0;
+    p->payload[0] = '\0';
+    p->error = NULL;
+}
+
+command_frame_event_t _command_frame_fail(command_frame_parser_t *p, const char *error, char c) {
+    p->error = error;
+    p->len = 0;
+    // a line break ends the bad line right away
+    p->state = c == '\n' ? _COMMAND_FRAME_LINE_START : _COMMAND_FRAME_SKIP;
+    return COMMAND_FRAME_ERROR;
+}
+
+int _command_frame_hex(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/*
+ * Takes the next byte. Whatever the event, `payload` and `len` stay valid until the next call.
+ */
+command_frame_event_t command_frame_parser_push(command_frame_parser_t *p, char c) {
+    switch (p->state) {
+        case _COMMAND_FRAME_LINE_START:
+            p->len = 0;
+            if (c == '$') {
+                p->expected_len = 0;
+                p->state = _COMMAND_FRAME_LENGTH;
+            } else if (c != '\n' && c != '\r') {
+                p->payload[p->len++] = c;
+                p->state = _COMMAND_FRAME_TEXT;
+            }
+            return COMMAND_FRAME_NONE;
+
+        case _COMMAND_FRAME_LENGTH:
+            if (c >= '0' && c <= '9' && (p->expected_len > 0 || c != '0')) {
+                p->expected_len = p->expected_len * 10 + (c - '0');
+                if (p->expected_len > COMMAND_FRAME_MAX_PAYLOAD) {
+                    return _command_frame_fail(p, "frame too long", c);
+                }
+                return COMMAND_FRAME_NONE;
+            }
+            if (c != ':' || p->expected_len == 0) {
+                return _command_frame_fail(p, "bad frame length", c);
+            }
+            p->crc = 0xFFFF;
+            p->state = _COMMAND_FRAME_PAYLOAD;
+            return COMMAND_FRAME_NONE;
+
+        case _COMMAND_FRAME_PAYLOAD:
+            p->payload[p->len++] = c;
+            p->crc = (uint16_t) (p->crc << 8) ^ COMMAND_FRAME_CRC_TABLE[(p->crc >> 8) ^ (uint8_t) c];
+            if (p->len == p->expected_len) {
+                p->state = _COMMAND_FRAME_STAR;
+            }
+            return COMMAND_FRAME_NONE;
+
+        case _COMMAND_FRAME_STAR:
+            if (c != '*') {
+                return _command_frame_fail(p, "frame length does not match", c);
+            }
+            p->received_crc = 0;
+            p->crc_digits = 0;
+            p->state = _COMMAND_FRAME_CRC;
+            return COMMAND_FRAME_NONE;
+
+        case _COMMAND_FRAME_CRC: {
+            int digit = _command_frame_hex(c);
+            if (digit < 0) {
+                return _command_frame_fail(p, "bad frame checksum", c);
+            }
+            p->received_crc = (uint16_t) (p->received_crc << 4 | digit);
+            if (++p->crc_digits == 4) {
+                p->state = _COMMAND_FRAME_END;
+            }
+            return COMMAND_FRAME_NONE;
+        }
+
+        case _COMMAND_FRAME_END:
+            if (c == '\r') {
+                return COMMAND_FRAME_NONE;
+            }
+            if (c != '\n') {
+                return _command_frame_fail(p, "frame not followed by a line break", c);
+            }
+            p->state = _COMMAND_FRAME_LINE_START;
+            if (p->received_crc != p->crc) {
+                p->len = 0;
+                p->error = "frame checksum does not match";
+                return COMMAND_FRAME_ERROR;
+            }
+            p->payload[p->len] = '\0';
+            return COMMAND_FRAME_PAYLOAD;
+
+        case _COMMAND_FRAME_TEXT:
+            if (c == '\n') {
+                p->state = _COMMAND_FRAME_LINE_START;
+                if (p->len > 0 && p->payload[p->len - 1] == '\r') {
+                    p->len--;
+                }
+                p->payload[p->len] = '\0';
+                return COMMAND_FRAME_LINE;
+            }
+            if (p->len >= COMMAND_FRAME_MAX_LINE) {
+                return _command_frame_fail(p, "line too long", c);
+            }
+            p->payload[p->len++] = c;
+            return COMMAND_FRAME_NONE;
+
+        case _COMMAND_FRAME_SKIP:
+            if (c == '\n') {
+                p->state = _COMMAND_FRAME_LINE_START;
+            }
+            return COMMAND_FRAME_NONE;
+    }
+    return COMMAND_FRAME_NONE;
+}
+
+/*
+ * Takes bytes from `data` up to and including the first one completing an event, which is returned
+ * (`COMMAND_FRAME_NONE` once all of them are taken). `*consumed` is the number of bytes taken.
+ */
+command_frame_event_t command_frame_parser_feed(command_frame_parser_t *p, const char *data, size_t len,
+                                                size_t *consumed) {
+    size_t i = 0;
+    while (i < len) {
+        // payload bytes are the bulk of a frame, so they skip the state dispatch
+        if (p->state == _COMMAND_FRAME_PAYLOAD) {
+            size_t n = p->expected_len - p->len;
+            if (n > len - i) {
+                n = len - i;
+            }
+            uint16_t crc = p->crc;
+            for (size_t j = 0; j < n; j++) {
+                crc = (uint16_t) (crc << 8) ^ COMMAND_FRAME_CRC_TABLE[(crc >> 8) ^ (uint8_t) data[i + j]];
+            }
+            memcpy(p->payload + p->len, data + i, n);
+            p->crc = crc;
+            p->len += n;
+            i += n;
+            if (p->len == p->expected_len) {
+                p->state = _COMMAND_FRAME_STAR;
+            }
+            continue;
+        }
+        command_frame_event_t event = command_frame_parser_push(p, data[i++]);
+        if (event != COMMAND_FRAME_NONE) {
+            *consumed = i;
+            return event;
+        }
+    }
+    *consumed = i;
+    return COMMAND_FRAME_NONE;
+}
+
+/*
+ * Appends the start of a frame with a `len` byte payload to `b`, and returns where the payload starts.
+ * The caller appends the payload, then calls `command_frame_end()`.
+ */
+size_t command_frame_begin(csi_format_buffer_t *b, size_t len) {
+    csi_format_char(b, '$');
+    csi_format_uint(b, (uint32_t) len);
+    csi_format_char(b, ':');
+    return b->len;
+}
+
+void command_frame_end(csi_format_buffer_t *b, size_t payload_start) {
+    uint16_t crc = command_frame_crc(b->buf + payload_start, b->len - payload_start);
+    csi_format_char(b, '*');
+    for (int shift = 12; shift >= 0; shift -= 4) {
+        csi_format_char(b, CSI_FORMAT_HEX_DIGITS[(crc >> shift) & 0xF]);
+    }
+    csi_format_char(b, '\n');
+}
+
+/*
+ * Appends `payload` as a frame to `b`.
+ */
+void command_frame_encode(csi_format_buffer_t *b, const char *payload, size_t len) {
+    size_t start = command_frame_begin(b, len);
+    csi_format_append(b, payload, len);
+    command_frame_end(b, start);
+}
+
+#endif //ESP32_CSI_COMMAND_FRAME_COMPONENT_H
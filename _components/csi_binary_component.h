@@ -0,0 +1,385 @@
+#ifndef ESP32_CSI_CSI_BINARY_COMPONENT_H
+#define ESP32_CSI_CSI_BINARY_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_format_component.h"
+
+/*
+ * Compact binary alternative to the `CSI_DATA,...` text lines (`CONFIG_CSI_OUTPUT_FORMAT_BINARY`).
+ *
+ * Every record is framed as (all integers little endian):
+ *
+ *   magic (0xC5 0x1D) | version (u8) | record type (u8) | payload length (u16) | payload | CRC-16/CCITT (u16)
+ *
+ * The CRC covers everything from the version byte to the end of the payload. Decoders resynchronise on the
+ * magic bytes, so boot logs or other text interleaved on the serial port are simply skipped.
+ *
+ * CSI record payload:
+ *
+ *   mac[6] | rssi (i8) | noise_floor (i8) | ampdu_cnt (u8) | rx_state (u8)
+ *   | rate:5 sig_mode:2 cwb:1 | mcs:7 sgi:1 | channel:4 secondary_channel:4
+ *   | smoothing:1 not_sounding:1 aggregation:1 stbc:2 fec_coding:1 ant:1 real_time_set:1
+ *   | sig_len (u16) | local_timestamp (u32) | real_timestamp_us (i64) | len (u16)
+ *   | real_time_uncertainty_us (u32) | raw CSI values (i8[])
+ *
+ * The number of CSI values is implied by the payload length.
+ *
+ * Delta coded CSI record payload (`csi_delta_component.h`):
+ *
+ *   the fields of a CSI record up to real_time_uncertainty_us | sequence (u8) | codec (u8) | value count (u16)
+ *   | coded CSI values
+ *
+ * Segment footer payload (last record of every SD card segment, see `sd_segment_component.h`):
+ *
+ *   segment (u32) | record count (u32) | first timestamp_us (i64) | last timestamp_us (i64)
+ *
+ * Text record payload: one complete text line (e.g. `CSI_STATS,...`) including its '\n', written out as is.
+ */
+
+#define CSI_BINARY_MAGIC_0 0xC5
+#define CSI_BINARY_MAGIC_1 0x1D
+#define CSI_BINARY_VERSION 1
+
+#define CSI_BINARY_RECORD_CSI 1
+#define CSI_BINARY_RECORD_DROPPED 2
+#define CSI_BINARY_RECORD_ROLE 3
+#define CSI_BINARY_RECORD_SEGMENT 4
+#define CSI_BINARY_RECORD_TEXT 5
+#define CSI_BINARY_RECORD_CSI_DELTA 6
+
+#define CSI_BINARY_HEADER_SIZE 6
+#define CSI_BINARY_CRC_SIZE 2
+#define CSI_BINARY_CSI_FIXED_SIZE 34
+#define CSI_BINARY_DELTA_HEADER_SIZE 4
+#define CSI_BINARY_SEGMENT_SIZE 24
+#define CSI_BINARY_MAX_ROLE_LEN 32
+#define CSI_BINARY_MAX_VALUES 612
+// a delta coded record which did not compress is the largest
+#define CSI_BINARY_MAX_PAYLOAD (CSI_BINARY_CSI_FIXED_SIZE + CSI_BINARY_DELTA_HEADER_SIZE + CSI_BINARY_MAX_VALUES)
+#define CSI_BINARY_MAX_RECORD_SIZE (CSI_BINARY_HEADER_SIZE + CSI_BINARY_MAX_PAYLOAD + CSI_BINARY_CRC_SIZE)
+
+static const uint16_t CSI_BINARY_CRC_TABLE[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/*
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), a nibble at a time to keep the table small.
+ */
+uint16_t csi_binary_crc16(uint16_t crc, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ CSI_BINARY_CRC_TABLE[((crc >> 12) ^ (data[i] >> 4)) & 0x0F];
+        crc = (crc << 4) ^ CSI_BINARY_CRC_TABLE[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F];
+    }
+    return crc;
+}
+
+void _csi_binary_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+void _csi_binary_put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (i * 8)) & 0xFF;
+    }
+}
+
+void _csi_binary_put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (v >> (i * 8)) & 0xFF;
+    }
+}
+
+uint16_t _csi_binary_get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t _csi_binary_get_u32(const uint8_t *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+uint64_t _csi_binary_get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/*
+ * Writes the frame header, leaving `payload_len` bytes for the caller, and returns a pointer to the payload.
+ */
+uint8_t *_csi_binary_begin(uint8_t *out, uint8_t type, uint16_t payload_len) {
+    out[0] = CSI_BINARY_MAGIC_0;
+    out[1] = CSI_BINARY_MAGIC_1;
+    out[2] = CSI_BINARY_VERSION;
+    out[3] = type;
+    _csi_binary_put_u16(out + 4, payload_len);
+    return out + CSI_BINARY_HEADER_SIZE;
+}
+
+size_t _csi_binary_end(uint8_t *out, uint16_t payload_len) {
+    size_t crc_offset = CSI_BINARY_HEADER_SIZE + payload_len;
+    _csi_binary_put_u16(out + crc_offset, csi_binary_crc16(0xFFFF, out + 2, crc_offset - 2));
+    return crc_offset + CSI_BINARY_CRC_SIZE;
+}
+
+/*
+ * The `CSI_BINARY_CSI_FIXED_SIZE` bytes in front of the values of CSI and delta coded CSI records.
+ */
+void _csi_binary_put_record(uint8_t *p, const csi_record_t *r) {
+    memcpy(p, r->mac, 6);
+    p[6] = (uint8_t) r->rssi;
+    p[7] = (uint8_t) r->noise_floor;
+    p[8] = r->ampdu_cnt;
+    p[9] = r->rx_state;
+    p[10] = (r->rate & 0x1F) | ((r->sig_mode & 0x03) << 5) | ((r->cwb & 0x01) << 7);
+    p[11] = (r->mcs & 0x7F) | ((r->sgi & 0x01) << 7);
+    p[12] = (r->channel & 0x0F) | ((r->secondary_channel & 0x0F) << 4);
+    p[13] = (r->smoothing & 0x01) | ((r->not_sounding & 0x01) << 1) | ((r->aggregation & 0x01) << 2)
+            | ((r->stbc & 0x03) << 3) | ((r->fec_coding & 0x01) << 5) | ((r->ant & 0x01) << 6)
+            | ((r->real_time_set & 0x01) << 7);
+    _csi_binary_put_u16(p + 14, r->sig_len);
+    _csi_binary_put_u32(p + 16, r->local_timestamp);
+    _csi_binary_put_u64(p + 20, (uint64_t) r->real_timestamp_us);
+    _csi_binary_put_u16(p + 28, r->len);
+    // reserved (always zero) before clock sync, which reads as an unknown bound
+    _csi_binary_put_u32(p + 30, r->real_time_uncertainty_us);
+}
+
+/*
+ * Each encoder returns the number of bytes written to `out`, or 0 if `cap` is too small.
+ */
+size_t csi_binary_encode_csi(uint8_t *out, size_t cap, const csi_record_t *r, const int8_t *values, uint16_t count) {
+    if (count > CSI_BINARY_MAX_VALUES) {
+        count = CSI_BINARY_MAX_VALUES;
+    }
+    uint16_t payload_len = CSI_BINARY_CSI_FIXED_SIZE + count;
+    if (cap < (size_t) CSI_BINARY_HEADER_SIZE + payload_len + CSI_BINARY_CRC_SIZE) {
+        return 0;
+    }
+
+    uint8_t *p = _csi_binary_begin(out, CSI_BINARY_RECORD_CSI, payload_len);
+    _csi_binary_put_record(p, r);
+    memcpy(p + CSI_BINARY_CSI_FIXED_SIZE, values, count);
+
+    return _csi_binary_end(out, payload_len);
+}
+
+size_t csi_binary_encode_dropped(uint8_t *out, size_t cap, uint32_t total, uint32_t since_last) {
+    const uint16_t payload_len = 8;
+    if (cap < CSI_BINARY_HEADER_SIZE + payload_len + CSI_BINARY_CRC_SIZE) {
+        return 0;
+    }
+    uint8_t *p = _csi_binary_begin(out, CSI_BINARY_RECORD_DROPPED, payload_len);
+    _csi_binary_put_u32(p, total);
+    _csi_binary_put_u32(p + 4, since_last);
+    return _csi_binary_end(out, payload_len);
+}
+
+size_t csi_binary_encode_role(uint8_t *out, size_t cap, const char *role) {
+    size_t role_len = strlen(role);
+    if (role_len > CSI_BINARY_MAX_ROLE_LEN) {
+        role_len = CSI_BINARY_MAX_ROLE_LEN;
+    }
+    if (cap < CSI_BINARY_HEADER_SIZE + role_len + CSI_BINARY_CRC_SIZE) {
+        return 0;
+    }
+    uint8_t *p = _csi_binary_begin(out, CSI_BINARY_RECORD_ROLE, role_len);
+    memcpy(p, role, role_len);
+    return _csi_binary_end(out, role_len);
+}
+
+size_t csi_binary_encode_segment(uint8_t *out, size_t cap, uint32_t segment, uint32_t records,
+                                 int64_t first_us, int64_t last_us) {
+    const uint16_t payload_len = CSI_BINARY_SEGMENT_SIZE;
+    if (cap < CSI_BINARY_HEADER_SIZE + payload_len + CSI_BINARY_CRC_SIZE) {
+        return 0;
+    }
+    uint8_t *p = _csi_binary_begin(out, CSI_BINARY_RECORD_SEGMENT, payload_len);
+    _csi_binary_put_u32(p, segment);
+    _csi_binary_put_u32(p + 4, records);
+    _csi_binary_put_u64(p + 8, (uint64_t) first_us);
+    _csi_binary_put_u64(p + 16, (uint64_t) last_us);
+    return _csi_binary_end(out, payload_len);
+}
+
+size_t csi_binary_encode_text(uint8_t *out, size_t cap, const char *text, size_t len) {
+    if (len > CSI_BINARY_MAX_PAYLOAD || cap < CSI_BINARY_HEADER_SIZE + len + CSI_BINARY_CRC_SIZE) {
+        return 0;
+    }
+    uint8_t *p = _csi_binary_begin(out, CSI_BINARY_RECORD_TEXT, len);
+    memcpy(p, text, len);
+    return _csi_binary_end(out, len);
+}
+
+typedef enum {
+    CSI_BINARY_DECODED,   // `consumed` bytes form the record in `out`
+    CSI_BINARY_NEED_MORE, // the buffer ends part way through a record, nothing consumed
+    CSI_BINARY_SKIPPED,   // `consumed` bytes are not (or not a valid) record and should be discarded
+} csi_binary_result_t;
+
+typedef struct {
+    uint8_t type;
+
+    // CSI_BINARY_RECORD_CSI, `values` points into the decoded buffer
+    csi_record_t record;
+    const int8_t *values;
+    uint16_t value_count;
+
+    // CSI_BINARY_RECORD_CSI_DELTA: `record` and `value_count` as above, the values still coded (`coded` points into
+    // the decoded buffer) until `csi_delta_decode()` turns the record into a CSI_BINARY_RECORD_CSI
+    uint8_t delta_sequence;
+    uint8_t delta_codec;
+    const uint8_t *coded;
+    uint16_t coded_len;
+
+    // CSI_BINARY_RECORD_DROPPED
+    uint32_t dropped_total;
+    uint32_t dropped_since_last;
+
+    // CSI_BINARY_RECORD_ROLE
+    char role[CSI_BINARY_MAX_ROLE_LEN + 1];
+
+    // CSI_BINARY_RECORD_SEGMENT
+    uint32_t segment;
+    uint32_t segment_records;
+    int64_t segment_first_us;
+    int64_t segment_last_us;
+
+    // CSI_BINARY_RECORD_TEXT, `text` points into the decoded buffer and is not NUL terminated
+    const char *text;
+    uint16_t text_len;
+} csi_binary_record_t;
+
+void _csi_binary_get_record(const uint8_t *p, csi_record_t *r) {
+    memcpy(r->mac, p, 6);
+    r->rssi = (int8_t) p[6];
+    r->noise_floor = (int8_t) p[7];
+    r->ampdu_cnt = p[8];
+    r->rx_state = p[9];
+    r->rate = p[10] & 0x1F;
+    r->sig_mode = (p[10] >> 5) & 0x03;
+    r->cwb = p[10] >> 7;
+    r->mcs = p[11] & 0x7F;
+    r->sgi = p[11] >> 7;
+    r->channel = p[12] & 0x0F;
+    r->secondary_channel = p[12] >> 4;
+    r->smoothing = p[13] & 0x01;
+    r->not_sounding = (p[13] >> 1) & 0x01;
+    r->aggregation = (p[13] >> 2) & 0x01;
+    r->stbc = (p[13] >> 3) & 0x03;
+    r->fec_coding = (p[13] >> 5) & 0x01;
+    r->ant = (p[13] >> 6) & 0x01;
+    r->real_time_set = p[13] >> 7;
+    r->sig_len = _csi_binary_get_u16(p + 14);
+    r->local_timestamp = _csi_binary_get_u32(p + 16);
+    r->real_timestamp_us = (int64_t) _csi_binary_get_u64(p + 20);
+    r->len = _csi_binary_get_u16(p + 28);
+    r->real_time_uncertainty_us = _csi_binary_get_u32(p + 30);
+}
+
+bool _csi_binary_decode_payload(uint8_t type, const uint8_t *p, uint16_t payload_len, csi_binary_record_t *out) {
+    out->type = type;
+    if (type == CSI_BINARY_RECORD_CSI) {
+        if (payload_len < CSI_BINARY_CSI_FIXED_SIZE
+            || payload_len > CSI_BINARY_CSI_FIXED_SIZE + CSI_BINARY_MAX_VALUES) {
+            return false;
+        }
+        _csi_binary_get_record(p, &out->record);
+        out->values = (const int8_t *) (p + CSI_BINARY_CSI_FIXED_SIZE);
+        out->value_count = payload_len - CSI_BINARY_CSI_FIXED_SIZE;
+        return true;
+    } else if (type == CSI_BINARY_RECORD_CSI_DELTA) {
+        if (payload_len < CSI_BINARY_CSI_FIXED_SIZE + CSI_BINARY_DELTA_HEADER_SIZE) {
+            return false;
+        }
+        _csi_binary_get_record(p, &out->record);
+        const uint8_t *h = p + CSI_BINARY_CSI_FIXED_SIZE;
+        out->delta_sequence = h[0];
+        out->delta_codec = h[1];
+        out->value_count = _csi_binary_get_u16(h + 2);
+        out->values = NULL;
+        out->coded = h + CSI_BINARY_DELTA_HEADER_SIZE;
+        out->coded_len = payload_len - CSI_BINARY_CSI_FIXED_SIZE - CSI_BINARY_DELTA_HEADER_SIZE;
+        return out->value_count <= CSI_BINARY_MAX_VALUES;
+    } else if (type == CSI_BINARY_RECORD_DROPPED) {
+        if (payload_len != 8) {
+            return false;
+        }
+        out->dropped_total = _csi_binary_get_u32(p);
+        out->dropped_since_last = _csi_binary_get_u32(p + 4);
+        return true;
+    } else if (type == CSI_BINARY_RECORD_ROLE) {
+        if (payload_len > CSI_BINARY_MAX_ROLE_LEN) {
+            return false;
+        }
+        memcpy(out->role, p, payload_len);
+        out->role[payload_len] = '\0';
+        return true;
+    } else if (type == CSI_BINARY_RECORD_SEGMENT) {
+        if (payload_len != CSI_BINARY_SEGMENT_SIZE) {
+            return false;
+        }
+        out->segment = _csi_binary_get_u32(p);
+        out->segment_records = _csi_binary_get_u32(p + 4);
+        out->segment_first_us = (int64_t) _csi_binary_get_u64(p + 8);
+        out->segment_last_us = (int64_t) _csi_binary_get_u64(p + 16);
+        return true;
+    } else if (type == CSI_BINARY_RECORD_TEXT) {
+        out->text = (const char *) p;
+        out->text_len = payload_len;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Decodes the first record in `buf`, skipping anything in front of it which is not a valid record.
+ */
+csi_binary_result_t csi_binary_decode(const uint8_t *buf, size_t len, size_t *consumed, csi_binary_record_t *out) {
+    *consumed = 0;
+
+    size_t start = 0;
+    while (start < len && buf[start] != CSI_BINARY_MAGIC_0) {
+        start++;
+    }
+    if (start > 0) {
+        *consumed = start;
+        return CSI_BINARY_SKIPPED;
+    }
+    if (len < CSI_BINARY_HEADER_SIZE) {
+        return CSI_BINARY_NEED_MORE;
+    }
+
+    uint16_t payload_len = _csi_binary_get_u16(buf + 4);
+    if (buf[1] != CSI_BINARY_MAGIC_1 || buf[2] != CSI_BINARY_VERSION || payload_len > CSI_BINARY_MAX_PAYLOAD) {
+        *consumed = 1;
+        return CSI_BINARY_SKIPPED;
+    }
+
+    size_t record_size = CSI_BINARY_HEADER_SIZE + payload_len + CSI_BINARY_CRC_SIZE;
+    if (len < record_size) {
+        return CSI_BINARY_NEED_MORE;
+    }
+
+    uint16_t crc = csi_binary_crc16(0xFFFF, buf + 2, CSI_BINARY_HEADER_SIZE - 2 + payload_len);
+    if (crc != _csi_binary_get_u16(buf + CSI_BINARY_HEADER_SIZE + payload_len)
+        || !_csi_binary_decode_payload(buf[3], buf + CSI_BINARY_HEADER_SIZE, payload_len, out)) {
+        *consumed = 1;
+        return CSI_BINARY_SKIPPED;
+    }
+
+    *consumed = record_size;
+    return CSI_BINARY_DECODED;
+}
+
+#endif //ESP32_CSI_CSI_BINARY_COMPONENT_H
@@ -1,10 +1,47 @@
 #ifndef ESP32_CSI_CSI_COMPONENT_H
 #define ESP32_CSI_CSI_COMPONENT_H
 
+#include "hal/cpu_hal.h"
 #include "time_component.h"
+#include "csi_format_component.h"
 #include "math.h"
-#include <sstream>
-#include <iostream>
+
+// How many of the LLTF, HT-LTF and STBC-HT-LTF of each frame are kept (`csi_layout_component.h`).
+#if CONFIG_SHOULD_COLLECT_ONLY_LLTF
+#define CSI_COLLECT_SEGMENTS 1
+#define CSI_RING_SLOT_DATA_SIZE 128
+#elif CONFIG_CSI_SKIP_STBC_HT_LTF
+#define CSI_COLLECT_SEGMENTS 2
+#define CSI_RING_SLOT_DATA_SIZE 384
+#else
+#define CSI_COLLECT_SEGMENTS 3
+#endif
+
+#ifdef CONFIG_CSI_RING_SLOTS
+#define CSI_RING_SLOT_COUNT CONFIG_CSI_RING_SLOTS
+#endif
+
+#include "csi_ring_component.h"
+#include "csi_binary_component.h"
+#include "csi_delta_component.h"
+#include "csi_layout_component.h"
+#include "csi_math_component.h"
+#include "csi_stats_component.h"
+#include "channel_scheduler_component.h"
+#include "csi_filter_component.h"
+#include "csi_rate_limit_component.h"
+#include "csi_features_component.h"
+#include "sta_session_component.h"
+
+#include "esp_vfs_dev.h"
+
+#ifdef CONFIG_SEND_CSI_TO_UDP
+#include "udp_stream_component.h"
+#endif
+
+#if CONFIG_CSI_PROBE_TAGS
+#include "probe_rx_component.h"
+#endif
 
 char *project_type;
 
@@ -14,79 +51,608 @@ char *project_type;
 
 #define CSI_TYPE CSI_RAW
 
-SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+#define CSI_WRITER_TASK_STACK_SIZE 4096
+#define CSI_WRITER_TASK_PRIORITY 10
+#define CSI_WRITER_TASK_CORE 1
+// wake up at least this often, so buffered SD output is synced even when no frames arrive
+#define CSI_WRITER_IDLE_TIMEOUT_MS 100
 
-void _wifi_csi_cb(void *ctx, wifi_csi_info_t *data) {
-    xSemaphoreTake(mutex, portMAX_DELAY);
-    std::stringstream ss;
-
-    wifi_csi_info_t d = data[0];
-    char mac[20] = {0};
-    sprintf(mac, "%02X:%02X:%02X:%02X:%02X:%02X", d.mac[0], d.mac[1], d.mac[2], d.mac[3], d.mac[4], d.mac[5]);
-
-    ss << "CSI_DATA,"
-       << project_type << ","
-       << mac << ","
-       // https://github.com/espressif/esp-idf/blob/9d0ca60398481a44861542638cfdc1949bb6f312/components/esp_wifi/include/esp_wifi_types.h#L314
-       << d.rx_ctrl.rssi << ","
-       << d.rx_ctrl.rate << ","
-       << d.rx_ctrl.sig_mode << ","
-       << d.rx_ctrl.mcs << ","
-       << d.rx_ctrl.cwb << ","
-       << d.rx_ctrl.smoothing << ","
-       << d.rx_ctrl.not_sounding << ","
-       << d.rx_ctrl.aggregation << ","
-       << d.rx_ctrl.stbc << ","
-       << d.rx_ctrl.fec_coding << ","
-       << d.rx_ctrl.sgi << ","
-       << d.rx_ctrl.noise_floor << ","
-       << d.rx_ctrl.ampdu_cnt << ","
-       << d.rx_ctrl.channel << ","
-       << d.rx_ctrl.secondary_channel << ","
-       << d.rx_ctrl.timestamp << ","
-       << d.rx_ctrl.ant << ","
-       << d.rx_ctrl.sig_len << ","
-       << d.rx_ctrl.rx_state << ","
-       << real_time_set << ","
-       << get_steady_clock_timestamp() << ","
-       << data->len << ",[";
+/*
+ * `_wifi_csi_cb` runs in the Wi-Fi driver task and only copies frames into `csi_ring`.
+ * Formatting and (slow) output happen in `csi_writer_task`.
+ */
+csi_ring_t csi_ring;
+TaskHandle_t csi_writer_handle = NULL;
 
-#if CONFIG_SHOULD_COLLECT_ONLY_LLTF
-    int data_len = 128;
+// Only ever touched by the writer task, so a single static line buffer is enough.
+csi_format_buffer_t csi_line;
+float csi_math_scratch[CSI_RING_SLOT_DATA_SIZE / 2];
+
+#ifdef CONFIG_CSI_STATS_INTERVAL_MS
+#define CSI_STATS_INTERVAL_MS CONFIG_CSI_STATS_INTERVAL_MS
+#else
+#define CSI_STATS_INTERVAL_MS 0
+#endif
+
+// How often `CSI_STATS` records are written, 0 for never. Read by the writer task, set by `STATS` commands.
+std::atomic<uint32_t> csi_stats_interval_ms(CSI_STATS_INTERVAL_MS);
+// Only touched by the writer task; the callback hands its timing over in `csi_ring_slot_t::fill_cycles`.
+csi_stats_t csi_stats;
+uint32_t csi_stats_dropped_base = 0;
+// Set while the channel is hopped (`channel_hop_component.h`), which adds `CSI_STATS_CHANNEL` records.
+channel_scheduler_t *csi_channel_scheduler = NULL;
+#ifdef CONFIG_STA_POLL_STATS_INTERVAL_S
+#define STA_POLL_STATS_INTERVAL_S CONFIG_STA_POLL_STATS_INTERVAL_S
+#else
+#define STA_POLL_STATS_INTERVAL_S 10
+#endif
+
+// Set on an AP which polls its stations (`sta_poll_loop()`), which needs the frames each of them yields. The writer
+// task writes their `STA_SESSION` records every `STA_POLL_STATS_INTERVAL_S`, under the table's mutex.
+sta_session_table_t *csi_sta_sessions = NULL;
+SemaphoreHandle_t csi_sta_sessions_mutex = NULL;
+// Only touched by the writer task.
+int64_t csi_sta_sessions_written_us = 0;
+
+#ifdef CONFIG_CSI_FILTER_RULES
+#define CSI_FILTER_RULES CONFIG_CSI_FILTER_RULES
+#else
+#define CSI_FILTER_RULES ""
+#endif
+
+// Read by `_wifi_csi_cb`, changed by `FILTER` commands (`input_component.h`).
+csi_filter_t csi_filter;
+// Replies to `FILTER` commands, only used by the task reading them.
+csi_format_buffer_t csi_filter_reply;
+
+#ifdef CONFIG_CSI_RATE_LIMIT_FPS
+#define CSI_RATE_LIMIT_FPS CONFIG_CSI_RATE_LIMIT_FPS
+#define CSI_RATE_LIMIT_BURST CONFIG_CSI_RATE_LIMIT_BURST
+#else
+#define CSI_RATE_LIMIT_FPS 0
+#define CSI_RATE_LIMIT_BURST 10
+#endif
+
+#ifdef CONFIG_CSI_DECIMATE_KEEP
+#define CSI_DECIMATE_KEEP CONFIG_CSI_DECIMATE_KEEP
+#define CSI_DECIMATE_EVERY CONFIG_CSI_DECIMATE_EVERY
+#else
+#define CSI_DECIMATE_KEEP 1
+#define CSI_DECIMATE_EVERY 1
+#endif
+
+// Per-MAC decimation and rate limit, applied by `_wifi_csi_cb` after `csi_filter`.
+csi_rate_limit_t csi_rate_limit;
+
+#if CONFIG_CSI_FEATURES_SUMMARY
+#define CSI_FEATURES_MODE CSI_FEATURES_SUMMARY
+#elif CONFIG_CSI_FEATURES_EVENTS
+#define CSI_FEATURES_MODE CSI_FEATURES_EVENTS
+#else
+#define CSI_FEATURES_MODE CSI_FEATURES_RAW
+#endif
+
+#ifdef CONFIG_CSI_FEATURES_GROUP
+#define CSI_FEATURES_GROUP CONFIG_CSI_FEATURES_GROUP
+#define CSI_FEATURES_SUMMARY_MS CONFIG_CSI_FEATURES_SUMMARY_MS
+#define CSI_FEATURES_MOTION_THRESHOLD_PPM CONFIG_CSI_FEATURES_MOTION_THRESHOLD_PPM
+#else
+#define CSI_FEATURES_GROUP 4
+#define CSI_FEATURES_SUMMARY_MS 1000
+#define CSI_FEATURES_MOTION_THRESHOLD_PPM 5000
+#endif
+
+// What the writer task makes of frames (a `csi_features_mode_t`), set by `FEATURES` commands.
+std::atomic<int> csi_features_mode(CSI_FEATURES_MODE);
+// Only touched by the writer task.
+csi_features_t csi_features;
+
+#if CONFIG_CSI_OUTPUT_FORMAT_BINARY
+#define CSI_OUTPUT_BINARY true
 #else
+#define CSI_OUTPUT_BINARY false
+#endif
+
+// Output format of the serial port, only touched by the writer task. Starts as configured, switched by `FORMAT`.
+bool csi_output_binary = CSI_OUTPUT_BINARY;
+// Format asked for by `csi_output_request()`: -1 for none, otherwise 0 (CSV) or 1 (binary).
+std::atomic<int> csi_output_requested(-1);
+
+uint8_t csi_text_record[CSI_BINARY_MAX_RECORD_SIZE];
+
+#if CONFIG_CSI_BINARY_DELTA
+#define CSI_BINARY_DELTA 1
+#define CSI_DELTA_KEYFRAME_EVERY CONFIG_CSI_DELTA_KEYFRAME_EVERY
+#else
+#define CSI_BINARY_DELTA 0
+#define CSI_DELTA_KEYFRAME_EVERY 32
+#endif
+
+#if CSI_BINARY_DELTA
+// Previous frames of the binary serial output, only touched by the writer task.
+csi_delta_t csi_delta_serial;
+#ifdef CONFIG_SEND_CSI_TO_UDP
+// The network loses records on its own, so it has its own keyframes.
+csi_delta_t csi_delta_udp;
+#endif
+#endif
+
+#if CONFIG_CSI_PROBE_TAGS
+// Filled by `_wifi_probe_cb` in the Wi-Fi driver task, drained by the writer task.
+probe_rx_ring_t probe_rx_ring;
+uint32_t probe_rx_reported_dropped = 0;
+#endif
+
+uint32_t _csi_cycles_to_ns(uint32_t cycles) {
+    return (uint32_t) ((uint64_t) cycles * 1000 / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+}
+
+// In binary mode the role is repeated every so often, so a capture started part way through can still be decoded.
+#define CSI_BINARY_ROLE_INTERVAL 256
+
+void _csi_record_from_info(csi_record_t *r, const wifi_csi_info_t *d, int64_t steady_us) {
+    // https://github.com/espressif/esp-idf/blob/9d0ca60398481a44861542638cfdc1949bb6f312/components/esp_wifi/include/esp_wifi_types.h#L314
+    memcpy(r->mac, d->mac, sizeof(r->mac));
+    r->rssi = d->rx_ctrl.rssi;
+    r->rate = d->rx_ctrl.rate;
+    r->sig_mode = d->rx_ctrl.sig_mode;
+    r->mcs = d->rx_ctrl.mcs;
+    r->cwb = d->rx_ctrl.cwb;
+    r->smoothing = d->rx_ctrl.smoothing;
+    r->not_sounding = d->rx_ctrl.not_sounding;
+    r->aggregation = d->rx_ctrl.aggregation;
+    r->stbc = d->rx_ctrl.stbc;
+    r->fec_coding = d->rx_ctrl.fec_coding;
+    r->sgi = d->rx_ctrl.sgi;
+    r->noise_floor = d->rx_ctrl.noise_floor;
+    r->ampdu_cnt = d->rx_ctrl.ampdu_cnt;
+    r->channel = d->rx_ctrl.channel;
+    r->secondary_channel = d->rx_ctrl.secondary_channel;
+    r->local_timestamp = d->rx_ctrl.timestamp;
+    r->ant = d->rx_ctrl.ant;
+    r->sig_len = d->rx_ctrl.sig_len;
+    r->rx_state = d->rx_ctrl.rx_state;
+    r->real_time_set = real_time_set;
+    get_real_clock_timestamp_us(steady_us, &r->real_timestamp_us, &r->real_time_uncertainty_us);
+    r->len = d->len;
+}
+
+void _wifi_csi_cb(void *ctx, wifi_csi_info_t *data) {
+    // the cycle counter is per core, so both ends of a measurement are taken in the same task
+    uint32_t entry_cycles = cpu_hal_get_cycle_count();
+    // before anything is copied: filtered frames neither take a ring slot nor count as CSI_STATS frames
+    if (!csi_filter_accept(&csi_filter, data->mac, data->rx_ctrl.rssi, data->rx_ctrl.sig_mode, data->rx_ctrl.cwb)) {
+        return;
+    }
+    // the one clock read per frame, for the rate limit and both timestamps
+    int64_t steady_us = get_steady_clock_timestamp_us();
+    if (!csi_rate_limit_accept(&csi_rate_limit, data->mac, (uint32_t) steady_us)) {
+        return;
+    }
+    if (csi_sta_sessions != NULL) {
+        sta_session_frame(csi_sta_sessions, data->mac);
+    }
+    csi_ring_slot_t *slot = csi_ring_acquire(&csi_ring);
+    if (slot == NULL) {
+        // counted in csi_ring.dropped and reported by the writer
+        return;
+    }
+
+    _csi_record_from_info(&slot->record, data, steady_us);
+    slot->steady_timestamp_us = steady_us;
+
     int data_len = data->len;
+#if CSI_COLLECT_SEGMENTS == 1
+    // every frame starts with the 64 subcarriers of its LLTF
+    data_len = 128;
+#elif CSI_COLLECT_SEGMENTS < CSI_LAYOUT_MAX_SEGMENTS
+    // frames of an unknown layout are kept whole, as far as they fit
+    csi_layout_t layout;
+    if (csi_layout_from_record(&layout, &slot->record, data->len)) {
+        data_len = csi_layout_prefix_len(&layout, CSI_COLLECT_SEGMENTS);
+    }
 #endif
+    if (data_len > CSI_RING_SLOT_DATA_SIZE) {
+        data_len = CSI_RING_SLOT_DATA_SIZE;
+    }
+    memcpy(slot->data, data->buf, data_len);
+    slot->data_len = data_len;
+    slot->fill_cycles = cpu_hal_get_cycle_count() - entry_cycles;
 
-int8_t *my_ptr;
-#if CSI_RAW
-    my_ptr = data->buf;
-    for (int i = 0; i < data_len; i++) {
-        ss << (int) my_ptr[i] << " ";
+    csi_ring_publish(&csi_ring);
+    xTaskNotifyGive(csi_writer_handle);
+}
+
+#if CONFIG_CSI_PROBE_TAGS
+/*
+ * Promiscuous rx callback: only probes are queued, everything else is left to the CSI callback.
+ */
+void _wifi_probe_cb(void *buf, wifi_promiscuous_pkt_type_t type) {
+    if (type != WIFI_PKT_DATA && type != WIFI_PKT_MGMT) {
+        return;
+    }
+    const wifi_promiscuous_pkt_t *pkt = (const wifi_promiscuous_pkt_t *) buf;
+    if (probe_rx_frame(&probe_rx_ring, pkt->payload, pkt->rx_ctrl.sig_len, pkt->rx_ctrl.timestamp)) {
+        xTaskNotifyGive(csi_writer_handle);
     }
+}
+#endif
+
+void _csi_format_slot(csi_format_buffer_t *b, const csi_ring_slot_t *slot) {
+    csi_format_reset(b);
+    csi_format_csv_prefix(b, project_type, &slot->record);
+
+    int data_len = slot->data_len;
+    const int8_t *my_ptr;
+#if CSI_RAW
+    my_ptr = slot->data;
+    csi_format_csv_values(b, my_ptr, data_len);
 #endif
 #if CSI_AMPLITUDE
-    my_ptr = data->buf;
+    my_ptr = slot->data;
+    csi_amplitude_f32(my_ptr, data_len / 2, csi_math_scratch);
     for (int i = 0; i < data_len / 2; i++) {
-        ss << (int) sqrt(pow(my_ptr[i * 2], 2) + pow(my_ptr[(i * 2) + 1], 2)) << " ";
+        csi_format_int(b, (int) csi_math_scratch[i]);
+        csi_format_char(b, ' ');
     }
 #endif
 #if CSI_PHASE
-    my_ptr = data->buf;
+    my_ptr = slot->data;
+    csi_phase_f32(my_ptr, data_len / 2, csi_math_scratch);
     for (int i = 0; i < data_len / 2; i++) {
-        ss << (int) atan2(my_ptr[i*2], my_ptr[(i*2)+1]) << " ";
+        csi_format_int(b, (int) csi_math_scratch[i]);
+        csi_format_char(b, ' ');
+    }
+#endif
+    csi_format_csv_suffix(b);
+}
+
+/*
+ * `CSI_DROPPED,<role>,<total dropped>,<dropped since last report>`
+ */
+void _csi_format_dropped(csi_format_buffer_t *b, uint32_t total, uint32_t since_last) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_DROPPED,");
+    csi_format_str(b, project_type);
+    csi_format_char(b, ',');
+    csi_format_uint(b, total);
+    csi_format_char(b, ',');
+    csi_format_uint(b, since_last);
+    csi_format_char(b, '\n');
+}
+
+#ifdef CONFIG_SEND_CSI_TO_UDP
+// The network always gets binary records, whatever `CONFIG_CSI_OUTPUT_FORMAT` is.
+uint8_t csi_udp_record[CSI_BINARY_MAX_RECORD_SIZE];
+
+void _csi_stream_slot(const csi_ring_slot_t *slot, uint32_t frame_count) {
+    int64_t now_us = get_steady_clock_timestamp_us();
+    size_t len;
+    if (frame_count % CSI_BINARY_ROLE_INTERVAL == 0) {
+        len = csi_binary_encode_role(csi_udp_record, sizeof(csi_udp_record), project_type);
+        udp_stream_write(csi_udp_record, len, now_us);
+    }
+#if CSI_BINARY_DELTA
+    len = csi_delta_encode(&csi_delta_udp, csi_udp_record, sizeof(csi_udp_record), &slot->record, slot->data,
+                           slot->data_len);
+#else
+    len = csi_binary_encode_csi(csi_udp_record, sizeof(csi_udp_record), &slot->record, slot->data, slot->data_len);
+#endif
+    udp_stream_write(csi_udp_record, len, now_us);
+}
+
+void _csi_stream_dropped(uint32_t total, uint32_t since_last) {
+    size_t len = csi_binary_encode_dropped(csi_udp_record, sizeof(csi_udp_record), total, since_last);
+    udp_stream_write(csi_udp_record, len, get_steady_clock_timestamp_us());
+}
+#endif
+
+/*
+ * Writes a complete text line: as is in CSV mode, wrapped in a text record in binary mode and over UDP.
+ */
+void _csi_write_text(const csi_format_buffer_t *line) {
+    size_t len = csi_binary_encode_text(csi_text_record, sizeof(csi_text_record), line->buf, line->len);
+    if (csi_output_binary) {
+        outwrite(csi_text_record, len);
+    } else {
+        outwrite(line->buf, line->len);
+    }
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    udp_stream_write(csi_text_record, len, get_steady_clock_timestamp_us());
+#endif
+}
+
+/*
+ * Adds a frame to the features of its source MAC and writes whatever records that makes due, instead of the frame.
+ */
+void _csi_write_features(csi_ring_slot_t *slot, int mode) {
+    uint32_t start_cycles = cpu_hal_get_cycle_count();
+    int64_t steady_us = slot->steady_timestamp_us;
+    int64_t real_us = slot->record.real_timestamp_us;
+    csi_features_link_t *link;
+    uint32_t due = csi_features_add(&csi_features, slot->record.mac, slot->record.rssi, slot->data, slot->data_len,
+                                    steady_us, &link);
+    csi_ring_release(&csi_ring);
+    uint32_t computed_cycles = cpu_hal_get_cycle_count();
+    if (due & CSI_FEATURES_MOTION_CHANGED) {
+        csi_features_format_motion(&csi_line, project_type, link, real_us);
+        _csi_write_text(&csi_line);
+    }
+    if (due & CSI_FEATURES_SUMMARY_DUE) {
+        if (mode == CSI_FEATURES_SUMMARY) {
+            csi_features_format_summary(&csi_line, project_type, link, real_us);
+            _csi_write_text(&csi_line);
+        }
+        csi_features_summary_done(link, steady_us);
+    }
+    csi_stats_add(&csi_stats, CSI_STATS_FORMAT, _csi_cycles_to_ns(computed_cycles - start_cycles));
+    csi_stats_add(&csi_stats, CSI_STATS_OUTPUT, _csi_cycles_to_ns(cpu_hal_get_cycle_count() - computed_cycles));
+}
+
+void _csi_write_slot(csi_ring_slot_t *slot, uint32_t frame_count) {
+    int features_mode = csi_features_mode.load(std::memory_order_relaxed);
+    if (features_mode != CSI_FEATURES_RAW) {
+        _csi_write_features(slot, features_mode);
+        return;
+    }
+    uint32_t start_cycles = cpu_hal_get_cycle_count();
+    const void *out = csi_line.buf;
+    size_t len = 0;
+    if (csi_output_binary) {
+        uint8_t *record = (uint8_t *) csi_line.buf;
+        if (frame_count % CSI_BINARY_ROLE_INTERVAL == 0) {
+            len += csi_binary_encode_role(record, sizeof(csi_line.buf), project_type);
+        }
+#if CSI_BINARY_DELTA
+        len += csi_delta_encode(&csi_delta_serial, record + len, sizeof(csi_line.buf) - len, &slot->record,
+                                slot->data, slot->data_len);
+#else
+        len += csi_binary_encode_csi(record + len, sizeof(csi_line.buf) - len, &slot->record, slot->data,
+                                     slot->data_len);
+#endif
+    } else {
+        _csi_format_slot(&csi_line, slot);
+        len = csi_line.len;
+    }
+    uint32_t formatted_cycles = cpu_hal_get_cycle_count();
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    _csi_stream_slot(slot, frame_count);
+#endif
+    csi_ring_release(&csi_ring);
+    outwrite(out, len);
+    csi_stats_add(&csi_stats, CSI_STATS_FORMAT, _csi_cycles_to_ns(formatted_cycles - start_cycles));
+    csi_stats_add(&csi_stats, CSI_STATS_OUTPUT, _csi_cycles_to_ns(cpu_hal_get_cycle_count() - formatted_cycles));
+}
+
+void _csi_write_dropped(uint32_t total, uint32_t since_last) {
+    if (csi_output_binary) {
+        size_t len = csi_binary_encode_dropped((uint8_t *) csi_line.buf, sizeof(csi_line.buf), total, since_last);
+        outwrite(csi_line.buf, len);
+    } else {
+        _csi_format_dropped(&csi_line, total, since_last);
+        outwrite(csi_line.buf, csi_line.len);
     }
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    _csi_stream_dropped(total, since_last);
 #endif
-    ss << "]\n";
+}
+
+/*
+ * Accounts for a frame just taken off the ring: callback time, time spent queued and the source MAC.
+ */
+void _csi_stats_frame(const csi_ring_slot_t *slot, int64_t now_us) {
+    csi_stats_frame(&csi_stats, slot->record.mac, slot->record.channel);
+    csi_stats_add(&csi_stats, CSI_STATS_CALLBACK, _csi_cycles_to_ns(slot->fill_cycles));
+    int64_t queued_us = now_us - slot->steady_timestamp_us;
+    if (queued_us < 0) {
+        queued_us = 0;
+    } else if (queued_us > UINT32_MAX / 1000) {
+        queued_us = UINT32_MAX / 1000;
+    }
+    csi_stats_add(&csi_stats, CSI_STATS_QUEUE, (uint32_t) queued_us * 1000);
+}
 
-    printf(ss.str().c_str());
+/*
+ * Takes the visits and dwell time of every channel in the sweep, writing a `CSI_STATS_CHANNEL` record each if `write`.
+ */
+void _csi_stats_channels(bool write) {
+    if (csi_channel_scheduler == NULL) {
+        return;
+    }
+    for (int i = 0; i < csi_channel_scheduler->count; i++) {
+        uint32_t visits, dwell_us;
+        channel_scheduler_take(csi_channel_scheduler, i, &visits, &dwell_us);
+        uint8_t channel = csi_channel_scheduler->entries[i].channel;
+        if (write) {
+            csi_stats_format_channel(&csi_line, project_type, channel, csi_stats.channel_frames[channel], visits,
+                                     dwell_us);
+            _csi_write_text(&csi_line);
+        }
+    }
+}
+
+/*
+ * Takes the frames passed and dropped by the rate limiter for every MAC, writing a `CSI_STATS_LIMIT` record each
+ * (if any) if `write`.
+ */
+void _csi_stats_rate_limit(bool write) {
+    if (!csi_rate_limit.enabled) {
+        return;
+    }
+    for (int i = 0; i <= CSI_RATE_LIMIT_SLOTS; i++) {
+        uint8_t mac[6];
+        uint32_t passed, decimated, limited;
+        bool tracked = csi_rate_limit_take(&csi_rate_limit, i, mac, &passed, &decimated, &limited);
+        if (write && passed + decimated + limited > 0) {
+            csi_rate_limit_format(&csi_line, project_type, tracked ? mac : NULL, passed, decimated, limited);
+            _csi_write_text(&csi_line);
+        }
+    }
+}
+
+/*
+ * Writes `CSI_STATS` (and `CSI_STATS_MAC`, `CSI_STATS_CHANNEL`, `CSI_STATS_LIMIT`) records once `csi_stats_interval_ms` has passed, and starts a new interval.
+ */
+void _csi_stats_poll(int64_t now_us) {
+    int64_t elapsed_us = now_us - csi_stats.interval_start_us;
+    uint32_t interval_ms = csi_stats_interval_ms.load(std::memory_order_relaxed);
+    if (interval_ms == 0) {
+        // nothing is reported, but the counters must not wrap and the first interval once enabled stays short
+        if (elapsed_us >= 1000000) {
+            csi_stats_dropped_base = csi_ring_dropped(&csi_ring);
+            _csi_stats_channels(false);
+            _csi_stats_rate_limit(false);
+            csi_stats_reset(&csi_stats, now_us);
+        }
+        return;
+    }
+    if (elapsed_us < (int64_t) interval_ms * 1000) {
+        return;
+    }
+
+    uint32_t dropped = csi_ring_dropped(&csi_ring);
+    csi_stats.dropped = dropped - csi_stats_dropped_base;
+    csi_stats_dropped_base = dropped;
+
+    csi_stats_format_summary(&csi_line, project_type, &csi_stats, now_us);
+    _csi_write_text(&csi_line);
+    for (int i = 0; i < CSI_STATS_MAC_SLOTS; i++) {
+        const csi_mac_count_t *entry = &csi_stats.macs.entries[i];
+        if (entry->used) {
+            csi_stats_format_mac(&csi_line, project_type, entry->mac, entry->frames);
+            _csi_write_text(&csi_line);
+        }
+    }
+    if (csi_stats.macs.other_frames > 0) {
+        csi_stats_format_mac(&csi_line, project_type, NULL, csi_stats.macs.other_frames);
+        _csi_write_text(&csi_line);
+    }
+    _csi_stats_channels(true);
+    _csi_stats_rate_limit(true);
+    csi_stats_reset(&csi_stats, now_us);
+}
+
+/*
+ * Writes a `STA_SESSION` record for every station once `STA_POLL_STATS_INTERVAL_S` has passed. The table is only
+ * locked while a record is formatted, so the WiFi events and the polling task never wait for the output.
+ */
+void _csi_sta_sessions_poll(int64_t now_us) {
+    if (csi_sta_sessions == NULL || STA_POLL_STATS_INTERVAL_S == 0
+        || now_us - csi_sta_sessions_written_us < STA_POLL_STATS_INTERVAL_S * 1000000LL) {
+        return;
+    }
+    for (int i = 0; i < STA_SESSION_SLOTS; i++) {
+        sta_session_t *s = &csi_sta_sessions->sessions[i];
+        xSemaphoreTake(csi_sta_sessions_mutex, portMAX_DELAY);
+        bool used = s->key.load(std::memory_order_relaxed) != 0;
+        if (used) {
+            sta_session_format(&csi_line, project_type, s, now_us);
+        }
+        xSemaphoreGive(csi_sta_sessions_mutex);
+        if (used) {
+            _csi_write_text(&csi_line);
+        }
+    }
+    csi_sta_sessions_written_us = now_us;
+}
+
+#if CONFIG_CSI_PROBE_TAGS
+/*
+ * Writes a `CSI_PROBE` line for every queued probe, preceded by a `CSI_PROBE_DROPPED` line if the ring overflowed.
+ */
+void _csi_probe_poll() {
+    uint32_t dropped = probe_rx_dropped(&probe_rx_ring);
+    if (dropped != probe_rx_reported_dropped) {
+        probe_rx_format_dropped(&csi_line, project_type, dropped, dropped - probe_rx_reported_dropped);
+        _csi_write_text(&csi_line);
+        probe_rx_reported_dropped = dropped;
+    }
+    probe_rx_record_t record;
+    while (probe_rx_pop(&probe_rx_ring, &record)) {
+        probe_rx_format(&csi_line, project_type, &record);
+        _csi_write_text(&csi_line);
+    }
+}
+#endif
+
+/*
+ * Starts the output in the current format: the CSV header, or (in binary mode) a line ending setting which leaves
+ * '\n' bytes inside records alone and the role.
+ */
+void _csi_output_start() {
+    // whatever was written in the previous format goes out with the previous line endings
+    outflush();
     fflush(stdout);
-    vTaskDelay(0);
-    xSemaphoreGive(mutex);
+    if (csi_output_binary) {
+        // Binary captures are turned back into CSV (including the header) by `cpp_utils/csi_binary_decode.cc`.
+        esp_vfs_dev_uart_port_set_tx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM, ESP_LINE_ENDINGS_LF);
+        size_t len = csi_binary_encode_role((uint8_t *) csi_line.buf, sizeof(csi_line.buf), project_type);
+        outwrite(csi_line.buf, len);
+#if CSI_BINARY_DELTA
+        // a reader which starts here gets a keyframe of every source first
+        csi_delta_reset(&csi_delta_serial);
+#endif
+    } else {
+        esp_vfs_dev_uart_port_set_tx_line_endings(CONFIG_ESP_CONSOLE_UART_NUM, ESP_LINE_ENDINGS_CRLF);
+        outprintf(CSI_CSV_HEADER);
+    }
 }
 
-void _print_csi_csv_header() {
-    char *header_str = (char *) "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,rx_state,real_time_set,real_timestamp,len,CSI_DATA\n";
-    outprintf(header_str);
+/*
+ * Asks the writer task to switch the serial output to CSV or binary records. False (nothing changes) when writing to
+ * the SD card, whose files keep the format they were opened with.
+ */
+bool csi_output_request(bool binary) {
+#ifdef CONFIG_SEND_CSI_TO_SD
+    return binary == CSI_OUTPUT_BINARY;
+#else
+    csi_output_requested.store(binary ? 1 : 0);
+    if (csi_writer_handle != NULL) {
+        xTaskNotifyGive(csi_writer_handle);
+    }
+    return true;
+#endif
+}
+
+void csi_writer_task(void *pvParameters) {
+    uint32_t reported_dropped = 0;
+    uint32_t frame_count = 0;
+
+    while (true) {
+        int requested = csi_output_requested.exchange(-1);
+        if (requested >= 0 && (requested == 1) != csi_output_binary) {
+            csi_output_binary = requested == 1;
+            _csi_output_start();
+            // the next frame repeats the role
+            frame_count = 0;
+        }
+
+        csi_ring_slot_t *slot = csi_ring_peek(&csi_ring);
+        int64_t now_us = get_steady_clock_timestamp_us();
+        _csi_stats_poll(now_us);
+        _csi_sta_sessions_poll(now_us);
+#if CONFIG_CSI_PROBE_TAGS
+        _csi_probe_poll();
+#endif
+        if (slot == NULL) {
+            // only flush once the ring is drained, so bursts go out in as few writes as possible
+            outflush();
+#ifdef CONFIG_SEND_CSI_TO_UDP
+            udp_stream_poll(now_us);
+#endif
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CSI_WRITER_IDLE_TIMEOUT_MS));
+            continue;
+        }
+
+        uint32_t dropped = csi_ring_dropped(&csi_ring);
+        if (dropped != reported_dropped) {
+            _csi_write_dropped(dropped, dropped - reported_dropped);
+            reported_dropped = dropped;
+        }
+
+        _csi_stats_frame(slot, now_us);
+        _csi_write_slot(slot, frame_count++);
+    }
 }
 
 void csi_init(char *type) {
@@ -104,10 +670,41 @@ void csi_init(char *type) {
     configuration_csi.channel_filter_en = 0;
     configuration_csi.manu_scale = 0;
 
+#if CSI_BINARY_DELTA
+    csi_delta_init(&csi_delta_serial, CSI_DELTA_KEYFRAME_EVERY);
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    csi_delta_init(&csi_delta_udp, CSI_DELTA_KEYFRAME_EVERY);
+#endif
+#endif
+    _csi_output_start();
+
+    csi_ring_reset(&csi_ring);
+    csi_stats_reset(&csi_stats, get_steady_clock_timestamp_us());
+    csi_filter_reset(&csi_filter);
+    csi_features_configure(&csi_features, CSI_FEATURES_GROUP, CSI_FEATURES_MOTION_THRESHOLD_PPM,
+                           CSI_FEATURES_SUMMARY_MS);
+    if (CSI_FILTER_RULES[0] != '\0' && !csi_filter_command(&csi_filter, CSI_FILTER_RULES, &csi_filter_reply)) {
+        printf("ERROR: initial CSI filter not applied, %.*s", (int) csi_filter_reply.len, csi_filter_reply.buf);
+    }
+    if (!csi_rate_limit_configure(&csi_rate_limit, CSI_RATE_LIMIT_FPS, CSI_RATE_LIMIT_BURST, CSI_DECIMATE_KEEP,
+                                  CSI_DECIMATE_EVERY)) {
+        printf("ERROR: CSI rate limit not applied, decimation keeps more frames than it sees\n");
+    }
+#if CONFIG_CSI_PROBE_TAGS
+    probe_rx_ring_reset(&probe_rx_ring);
+#endif
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    udp_stream_init();
+#endif
+    xTaskCreatePinnedToCore(&csi_writer_task, "csi_writer", CSI_WRITER_TASK_STACK_SIZE, NULL,
+                            CSI_WRITER_TASK_PRIORITY, &csi_writer_handle, CSI_WRITER_TASK_CORE);
+
     ESP_ERROR_CHECK(esp_wifi_set_csi_config(&configuration_csi));
     ESP_ERROR_CHECK(esp_wifi_set_csi_rx_cb(&_wifi_csi_cb, NULL));
-
-    _print_csi_csv_header();
+#if CONFIG_CSI_PROBE_TAGS
+    // the caller enables promiscuous mode, with data and management frames in its filter
+    ESP_ERROR_CHECK(esp_wifi_set_promiscuous_rx_cb(&_wifi_probe_cb));
+#endif
 #endif
 }
 
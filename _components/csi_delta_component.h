@@ -0,0 +1,325 @@
+#ifndef ESP32_CSI_CSI_DELTA_COMPONENT_H
+#define ESP32_CSI_CSI_DELTA_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_format_component.h"
+#include "csi_filter_component.h"
+#include "csi_binary_component.h"
+
+/*
+ * Lossless compression of the CSI values of binary records (`CSI_BINARY_RECORD_CSI_DELTA`, see
+ * `csi_binary_component.h`), for when the serial port or the network is what limits the frame rate.
+ *
+ * Each value is predicted, either from the same value of the previous frame of its source MAC (temporal) or from the
+ * same part (imaginary or real) of the subcarrier before it (intra), whichever leaves the smaller residuals in this
+ * frame. The residuals are zigzag mapped (0, -1, 1, -2, ... to 0, 1, 2, 3, ...) and Rice coded with the parameter `k`
+ * which suits the frame: `z >> k` in unary (that many 1 bits and a 0), then the low `k` bits of `z`. A quotient of
+ * `CSI_DELTA_RICE_ESCAPE` is followed by `z` in 8 bits instead. Bits are packed from the most significant one of
+ * each byte. Values which would not get any smaller are stored as they are.
+ *
+ * The codec byte of a record:
+ *
+ *   bit 7       intra predicted, the record can be decoded on its own (a keyframe)
+ *   bits 0-3    k (0 to 7), or `CSI_DELTA_CODEC_STORED` for values stored as they are
+ *
+ * A frame of a source is a keyframe if it is the first of the source (or the first since `csi_delta_reset()`), if
+ * the number of values changed, or if `keyframe_every - 1` temporally predicted frames of the source went before it.
+ * The sequence number counts the frames of each source, so a decoder which missed one (a record lost or corrupted on
+ * the way) skips that source's frames until its next keyframe instead of decoding them wrongly.
+ *
+ * Encoder and decoder each keep the previous frame of up to `CSI_DELTA_SOURCES` MACs (about 6 KB with scratch space),
+ * the least recently seen one making room for a new MAC.
+ */
+
+#define CSI_DELTA_SOURCES 8
+#define CSI_DELTA_RICE_ESCAPE 12
+#define CSI_DELTA_MAX_K 7
+#define CSI_DELTA_CODEC_INTRA 0x80
+#define CSI_DELTA_CODEC_STORED 0x0F
+
+typedef struct {
+    // MAC as in `csi_filter_component.h`, 0 for an unused entry
+    uint64_t key;
+    uint32_t last_used;
+    // of the frame in `previous`
+    uint8_t sequence;
+    uint16_t count;
+    uint16_t since_keyframe;
+    int8_t previous[CSI_BINARY_MAX_VALUES];
+} csi_delta_source_t;
+
+typedef struct {
+    csi_delta_source_t sources[CSI_DELTA_SOURCES];
+    uint32_t clock;
+    // encoder only
+    uint16_t keyframe_every;
+
+    uint32_t keyframes;
+    uint32_t deltas;
+    // decoder only: frames which could not be decoded because an earlier frame of the source was missing
+    uint32_t undecodable;
+    // scratch space for the residuals of both predictions, off the stack of the writer task
+    uint8_t residuals[2][CSI_BINARY_MAX_VALUES];
+} csi_delta_t;
+
+/*
+ * Every frame of a source is a keyframe with `keyframe_every` 1. At most 255.
+ */
+void csi_delta_init(csi_delta_t *d, uint16_t keyframe_every) {
+    memset(d, 0, sizeof(*d));
+    d->keyframe_every = keyframe_every < 1 ? 1 : (keyframe_every > 255 ? 255 : keyframe_every);
+}
+
+/*
+ * Forgets every source, so the next frame of each is a keyframe (e.g. when a new capture starts).
+ */
+void csi_delta_reset(csi_delta_t *d) {
+    for (int i = 0; i < CSI_DELTA_SOURCES; i++) {
+        d->sources[i].key = 0;
+    }
+}
+
+/*
+ * The entry of `mac`, or NULL if there is none and `add` is false. A new entry has `count` 0.
+ */
+csi_delta_source_t *_csi_delta_source(csi_delta_t *d, const uint8_t mac[6], bool add) {
+    uint64_t key = _csi_filter_key(mac);
+    csi_delta_source_t *victim = NULL;
+    d->clock++;
+    for (int i = 0; i < CSI_DELTA_SOURCES; i++) {
+        csi_delta_source_t *s = &d->sources[i];
+        if (s->key == key) {
+            s->last_used = d->clock;
+            return s;
+        }
+        // an unused entry, otherwise the least recently used one
+        if (victim == NULL || (victim->key != 0
+                               && (s->key == 0 || d->clock - s->last_used > d->clock - victim->last_used))) {
+            victim = s;
+        }
+    }
+    if (!add) {
+        return NULL;
+    }
+    victim->key = key;
+    victim->last_used = d->clock;
+    victim->count = 0;
+    return victim;
+}
+
+uint8_t _csi_delta_zigzag(int8_t v) {
+    return (uint8_t) ((uint8_t) v << 1) ^ (uint8_t) (v >> 7);
+}
+
+int8_t _csi_delta_unzigzag(uint8_t z) {
+    return (int8_t) ((z >> 1) ^ -(z & 1));
+}
+
+/*
+ * The zigzag mapped residuals of `values` and their sum, predicted from `reference` (temporal) or, if that is NULL,
+ * from the value two before (intra).
+ */
+uint32_t _csi_delta_residuals(const int8_t *values, const int8_t *reference, uint16_t count, uint8_t *z) {
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        int8_t prediction = reference != NULL ? reference[i] : (i >= 2 ? values[i - 2] : 0);
+        z[i] = _csi_delta_zigzag((int8_t) (values[i] - prediction));
+        sum += z[i];
+    }
+    return sum;
+}
+
+/*
+ * Rice codes `z` into at most `cap` bytes. Returns the number of bytes, or 0 if they do not fit.
+ */
+size_t _csi_delta_rice(const uint8_t *z, uint16_t count, uint8_t k, uint8_t *out, size_t cap) {
+    uint32_t bits = 0;
+    int pending = 0;
+    size_t len = 0;
+    uint32_t low = (1u << k) - 1;
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t q = z[i] >> k;
+        if (q < CSI_DELTA_RICE_ESCAPE) {
+            // q 1 bits, a 0 and the low bits
+            bits = (bits << (q + 1 + k)) | ((((1u << q) - 1) << 1) << k) | (z[i] & low);
+            pending += q + 1 + k;
+        } else {
+            bits = (bits << (CSI_DELTA_RICE_ESCAPE + 8)) | (((1u << CSI_DELTA_RICE_ESCAPE) - 1) << 8) | z[i];
+            pending += CSI_DELTA_RICE_ESCAPE + 8;
+        }
+        while (pending >= 8) {
+            if (len == cap) {
+                return 0;
+            }
+            pending -= 8;
+            out[len++] = (uint8_t) (bits >> pending);
+        }
+    }
+    if (pending > 0) {
+        if (len == cap) {
+            return 0;
+        }
+        out[len++] = (uint8_t) (bits << (8 - pending));
+    }
+    return len;
+}
+
+/*
+ * Writes the delta coded record of a frame to `out` and returns its size, or 0 if `cap` is too small.
+ */
+size_t csi_delta_encode(csi_delta_t *d, uint8_t *out, size_t cap, const csi_record_t *r, const int8_t *values,
+                        uint16_t count) {
+    if (count > CSI_BINARY_MAX_VALUES) {
+        count = CSI_BINARY_MAX_VALUES;
+    }
+    size_t max_len = CSI_BINARY_HEADER_SIZE + CSI_BINARY_CSI_FIXED_SIZE + CSI_BINARY_DELTA_HEADER_SIZE + count
+                     + CSI_BINARY_CRC_SIZE;
+    if (cap < max_len) {
+        return 0;
+    }
+    csi_delta_source_t *s = _csi_delta_source(d, r->mac, true);
+    bool keyframe = s->count != count || count == 0 || s->since_keyframe + 1 >= d->keyframe_every;
+
+    // the residuals of both predictions, the smaller ones kept
+    uint8_t *intra = d->residuals[0], *temporal = d->residuals[1];
+    uint32_t sum = _csi_delta_residuals(values, NULL, count, intra);
+    const uint8_t *z = intra;
+    if (!keyframe) {
+        uint32_t temporal_sum = _csi_delta_residuals(values, s->previous, count, temporal);
+        if (temporal_sum < sum) {
+            sum = temporal_sum;
+            z = temporal;
+        }
+    }
+    // k is about log2 of the mean residual, less one for the unary part
+    uint8_t k = 0;
+    while (k < CSI_DELTA_MAX_K && ((uint32_t) count << (k + 1)) <= sum) {
+        k++;
+    }
+
+    uint8_t *p = out + CSI_BINARY_HEADER_SIZE;
+    uint8_t *h = p + CSI_BINARY_CSI_FIXED_SIZE;
+    uint8_t *coded = h + CSI_BINARY_DELTA_HEADER_SIZE;
+    uint8_t codec = z == intra ? CSI_DELTA_CODEC_INTRA : 0;
+    size_t coded_len = _csi_delta_rice(z, count, k, coded, count > 0 ? count - 1 : 0);
+    if (coded_len == 0) {
+        memcpy(coded, values, count);
+        coded_len = count;
+        // stored values do not depend on the previous frame either
+        codec = CSI_DELTA_CODEC_INTRA | CSI_DELTA_CODEC_STORED;
+    } else {
+        codec |= k;
+    }
+
+    uint16_t payload_len = CSI_BINARY_CSI_FIXED_SIZE + CSI_BINARY_DELTA_HEADER_SIZE + coded_len;
+    _csi_binary_begin(out, CSI_BINARY_RECORD_CSI_DELTA, payload_len);
+    _csi_binary_put_record(p, r);
+    h[0] = ++s->sequence;
+    h[1] = codec;
+    _csi_binary_put_u16(h + 2, count);
+
+    memcpy(s->previous, values, count);
+    s->count = count;
+    if (codec & CSI_DELTA_CODEC_INTRA) {
+        s->since_keyframe = 0;
+        d->keyframes++;
+    } else {
+        s->since_keyframe++;
+        d->deltas++;
+    }
+    return _csi_binary_end(out, payload_len);
+}
+
+/*
+ * Reverses `_csi_delta_rice()` into residuals. False if the bits end early.
+ */
+bool _csi_delta_unrice(const uint8_t *in, size_t len, uint8_t k, uint16_t count, uint8_t *z) {
+    size_t pos = 0;
+    uint32_t bits = 0;
+    int available = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        // a value takes at most 20 bits
+        while (available <= 24 && pos < len) {
+            bits = (bits << 8) | in[pos++];
+            available += 8;
+        }
+        uint32_t q = 0;
+        while (q < CSI_DELTA_RICE_ESCAPE && available > 0 && (bits >> (available - 1)) & 1) {
+            q++;
+            available--;
+        }
+        if (q == CSI_DELTA_RICE_ESCAPE) {
+            if (available < 8) {
+                return false;
+            }
+            available -= 8;
+            z[i] = (uint8_t) (bits >> available);
+            continue;
+        }
+        if (available < 1 + k) {
+            return false;
+        }
+        available -= 1 + k;
+        uint32_t v = (q << k) | ((bits >> available) & ((1u << k) - 1));
+        if (v > 0xFF) {
+            return false;
+        }
+        z[i] = (uint8_t) v;
+    }
+    return true;
+}
+
+/*
+ * Decodes the values of a `CSI_BINARY_RECORD_CSI_DELTA` record from `csi_binary_decode()`, and turns it into a
+ * `CSI_BINARY_RECORD_CSI` record whose values point into `d` (valid until the next call). False if it cannot be
+ * decoded, because a frame it depends on was missed (counted in `undecodable`) or it is malformed.
+ */
+bool csi_delta_decode(csi_delta_t *d, csi_binary_record_t *record) {
+    uint8_t codec = record->delta_codec;
+    uint16_t count = record->value_count;
+    bool intra = (codec & CSI_DELTA_CODEC_INTRA) != 0;
+    uint8_t k = codec & 0x0F;
+    if ((codec & 0x70) != 0 || (k > CSI_DELTA_MAX_K && k != CSI_DELTA_CODEC_STORED)
+        || (k == CSI_DELTA_CODEC_STORED && (!intra || record->coded_len != count))) {
+        return false;
+    }
+    csi_delta_source_t *s = _csi_delta_source(d, record->record.mac, intra);
+    if (!intra && (s == NULL || s->count != count || (uint8_t) (s->sequence + 1) != record->delta_sequence)) {
+        d->undecodable++;
+        // and so are the frames after it, until the next keyframe
+        if (s != NULL) {
+            s->count = 0;
+        }
+        return false;
+    }
+
+    if (k == CSI_DELTA_CODEC_STORED) {
+        memcpy(s->previous, record->coded, count);
+    } else {
+        uint8_t *z = d->residuals[0];
+        if (!_csi_delta_unrice(record->coded, record->coded_len, k, count, z)) {
+            s->count = 0;
+            return false;
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            int8_t prediction = intra ? (i >= 2 ? s->previous[i - 2] : 0) : s->previous[i];
+            s->previous[i] = (int8_t) (prediction + _csi_delta_unzigzag(z[i]));
+        }
+    }
+    s->sequence = record->delta_sequence;
+    s->count = count;
+    if (intra) {
+        d->keyframes++;
+    } else {
+        d->deltas++;
+    }
+
+    record->type = CSI_BINARY_RECORD_CSI;
+    record->values = s->previous;
+    return true;
+}
+
+#endif //ESP32_CSI_CSI_DELTA_COMPONENT_H
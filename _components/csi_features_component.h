@@ -0,0 +1,304 @@
+#ifndef ESP32_CSI_CSI_FEATURES_COMPONENT_H
+#define ESP32_CSI_CSI_FEATURES_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_format_component.h"
+
+/*
+ * Features of the CSI of each source MAC, for deployments which only need those and not the raw I/Q values.
+ * Runs in the writer task, on frames taken off the ring, in integer arithmetic only:
+ *
+ *   amplitude    per subcarrier in Q8 (amplitude * 256, rounded), as `csi_amplitude_q8` but without floats
+ *   groups       the mean amplitude of every `group` neighbouring subcarriers
+ *   variance     of each group over the last `CSI_FEATURES_WINDOW` frames of the MAC, from running sums
+ *   motion score the summed variances over the summed squared means of the groups, in ppm: 0 for a still channel,
+ *                growing as movement makes the amplitudes fluctuate, and unaffected by the overall gain
+ *
+ * Only the first `CSI_FEATURES_MAX_PAIRS` subcarriers are used: the LLTF, which every frame carries whatever its
+ * sig_mode, so frames of different kinds from one MAC still add to the same window.
+ *
+ * Motion starts when the score reaches `threshold_ppm`, and ends when it falls below half of it. Records:
+ *
+ *   CSI_MOTION,<role>,<mac>,<real_timestamp>,<1 for start, 0 for end>,<score ppm>
+ *   CSI_FEATURES,<role>,<mac>,<real_timestamp>,<frames>,<mean rssi>,<motion>,<score ppm>,<peak score ppm>,<groups>,
+ *       [<mean amplitude of each group over the window> ...]
+ *
+ * A `CSI_FEATURES` summary covers the frames of a MAC since its previous one, and is due once `summary_us` passed.
+ * Up to `CSI_FEATURES_LINKS` MACs are followed at once, the one seen least recently makes way for a new one (so use
+ * the filter, `csi_filter_component.h`, to pick the links of interest).
+ */
+
+#define CSI_FEATURES_MAX_PAIRS 64
+#define CSI_FEATURES_WINDOW 32
+#define CSI_FEATURES_LINKS 4
+
+typedef enum {
+    // raw CSI frames, no features
+    CSI_FEATURES_RAW = 0,
+    // `CSI_FEATURES` summaries and `CSI_MOTION` events
+    CSI_FEATURES_SUMMARY = 1,
+    // `CSI_MOTION` events only
+    CSI_FEATURES_EVENTS = 2,
+} csi_features_mode_t;
+
+// returned by `csi_features_add()`
+#define CSI_FEATURES_MOTION_CHANGED 1
+#define CSI_FEATURES_SUMMARY_DUE 2
+
+typedef struct {
+    bool used;
+    uint8_t mac[6];
+    int64_t last_us;
+    // groups of every frame in the window, reset when a frame has a different number of them
+    int groups;
+    uint16_t window[CSI_FEATURES_WINDOW][CSI_FEATURES_MAX_PAIRS];
+    int next;
+    int count;
+    uint32_t sums[CSI_FEATURES_MAX_PAIRS];
+    uint64_t square_sums[CSI_FEATURES_MAX_PAIRS];
+
+    // 0 until the window is full
+    uint32_t score_ppm;
+    bool motion;
+
+    // since the last summary
+    int64_t summary_start_us;
+    uint32_t frames;
+    int32_t rssi_sum;
+    uint32_t peak_score_ppm;
+} csi_features_link_t;
+
+typedef struct {
+    int group;
+    uint32_t threshold_ppm;
+    int64_t summary_us;
+    csi_features_link_t links[CSI_FEATURES_LINKS];
+} csi_features_t;
+
+void csi_features_configure(csi_features_t *f, int group, uint32_t threshold_ppm, uint32_t summary_ms) {
+    memset(f->links, 0, sizeof(f->links));
+    f->group = group < 1 ? 1 : (group > CSI_FEATURES_MAX_PAIRS ? CSI_FEATURES_MAX_PAIRS : group);
+    f->threshold_ppm = threshold_ppm;
+    f->summary_us = (int64_t) summary_ms * 1000;
+}
+
+/*
+ * sqrt(x), rounded to the nearest integer.
+ */
+uint32_t csi_features_isqrt(uint32_t x) {
+    uint32_t remainder = x;
+    uint32_t root = 0;
+    // a fixed number of steps without branches: the bits of an amplitude give a branch predictor nothing to go by
+    for (uint32_t bit = 1u << 30; bit != 0; bit >>= 2) {
+        uint32_t trial = root + bit;
+        uint32_t take = 0 - (uint32_t) (remainder >= trial);
+        remainder -= trial & take;
+        root = (root >> 1) + (bit & take);
+    }
+    // x - root^2 > root means x > (root + 1/2)^2
+    return root + (remainder > root);
+}
+
+/*
+ * Amplitude of each pair in Q8, at most 46341 (for -128, -128).
+ */
+void csi_features_amplitude_q8(const int8_t *iq, int pairs, uint16_t *out) {
+    for (int k = 0; k < pairs; k++) {
+        int32_t imag = iq[k * 2];
+        int32_t real = iq[k * 2 + 1];
+        out[k] = (uint16_t) csi_features_isqrt((uint32_t) (imag * imag + real * real) << 16);
+    }
+}
+
+/*
+ * Rounded mean of every `group` neighbouring amplitudes (the last group may be smaller). Returns the number of groups.
+ */
+int csi_features_group_q8(const uint16_t *amplitude, int pairs, int group, uint16_t *out) {
+    int groups = 0;
+    for (int k = 0; k < pairs; k += group) {
+        int n = pairs - k < group ? pairs - k : group;
+        uint32_t sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += amplitude[k + i];
+        }
+        out[groups++] = (uint16_t) ((sum + n / 2) / n);
+    }
+    return groups;
+}
+
+/*
+ * Summed variances over summed squared means of a full window, in ppm. Both are W^2 times the sums below.
+ */
+uint32_t _csi_features_score_ppm(const csi_features_link_t *l) {
+    uint64_t spread = 0;
+    uint64_t level = 0;
+    for (int g = 0; g < l->groups; g++) {
+        uint64_t sum = l->sums[g];
+        spread += CSI_FEATURES_WINDOW * l->square_sums[g] - sum * sum;
+        level += sum * sum;
+    }
+    // keeps spread * 10^6 within 64 bits
+    while (spread >= (1ull << 44)) {
+        spread >>= 1;
+        level >>= 1;
+    }
+    if (level == 0) {
+        return 0;
+    }
+    uint64_t score = spread * 1000000 / level;
+    return score > UINT32_MAX ? UINT32_MAX : (uint32_t) score;
+}
+
+csi_features_link_t *_csi_features_link(csi_features_t *f, const uint8_t mac[6], int64_t now_us) {
+    csi_features_link_t *oldest = &f->links[0];
+    for (int i = 0; i < CSI_FEATURES_LINKS; i++) {
+        csi_features_link_t *l = &f->links[i];
+        if (l->used && memcmp(l->mac, mac, 6) == 0) {
+            return l;
+        }
+        if (!l->used || (oldest->used && l->last_us < oldest->last_us)) {
+            oldest = l;
+        }
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->used = true;
+    memcpy(oldest->mac, mac, 6);
+    oldest->summary_start_us = now_us;
+    return oldest;
+}
+
+/*
+ * Adds the CSI of a frame (`len` bytes of interleaved pairs) to the features of its source MAC, `*link` on return.
+ * Returns `CSI_FEATURES_MOTION_CHANGED` if motion started or ended, and `CSI_FEATURES_SUMMARY_DUE` if a summary is due
+ * (write it, then call `csi_features_summary_done()`).
+ */
+uint32_t csi_features_add(csi_features_t *f, const uint8_t mac[6], int8_t rssi, const int8_t *iq, int len,
+                          int64_t now_us, csi_features_link_t **link) {
+    csi_features_link_t *l = _csi_features_link(f, mac, now_us);
+    *link = l;
+    l->last_us = now_us;
+    l->frames++;
+    l->rssi_sum += rssi;
+
+    int pairs = len / 2 < CSI_FEATURES_MAX_PAIRS ? len / 2 : CSI_FEATURES_MAX_PAIRS;
+    uint16_t amplitude[CSI_FEATURES_MAX_PAIRS];
+    uint16_t groups[CSI_FEATURES_MAX_PAIRS];
+    csi_features_amplitude_q8(iq, pairs, amplitude);
+    int n = csi_features_group_q8(amplitude, pairs, f->group, groups);
+    if (n != l->groups) {
+        l->groups = n;
+        l->next = 0;
+        l->count = 0;
+        l->score_ppm = 0;
+        memset(l->sums, 0, sizeof(l->sums));
+        memset(l->square_sums, 0, sizeof(l->square_sums));
+    }
+
+    // the oldest frame leaves the window as the new one enters
+    uint16_t *slot = l->window[l->next];
+    bool full = l->count == CSI_FEATURES_WINDOW;
+    for (int g = 0; g < n; g++) {
+        uint32_t v = groups[g];
+        if (full) {
+            uint32_t old = slot[g];
+            l->sums[g] -= old;
+            l->square_sums[g] -= old * old;
+        }
+        l->sums[g] += v;
+        l->square_sums[g] += v * v;
+        slot[g] = (uint16_t) v;
+    }
+    l->next = (l->next + 1) % CSI_FEATURES_WINDOW;
+    if (!full) {
+        l->count++;
+    }
+
+    uint32_t result = 0;
+    if (l->count == CSI_FEATURES_WINDOW) {
+        l->score_ppm = _csi_features_score_ppm(l);
+        l->peak_score_ppm = l->score_ppm > l->peak_score_ppm ? l->score_ppm : l->peak_score_ppm;
+        bool motion = l->motion ? l->score_ppm >= f->threshold_ppm / 2 : l->score_ppm >= f->threshold_ppm;
+        if (motion != l->motion) {
+            l->motion = motion;
+            result |= CSI_FEATURES_MOTION_CHANGED;
+        }
+    }
+    if (now_us - l->summary_start_us >= f->summary_us) {
+        result |= CSI_FEATURES_SUMMARY_DUE;
+    }
+    return result;
+}
+
+void csi_features_summary_done(csi_features_link_t *l, int64_t now_us) {
+    l->summary_start_us = now_us;
+    l->frames = 0;
+    l->rssi_sum = 0;
+    l->peak_score_ppm = 0;
+}
+
+/*
+ * Q8 as a decimal with 2 places.
+ */
+void _csi_features_format_q8(csi_format_buffer_t *b, uint32_t q8) {
+    uint32_t hundredths = (q8 * 100 + 128) >> 8;
+    csi_format_uint(b, hundredths / 100);
+    csi_format_char(b, '.');
+    csi_format_append(b, CSI_FORMAT_DIGIT_PAIRS + (hundredths % 100) * 2, 2);
+}
+
+void _csi_features_format_start(csi_format_buffer_t *b, const char *type, const char *role,
+                                const csi_features_link_t *l, int64_t real_timestamp_us) {
+    csi_format_reset(b);
+    csi_format_str(b, type);
+    csi_format_char(b, ',');
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    csi_format_mac(b, l->mac);
+    csi_format_char(b, ',');
+    csi_format_timestamp_us(b, real_timestamp_us);
+    csi_format_char(b, ',');
+}
+
+/*
+ * `CSI_MOTION,...` line, see the top of this file.
+ */
+void csi_features_format_motion(csi_format_buffer_t *b, const char *role, const csi_features_link_t *l,
+                                int64_t real_timestamp_us) {
+    _csi_features_format_start(b, "CSI_MOTION", role, l, real_timestamp_us);
+    csi_format_char(b, l->motion ? '1' : '0');
+    csi_format_char(b, ',');
+    csi_format_uint(b, l->score_ppm);
+    csi_format_char(b, '\n');
+}
+
+/*
+ * `CSI_FEATURES,...` line, see the top of this file.
+ */
+void csi_features_format_summary(csi_format_buffer_t *b, const char *role, const csi_features_link_t *l,
+                                 int64_t real_timestamp_us) {
+    _csi_features_format_start(b, "CSI_FEATURES", role, l, real_timestamp_us);
+    csi_format_uint(b, l->frames);
+    csi_format_char(b, ',');
+    csi_format_int(b, l->frames > 0 ? l->rssi_sum / (int32_t) l->frames : 0);
+    csi_format_char(b, ',');
+    csi_format_char(b, l->motion ? '1' : '0');
+    csi_format_char(b, ',');
+    csi_format_uint(b, l->score_ppm);
+    csi_format_char(b, ',');
+    csi_format_uint(b, l->peak_score_ppm);
+    csi_format_char(b, ',');
+    csi_format_uint(b, l->groups);
+    csi_format_str(b, ",[");
+    for (int g = 0; g < l->groups; g++) {
+        if (g > 0) {
+            csi_format_char(b, ' ');
+        }
+        _csi_features_format_q8(b, l->count > 0 ? (l->sums[g] + l->count / 2) / l->count : 0);
+    }
+    csi_format_str(b, "]\n");
+}
+
+#endif //ESP32_CSI_CSI_FEATURES_COMPONENT_H
@@ -0,0 +1,431 @@
+#ifndef ESP32_CSI_CSI_FILTER_COMPONENT_H
+#define ESP32_CSI_CSI_FILTER_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "csi_format_component.h"
+#include "csi_stats_component.h"
+
+/*
+ * Frame filter applied at the top of `_wifi_csi_cb`, before a frame is copied or formatted:
+ * an allowlist or denylist of source MACs, plus optional minimum RSSI, sig_mode and bandwidth conditions.
+ *
+ * It is changed at runtime with `FILTER: <command>[; <command>...]` lines on the serial port:
+ *
+ *   OFF | ALLOW | DENY          how the MAC list is used (OFF ignores it)
+ *   ADD <mac>[,<mac>...]        REMOVE <mac>[,<mac>...]        CLEAR
+ *   RSSI <dBm> | RSSI ANY       frames below <dBm> are dropped
+ *   SIG_MODE <n>[,<n>...] | SIG_MODE ANY      0 = non-HT (11b/g), 1 = HT (11n), 3 = VHT (11ac)
+ *   BANDWIDTH 20 | 40 | ANY
+ *   STATUS
+ *
+ * All commands of a line take effect together, or not at all if one of them is invalid.
+ *
+ * The callback never waits for an update: there are two copies of the rules, the callback reads the active one
+ * and the updater edits the other one and then swaps them. A per-copy reader count tells the updater when the
+ * copy it is about to edit is no longer read.
+ */
+
+typedef enum {
+    CSI_FILTER_OFF,
+    CSI_FILTER_ALLOW,
+    CSI_FILTER_DENY,
+} csi_filter_mode_t;
+
+static const char *const CSI_FILTER_MODE_NAMES[] = {"OFF", "ALLOW", "DENY"};
+
+// Must be a power of two; the table is never filled beyond 3/4 so probe sequences stay short.
+#define CSI_FILTER_SLOTS 64
+#define CSI_FILTER_MAX_MACS (CSI_FILTER_SLOTS * 3 / 4)
+#define CSI_FILTER_ANY_RSSI -128
+#define CSI_FILTER_ANY 0xFF
+// a stored key has this bit set, so an empty slot (0) never matches a MAC
+#define CSI_FILTER_KEY_USED ((uint64_t) 1 << 48)
+
+static_assert((CSI_FILTER_SLOTS & (CSI_FILTER_SLOTS - 1)) == 0, "CSI_FILTER_SLOTS must be a power of two");
+
+typedef struct {
+    // open addressing with linear probing; removal shifts entries back, so there are no tombstones
+    uint64_t keys[CSI_FILTER_SLOTS];
+    uint32_t count;
+    csi_filter_mode_t mode;
+    int8_t min_rssi;
+    // bit n set if sig_mode / cwb n passes
+    uint8_t sig_modes;
+    uint8_t bandwidths;
+} csi_filter_rules_t;
+
+typedef struct {
+    csi_filter_rules_t rules[2];
+    std::atomic<uint32_t> active;
+    std::atomic<uint32_t> readers[2];
+    // false while the active rules let everything pass, which skips the lookup entirely
+    std::atomic<bool> enabled;
+    std::atomic<uint32_t> passed;
+    std::atomic<uint32_t> rejected;
+} csi_filter_t;
+
+void _csi_filter_rules_reset(csi_filter_rules_t *r) {
+    memset(r->keys, 0, sizeof(r->keys));
+    r->count = 0;
+    r->mode = CSI_FILTER_OFF;
+    r->min_rssi = CSI_FILTER_ANY_RSSI;
+    r->sig_modes = CSI_FILTER_ANY;
+    r->bandwidths = CSI_FILTER_ANY;
+}
+
+void csi_filter_reset(csi_filter_t *f) {
+    _csi_filter_rules_reset(&f->rules[0]);
+    _csi_filter_rules_reset(&f->rules[1]);
+    f->active.store(0);
+    f->readers[0].store(0);
+    f->readers[1].store(0);
+    f->enabled.store(false);
+    f->passed.store(0);
+    f->rejected.store(0);
+}
+
+uint64_t _csi_filter_key(const uint8_t mac[6]) {
+    uint64_t key = CSI_FILTER_KEY_USED;
+    for (int i = 0; i < 6; i++) {
+        key |= (uint64_t) mac[i] << (40 - 8 * i);
+    }
+    return key;
+}
+
+// slot holding `key`, or the empty slot where it would go
+uint32_t _csi_filter_slot(const csi_filter_rules_t *r, const uint8_t mac[6], uint64_t key) {
+    uint32_t i = _csi_mac_hash(mac) & (CSI_FILTER_SLOTS - 1);
+    while (r->keys[i] != 0 && r->keys[i] != key) {
+        i = (i + 1) & (CSI_FILTER_SLOTS - 1);
+    }
+    return i;
+}
+
+bool csi_filter_rules_contains(const csi_filter_rules_t *r, const uint8_t mac[6]) {
+    uint64_t key = _csi_filter_key(mac);
+    return r->keys[_csi_filter_slot(r, mac, key)] == key;
+}
+
+/*
+ * False if the table is full.
+ */
+bool csi_filter_rules_add(csi_filter_rules_t *r, const uint8_t mac[6]) {
+    uint64_t key = _csi_filter_key(mac);
+    uint32_t i = _csi_filter_slot(r, mac, key);
+    if (r->keys[i] == key) {
+        return true;
+    }
+    if (r->count >= CSI_FILTER_MAX_MACS) {
+        return false;
+    }
+    r->keys[i] = key;
+    r->count++;
+    return true;
+}
+
+void csi_filter_rules_remove(csi_filter_rules_t *r, const uint8_t mac[6]) {
+    uint64_t key = _csi_filter_key(mac);
+    uint32_t hole = _csi_filter_slot(r, mac, key);
+    if (r->keys[hole] != key) {
+        return;
+    }
+    r->keys[hole] = 0;
+    r->count--;
+    // move later entries of the same probe sequence back into the hole, so lookups never stop short of them
+    uint32_t i = hole;
+    while (true) {
+        i = (i + 1) & (CSI_FILTER_SLOTS - 1);
+        if (r->keys[i] == 0) {
+            return;
+        }
+        uint8_t other[6];
+        for (int b = 0; b < 6; b++) {
+            other[b] = (uint8_t) (r->keys[i] >> (40 - 8 * b));
+        }
+        uint32_t home = _csi_mac_hash(other) & (CSI_FILTER_SLOTS - 1);
+        // the entry may move if its home slot is not cyclically within (hole, i]
+        if (((i - home) & (CSI_FILTER_SLOTS - 1)) >= ((i - hole) & (CSI_FILTER_SLOTS - 1))) {
+            r->keys[hole] = r->keys[i];
+            r->keys[i] = 0;
+            hole = i;
+        }
+    }
+}
+
+bool _csi_filter_rules_pass_all(const csi_filter_rules_t *r) {
+    return r->mode == CSI_FILTER_OFF && r->min_rssi == CSI_FILTER_ANY_RSSI && r->sig_modes == CSI_FILTER_ANY
+           && r->bandwidths == CSI_FILTER_ANY;
+}
+
+bool csi_filter_rules_accept(const csi_filter_rules_t *r, const uint8_t mac[6], int8_t rssi, uint8_t sig_mode,
+                             uint8_t cwb) {
+    if (rssi < r->min_rssi || !(r->sig_modes & (1 << (sig_mode & 7))) || !(r->bandwidths & (1 << (cwb & 7)))) {
+        return false;
+    }
+    if (r->mode == CSI_FILTER_OFF) {
+        return true;
+    }
+    return csi_filter_rules_contains(r, mac) == (r->mode == CSI_FILTER_ALLOW);
+}
+
+/*
+ * Called for every frame, from the Wi-Fi driver task. Never blocks.
+ */
+bool csi_filter_accept(csi_filter_t *f, const uint8_t mac[6], int8_t rssi, uint8_t sig_mode, uint8_t cwb) {
+    if (!f->enabled.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    uint32_t i;
+    while (true) {
+        i = f->active.load();
+        f->readers[i].fetch_add(1);
+        // the rules may have been swapped between the two lines above, in which case the updater may edit them
+        if (f->active.load() == i) {
+            break;
+        }
+        f->readers[i].fetch_sub(1);
+    }
+    bool accept = csi_filter_rules_accept(&f->rules[i], mac, rssi, sig_mode, cwb);
+    f->readers[i].fetch_sub(1);
+    // only the Wi-Fi driver task counts, so no read-modify-write is needed
+    std::atomic<uint32_t> &counter = accept ? f->passed : f->rejected;
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return accept;
+}
+
+/*
+ * Updater (a single task): returns a copy of the active rules to change, which only takes effect
+ * with `csi_filter_publish()`.
+ */
+csi_filter_rules_t *csi_filter_edit(csi_filter_t *f) {
+    uint32_t next = 1 - f->active.load();
+    // Readers still on the copy swapped out last time are in the middle of a single lookup. The Wi-Fi driver
+    // task has a higher priority than anything updating the filter, so they are never stuck behind this loop.
+    while (f->readers[next].load() != 0) {
+    }
+    f->rules[next] = f->rules[1 - next];
+    return &f->rules[next];
+}
+
+void csi_filter_publish(csi_filter_t *f) {
+    uint32_t next = 1 - f->active.load();
+    f->enabled.store(!_csi_filter_rules_pass_all(&f->rules[next]));
+    f->active.store(next);
+}
+
+const csi_filter_rules_t *csi_filter_rules(csi_filter_t *f) {
+    return &f->rules[f->active.load()];
+}
+
+bool _csi_filter_parse_mac(const char **p, uint8_t mac[6]) {
+    const char *s = *p;
+    for (int i = 0; i < 6; i++) {
+        char *end;
+        if (!((s[0] >= '0' && s[0] <= '9') || (s[0] >= 'a' && s[0] <= 'f') || (s[0] >= 'A' && s[0] <= 'F'))) {
+            return false;
+        }
+        unsigned long v = strtoul(s, &end, 16);
+        if (end - s != 2 || v > 0xFF || (i < 5 && *end != ':')) {
+            return false;
+        }
+        mac[i] = (uint8_t) v;
+        s = end + (i < 5 ? 1 : 0);
+    }
+    *p = s;
+    return true;
+}
+
+bool _csi_filter_word(const char **p, const char *word) {
+    size_t n = strlen(word);
+    if (strncmp(*p, word, n) != 0 || ((*p)[n] != '\0' && (*p)[n] != ' ' && (*p)[n] != ';')) {
+        return false;
+    }
+    *p += n;
+    while (**p == ' ') {
+        (*p)++;
+    }
+    return true;
+}
+
+// end of a command: nothing but spaces until ';' or the end of the line
+bool _csi_filter_end(const char **p) {
+    while (**p == ' ') {
+        (*p)++;
+    }
+    return **p == ';' || **p == '\0';
+}
+
+bool _csi_filter_macs(const char **p, csi_filter_rules_t *r, bool add) {
+    while (true) {
+        while (**p == ' ') {
+            (*p)++;
+        }
+        uint8_t mac[6];
+        if (!_csi_filter_parse_mac(p, mac)) {
+            return false;
+        }
+        if (add) {
+            if (!csi_filter_rules_add(r, mac)) {
+                return false;
+            }
+        } else {
+            csi_filter_rules_remove(r, mac);
+        }
+        if (**p != ',') {
+            return _csi_filter_end(p);
+        }
+        (*p)++;
+    }
+}
+
+// comma separated numbers below 8, as a bit set
+bool _csi_filter_bits(const char **p, uint8_t *out) {
+    if (_csi_filter_word(p, "ANY")) {
+        *out = CSI_FILTER_ANY;
+        return _csi_filter_end(p);
+    }
+    uint8_t bits = 0;
+    while (true) {
+        char *end;
+        long v = strtol(*p, &end, 10);
+        if (end == *p || v < 0 || v > 7) {
+            return false;
+        }
+        bits |= 1 << v;
+        *p = end;
+        if (**p != ',') {
+            *out = bits;
+            return _csi_filter_end(p);
+        }
+        (*p)++;
+    }
+}
+
+/*
+ * `FILTER: STATUS` reply: `CSI_FILTER,<mode>,<MACs>,<min rssi|ANY>,<sig_mode bits>,<bandwidth bits>,<passed>,<rejected>`
+ * followed by one `CSI_FILTER_MAC,<mac>` line per MAC.
+ */
+void _csi_filter_status(csi_filter_t *f, const csi_filter_rules_t *r, csi_format_buffer_t *reply) {
+    csi_format_str(reply, "CSI_FILTER,");
+    csi_format_str(reply, CSI_FILTER_MODE_NAMES[r->mode]);
+    csi_format_char(reply, ',');
+    csi_format_uint(reply, r->count);
+    csi_format_char(reply, ',');
+    if (r->min_rssi == CSI_FILTER_ANY_RSSI) {
+        csi_format_str(reply, "ANY");
+    } else {
+        csi_format_int(reply, r->min_rssi);
+    }
+    csi_format_char(reply, ',');
+    csi_format_uint(reply, r->sig_modes);
+    csi_format_char(reply, ',');
+    csi_format_uint(reply, r->bandwidths);
+    csi_format_char(reply, ',');
+    csi_format_uint(reply, f->passed.load(std::memory_order_relaxed));
+    csi_format_char(reply, ',');
+    csi_format_uint(reply, f->rejected.load(std::memory_order_relaxed));
+    csi_format_char(reply, '\n');
+    for (int i = 0; i < CSI_FILTER_SLOTS; i++) {
+        if (r->keys[i] != 0) {
+            uint8_t mac[6];
+            for (int b = 0; b < 6; b++) {
+                mac[b] = (uint8_t) (r->keys[i] >> (40 - 8 * b));
+            }
+            csi_format_str(reply, "CSI_FILTER_MAC,");
+            csi_format_mac(reply, mac);
+            csi_format_char(reply, '\n');
+        }
+    }
+}
+
+bool csi_filter_match_command(const char *line) {
+    return strncmp(line, "FILTER:", 7) == 0;
+}
+
+/*
+ * Applies the commands of a `FILTER: ...` line (see the top of this file), the `FILTER:` being optional. `reply` gets
+ * the status for `STATUS`, `invalid command at "<rest of line>"` if a command is not valid and nothing otherwise.
+ */
+bool csi_filter_command(csi_filter_t *f, const char *line, csi_format_buffer_t *reply) {
+    csi_format_reset(reply);
+    const char *p = line + (csi_filter_match_command(line) ? 7 : 0);
+    csi_filter_rules_t *r = csi_filter_edit(f);
+    bool status = false;
+    bool ok = true;
+    // start of the command being parsed, for the error reply
+    const char *command = p;
+    while (ok) {
+        while (*p == ' ' || *p == ';') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        command = p;
+        if (_csi_filter_word(&p, "OFF")) {
+            r->mode = CSI_FILTER_OFF;
+            ok = _csi_filter_end(&p);
+        } else if (_csi_filter_word(&p, "ALLOW")) {
+            r->mode = CSI_FILTER_ALLOW;
+            ok = _csi_filter_end(&p);
+        } else if (_csi_filter_word(&p, "DENY")) {
+            r->mode = CSI_FILTER_DENY;
+            ok = _csi_filter_end(&p);
+        } else if (_csi_filter_word(&p, "ADD")) {
+            ok = _csi_filter_macs(&p, r, true);
+        } else if (_csi_filter_word(&p, "REMOVE")) {
+            ok = _csi_filter_macs(&p, r, false);
+        } else if (_csi_filter_word(&p, "CLEAR")) {
+            memset(r->keys, 0, sizeof(r->keys));
+            r->count = 0;
+            ok = _csi_filter_end(&p);
+        } else if (_csi_filter_word(&p, "RSSI")) {
+            if (_csi_filter_word(&p, "ANY")) {
+                r->min_rssi = CSI_FILTER_ANY_RSSI;
+            } else {
+                char *end;
+                long v = strtol(p, &end, 10);
+                ok = end != p && v >= -127 && v <= 127;
+                r->min_rssi = (int8_t) v;
+                p = end;
+            }
+            ok = ok && _csi_filter_end(&p);
+        } else if (_csi_filter_word(&p, "SIG_MODE")) {
+            ok = _csi_filter_bits(&p, &r->sig_modes);
+        } else if (_csi_filter_word(&p, "BANDWIDTH")) {
+            if (_csi_filter_word(&p, "20")) {
+                r->bandwidths = 1 << 0;
+            } else if (_csi_filter_word(&p, "40")) {
+                r->bandwidths = 1 << 1;
+            } else {
+                ok = _csi_filter_word(&p, "ANY");
+                r->bandwidths = CSI_FILTER_ANY;
+            }
+            ok = ok && _csi_filter_end(&p);
+        } else if (_csi_filter_word(&p, "STATUS")) {
+            status = true;
+            ok = _csi_filter_end(&p);
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok) {
+        // the edited copy is simply not published
+        csi_format_str(reply, "invalid command at \"");
+        csi_format_str(reply, command);
+        csi_format_str(reply, "\"\n");
+        return false;
+    }
+    csi_filter_publish(f);
+    if (status) {
+        _csi_filter_status(f, csi_filter_rules(f), reply);
+    }
+    return true;
+}
+
+#endif //ESP32_CSI_CSI_FILTER_COMPONENT_H
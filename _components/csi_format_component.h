@@ -0,0 +1,240 @@
+#ifndef ESP32_CSI_CSI_FORMAT_COMPONENT_H
+#define ESP32_CSI_CSI_FORMAT_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Allocation-free formatting of `CSI_DATA,...` lines.
+ */
+
+// A full LLTF + HT-LTF + STBC-HT-LTF frame (612 values at up to 5 chars each) plus the header fits.
+#define CSI_FORMAT_BUFFER_SIZE 4096
+
+#define CSI_CSV_HEADER "type,role,mac,rssi,rate,sig_mode,mcs,bandwidth,smoothing,not_sounding,aggregation,stbc,fec_coding,sgi,noise_floor,ampdu_cnt,channel,secondary_channel,local_timestamp,ant,sig_len,rx_state,real_time_set,real_timestamp,real_time_uncertainty_us,len,CSI_DATA\n"
+
+/*
+ * Header fields of a single CSI frame, copied out of `wifi_csi_info_t`.
+ * Field order follows the columns of `CSI_CSV_HEADER`.
+ */
+typedef struct {
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t rate;
+    uint8_t sig_mode;
+    uint8_t mcs;
+    uint8_t cwb;
+    uint8_t smoothing;
+    uint8_t not_sounding;
+    uint8_t aggregation;
+    uint8_t stbc;
+    uint8_t fec_coding;
+    uint8_t sgi;
+    int8_t noise_floor;
+    uint8_t ampdu_cnt;
+    uint8_t channel;
+    uint8_t secondary_channel;
+    uint8_t ant;
+    uint8_t rx_state;
+    uint8_t real_time_set;
+    uint16_t sig_len;
+    uint16_t len;
+    uint32_t local_timestamp;
+    int64_t real_timestamp_us;
+    // bound on the error of `real_timestamp_us` from clock sync, 0 if unknown
+    uint32_t real_time_uncertainty_us;
+} csi_record_t;
+
+/*
+ * Fixed capacity line buffer. Appends past the end are dropped and flagged with `overflow`.
+ */
+typedef struct {
+    char buf[CSI_FORMAT_BUFFER_SIZE];
+    size_t len;
+    bool overflow;
+} csi_format_buffer_t;
+
+static const char CSI_FORMAT_DIGIT_PAIRS[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+static const char CSI_FORMAT_HEX_DIGITS[17] = "0123456789ABCDEF";
+
+void csi_format_reset(csi_format_buffer_t *b) {
+    b->len = 0;
+    b->overflow = false;
+}
+
+void csi_format_append(csi_format_buffer_t *b, const char *s, size_t n) {
+    if (b->len + n > CSI_FORMAT_BUFFER_SIZE) {
+        n = CSI_FORMAT_BUFFER_SIZE - b->len;
+        b->overflow = true;
+    }
+    memcpy(b->buf + b->len, s, n);
+    b->len += n;
+}
+
+void csi_format_str(csi_format_buffer_t *b, const char *s) {
+    csi_format_append(b, s, strlen(s));
+}
+
+void csi_format_char(csi_format_buffer_t *b, char c) {
+    if (b->len < CSI_FORMAT_BUFFER_SIZE) {
+        b->buf[b->len++] = c;
+    } else {
+        b->overflow = true;
+    }
+}
+
+/*
+ * Writes the decimal digits of `v` backwards ending just before `end`, two digits at a time.
+ * Returns a pointer to the first digit. `end` must have at least 20 bytes in front of it.
+ */
+char *_csi_format_u64_digits(char *end, uint64_t v) {
+    char *p = end;
+    while (v >= 100) {
+        const char *pair = CSI_FORMAT_DIGIT_PAIRS + (v % 100) * 2;
+        v /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (v >= 10) {
+        const char *pair = CSI_FORMAT_DIGIT_PAIRS + v * 2;
+        *--p = pair[1];
+        *--p = pair[0];
+    } else {
+        *--p = (char) ('0' + v);
+    }
+    return p;
+}
+
+void csi_format_uint(csi_format_buffer_t *b, uint64_t v) {
+    char tmp[20];
+    char *start = _csi_format_u64_digits(tmp + sizeof(tmp), v);
+    csi_format_append(b, start, tmp + sizeof(tmp) - start);
+}
+
+void csi_format_int(csi_format_buffer_t *b, int64_t v) {
+    if (v < 0) {
+        csi_format_char(b, '-');
+        csi_format_uint(b, 0 - (uint64_t) v);
+    } else {
+        csi_format_uint(b, (uint64_t) v);
+    }
+}
+
+void csi_format_mac(csi_format_buffer_t *b, const uint8_t mac[6]) {
+    char tmp[17];
+    for (int i = 0; i < 6; i++) {
+        tmp[i * 3] = CSI_FORMAT_HEX_DIGITS[mac[i] >> 4];
+        tmp[i * 3 + 1] = CSI_FORMAT_HEX_DIGITS[mac[i] & 0x0F];
+        if (i < 5) {
+            tmp[i * 3 + 2] = ':';
+        }
+    }
+    csi_format_append(b, tmp, sizeof(tmp));
+}
+
+/*
+ * Prints microseconds as seconds with all 6 decimals, e.g. `1700000000.000250` or `-0.500000`. Exact for any value,
+ * where the 6 significant digits of `%g` (which the CSV used before) round a current epoch time to 10000 s.
+ */
+void csi_format_timestamp_us(csi_format_buffer_t *b, int64_t us) {
+    uint64_t u = (uint64_t) us;
+    if (us < 0) {
+        csi_format_char(b, '-');
+        u = 0 - u;
+    }
+
+    char tmp[28];
+    char *p = tmp + sizeof(tmp);
+    uint32_t fraction = (uint32_t) (u % 1000000);
+    for (int i = 0; i < 3; i++) {
+        p -= 2;
+        memcpy(p, CSI_FORMAT_DIGIT_PAIRS + (fraction % 100) * 2, 2);
+        fraction /= 100;
+    }
+    *--p = '.';
+    const char *s = _csi_format_u64_digits(p, u / 1000000);
+    csi_format_append(b, s, tmp + sizeof(tmp) - s);
+}
+
+/*
+ * Everything up to and including the opening `[` of the CSI value list.
+ */
+void csi_format_csv_prefix(csi_format_buffer_t *b, const char *type, const csi_record_t *r) {
+    csi_format_append(b, "CSI_DATA,", 9);
+    csi_format_str(b, type);
+    csi_format_char(b, ',');
+    csi_format_mac(b, r->mac);
+    csi_format_char(b, ',');
+
+    const int64_t fields[] = {
+            r->rssi, r->rate, r->sig_mode, r->mcs, r->cwb, r->smoothing, r->not_sounding,
+            r->aggregation, r->stbc, r->fec_coding, r->sgi, r->noise_floor, r->ampdu_cnt,
+            r->channel, r->secondary_channel, r->local_timestamp, r->ant, r->sig_len, r->rx_state,
+            r->real_time_set,
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        csi_format_int(b, fields[i]);
+        csi_format_char(b, ',');
+    }
+
+    csi_format_timestamp_us(b, r->real_timestamp_us);
+    csi_format_char(b, ',');
+    csi_format_uint(b, r->real_time_uncertainty_us);
+    csi_format_char(b, ',');
+    csi_format_uint(b, r->len);
+    csi_format_append(b, ",[", 2);
+}
+
+/*
+ * Raw CSI values, each followed by a single space.
+ */
+void csi_format_csv_values(csi_format_buffer_t *b, const int8_t *values, int count) {
+    if (b->len + (size_t) count * 5 > CSI_FORMAT_BUFFER_SIZE) {
+        for (int i = 0; i < count; i++) {
+            csi_format_int(b, values[i]);
+            csi_format_char(b, ' ');
+        }
+        return;
+    }
+
+    // "-128 " is the longest possible entry, so the capacity check above covers every write below
+    char *p = b->buf + b->len;
+    for (int i = 0; i < count; i++) {
+        int v = values[i];
+        if (v < 0) {
+            *p++ = '-';
+            v = -v;
+        }
+        if (v >= 100) {
+            *p++ = '1';
+            v -= 100;
+            *p++ = CSI_FORMAT_DIGIT_PAIRS[v * 2];
+            *p++ = CSI_FORMAT_DIGIT_PAIRS[v * 2 + 1];
+        } else if (v >= 10) {
+            *p++ = CSI_FORMAT_DIGIT_PAIRS[v * 2];
+            *p++ = CSI_FORMAT_DIGIT_PAIRS[v * 2 + 1];
+        } else {
+            *p++ = (char) ('0' + v);
+        }
+        *p++ = ' ';
+    }
+    b->len = p - b->buf;
+}
+
+void csi_format_csv_suffix(csi_format_buffer_t *b) {
+    csi_format_append(b, "]\n", 2);
+}
+
+#endif //ESP32_CSI_CSI_FORMAT_COMPONENT_H
@@ -0,0 +1,271 @@
+#ifndef ESP32_CSI_CSI_LAYOUT_COMPONENT_H
+#define ESP32_CSI_CSI_LAYOUT_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "csi_format_component.h"
+
+/*
+ * Which bytes of a CSI buffer belong to which training field and subcarrier.
+ *
+ * The driver hands over the LLTF, then the HT-LTF and the STBC-HT-LTF of a frame, as far as it has them, each as
+ * interleaved imaginary/real int8 pairs of its subcarriers. Which of them a frame has, and which subcarriers each
+ * covers in which order, depends on the signal mode, bandwidth, secondary channel and STBC of the frame (the table
+ * in the ESP-IDF Wi-Fi guide, "Wi-Fi Channel State Information"):
+ *
+ *   secondary  sig_mode  cwb   stbc  LLTF             HT-LTF           STBC-HT-LTF      bytes
+ *   none       non HT    20    -     0~31,-32~-1      -                -                128
+ *   none       HT        20    no    0~31,-32~-1      0~31,-32~-1      -                256
+ *   none       HT        20    yes   0~31,-32~-1      0~31,-32~-1      0~31,-32~-1      384
+ *   below      non HT    20    -     0~63             -                -                128
+ *   below      HT        20    no    0~63             0~63             -                256
+ *   below      HT        20    yes   0~63             0~62             0~62             380
+ *   below      HT        40    no    0~63             0~63,-64~-1      -                384
+ *   below      HT        40    yes   0~63             0~60,-60~-1      0~60,-60~-1      612
+ *   above      non HT    20    -     -64~-1           -                -                128
+ *   above      HT        20    no    -64~-1           -64~-1           -                256
+ *   above      HT        20    yes   -64~-1           -62~-1           -62~-1           376
+ *   above      HT        40    no    -64~-1           0~63,-64~-1      -                384
+ *   above      HT        40    yes   -64~-1           0~60,-60~-1      0~60,-60~-1      612
+ *
+ * With a secondary channel the subcarriers are numbered as in the 40 MHz channel, so those of the 20 MHz primary
+ * channel are centred on 32 (secondary below) or -32 (secondary above). Not every listed subcarrier carries
+ * anything: the LLTF uses 26 on either side of the centre, the 20 MHz HT-LTF 28, the 40 MHz HT-LTF 2 to 58 on either
+ * side. The rest (the DC subcarrier and the guard bands) are null.
+ *
+ * A buffer may hold just the first segments of its frame (e.g. `CONFIG_SHOULD_COLLECT_ONLY_LLTF`), which
+ * `csi_layout_fit()` tells from the number of values. The views point into the buffer, nothing is copied.
+ *
+ * Only a lookup table and arithmetic, also used by `cpp_utils/csi_parse` to export the training fields.
+ */
+
+#define CSI_LAYOUT_MAX_SEGMENTS 3
+
+typedef enum {
+    CSI_FIELD_LLTF = 0,
+    CSI_FIELD_HT_LTF = 1,
+    CSI_FIELD_STBC_HT_LTF = 2,
+} csi_field_t;
+
+typedef struct {
+    csi_field_t field;
+    // in values (two per subcarrier) from the start of the buffer
+    uint16_t offset;
+    uint8_t count;
+    // subcarrier indices in buffer order: `runs[0].count` from `runs[0].first` up, then the same for `runs[1]`
+    struct {
+        int8_t first;
+        uint8_t count;
+    } runs[2];
+    // subcarrier k carries something if `dc_gap <= |k - center| <= edge`
+    int8_t center;
+    uint8_t dc_gap;
+    uint8_t edge;
+} csi_segment_t;
+
+typedef struct {
+    // of the frame, whether or not the buffer holds them all
+    uint8_t segment_total;
+    uint16_t total_len;
+    // held by the buffer, set by `csi_layout_fit()`
+    uint8_t segment_count;
+    uint16_t len;
+    csi_segment_t segments[CSI_LAYOUT_MAX_SEGMENTS];
+} csi_layout_t;
+
+/*
+ * A segment of a buffer. Entry `i` is subcarrier `csi_segment_subcarrier(segment, i)`.
+ */
+typedef struct {
+    const csi_segment_t *segment;
+    const int8_t *data;
+} csi_segment_view_t;
+
+// The subcarrier spans of the table above.
+typedef enum {
+    _CSI_SPAN_20,
+    _CSI_SPAN_UPPER_64,
+    _CSI_SPAN_UPPER_63,
+    _CSI_SPAN_LOWER_64,
+    _CSI_SPAN_LOWER_62,
+    _CSI_SPAN_40,
+    _CSI_SPAN_40_STBC,
+    _CSI_SPAN_NONE,
+} _csi_span_t;
+
+typedef struct {
+    uint8_t secondary_channel;
+    uint8_t sig_mode;
+    uint8_t cwb;
+    uint8_t stbc;
+    uint8_t spans[CSI_LAYOUT_MAX_SEGMENTS];
+} _csi_layout_row_t;
+
+// `stbc` 2 matches either, as non-HT frames have no STBC.
+static const _csi_layout_row_t _CSI_LAYOUT_ROWS[] = {
+        {0, 0, 0, 2, {_CSI_SPAN_20, _CSI_SPAN_NONE, _CSI_SPAN_NONE}},
+        {0, 1, 0, 0, {_CSI_SPAN_20, _CSI_SPAN_20, _CSI_SPAN_NONE}},
+        {0, 1, 0, 1, {_CSI_SPAN_20, _CSI_SPAN_20, _CSI_SPAN_20}},
+        {2, 0, 0, 2, {_CSI_SPAN_UPPER_64, _CSI_SPAN_NONE, _CSI_SPAN_NONE}},
+        {2, 1, 0, 0, {_CSI_SPAN_UPPER_64, _CSI_SPAN_UPPER_64, _CSI_SPAN_NONE}},
+        {2, 1, 0, 1, {_CSI_SPAN_UPPER_64, _CSI_SPAN_UPPER_63, _CSI_SPAN_UPPER_63}},
+        {2, 1, 1, 0, {_CSI_SPAN_UPPER_64, _CSI_SPAN_40, _CSI_SPAN_NONE}},
+        {2, 1, 1, 1, {_CSI_SPAN_UPPER_64, _CSI_SPAN_40_STBC, _CSI_SPAN_40_STBC}},
+        {1, 0, 0, 2, {_CSI_SPAN_LOWER_64, _CSI_SPAN_NONE, _CSI_SPAN_NONE}},
+        {1, 1, 0, 0, {_CSI_SPAN_LOWER_64, _CSI_SPAN_LOWER_64, _CSI_SPAN_NONE}},
+        {1, 1, 0, 1, {_CSI_SPAN_LOWER_64, _CSI_SPAN_LOWER_62, _CSI_SPAN_LOWER_62}},
+        {1, 1, 1, 0, {_CSI_SPAN_LOWER_64, _CSI_SPAN_40, _CSI_SPAN_NONE}},
+        {1, 1, 1, 1, {_CSI_SPAN_LOWER_64, _CSI_SPAN_40_STBC, _CSI_SPAN_40_STBC}},
+};
+
+void _csi_layout_span(csi_segment_t *s, _csi_span_t span) {
+    static const int8_t runs[][4] = {
+            {0, 32, -32, 32},
+            {0, 64, 0, 0},
+            {0, 63, 0, 0},
+            {-64, 64, 0, 0},
+            {-62, 62, 0, 0},
+            {0, 64, -64, 64},
+            {0, 61, -60, 60},
+    };
+    s->runs[0].first = runs[span][0];
+    s->runs[0].count = (uint8_t) runs[span][1];
+    s->runs[1].first = runs[span][2];
+    s->runs[1].count = (uint8_t) runs[span][3];
+    s->count = s->runs[0].count + s->runs[1].count;
+}
+
+/*
+ * The layout of a whole frame. False for a combination the driver does not hand over (e.g. 40 MHz without a
+ * secondary channel).
+ */
+bool csi_layout_init(csi_layout_t *l, uint8_t sig_mode, uint8_t cwb, uint8_t secondary_channel, uint8_t stbc) {
+    const _csi_layout_row_t *row = NULL;
+    for (size_t i = 0; i < sizeof(_CSI_LAYOUT_ROWS) / sizeof(_CSI_LAYOUT_ROWS[0]); i++) {
+        const _csi_layout_row_t *r = &_CSI_LAYOUT_ROWS[i];
+        if (r->secondary_channel == secondary_channel && r->sig_mode == sig_mode && r->cwb == cwb
+            && (r->stbc == 2 || r->stbc == (stbc != 0))) {
+            row = r;
+            break;
+        }
+    }
+    l->segment_total = l->segment_count = 0;
+    l->total_len = l->len = 0;
+    if (row == NULL) {
+        return false;
+    }
+
+    int8_t center = secondary_channel == 2 ? 32 : (secondary_channel == 1 ? -32 : 0);
+    for (int i = 0; i < CSI_LAYOUT_MAX_SEGMENTS && row->spans[i] != _CSI_SPAN_NONE; i++) {
+        csi_segment_t *s = &l->segments[i];
+        s->field = (csi_field_t) i;
+        s->offset = l->total_len;
+        _csi_layout_span(s, (_csi_span_t) row->spans[i]);
+        bool wide = i > 0 && cwb == 1;
+        s->center = wide ? 0 : center;
+        s->dc_gap = wide ? 2 : 1;
+        s->edge = i == 0 ? 26 : (wide ? 58 : 28);
+        l->total_len += 2 * s->count;
+        l->segment_total++;
+    }
+    l->segment_count = l->segment_total;
+    l->len = l->total_len;
+    return true;
+}
+
+/*
+ * Sets how many segments a buffer of `value_count` values holds. False unless it holds a whole number of them.
+ */
+bool csi_layout_fit(csi_layout_t *l, uint16_t value_count) {
+    uint16_t len = 0;
+    for (int i = 0; i <= l->segment_total; i++) {
+        if (len == value_count) {
+            l->segment_count = i;
+            l->len = len;
+            return true;
+        }
+        if (i < l->segment_total) {
+            len += 2 * l->segments[i].count;
+        }
+    }
+    return false;
+}
+
+/*
+ * The layout of a buffer of `value_count` values of the frame described by `r`.
+ */
+bool csi_layout_from_record(csi_layout_t *l, const csi_record_t *r, uint16_t value_count) {
+    return csi_layout_init(l, r->sig_mode, r->cwb, r->secondary_channel, r->stbc) && csi_layout_fit(l, value_count);
+}
+
+/*
+ * The number of values of the first `segments` segments, e.g. to copy only those.
+ */
+uint16_t csi_layout_prefix_len(const csi_layout_t *l, int segments) {
+    uint16_t len = 0;
+    for (int i = 0; i < segments && i < l->segment_total; i++) {
+        len += 2 * l->segments[i].count;
+    }
+    return len;
+}
+
+int csi_segment_subcarrier(const csi_segment_t *s, int i) {
+    return i < s->runs[0].count ? s->runs[0].first + i : s->runs[1].first + (i - s->runs[0].count);
+}
+
+/*
+ * The entry of subcarrier `k` in the segment, -1 if it has none.
+ */
+int csi_segment_find(const csi_segment_t *s, int k) {
+    for (int run = 0, base = 0; run < 2; base += s->runs[run].count, run++) {
+        int i = k - s->runs[run].first;
+        if (i >= 0 && i < s->runs[run].count) {
+            return base + i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * False for the DC and guard subcarriers, which are null.
+ */
+bool csi_segment_used(const csi_segment_t *s, int k) {
+    int distance = k > s->center ? k - s->center : s->center - k;
+    return distance >= s->dc_gap && distance <= s->edge;
+}
+
+/*
+ * The view of `field` in `buf`. False if the buffer does not hold it.
+ */
+bool csi_layout_view(const csi_layout_t *l, const int8_t *buf, csi_field_t field, csi_segment_view_t *view) {
+    if ((int) field >= l->segment_count) {
+        return false;
+    }
+    view->segment = &l->segments[field];
+    view->data = buf + view->segment->offset;
+    return true;
+}
+
+int8_t csi_view_imag(const csi_segment_view_t *v, int i) {
+    return v->data[2 * i];
+}
+
+int8_t csi_view_real(const csi_segment_view_t *v, int i) {
+    return v->data[2 * i + 1];
+}
+
+/*
+ * The pair of subcarrier `k`. False if the segment does not have it or it is null.
+ */
+bool csi_view_get(const csi_segment_view_t *v, int k, int8_t *imag, int8_t *real) {
+    int i = csi_segment_find(v->segment, k);
+    if (i < 0 || !csi_segment_used(v->segment, k)) {
+        return false;
+    }
+    *imag = csi_view_imag(v, i);
+    *real = csi_view_real(v, i);
+    return true;
+}
+
+#endif //ESP32_CSI_CSI_LAYOUT_COMPONENT_H
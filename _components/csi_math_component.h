@@ -0,0 +1,263 @@
+#ifndef ESP32_CSI_CSI_MATH_COMPONENT_H
+#define ESP32_CSI_CSI_MATH_COMPONENT_H
+
+#include <stdint.h>
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Bulk amplitude/phase of raw CSI buffers, shared by the firmware (`CSI_AMPLITUDE` / `CSI_PHASE`)
+ * and the host utilities in `cpp_utils/`.
+ *
+ * CSI buffers hold interleaved int8 pairs, imaginary part first:
+ *
+ *   buf[2 * k] = imag(k), buf[2 * k + 1] = real(k)
+ *
+ * so amplitude(k) = sqrt(imag^2 + real^2) and phase(k) = atan2(imag, real), matching `python_utils/parse_csi.py`.
+ *
+ * On x86 hosts the kernels use AVX2 or SSE2; everywhere else (including the ESP32) a portable scalar loop
+ * computing exactly the same approximation is used. Phase is accurate to about 3e-7 rad.
+ *
+ * Fixed-point variants:
+ *  - amplitude in Q8 (amplitude * 256, rounded), at most 46341 so it fits a uint16_t
+ *  - phase as a 16-bit binary angle (radians * 32768 / pi, rounded), so -pi..pi maps onto -32768..32767
+ */
+
+#define CSI_MATH_PI 3.14159265358979f
+#define CSI_MATH_PI_2 1.57079632679490f
+#define CSI_MATH_PI_4 0.78539816339745f
+#define CSI_MATH_TAN_PI_8 0.41421356237310f
+
+// atan(x) = x - x^3/3 + x^5/5 - ..., truncation error below 1.2e-7 for |x| <= tan(pi/8)
+#define CSI_MATH_ATAN_C3 (-1.0f / 3)
+#define CSI_MATH_ATAN_C5 (1.0f / 5)
+#define CSI_MATH_ATAN_C7 (-1.0f / 7)
+#define CSI_MATH_ATAN_C9 (1.0f / 9)
+#define CSI_MATH_ATAN_C11 (-1.0f / 11)
+#define CSI_MATH_ATAN_C13 (1.0f / 13)
+
+float _csi_math_atan_reduced(float z) {
+    float z2 = z * z;
+    float p = CSI_MATH_ATAN_C13;
+    p = p * z2 + CSI_MATH_ATAN_C11;
+    p = p * z2 + CSI_MATH_ATAN_C9;
+    p = p * z2 + CSI_MATH_ATAN_C7;
+    p = p * z2 + CSI_MATH_ATAN_C5;
+    p = p * z2 + CSI_MATH_ATAN_C3;
+    return z + z * z2 * p;
+}
+
+/*
+ * The scalar reference of the vector kernels below; keep the two in step.
+ */
+float csi_math_atan2(float y, float x) {
+    float ay = fabsf(y);
+    float ax = fabsf(x);
+    float hi = ay > ax ? ay : ax;
+    float lo = ay > ax ? ax : ay;
+    if (hi == 0) {
+        return 0;
+    }
+
+    float z = lo / hi;
+    float offset = 0;
+    if (z > CSI_MATH_TAN_PI_8) {
+        z = (z - 1) / (z + 1);
+        offset = CSI_MATH_PI_4;
+    }
+    float r = offset + _csi_math_atan_reduced(z);
+
+    if (ay > ax) {
+        r = CSI_MATH_PI_2 - r;
+    }
+    if (x < 0) {
+        r = CSI_MATH_PI - r;
+    }
+    return y < 0 ? -r : r;
+}
+
+#if defined(__AVX2__)
+
+__m256 _csi_math_atan2_avx2(__m256 y, __m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 ay = _mm256_andnot_ps(sign_mask, y);
+    __m256 ax = _mm256_andnot_ps(sign_mask, x);
+    __m256 swap = _mm256_cmp_ps(ay, ax, _CMP_GT_OQ);
+    __m256 hi = _mm256_max_ps(ay, ax);
+    __m256 lo = _mm256_min_ps(ay, ax);
+    __m256 both_zero = _mm256_cmp_ps(hi, zero, _CMP_EQ_OQ);
+
+    __m256 z = _mm256_div_ps(lo, _mm256_blendv_ps(hi, one, both_zero));
+    __m256 reduce = _mm256_cmp_ps(z, _mm256_set1_ps(CSI_MATH_TAN_PI_8), _CMP_GT_OQ);
+    z = _mm256_blendv_ps(z, _mm256_div_ps(_mm256_sub_ps(z, one), _mm256_add_ps(z, one)), reduce);
+    __m256 offset = _mm256_and_ps(reduce, _mm256_set1_ps(CSI_MATH_PI_4));
+
+    __m256 z2 = _mm256_mul_ps(z, z);
+    __m256 p = _mm256_set1_ps(CSI_MATH_ATAN_C13);
+    p = _mm256_add_ps(_mm256_mul_ps(p, z2), _mm256_set1_ps(CSI_MATH_ATAN_C11));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z2), _mm256_set1_ps(CSI_MATH_ATAN_C9));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z2), _mm256_set1_ps(CSI_MATH_ATAN_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z2), _mm256_set1_ps(CSI_MATH_ATAN_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, z2), _mm256_set1_ps(CSI_MATH_ATAN_C3));
+    __m256 r = _mm256_add_ps(offset, _mm256_add_ps(z, _mm256_mul_ps(_mm256_mul_ps(z, z2), p)));
+
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(CSI_MATH_PI_2), r), swap);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(CSI_MATH_PI), r), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(zero, r), _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+    return _mm256_andnot_ps(both_zero, r);
+}
+
+/*
+ * 16 pairs (32 bytes) of CSI as imag/real int32 lanes in two halves of 8.
+ */
+void _csi_math_load16_avx2(const int8_t *iq, __m256i *imag, __m256i *real) {
+    __m256i lo = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) iq));
+    __m256i hi = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (iq + 16)));
+    imag[0] = _mm256_srai_epi32(_mm256_slli_epi32(lo, 16), 16);
+    real[0] = _mm256_srai_epi32(lo, 16);
+    imag[1] = _mm256_srai_epi32(_mm256_slli_epi32(hi, 16), 16);
+    real[1] = _mm256_srai_epi32(hi, 16);
+}
+
+#elif defined(__SSE2__)
+
+__m128 _csi_math_select_sse2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__m128 _csi_math_atan2_sse2(__m128 y, __m128 x) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 ay = _mm_andnot_ps(sign_mask, y);
+    __m128 ax = _mm_andnot_ps(sign_mask, x);
+    __m128 swap = _mm_cmpgt_ps(ay, ax);
+    __m128 hi = _mm_max_ps(ay, ax);
+    __m128 lo = _mm_min_ps(ay, ax);
+    __m128 both_zero = _mm_cmpeq_ps(hi, zero);
+
+    __m128 z = _mm_div_ps(lo, _csi_math_select_sse2(both_zero, one, hi));
+    __m128 reduce = _mm_cmpgt_ps(z, _mm_set1_ps(CSI_MATH_TAN_PI_8));
+    z = _csi_math_select_sse2(reduce, _mm_div_ps(_mm_sub_ps(z, one), _mm_add_ps(z, one)), z);
+    __m128 offset = _mm_and_ps(reduce, _mm_set1_ps(CSI_MATH_PI_4));
+
+    __m128 z2 = _mm_mul_ps(z, z);
+    __m128 p = _mm_set1_ps(CSI_MATH_ATAN_C13);
+    p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(CSI_MATH_ATAN_C11));
+    p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(CSI_MATH_ATAN_C9));
+    p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(CSI_MATH_ATAN_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(CSI_MATH_ATAN_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(CSI_MATH_ATAN_C3));
+    __m128 r = _mm_add_ps(offset, _mm_add_ps(z, _mm_mul_ps(_mm_mul_ps(z, z2), p)));
+
+    r = _csi_math_select_sse2(swap, _mm_sub_ps(_mm_set1_ps(CSI_MATH_PI_2), r), r);
+    r = _csi_math_select_sse2(_mm_cmplt_ps(x, zero), _mm_sub_ps(_mm_set1_ps(CSI_MATH_PI), r), r);
+    r = _csi_math_select_sse2(_mm_cmplt_ps(y, zero), _mm_sub_ps(zero, r), r);
+    return _mm_andnot_ps(both_zero, r);
+}
+
+/*
+ * 8 pairs (16 bytes) of CSI as imag/real int32 lanes in two halves of 4.
+ */
+void _csi_math_load8_sse2(const int8_t *iq, __m128i *imag, __m128i *real) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *) iq);
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+    imag[0] = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+    real[0] = _mm_srai_epi32(lo, 16);
+    imag[1] = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+    real[1] = _mm_srai_epi32(hi, 16);
+}
+
+#endif
+
+void csi_amplitude_f32(const int8_t *iq, int pairs, float *out) {
+    int k = 0;
+#if defined(__AVX2__)
+    for (; k + 16 <= pairs; k += 16) {
+        __m256i lo = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (iq + k * 2)));
+        __m256i hi = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (iq + k * 2 + 16)));
+        // pmaddwd of the interleaved pairs with themselves is exactly imag^2 + real^2
+        _mm256_storeu_ps(out + k, _mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(lo, lo))));
+        _mm256_storeu_ps(out + k + 8, _mm256_sqrt_ps(_mm256_cvtepi32_ps(_mm256_madd_epi16(hi, hi))));
+    }
+#elif defined(__SSE2__)
+    for (; k + 8 <= pairs; k += 8) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (iq + k * 2));
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+        __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+        _mm_storeu_ps(out + k, _mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(lo, lo))));
+        _mm_storeu_ps(out + k + 4, _mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(hi, hi))));
+    }
+#endif
+    for (; k < pairs; k++) {
+        int imag = iq[k * 2];
+        int real = iq[k * 2 + 1];
+        out[k] = sqrtf((float) (imag * imag + real * real));
+    }
+}
+
+void csi_phase_f32(const int8_t *iq, int pairs, float *out) {
+    int k = 0;
+#if defined(__AVX2__)
+    for (; k + 16 <= pairs; k += 16) {
+        __m256i imag[2], real[2];
+        _csi_math_load16_avx2(iq + k * 2, imag, real);
+        for (int h = 0; h < 2; h++) {
+            __m256 phase = _csi_math_atan2_avx2(_mm256_cvtepi32_ps(imag[h]), _mm256_cvtepi32_ps(real[h]));
+            _mm256_storeu_ps(out + k + h * 8, phase);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; k + 8 <= pairs; k += 8) {
+        __m128i imag[2], real[2];
+        _csi_math_load8_sse2(iq + k * 2, imag, real);
+        for (int h = 0; h < 2; h++) {
+            __m128 phase = _csi_math_atan2_sse2(_mm_cvtepi32_ps(imag[h]), _mm_cvtepi32_ps(real[h]));
+            _mm_storeu_ps(out + k + h * 4, phase);
+        }
+    }
+#endif
+    for (; k < pairs; k++) {
+        out[k] = csi_math_atan2((float) iq[k * 2], (float) iq[k * 2 + 1]);
+    }
+}
+
+/*
+ * Fixed-point variants, converting via a small float block so the vector kernels are still used.
+ */
+#define CSI_MATH_BLOCK 64
+
+void csi_amplitude_q8(const int8_t *iq, int pairs, uint16_t *out) {
+    float block[CSI_MATH_BLOCK];
+    for (int k = 0; k < pairs; k += CSI_MATH_BLOCK) {
+        int n = pairs - k < CSI_MATH_BLOCK ? pairs - k : CSI_MATH_BLOCK;
+        csi_amplitude_f32(iq + k * 2, n, block);
+        for (int i = 0; i < n; i++) {
+            out[k + i] = (uint16_t) (block[i] * 256.0f + 0.5f);
+        }
+    }
+}
+
+void csi_phase_q15(const int8_t *iq, int pairs, int16_t *out) {
+    float block[CSI_MATH_BLOCK];
+    for (int k = 0; k < pairs; k += CSI_MATH_BLOCK) {
+        int n = pairs - k < CSI_MATH_BLOCK ? pairs - k : CSI_MATH_BLOCK;
+        csi_phase_f32(iq + k * 2, n, block);
+        for (int i = 0; i < n; i++) {
+            int32_t v = (int32_t) lrintf(block[i] * (32768.0f / CSI_MATH_PI));
+            out[k + i] = (int16_t) (v > 32767 ? 32767 : v);
+        }
+    }
+}
+
+#endif //ESP32_CSI_CSI_MATH_COMPONENT_H
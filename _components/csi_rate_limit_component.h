@@ -0,0 +1,290 @@
+#ifndef ESP32_CSI_CSI_RATE_LIMIT_COMPONENT_H
+#define ESP32_CSI_CSI_RATE_LIMIT_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#include "csi_format_component.h"
+#include "csi_stats_component.h"
+#include "csi_filter_component.h"
+
+/*
+ * Per-source output policy applied in `_wifi_csi_cb` (after `csi_filter_component.h`), so that one busy transmitter
+ * cannot take the whole serial link from the others:
+ *
+ *   decimation   of every `every` frames of a MAC, `keep` are written, evenly spread (e.g. 1 of 4: every 4th frame)
+ *   rate limit   a token bucket per MAC: at most `rate_fps` frames per second on average, `burst` at once
+ *
+ * Decimation comes first, so the rate limit applies to the frames it keeps.
+ * Each MAC gets its own budget. MACs seen once the table is full (e.g. a flood of randomized probe request MACs)
+ * share the budget of a single `other` entry. A full table gives up the entries of MACs not seen for
+ * `CSI_RATE_LIMIT_IDLE_US` (at most once every `CSI_RATE_LIMIT_EXPIRY_US`), which then count as `other`.
+ *
+ * Frames dropped by the policy are reported with the `CSI_STATS` records, one line per MAC:
+ *
+ *   CSI_STATS_LIMIT,<role>,<mac|other>,<passed>,<decimated>,<rate limited>
+ *
+ * The table is only changed by the Wi-Fi driver task; the writer task takes the counters.
+ */
+
+// Must be a power of two; at most 3/4 of the slots are taken so probe sequences stay short.
+#define CSI_RATE_LIMIT_SLOTS 64
+#define CSI_RATE_LIMIT_MAX_MACS (CSI_RATE_LIMIT_SLOTS * 3 / 4)
+#define CSI_RATE_LIMIT_IDLE_US 10000000
+#define CSI_RATE_LIMIT_EXPIRY_US 1000000
+#define CSI_RATE_LIMIT_MAX_FPS 10000
+#define CSI_RATE_LIMIT_MAX_BURST 1000
+// a frame costs this many tokens, and every microsecond adds `rate_fps` of them
+#define CSI_RATE_LIMIT_TOKENS_PER_FRAME 1000000u
+
+static_assert((CSI_RATE_LIMIT_SLOTS & (CSI_RATE_LIMIT_SLOTS - 1)) == 0, "CSI_RATE_LIMIT_SLOTS must be a power of two");
+
+typedef struct {
+    // MAC as in `csi_filter_component.h`, 0 for a free slot. Atomic because the writer reads it to report.
+    std::atomic<uint64_t> key;
+    uint32_t last_us;
+    uint32_t tokens;
+    // decimation accumulator, a frame is kept each time it reaches `every`
+    uint32_t phase;
+
+    std::atomic<uint32_t> passed;
+    std::atomic<uint32_t> decimated;
+    std::atomic<uint32_t> limited;
+} csi_rate_limit_entry_t;
+
+typedef struct {
+    // 0 for no rate limit
+    uint32_t rate_fps;
+    uint32_t burst;
+    // keep `keep` frames out of every `every`
+    uint32_t keep;
+    uint32_t every;
+    bool enabled;
+
+    // open addressing with linear probing, removal shifts entries back
+    csi_rate_limit_entry_t entries[CSI_RATE_LIMIT_SLOTS];
+    csi_rate_limit_entry_t other;
+    uint32_t used;
+    uint32_t last_expiry_us;
+    // all frames dropped so far, by either rule
+    std::atomic<uint32_t> dropped;
+} csi_rate_limit_t;
+
+void _csi_rate_limit_entry_reset(const csi_rate_limit_t *l, csi_rate_limit_entry_t *e, uint64_t key,
+                                 uint32_t now_us) {
+    e->key.store(key, std::memory_order_relaxed);
+    e->last_us = now_us;
+    // a new source may start with a burst
+    e->tokens = l->burst * CSI_RATE_LIMIT_TOKENS_PER_FRAME;
+    e->phase = l->every - l->keep;
+}
+
+/*
+ * Sets the policy and forgets every MAC. Must not run concurrently with `csi_rate_limit_accept()`.
+ * False, leaving the limiter disabled, if a value is out of range.
+ */
+bool csi_rate_limit_configure(csi_rate_limit_t *l, uint32_t rate_fps, uint32_t burst, uint32_t keep,
+                              uint32_t every) {
+    for (int i = 0; i < CSI_RATE_LIMIT_SLOTS; i++) {
+        l->entries[i].key.store(0);
+        l->entries[i].passed.store(0);
+        l->entries[i].decimated.store(0);
+        l->entries[i].limited.store(0);
+    }
+    l->other.passed.store(0);
+    l->other.decimated.store(0);
+    l->other.limited.store(0);
+    l->used = 0;
+    l->last_expiry_us = 0;
+    l->dropped.store(0);
+    l->enabled = false;
+    if (rate_fps > CSI_RATE_LIMIT_MAX_FPS || burst < 1 || burst > CSI_RATE_LIMIT_MAX_BURST || keep < 1
+        || every < keep) {
+        return false;
+    }
+    l->rate_fps = rate_fps;
+    l->burst = burst;
+    l->keep = keep;
+    l->every = every;
+    l->enabled = rate_fps > 0 || keep < every;
+    _csi_rate_limit_entry_reset(l, &l->other, 0, 0);
+    return true;
+}
+
+// slot holding `key`, or the empty slot where it would go
+uint32_t _csi_rate_limit_slot(const csi_rate_limit_t *l, uint32_t home, uint64_t key) {
+    uint32_t i = home;
+    uint64_t k;
+    while ((k = l->entries[i].key.load(std::memory_order_relaxed)) != 0 && k != key) {
+        i = (i + 1) & (CSI_RATE_LIMIT_SLOTS - 1);
+    }
+    return i;
+}
+
+uint32_t _csi_rate_limit_home(uint64_t key) {
+    uint8_t mac[6];
+    for (int b = 0; b < 6; b++) {
+        mac[b] = (uint8_t) (key >> (40 - 8 * b));
+    }
+    return _csi_mac_hash(mac) & (CSI_RATE_LIMIT_SLOTS - 1);
+}
+
+// Moves counters so that none are lost to a concurrent `csi_rate_limit_take()`.
+void _csi_rate_limit_move_counters(csi_rate_limit_entry_t *to, csi_rate_limit_entry_t *from) {
+    to->passed.fetch_add(from->passed.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    to->decimated.fetch_add(from->decimated.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    to->limited.fetch_add(from->limited.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void _csi_rate_limit_remove(csi_rate_limit_t *l, uint32_t hole) {
+    // frames of the interval not reported yet now count as `other`
+    _csi_rate_limit_move_counters(&l->other, &l->entries[hole]);
+    l->entries[hole].key.store(0, std::memory_order_relaxed);
+    l->used--;
+    // as in `csi_filter_rules_remove()`
+    uint32_t i = hole;
+    while (true) {
+        i = (i + 1) & (CSI_RATE_LIMIT_SLOTS - 1);
+        uint64_t key = l->entries[i].key.load(std::memory_order_relaxed);
+        if (key == 0) {
+            return;
+        }
+        uint32_t home = _csi_rate_limit_home(key);
+        if (((i - home) & (CSI_RATE_LIMIT_SLOTS - 1)) >= ((i - hole) & (CSI_RATE_LIMIT_SLOTS - 1))) {
+            csi_rate_limit_entry_t *to = &l->entries[hole], *from = &l->entries[i];
+            to->last_us = from->last_us;
+            to->tokens = from->tokens;
+            to->phase = from->phase;
+            // the key first, so a counter seen in `to` always has a MAC
+            to->key.store(key, std::memory_order_release);
+            _csi_rate_limit_move_counters(to, from);
+            from->key.store(0, std::memory_order_release);
+            hole = i;
+        }
+    }
+}
+
+// Frees the entries of MACs not seen for `CSI_RATE_LIMIT_IDLE_US`.
+void _csi_rate_limit_expire(csi_rate_limit_t *l, uint32_t now_us) {
+    uint32_t i = 0;
+    while (i < CSI_RATE_LIMIT_SLOTS) {
+        csi_rate_limit_entry_t *e = &l->entries[i];
+        if (e->key.load(std::memory_order_relaxed) != 0 && now_us - e->last_us > CSI_RATE_LIMIT_IDLE_US) {
+            // another entry may have moved into slot i, which is looked at again
+            _csi_rate_limit_remove(l, i);
+        } else {
+            i++;
+        }
+    }
+}
+
+csi_rate_limit_entry_t *_csi_rate_limit_entry(csi_rate_limit_t *l, const uint8_t mac[6], uint32_t now_us) {
+    uint64_t key = _csi_filter_key(mac);
+    uint32_t home = _csi_mac_hash(mac) & (CSI_RATE_LIMIT_SLOTS - 1);
+    uint32_t i = _csi_rate_limit_slot(l, home, key);
+    if (l->entries[i].key.load(std::memory_order_relaxed) == key) {
+        return &l->entries[i];
+    }
+    if (l->used >= CSI_RATE_LIMIT_MAX_MACS) {
+        // a flood of new MACs must not sweep the table on every frame
+        if (now_us - l->last_expiry_us < CSI_RATE_LIMIT_EXPIRY_US) {
+            return &l->other;
+        }
+        l->last_expiry_us = now_us;
+        _csi_rate_limit_expire(l, now_us);
+        if (l->used >= CSI_RATE_LIMIT_MAX_MACS) {
+            return &l->other;
+        }
+        i = _csi_rate_limit_slot(l, home, key);
+    }
+    l->used++;
+    _csi_rate_limit_entry_reset(l, &l->entries[i], key, now_us);
+    return &l->entries[i];
+}
+
+/*
+ * Called for every frame, from the Wi-Fi driver task, with a microsecond clock (which may wrap).
+ * False if the frame is to be dropped.
+ */
+bool csi_rate_limit_accept(csi_rate_limit_t *l, const uint8_t mac[6], uint32_t now_us) {
+    if (!l->enabled) {
+        return true;
+    }
+    csi_rate_limit_entry_t *e = _csi_rate_limit_entry(l, mac, now_us);
+
+    uint64_t tokens = e->tokens + (uint64_t) (now_us - e->last_us) * l->rate_fps;
+    uint64_t capacity = (uint64_t) l->burst * CSI_RATE_LIMIT_TOKENS_PER_FRAME;
+    e->tokens = (uint32_t) (tokens < capacity ? tokens : capacity);
+    e->last_us = now_us;
+
+    e->phase += l->keep;
+    if (e->phase < l->every) {
+        e->decimated.fetch_add(1, std::memory_order_relaxed);
+        l->dropped.store(l->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+    e->phase -= l->every;
+    if (l->rate_fps > 0) {
+        if (e->tokens < CSI_RATE_LIMIT_TOKENS_PER_FRAME) {
+            e->limited.fetch_add(1, std::memory_order_relaxed);
+            l->dropped.store(l->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        e->tokens -= CSI_RATE_LIMIT_TOKENS_PER_FRAME;
+    }
+    e->passed.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/*
+ * Frames passed and dropped by `entry` (`CSI_RATE_LIMIT_SLOTS` for the `other` entry) since the previous call,
+ * which resets them. Safe to call from another task than the one calling `csi_rate_limit_accept()`.
+ * `mac` is left as is for the `other` entry and for free slots, for which the function returns false.
+ */
+bool csi_rate_limit_take(csi_rate_limit_t *l, int entry, uint8_t mac[6], uint32_t *passed, uint32_t *decimated,
+                         uint32_t *limited) {
+    csi_rate_limit_entry_t *e = entry == CSI_RATE_LIMIT_SLOTS ? &l->other : &l->entries[entry];
+    // An entry moving out of this slot still has its key before the counters are taken, one moving in already
+    // has it after.
+    uint64_t key = e->key.load(std::memory_order_acquire);
+    *passed = e->passed.exchange(0, std::memory_order_relaxed);
+    *decimated = e->decimated.exchange(0, std::memory_order_relaxed);
+    *limited = e->limited.exchange(0, std::memory_order_relaxed);
+    if (key == 0) {
+        key = e->key.load(std::memory_order_acquire);
+    }
+    if (entry == CSI_RATE_LIMIT_SLOTS || key == 0) {
+        return false;
+    }
+    for (int b = 0; b < 6; b++) {
+        mac[b] = (uint8_t) (key >> (40 - 8 * b));
+    }
+    return true;
+}
+
+/*
+ * `CSI_STATS_LIMIT,...` line, see the top of this file. `mac` is NULL for the `other` entry.
+ */
+void csi_rate_limit_format(csi_format_buffer_t *b, const char *role, const uint8_t *mac, uint32_t passed,
+                           uint32_t decimated, uint32_t limited) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_STATS_LIMIT,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    if (mac == NULL) {
+        csi_format_str(b, "other");
+    } else {
+        csi_format_mac(b, mac);
+    }
+    csi_format_char(b, ',');
+    csi_format_uint(b, passed);
+    csi_format_char(b, ',');
+    csi_format_uint(b, decimated);
+    csi_format_char(b, ',');
+    csi_format_uint(b, limited);
+    csi_format_char(b, '\n');
+}
+
+#endif //ESP32_CSI_CSI_RATE_LIMIT_COMPONENT_H
@@ -0,0 +1,91 @@
+#ifndef ESP32_CSI_CSI_RING_COMPONENT_H
+#define ESP32_CSI_CSI_RING_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "csi_format_component.h"
+
+/*
+ * Single-producer/single-consumer ring of preallocated CSI frame slots.
+ *
+ * The Wi-Fi driver callback is the only producer and the CSI writer task the only consumer,
+ * so no locks are needed: each side only ever stores to its own index.
+ */
+
+// Must be a power of two.
+#ifndef CSI_RING_SLOT_COUNT
+#define CSI_RING_SLOT_COUNT 16
+#endif
+
+// LLTF + HT-LTF + STBC-HT-LTF is the largest CSI buffer the driver hands us.
+#ifndef CSI_RING_SLOT_DATA_SIZE
+#define CSI_RING_SLOT_DATA_SIZE 612
+#endif
+
+static_assert((CSI_RING_SLOT_COUNT & (CSI_RING_SLOT_COUNT - 1)) == 0, "CSI_RING_SLOT_COUNT must be a power of two");
+
+typedef struct {
+    csi_record_t record;
+    uint16_t data_len;
+    // CPU cycles the producer spent filling the slot, for `csi_stats_component.h`
+    uint32_t fill_cycles;
+    // steady clock time the slot was filled, for the time it spent queued
+    int64_t steady_timestamp_us;
+    int8_t data[CSI_RING_SLOT_DATA_SIZE];
+} csi_ring_slot_t;
+
+typedef struct {
+    csi_ring_slot_t slots[CSI_RING_SLOT_COUNT];
+    // free running counters, masked on access
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    // number of frames discarded because every slot was in use
+    std::atomic<uint32_t> dropped;
+} csi_ring_t;
+
+void csi_ring_reset(csi_ring_t *ring) {
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->dropped.store(0);
+}
+
+/*
+ * Producer: returns the next free slot, or NULL (counting a drop) if the ring is full.
+ * The slot only becomes visible to the consumer after `csi_ring_publish()`.
+ */
+csi_ring_slot_t *csi_ring_acquire(csi_ring_t *ring) {
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= CSI_RING_SLOT_COUNT) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    return &ring->slots[head & (CSI_RING_SLOT_COUNT - 1)];
+}
+
+void csi_ring_publish(csi_ring_t *ring) {
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/*
+ * Consumer: returns the oldest published slot, or NULL if the ring is empty.
+ * The slot stays owned by the consumer until `csi_ring_release()`.
+ */
+csi_ring_slot_t *csi_ring_peek(csi_ring_t *ring) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail == ring->head.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+    return &ring->slots[tail & (CSI_RING_SLOT_COUNT - 1)];
+}
+
+void csi_ring_release(csi_ring_t *ring) {
+    ring->tail.store(ring->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint32_t csi_ring_dropped(csi_ring_t *ring) {
+    return ring->dropped.load(std::memory_order_relaxed);
+}
+
+#endif //ESP32_CSI_CSI_RING_COMPONENT_H
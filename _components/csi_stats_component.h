@@ -0,0 +1,286 @@
+#ifndef ESP32_CSI_CSI_STATS_COMPONENT_H
+#define ESP32_CSI_CSI_STATS_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_format_component.h"
+
+/*
+ * Fixed-memory latency histograms and per-MAC frame counts for the CSI hot path,
+ * reported as (one line per MAC after the summary):
+ *
+ *   CSI_STATS,<role>,<interval ms>,<frames>,<dropped>,<MACs>,<stage>_ns=<min>/<mean>/<p99>/<max>,...
+ *   CSI_STATS_MAC,<role>,<mac>,<frames>
+ *
+ * and, while the channel is hopped (`channel_scheduler_component.h`), one line per channel in the sweep with the
+ * frames received on it and the visits to it and time spent on it which ended during the interval:
+ *
+ *   CSI_STATS_CHANNEL,<role>,<channel>,<frames>,<visits>,<dwell ms>
+ *
+ * All counters cover the interval since the previous report. A stage with no samples is reported as `0/0/0/0`.
+ */
+
+typedef enum {
+    CSI_STATS_CALLBACK, // `_wifi_csi_cb` entry until the frame is published
+    CSI_STATS_QUEUE,    // frame published until the writer task picks it up
+    CSI_STATS_FORMAT,   // CSV formatting / binary encoding
+    CSI_STATS_OUTPUT,   // `outwrite()` (serial, SD buffer)
+    CSI_STATS_STAGES,
+} csi_stats_stage_t;
+
+static const char *const CSI_STATS_STAGE_NAMES[CSI_STATS_STAGES] = {"callback", "queue", "format", "output"};
+
+/*
+ * Log-linear buckets: exact below 16, above that 8 buckets per power of two, so a percentile read from the
+ * histogram is never more than 12.5% above the true value. 240 buckets cover the whole uint32_t range.
+ */
+#define CSI_HISTOGRAM_LINEAR 16
+#define CSI_HISTOGRAM_SUB_BITS 3
+#define CSI_HISTOGRAM_BUCKETS (CSI_HISTOGRAM_LINEAR + (32 - 4) * (1 << CSI_HISTOGRAM_SUB_BITS))
+
+typedef struct {
+    uint32_t buckets[CSI_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} csi_histogram_t;
+
+void csi_histogram_reset(csi_histogram_t *h) {
+    memset(h->buckets, 0, sizeof(h->buckets));
+    h->count = 0;
+    h->min = UINT32_MAX;
+    h->max = 0;
+    h->sum = 0;
+}
+
+uint32_t _csi_histogram_bucket(uint32_t v) {
+    if (v < CSI_HISTOGRAM_LINEAR) {
+        return v;
+    }
+    uint32_t exponent = 31 - __builtin_clz(v);
+    uint32_t sub = (v >> (exponent - CSI_HISTOGRAM_SUB_BITS)) & ((1 << CSI_HISTOGRAM_SUB_BITS) - 1);
+    return CSI_HISTOGRAM_LINEAR + ((exponent - 4) << CSI_HISTOGRAM_SUB_BITS) + sub;
+}
+
+// largest value which falls into bucket `i`
+uint32_t _csi_histogram_bucket_max(uint32_t i) {
+    if (i < CSI_HISTOGRAM_LINEAR) {
+        return i;
+    }
+    uint32_t exponent = 4 + ((i - CSI_HISTOGRAM_LINEAR) >> CSI_HISTOGRAM_SUB_BITS);
+    uint32_t sub = (i - CSI_HISTOGRAM_LINEAR) & ((1 << CSI_HISTOGRAM_SUB_BITS) - 1);
+    uint32_t shift = exponent - CSI_HISTOGRAM_SUB_BITS;
+    uint64_t lower = (uint64_t) ((1 << CSI_HISTOGRAM_SUB_BITS) + sub) << shift;
+    return (uint32_t) (lower + ((uint64_t) 1 << shift) - 1);
+}
+
+void csi_histogram_add(csi_histogram_t *h, uint32_t v) {
+    h->buckets[_csi_histogram_bucket(v)]++;
+    h->count++;
+    h->sum += v;
+    if (v < h->min) {
+        h->min = v;
+    }
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+void csi_histogram_merge(csi_histogram_t *dst, const csi_histogram_t *src) {
+    for (int i = 0; i < CSI_HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+uint32_t csi_histogram_mean(const csi_histogram_t *h) {
+    return h->count == 0 ? 0 : (uint32_t) (h->sum / h->count);
+}
+
+/*
+ * Upper bound of the bucket holding the `permille`/1000 quantile, clamped to the exact min/max.
+ */
+uint32_t csi_histogram_percentile(const csi_histogram_t *h, uint32_t permille) {
+    if (h->count == 0) {
+        return 0;
+    }
+    // rank of the sample, rounded up, as in the "nearest rank" definition
+    uint64_t rank = ((uint64_t) h->count * permille + 999) / 1000;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < CSI_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint32_t v = _csi_histogram_bucket_max(i);
+            return v > h->max ? h->max : (v < h->min ? h->min : v);
+        }
+    }
+    return h->max;
+}
+
+/*
+ * Frame counts per source MAC in a small open addressing table. Once it is 3/4 full, frames from
+ * MACs not already in it are counted in `other_frames`, which keeps both memory and probe lengths bounded.
+ */
+#define CSI_STATS_MAC_SLOTS 32
+
+static_assert((CSI_STATS_MAC_SLOTS & (CSI_STATS_MAC_SLOTS - 1)) == 0, "CSI_STATS_MAC_SLOTS must be a power of two");
+
+typedef struct {
+    uint8_t mac[6];
+    bool used;
+    uint32_t frames;
+} csi_mac_count_t;
+
+typedef struct {
+    csi_mac_count_t entries[CSI_STATS_MAC_SLOTS];
+    uint32_t used;
+    uint32_t other_frames;
+} csi_mac_counts_t;
+
+void csi_mac_counts_reset(csi_mac_counts_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+uint32_t _csi_mac_hash(const uint8_t mac[6]) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        hash = (hash ^ mac[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void csi_mac_counts_add(csi_mac_counts_t *t, const uint8_t mac[6]) {
+    uint32_t i = _csi_mac_hash(mac) & (CSI_STATS_MAC_SLOTS - 1);
+    while (t->entries[i].used) {
+        if (memcmp(t->entries[i].mac, mac, 6) == 0) {
+            t->entries[i].frames++;
+            return;
+        }
+        i = (i + 1) & (CSI_STATS_MAC_SLOTS - 1);
+    }
+    if (t->used >= CSI_STATS_MAC_SLOTS * 3 / 4) {
+        t->other_frames++;
+        return;
+    }
+    memcpy(t->entries[i].mac, mac, 6);
+    t->entries[i].used = true;
+    t->entries[i].frames = 1;
+    t->used++;
+}
+
+// `rx_ctrl.channel` is 4 bits wide
+#define CSI_STATS_CHANNELS 16
+
+typedef struct {
+    csi_histogram_t stages[CSI_STATS_STAGES];
+    csi_mac_counts_t macs;
+    uint32_t channel_frames[CSI_STATS_CHANNELS];
+    uint32_t frames;
+    uint32_t dropped;
+    int64_t interval_start_us;
+} csi_stats_t;
+
+void csi_stats_reset(csi_stats_t *s, int64_t now_us) {
+    for (int i = 0; i < CSI_STATS_STAGES; i++) {
+        csi_histogram_reset(&s->stages[i]);
+    }
+    csi_mac_counts_reset(&s->macs);
+    memset(s->channel_frames, 0, sizeof(s->channel_frames));
+    s->frames = 0;
+    s->dropped = 0;
+    s->interval_start_us = now_us;
+}
+
+void csi_stats_frame(csi_stats_t *s, const uint8_t mac[6], uint8_t channel) {
+    s->frames++;
+    s->channel_frames[channel & (CSI_STATS_CHANNELS - 1)]++;
+    csi_mac_counts_add(&s->macs, mac);
+}
+
+void csi_stats_add(csi_stats_t *s, csi_stats_stage_t stage, uint32_t ns) {
+    csi_histogram_add(&s->stages[stage], ns);
+}
+
+/*
+ * `CSI_STATS,...` summary line, see the top of this file.
+ */
+void csi_stats_format_summary(csi_format_buffer_t *b, const char *role, const csi_stats_t *s, int64_t now_us) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_STATS,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    csi_format_uint(b, (uint64_t) (now_us - s->interval_start_us) / 1000);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->frames);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->dropped);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->macs.used + (s->macs.other_frames > 0 ? 1 : 0));
+    for (int i = 0; i < CSI_STATS_STAGES; i++) {
+        const csi_histogram_t *h = &s->stages[i];
+        csi_format_char(b, ',');
+        csi_format_str(b, CSI_STATS_STAGE_NAMES[i]);
+        csi_format_str(b, "_ns=");
+        csi_format_uint(b, h->count == 0 ? 0 : h->min);
+        csi_format_char(b, '/');
+        csi_format_uint(b, csi_histogram_mean(h));
+        csi_format_char(b, '/');
+        csi_format_uint(b, csi_histogram_percentile(h, 990));
+        csi_format_char(b, '/');
+        csi_format_uint(b, h->max);
+    }
+    csi_format_char(b, '\n');
+}
+
+/*
+ * `CSI_STATS_MAC,...` line for `mac`, or for all MACs which did not fit into the table if `mac` is NULL.
+ */
+void csi_stats_format_mac(csi_format_buffer_t *b, const char *role, const uint8_t *mac, uint32_t frames) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_STATS_MAC,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    if (mac == NULL) {
+        csi_format_str(b, "other");
+    } else {
+        csi_format_mac(b, mac);
+    }
+    csi_format_char(b, ',');
+    csi_format_uint(b, frames);
+    csi_format_char(b, '\n');
+}
+
+/*
+ * `CSI_STATS_CHANNEL,...` line, see the top of this file.
+ */
+void csi_stats_format_channel(csi_format_buffer_t *b, const char *role, uint8_t channel, uint32_t frames,
+                              uint32_t visits, uint32_t dwell_us) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_STATS_CHANNEL,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    csi_format_uint(b, channel);
+    csi_format_char(b, ',');
+    csi_format_uint(b, frames);
+    csi_format_char(b, ',');
+    csi_format_uint(b, visits);
+    csi_format_char(b, ',');
+    csi_format_uint(b, dwell_us / 1000);
+    csi_format_char(b, '\n');
+}
+
+#endif //ESP32_CSI_CSI_STATS_COMPONENT_H
@@ -0,0 +1,77 @@
+#ifndef ESP32_CSI_INJECTION_COMPONENT_H
+#define ESP32_CSI_INJECTION_COMPONENT_H
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+
+#include "sockets_component.h"
+#include "probe_frame_component.h"
+
+/*
+ * Alternative to `socket_transmitter_sta_loop` which injects a prebuilt 802.11 frame (see `probe_frame_component.h`)
+ * with `esp_wifi_80211_tx`, paced by the same scheduler. Every frame carries the next `probe_sequence`.
+ */
+
+probe_frame_t injection_frame;
+
+/*
+ * Builds `injection_frame`. False if the data frame cannot be addressed yet because the station is not associated.
+ */
+bool _injection_build_frame() {
+    uint8_t self[6];
+    ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, self));
+#if CONFIG_PACKET_TX_RAW_ACTION
+    probe_frame_build_action(&injection_frame, self);
+#else
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return false;
+    }
+    probe_frame_build_data(&injection_frame, ap.bssid, self, PROBE_BROADCAST);
+#endif
+    return true;
+}
+
+void injection_transmitter_sta_loop(bool (*is_wifi_connected)()) {
+    esp_timer_handle_t timer = _transmitter_timer_create();
+    while (1) {
+#if !CONFIG_PACKET_TX_RAW_ACTION
+        while (!is_wifi_connected()) {
+            // wait until connected to AP
+            printf("wifi not connected. waiting...\n");
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+        }
+#endif
+        if (!_injection_build_frame()) {
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        printf("injecting frames.\n");
+        packet_scheduler_init(&packet_scheduler, packet_rate, packet_burst, esp_timer_get_time());
+        while (1) {
+#if !CONFIG_PACKET_TX_RAW_ACTION
+            if (!is_wifi_connected()) {
+                printf("ERROR: wifi is not connected\n");
+                break;
+            }
+#endif
+
+            _transmitter_wait(timer);
+            int64_t now_us = esp_timer_get_time();
+            for (uint32_t i = 0; i < packet_scheduler.burst; i++) {
+                // a frame the driver has no room for is lost like one lost on air, so it uses up its number too
+                probe_frame_stamp(&injection_frame, probe_sequence++, esp_timer_get_time());
+                if (esp_wifi_80211_tx(WIFI_IF_STA, injection_frame.data, injection_frame.len, true) != ESP_OK) {
+                    packet_send_errors++;
+                }
+            }
+            _transmitter_sent(now_us);
+        }
+    }
+}
+
+#endif //ESP32_CSI_INJECTION_COMPONENT_H
@@ -1,42 +1,179 @@
 #ifndef ESP32_CSI_INPUT_COMPONENT_H
 #define ESP32_CSI_INPUT_COMPONENT_H
 
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+
+#include "driver/uart.h"
+#include "esp_vfs_dev.h"
+
 #include "csi_component.h"
+#include "command_component.h"
+
+/*
+ * Reads commands (`command_component.h`) from the serial port, framed or typed by hand, and prints the replies.
+ * Projects register their own commands (e.g. `CHANNEL`) before calling `input_loop()`.
+ */
+
+// bytes taken from the UART driver per read
+#define INPUT_READ_SIZE 64
+// bytes the UART driver keeps until they are read, more than its 128 byte FIFO
+#define INPUT_RX_BUFFER_SIZE 1024
 
-char input_buffer[256];
-int input_buffer_pointer = 0;
+command_frame_parser_t input_parser;
+// Only used by the task running `input_loop()`.
+csi_format_buffer_t input_reply_text;
+csi_format_buffer_t input_reply;
 
-void _handle_input() {
-    if (match_set_timestamp_template(input_buffer)) {
-        printf("Setting local time to %s\n", input_buffer);
-        time_set(input_buffer);
+bool _input_settime(const char *args, csi_format_buffer_t *reply) {
+    long int tv_sec;
+    long int tv_usec;
+    if (sscanf(args, "%li.%li", &tv_sec, &tv_usec) <= 0) {
+        csi_format_str(reply, "expected <seconds>.<microseconds>");
+        return false;
+    }
+    time_set((char *) args);
+    return true;
+}
+
+bool _input_filter(const char *args, csi_format_buffer_t *reply) {
+    bool ok = csi_filter_command(&csi_filter, args, &csi_filter_reply);
+    csi_format_append(reply, csi_filter_reply.buf, csi_filter_reply.len);
+    return ok;
+}
+
+bool _input_stats(const char *args, csi_format_buffer_t *reply) {
+    uint32_t interval_ms;
+    if (*args == '\0') {
+        csi_format_uint(reply, csi_stats_interval_ms);
+        return true;
+    }
+    if (!command_parse_uint(&args, 3600000, &interval_ms) || *args != '\0') {
+        csi_format_str(reply, "expected an interval of 0 to 3600000 ms");
+        return false;
+    }
+    csi_stats_interval_ms = interval_ms;
+    return true;
+}
+
+bool _input_format(const char *args, csi_format_buffer_t *reply) {
+    bool binary;
+    if (strcmp(args, "CSV") == 0) {
+        binary = false;
+    } else if (strcmp(args, "BINARY") == 0) {
+        binary = true;
+    } else if (*args == '\0') {
+        csi_format_str(reply, csi_output_binary ? "BINARY" : "CSV");
+        return true;
     } else {
-        printf("Unable to handle input %s\n", input_buffer);
+        csi_format_str(reply, "expected CSV or BINARY");
+        return false;
+    }
+    if (!csi_output_request(binary)) {
+        csi_format_str(reply, "the SD card keeps the format set at build time");
+        return false;
     }
+    return true;
 }
 
-void input_check() {
-    uint8_t ch = fgetc(stdin);
-
-    while (ch != 0xFF) {
-        if (ch == '\n') {
-            _handle_input();
-            input_buffer[0] = '\0';
-            input_buffer_pointer = 0;
-        } else {
-            input_buffer[input_buffer_pointer] = ch;
-            input_buffer[input_buffer_pointer + 1] = '\0';
-            input_buffer_pointer++;
+bool _input_features(const char *args, csi_format_buffer_t *reply) {
+    static const char *names[] = {"RAW", "SUMMARY", "EVENTS"};
+    if (*args == '\0') {
+        csi_format_str(reply, names[csi_features_mode.load()]);
+        return true;
+    }
+    for (int mode = CSI_FEATURES_RAW; mode <= CSI_FEATURES_EVENTS; mode++) {
+        if (strcmp(args, names[mode]) == 0) {
+            csi_features_mode.store(mode);
+            return true;
         }
+    }
+    csi_format_str(reply, "expected RAW, SUMMARY or EVENTS");
+    return false;
+}
+
+/*
+ * Adds the commands every project has, after any the project registered itself.
+ */
+void input_register_commands() {
+    command_register_builtin();
+    command_register("SETTIME", &_input_settime, "SETTIME <seconds>.<microseconds>  sets the real time clock");
+    command_register("FILTER", &_input_filter, "FILTER <command>[; <command>...]  changes the CSI filter");
+    command_register("STATS", &_input_stats, "STATS [<ms>]  shows or sets the CSI_STATS interval, 0 for none");
+    command_register("FORMAT", &_input_format, "FORMAT [CSV|BINARY]  shows or sets the serial output format");
+    command_register("FEATURES", &_input_features,
+                     "FEATURES [RAW|SUMMARY|EVENTS]  shows or sets whether raw CSI or features are written");
+}
+
+void _input_write_reply() {
+    fwrite(input_reply.buf, 1, input_reply.len, stdout);
+    fflush(stdout);
+}
 
-        ch = fgetc(stdin);
+void _input_handle(command_frame_event_t event) {
+    switch (event) {
+        case COMMAND_FRAME_PAYLOAD:
+            command_dispatch_frame(input_parser.payload, input_parser.len, &input_reply_text, &input_reply);
+            _input_write_reply();
+            break;
+        case COMMAND_FRAME_LINE:
+            if (command_dispatch_line(input_parser.payload, &input_reply_text, &input_reply)) {
+                _input_write_reply();
+            } else {
+                printf("Unable to handle input %s\n", input_parser.payload);
+            }
+            break;
+        case COMMAND_FRAME_ERROR:
+            printf("Unable to handle input, %s\n", input_parser.error);
+            break;
+        case COMMAND_FRAME_NONE:
+            break;
     }
 }
 
+/*
+ * Handles whatever arrived on the serial port since the last call.
+ */
+void input_check() {
+    char buf[INPUT_READ_SIZE];
+    ssize_t n;
+    // stdin does not block (`_input_uart_init()`), so this returns as soon as the UART driver's buffer is empty
+    while ((n = read(fileno(stdin), buf, sizeof(buf))) > 0) {
+        size_t pos = 0;
+        while (pos < (size_t) n) {
+            size_t consumed;
+            command_frame_event_t event = command_frame_parser_feed(&input_parser, buf + pos, n - pos, &consumed);
+            pos += consumed;
+            _input_handle(event);
+        }
+    }
+}
+
+/*
+ * Hands the console UART to the interrupt driven driver, so `select()` can sleep until bytes arrive. The console's
+ * output goes through the driver from then on as well, which waits for room in the FIFO without spinning.
+ */
+void _input_uart_init() {
+    uart_port_t port = (uart_port_t) CONFIG_ESP_CONSOLE_UART_NUM;
+    ESP_ERROR_CHECK(uart_driver_install(port, INPUT_RX_BUFFER_SIZE, 0, 0, NULL, 0));
+    esp_vfs_dev_uart_use_driver(port);
+    // reads with the driver block until they are filled, `input_check()` only takes what is there
+    fcntl(fileno(stdin), F_SETFL, O_NONBLOCK);
+}
+
 void input_loop() {
+    input_register_commands();
+    command_frame_parser_reset(&input_parser);
+    _input_uart_init();
+    int fd = fileno(stdin);
     while (true) {
-        input_check();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        if (select(fd + 1, &readable, NULL, NULL, NULL) > 0) {
+            input_check();
+        }
     }
 }
 
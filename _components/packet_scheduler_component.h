@@ -0,0 +1,104 @@
+#ifndef ESP32_CSI_PACKET_SCHEDULER_COMPONENT_H
+#define ESP32_CSI_PACKET_SCHEDULER_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "csi_stats_component.h"
+
+/*
+ * Absolute-deadline pacing for the active STA transmitter.
+ *
+ * Deadline `g` is `start + g * burst * 1e6 / rate` microseconds, computed from scratch every time,
+ * so neither the cost of sending nor a late wake-up moves the following deadlines: the long-run rate is exact.
+ * `burst` packets go out back to back at every deadline.
+ *
+ * Deadlines more than `PACKET_SCHEDULER_MAX_BACKLOG` periods in the past (e.g. after Wi-Fi stalled) are skipped
+ * and counted, instead of being caught up in one long burst.
+ *
+ * The caller passes the time in and sends the packets, so `cpp_utils/csi_bench scheduler` can simulate hours of it.
+ */
+
+#define PACKET_SCHEDULER_MAX_BACKLOG 8
+
+typedef struct {
+    uint32_t rate;
+    uint32_t burst;
+    int64_t start_us;
+    // index of the next deadline
+    uint64_t group;
+
+    // since the last `packet_scheduler_reset_stats()`
+    int64_t stats_start_us;
+    csi_histogram_t lateness_us; // how long after its deadline each burst went out
+    csi_histogram_t interval_us; // time between consecutive bursts
+    uint32_t bursts;
+    uint32_t skipped;
+    int64_t last_sent_us;
+} packet_scheduler_t;
+
+void packet_scheduler_reset_stats(packet_scheduler_t *s, int64_t now_us) {
+    s->stats_start_us = now_us;
+    csi_histogram_reset(&s->lateness_us);
+    csi_histogram_reset(&s->interval_us);
+    s->bursts = 0;
+    s->skipped = 0;
+}
+
+/*
+ * `rate` is in packets per second (at least 1), `burst` packets are sent at every deadline (at least 1).
+ * The first deadline is `now_us`.
+ */
+void packet_scheduler_init(packet_scheduler_t *s, uint32_t rate, uint32_t burst, int64_t now_us) {
+    s->rate = rate > 0 ? rate : 1;
+    s->burst = burst > 0 ? burst : 1;
+    s->start_us = now_us;
+    s->group = 0;
+    s->last_sent_us = -1;
+    packet_scheduler_reset_stats(s, now_us);
+}
+
+int64_t _packet_scheduler_deadline(const packet_scheduler_t *s, uint64_t group) {
+    return s->start_us + (int64_t) (group * s->burst * 1000000 / s->rate);
+}
+
+int64_t packet_scheduler_deadline(const packet_scheduler_t *s) {
+    return _packet_scheduler_deadline(s, s->group);
+}
+
+/*
+ * Microseconds until the next burst is due, 0 or less if it is due now.
+ */
+int64_t packet_scheduler_wait_us(const packet_scheduler_t *s, int64_t now_us) {
+    return packet_scheduler_deadline(s) - now_us;
+}
+
+/*
+ * Call once the burst due at the current deadline has been sent (whether or not every send succeeded).
+ */
+void packet_scheduler_sent(packet_scheduler_t *s, int64_t now_us) {
+    int64_t late_us = now_us - packet_scheduler_deadline(s);
+    csi_histogram_add(&s->lateness_us, late_us < 0 ? 0 : (late_us > UINT32_MAX ? UINT32_MAX : (uint32_t) late_us));
+    if (s->last_sent_us >= 0) {
+        int64_t interval_us = now_us - s->last_sent_us;
+        csi_histogram_add(&s->interval_us, interval_us > UINT32_MAX ? UINT32_MAX : (uint32_t) interval_us);
+    }
+    s->last_sent_us = now_us;
+    s->bursts++;
+    s->group++;
+
+    // period in whole microseconds is close enough to decide what counts as too far behind
+    int64_t period_us = (int64_t) s->burst * 1000000 / s->rate;
+    int64_t oldest_us = now_us - (period_us > 0 ? period_us : 1) * PACKET_SCHEDULER_MAX_BACKLOG;
+    if (packet_scheduler_deadline(s) < oldest_us) {
+        // jump to the first deadline not older than the backlog allows
+        uint64_t target = (uint64_t) (oldest_us - s->start_us) * s->rate / ((uint64_t) s->burst * 1000000);
+        while (_packet_scheduler_deadline(s, target) < oldest_us) {
+            target++;
+        }
+        s->skipped += (uint32_t) (target - s->group);
+        s->group = target;
+    }
+}
+
+#endif //ESP32_CSI_PACKET_SCHEDULER_COMPONENT_H
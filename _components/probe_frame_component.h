@@ -0,0 +1,214 @@
+#ifndef ESP32_CSI_PROBE_FRAME_COMPONENT_H
+#define ESP32_CSI_PROBE_FRAME_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_binary_component.h"
+
+/*
+ * 802.11 frames injected with `esp_wifi_80211_tx` to trigger CSI on the receivers.
+ *
+ * The frame is built once as a template. Only the sequence number and TX timestamp of the probe payload
+ * are rewritten before every send. The payload (all integers little endian):
+ *
+ *   magic "CSIP" | version (u8) | reserved[3] | sequence (u32) | tx_timestamp_us (i64)
+ *
+ * Two kinds of frame carry it:
+ *  - a non-QoS data frame to the AP (ToDS): sent at the station's HT rate, so receivers get HT-LTF CSI,
+ *    but only while associated. The body is an LLC/SNAP header with the local experimental EtherType 0x88B5.
+ *  - a broadcast vendor-specific action frame: needs no association, but goes out at a legacy rate (LLTF only).
+ *
+ * The 802.11 sequence control field is left to the driver (`en_sys_seq`).
+ *
+ * The UDP transmitter (`socket_transmitter_sta_loop`) sends the same payload as its datagram. Receivers can only
+ * read it there if the network is open, as they see the frames before decryption.
+ */
+
+#define PROBE_PAYLOAD_SIZE 20
+#define PROBE_PAYLOAD_VERSION 1
+#define PROBE_ETHERTYPE 0x88B5
+#define PROBE_ETHERTYPE_IPV4 0x0800
+#define PROBE_UDP_PORT 2223
+// locally administered OUI, so the vendor action frame cannot clash with a registered one
+#define PROBE_ACTION_OUI_0 0x02
+#define PROBE_ACTION_OUI_1 0xC5
+#define PROBE_ACTION_OUI_2 0x1D
+
+#define PROBE_FRAME_HEADER_SIZE 24
+#define PROBE_FRAME_DATA_BODY_PREFIX 8   // LLC/SNAP
+#define PROBE_FRAME_ACTION_BODY_PREFIX 4 // category + OUI
+#define PROBE_FRAME_MAX_SIZE (PROBE_FRAME_HEADER_SIZE + PROBE_FRAME_DATA_BODY_PREFIX + PROBE_PAYLOAD_SIZE)
+
+#define PROBE_FC_DATA 0x08
+#define PROBE_FC_ACTION 0xD0
+// type and subtype, without the protocol version
+#define PROBE_FC_KIND_MASK 0xFC
+#define PROBE_FC_SUBTYPE_QOS 0x80
+#define PROBE_FC_FLAG_TO_DS 0x01
+#define PROBE_FC_FLAG_FROM_DS 0x02
+#define PROBE_FC_FLAG_PROTECTED 0x40
+#define PROBE_ACTION_CATEGORY_VENDOR 127
+
+static const uint8_t PROBE_MAGIC[4] = {'C', 'S', 'I', 'P'};
+static const uint8_t PROBE_BROADCAST[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+typedef struct {
+    uint8_t data[PROBE_FRAME_MAX_SIZE];
+    size_t len;
+    size_t payload_offset;
+} probe_frame_t;
+
+typedef struct {
+    uint32_t sequence;
+    int64_t tx_timestamp_us;
+} probe_payload_t;
+
+void _probe_frame_header(uint8_t *p, uint8_t fc0, uint8_t fc1, const uint8_t addr1[6], const uint8_t addr2[6],
+                         const uint8_t addr3[6]) {
+    p[0] = fc0;
+    p[1] = fc1;
+    // duration and sequence control are filled in by the driver
+    p[2] = 0;
+    p[3] = 0;
+    memcpy(p + 4, addr1, 6);
+    memcpy(p + 10, addr2, 6);
+    memcpy(p + 16, addr3, 6);
+    p[22] = 0;
+    p[23] = 0;
+}
+
+void _probe_payload_init(uint8_t *p) {
+    memcpy(p, PROBE_MAGIC, 4);
+    p[4] = PROBE_PAYLOAD_VERSION;
+    memset(p + 5, 0, PROBE_PAYLOAD_SIZE - 5);
+}
+
+/*
+ * Data frame from `self` through the AP `bssid` to `destination` (usually broadcast).
+ */
+void probe_frame_build_data(probe_frame_t *f, const uint8_t bssid[6], const uint8_t self[6],
+                            const uint8_t destination[6]) {
+    uint8_t *p = f->data;
+    _probe_frame_header(p, PROBE_FC_DATA, PROBE_FC_FLAG_TO_DS, bssid, self, destination);
+    p += PROBE_FRAME_HEADER_SIZE;
+    static const uint8_t snap[6] = {0xAA, 0xAA, 0x03, 0x00, 0x00, 0x00};
+    memcpy(p, snap, sizeof(snap));
+    p[6] = PROBE_ETHERTYPE >> 8;
+    p[7] = PROBE_ETHERTYPE & 0xFF;
+    f->payload_offset = PROBE_FRAME_HEADER_SIZE + PROBE_FRAME_DATA_BODY_PREFIX;
+    _probe_payload_init(f->data + f->payload_offset);
+    f->len = f->payload_offset + PROBE_PAYLOAD_SIZE;
+}
+
+/*
+ * Broadcast vendor-specific action frame from `self`.
+ */
+void probe_frame_build_action(probe_frame_t *f, const uint8_t self[6]) {
+    uint8_t *p = f->data;
+    _probe_frame_header(p, PROBE_FC_ACTION, 0, PROBE_BROADCAST, self, self);
+    p += PROBE_FRAME_HEADER_SIZE;
+    p[0] = PROBE_ACTION_CATEGORY_VENDOR;
+    p[1] = PROBE_ACTION_OUI_0;
+    p[2] = PROBE_ACTION_OUI_1;
+    p[3] = PROBE_ACTION_OUI_2;
+    f->payload_offset = PROBE_FRAME_HEADER_SIZE + PROBE_FRAME_ACTION_BODY_PREFIX;
+    _probe_payload_init(f->data + f->payload_offset);
+    f->len = f->payload_offset + PROBE_PAYLOAD_SIZE;
+}
+
+/*
+ * Rewrites the sequence number and TX timestamp of the template in place.
+ */
+void probe_frame_stamp(probe_frame_t *f, uint32_t sequence, int64_t tx_timestamp_us) {
+    uint8_t *p = f->data + f->payload_offset;
+    _csi_binary_put_u32(p + 8, sequence);
+    _csi_binary_put_u64(p + 12, (uint64_t) tx_timestamp_us);
+}
+
+/*
+ * Reads a probe payload from the start of `p`. False if it is not one.
+ */
+bool probe_payload_parse(const uint8_t *p, size_t len, probe_payload_t *out) {
+    if (len < PROBE_PAYLOAD_SIZE || memcmp(p, PROBE_MAGIC, 4) != 0 || p[4] != PROBE_PAYLOAD_VERSION) {
+        return false;
+    }
+    out->sequence = _csi_binary_get_u32(p + 8);
+    out->tx_timestamp_us = (int64_t) _csi_binary_get_u64(p + 12);
+    return true;
+}
+
+/*
+ * Body of a data frame: LLC/SNAP, then either the probe payload directly (injected frames)
+ * or IPv4 + UDP to `PROBE_UDP_PORT` (the UDP transmitter on an open network).
+ */
+bool _probe_data_body_parse(const uint8_t *body, size_t len, probe_payload_t *out) {
+    if (len < PROBE_FRAME_DATA_BODY_PREFIX || body[0] != 0xAA || body[1] != 0xAA || body[2] != 0x03) {
+        return false;
+    }
+    uint16_t ethertype = (body[6] << 8) | body[7];
+    body += PROBE_FRAME_DATA_BODY_PREFIX;
+    len -= PROBE_FRAME_DATA_BODY_PREFIX;
+    if (ethertype == PROBE_ETHERTYPE) {
+        return probe_payload_parse(body, len, out);
+    }
+    if (ethertype != PROBE_ETHERTYPE_IPV4 || len < 20 || (body[0] >> 4) != 4 || body[9] != 17) {
+        return false;
+    }
+    size_t ip_header_len = (body[0] & 0x0F) * 4;
+    if (ip_header_len < 20 || len < ip_header_len + 8) {
+        return false;
+    }
+    const uint8_t *udp = body + ip_header_len;
+    if (((udp[2] << 8) | udp[3]) != PROBE_UDP_PORT) {
+        return false;
+    }
+    return probe_payload_parse(udp + 8, len - ip_header_len - 8, out);
+}
+
+/*
+ * Finds the probe payload in a received 802.11 frame (an injected one, or an unencrypted UDP probe;
+ * trailing bytes such as the FCS are ignored). False for any other frame.
+ */
+bool probe_frame_parse(const uint8_t *frame, size_t len, probe_payload_t *out) {
+    if (len < PROBE_FRAME_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t kind = frame[0] & PROBE_FC_KIND_MASK;
+    if (kind == PROBE_FC_DATA || kind == (PROBE_FC_DATA | PROBE_FC_SUBTYPE_QOS)) {
+        size_t header_len = PROBE_FRAME_HEADER_SIZE;
+        if ((frame[1] & PROBE_FC_FLAG_TO_DS) && (frame[1] & PROBE_FC_FLAG_FROM_DS)) {
+            header_len += 6; // addr4
+        }
+        if (kind & PROBE_FC_SUBTYPE_QOS) {
+            header_len += 2;
+        }
+        if ((frame[1] & PROBE_FC_FLAG_PROTECTED) || len < header_len) {
+            return false;
+        }
+        return _probe_data_body_parse(frame + header_len, len - header_len, out);
+    }
+    if (frame[0] == PROBE_FC_ACTION) {
+        const uint8_t *body = frame + PROBE_FRAME_HEADER_SIZE;
+        size_t body_len = len - PROBE_FRAME_HEADER_SIZE;
+        if (body_len < PROBE_FRAME_ACTION_BODY_PREFIX || body[0] != PROBE_ACTION_CATEGORY_VENDOR
+            || body[1] != PROBE_ACTION_OUI_0 || body[2] != PROBE_ACTION_OUI_1 || body[3] != PROBE_ACTION_OUI_2) {
+            return false;
+        }
+        return probe_payload_parse(body + PROBE_FRAME_ACTION_BODY_PREFIX, body_len - PROBE_FRAME_ACTION_BODY_PREFIX,
+                                   out);
+    }
+    return false;
+}
+
+/*
+ * Payload of the UDP transmitter, stamped like `probe_frame_stamp()`.
+ */
+void probe_payload_stamp(uint8_t *payload, uint32_t sequence, int64_t tx_timestamp_us) {
+    _probe_payload_init(payload);
+    _csi_binary_put_u32(payload + 8, sequence);
+    _csi_binary_put_u64(payload + 12, (uint64_t) tx_timestamp_us);
+}
+
+#endif //ESP32_CSI_PROBE_FRAME_COMPONENT_H
@@ -0,0 +1,122 @@
+#ifndef ESP32_CSI_PROBE_RX_COMPONENT_H
+#define ESP32_CSI_PROBE_RX_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#include "csi_format_component.h"
+#include "probe_frame_component.h"
+
+/*
+ * Receiving side of `probe_frame_component.h` (`CONFIG_CSI_PROBE_TAGS`): the promiscuous callback hands every
+ * probe it sees to the CSI writer task through a small single-producer/single-consumer ring, and the writer
+ * reports each one as
+ *
+ *   CSI_PROBE,<role>,<mac>,<local_timestamp>,<sequence>,<tx_timestamp_us>
+ *
+ * `mac` and `local_timestamp` are the same as in the `CSI_DATA` row of that frame, which is how the two are joined
+ * (see `cpp_utils/csi_probe_analyze.cc`). Probes which did not fit into the ring are reported as
+ *
+ *   CSI_PROBE_DROPPED,<role>,<total dropped>,<dropped since last report>
+ *
+ * The promiscuous callback itself lives in `csi_component.h`.
+ */
+
+// Must be a power of two.
+#ifndef PROBE_RX_SLOT_COUNT
+#define PROBE_RX_SLOT_COUNT 32
+#endif
+
+static_assert((PROBE_RX_SLOT_COUNT & (PROBE_RX_SLOT_COUNT - 1)) == 0, "PROBE_RX_SLOT_COUNT must be a power of two");
+
+typedef struct {
+    uint8_t mac[6];
+    uint32_t local_timestamp;
+    probe_payload_t payload;
+} probe_rx_record_t;
+
+typedef struct {
+    probe_rx_record_t slots[PROBE_RX_SLOT_COUNT];
+    // free running counters, masked on access
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+} probe_rx_ring_t;
+
+void probe_rx_ring_reset(probe_rx_ring_t *ring) {
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->dropped.store(0);
+}
+
+/*
+ * Producer: parses a received 802.11 frame and queues it if it is a probe. Returns true if it was queued.
+ */
+bool probe_rx_frame(probe_rx_ring_t *ring, const uint8_t *frame, size_t len, uint32_t local_timestamp) {
+    probe_payload_t payload;
+    if (!probe_frame_parse(frame, len, &payload)) {
+        return false;
+    }
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= PROBE_RX_SLOT_COUNT) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    probe_rx_record_t *r = &ring->slots[head & (PROBE_RX_SLOT_COUNT - 1)];
+    // transmitter address
+    memcpy(r->mac, frame + 10, 6);
+    r->local_timestamp = local_timestamp;
+    r->payload = payload;
+    ring->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+/*
+ * Consumer: copies the oldest queued probe to `out`. False if the ring is empty.
+ */
+bool probe_rx_pop(probe_rx_ring_t *ring, probe_rx_record_t *out) {
+    uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail == ring->head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    *out = ring->slots[tail & (PROBE_RX_SLOT_COUNT - 1)];
+    ring->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t probe_rx_dropped(probe_rx_ring_t *ring) {
+    return ring->dropped.load(std::memory_order_relaxed);
+}
+
+/*
+ * `CSI_PROBE,...` line, see the top of this file.
+ */
+void probe_rx_format(csi_format_buffer_t *b, const char *role, const probe_rx_record_t *r) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_PROBE,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    csi_format_mac(b, r->mac);
+    csi_format_char(b, ',');
+    csi_format_uint(b, r->local_timestamp);
+    csi_format_char(b, ',');
+    csi_format_uint(b, r->payload.sequence);
+    csi_format_char(b, ',');
+    csi_format_int(b, r->payload.tx_timestamp_us);
+    csi_format_char(b, '\n');
+}
+
+void probe_rx_format_dropped(csi_format_buffer_t *b, const char *role, uint32_t total, uint32_t since_last) {
+    csi_format_reset(b);
+    csi_format_str(b, "CSI_PROBE_DROPPED,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    csi_format_uint(b, total);
+    csi_format_char(b, ',');
+    csi_format_uint(b, since_last);
+    csi_format_char(b, '\n');
+}
+
+#endif //ESP32_CSI_PROBE_RX_COMPONENT_H
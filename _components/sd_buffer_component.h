@@ -0,0 +1,223 @@
+#ifndef ESP32_CSI_SD_BUFFER_COMPONENT_H
+#define ESP32_CSI_SD_BUFFER_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+
+/*
+ * Double-buffered writer for the SD card.
+ *
+ * One task (the filler, i.e. the CSI writer) appends bytes to the active buffer. Once it holds a full cluster it is
+ * queued for a second task (the flusher) which writes it with a single `write()` while the filler carries on with the
+ * other buffer. Records simply continue in the next buffer, so no record is ever split across two files or lost.
+ *
+ * Writes are kept cluster aligned: if a partly filled buffer has to go out early (time based sync),
+ * the next buffer is shortened so that the following writes line up with clusters again.
+ *
+ * The filler and flusher only hand buffers to each other through `state`, so no lock is needed.
+ * Platform specific waking/waiting is supplied as function pointers, which keeps this header buildable on the host
+ * against a plain POSIX file.
+ */
+
+// Matches `allocation_unit_size` of the FAT filesystem in `sd_component.h`.
+#ifndef SD_BUFFER_SIZE
+#define SD_BUFFER_SIZE (16 * 1024)
+#endif
+
+#define SD_BUFFER_FREE 0
+#define SD_BUFFER_QUEUED 1
+
+typedef struct {
+    uint8_t data[2][SD_BUFFER_SIZE];
+    size_t fill[2];
+    bool sync_requested[2];
+    // file each buffer goes to, and whether that file is finished (synced and closed) after it
+    int buffer_fd[2];
+    bool close_after[2];
+    std::atomic<uint8_t> state[2];
+
+    // sync whenever this much time has passed or this many bytes were written since the last sync
+    int64_t sync_interval_us;
+    size_t sync_bytes;
+
+    // filler side
+    int fd;
+    int active;
+    int64_t pending_since_us;
+    uint64_t queued_bytes;
+
+    // flusher side
+    int next_flush;
+    size_t unsynced_bytes;
+    int64_t last_sync_us;
+
+    void (*notify_flusher)();
+    void (*wait_for_flusher)();
+
+    std::atomic<uint32_t> writes;
+    std::atomic<uint32_t> syncs;
+    std::atomic<uint32_t> write_errors;
+    // number of times the filler had to wait for the flusher
+    std::atomic<uint32_t> stalls;
+    std::atomic<uint64_t> bytes_written;
+} sd_buffer_t;
+
+void sd_buffer_init(sd_buffer_t *b, int fd, int64_t sync_interval_us, size_t sync_bytes,
+                    void (*notify_flusher)(), void (*wait_for_flusher)()) {
+    b->fill[0] = b->fill[1] = 0;
+    b->sync_requested[0] = b->sync_requested[1] = false;
+    b->buffer_fd[0] = b->buffer_fd[1] = fd;
+    b->close_after[0] = b->close_after[1] = false;
+    b->state[0].store(SD_BUFFER_FREE);
+    b->state[1].store(SD_BUFFER_FREE);
+    b->fd = fd;
+    b->sync_interval_us = sync_interval_us;
+    b->sync_bytes = sync_bytes;
+    b->active = 0;
+    b->pending_since_us = -1;
+    b->queued_bytes = 0;
+    b->next_flush = 0;
+    b->unsynced_bytes = 0;
+    b->last_sync_us = 0;
+    b->notify_flusher = notify_flusher;
+    b->wait_for_flusher = wait_for_flusher;
+    b->writes.store(0);
+    b->syncs.store(0);
+    b->write_errors.store(0);
+    b->stalls.store(0);
+    b->bytes_written.store(0);
+}
+
+/*
+ * Bytes the active buffer may hold so that it ends on a cluster boundary of the file.
+ * Every file starts out aligned, `queued_bytes` counts from the start of the current one.
+ */
+size_t _sd_buffer_capacity(const sd_buffer_t *b) {
+    return SD_BUFFER_SIZE - (b->queued_bytes % SD_BUFFER_SIZE);
+}
+
+/*
+ * Filler: queues the active buffer (if it holds anything) and switches to the other one,
+ * waiting for the flusher if that one has not been written yet.
+ */
+void _sd_buffer_hand_off(sd_buffer_t *b, bool sync, bool close_after) {
+    int i = b->active;
+    if (b->fill[i] == 0 && !close_after) {
+        return;
+    }
+
+    b->sync_requested[i] = sync;
+    b->buffer_fd[i] = b->fd;
+    b->close_after[i] = close_after;
+    b->queued_bytes += b->fill[i];
+    b->state[i].store(SD_BUFFER_QUEUED, std::memory_order_release);
+    b->notify_flusher();
+
+    b->active = 1 - i;
+    while (b->state[b->active].load(std::memory_order_acquire) != SD_BUFFER_FREE) {
+        b->stalls.fetch_add(1, std::memory_order_relaxed);
+        b->wait_for_flusher();
+    }
+    b->fill[b->active] = 0;
+    b->pending_since_us = -1;
+}
+
+/*
+ * Filler: appends `len` bytes. Only blocks if both buffers are full and waiting for the card.
+ */
+void sd_buffer_append(sd_buffer_t *b, const void *data, size_t len, int64_t now_us) {
+    const uint8_t *p = (const uint8_t *) data;
+    while (len > 0) {
+        int i = b->active;
+        size_t capacity = _sd_buffer_capacity(b);
+        size_t n = capacity - b->fill[i];
+        if (n > len) {
+            n = len;
+        }
+        memcpy(b->data[i] + b->fill[i], p, n);
+        b->fill[i] += n;
+        p += n;
+        len -= n;
+
+        if (b->pending_since_us < 0) {
+            b->pending_since_us = now_us;
+        }
+        if (b->fill[i] == capacity) {
+            _sd_buffer_hand_off(b, false, false);
+        }
+    }
+}
+
+/*
+ * Filler: call regularly, even when idle, so data never waits in a part filled buffer for longer than the
+ * sync interval.
+ */
+void sd_buffer_poll(sd_buffer_t *b, int64_t now_us) {
+    if (b->pending_since_us >= 0 && now_us - b->pending_since_us >= b->sync_interval_us) {
+        _sd_buffer_hand_off(b, true, false);
+    }
+}
+
+/*
+ * Filler: queue whatever is buffered and have it synced to the card.
+ */
+void sd_buffer_sync(sd_buffer_t *b) {
+    _sd_buffer_hand_off(b, true, false);
+}
+
+/*
+ * Filler: everything appended so far goes to the current file, which the flusher then syncs and closes.
+ * Everything appended from now on goes to `fd`.
+ */
+void sd_buffer_switch_file(sd_buffer_t *b, int fd) {
+    _sd_buffer_hand_off(b, true, true);
+    b->fd = fd;
+    b->queued_bytes = 0;
+}
+
+/*
+ * Flusher: writes the next queued buffer, if any. Returns false when there was nothing to do.
+ */
+bool sd_buffer_flush_next(sd_buffer_t *b, int64_t now_us) {
+    int i = b->next_flush;
+    if (b->state[i].load(std::memory_order_acquire) != SD_BUFFER_QUEUED) {
+        return false;
+    }
+
+    const uint8_t *p = b->data[i];
+    size_t remaining = b->fill[i];
+    while (remaining > 0) {
+        ssize_t n = write(b->buffer_fd[i], p, remaining);
+        if (n <= 0) {
+            b->write_errors.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        p += n;
+        remaining -= n;
+    }
+    size_t written = b->fill[i] - remaining;
+    if (written > 0) {
+        b->writes.fetch_add(1, std::memory_order_relaxed);
+    }
+    b->bytes_written.fetch_add(written, std::memory_order_relaxed);
+    b->unsynced_bytes += written;
+
+    if (b->sync_requested[i] || b->unsynced_bytes >= b->sync_bytes || now_us - b->last_sync_us >= b->sync_interval_us) {
+        fsync(b->buffer_fd[i]);
+        b->syncs.fetch_add(1, std::memory_order_relaxed);
+        b->unsynced_bytes = 0;
+        b->last_sync_us = now_us;
+    }
+    if (b->close_after[i]) {
+        close(b->buffer_fd[i]);
+    }
+
+    b->state[i].store(SD_BUFFER_FREE, std::memory_order_release);
+    b->next_flush = 1 - i;
+    return true;
+}
+
+#endif //ESP32_CSI_SD_BUFFER_COMPONENT_H
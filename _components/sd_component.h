@@ -2,7 +2,9 @@
 #define ESP32_CSI_SD_COMPONENT_H
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
 #include "esp_err.h"
@@ -17,24 +19,97 @@
 #define PIN_NUM_CLK  14
 #define PIN_NUM_CS   13
 
-FILE *f;
-char filename[24] = {0};
+#if CONFIG_CSI_OUTPUT_FORMAT_BINARY
+#define SD_FILE_EXTENSION "bin"
+#define SD_FILE_BINARY true
+#else
+#define SD_FILE_EXTENSION "csv"
+#define SD_FILE_BINARY false
+#endif
 
-void _sd_pick_next_file() {
-    int i = -1;
-    struct stat st;
-    while (true) {
-        i++;
-        printf("Checking %i.csv\n", i);
-        sprintf(filename, "/sdcard/%i.csv", i);
+#include "time_component.h"
+#include "csi_format_component.h"
+#include "sd_buffer_component.h"
+#include "sd_segment_component.h"
+
+#define SD_WRITER_TASK_STACK_SIZE 3072
+#define SD_WRITER_TASK_PRIORITY 5
+#define SD_WRITER_TASK_CORE 0
+
+#ifdef CONFIG_SD_SYNC_INTERVAL_MS
+#define SD_SYNC_INTERVAL_MS CONFIG_SD_SYNC_INTERVAL_MS
+#else
+#define SD_SYNC_INTERVAL_MS 1000
+#endif
+#define SD_SYNC_BYTES (256 * 1024)
+
+#ifdef CONFIG_SD_SEGMENT_SIZE_MB
+#define SD_SEGMENT_MAX_BYTES (CONFIG_SD_SEGMENT_SIZE_MB * 1024ULL * 1024ULL)
+#else
+#define SD_SEGMENT_MAX_BYTES (64 * 1024ULL * 1024ULL)
+#endif
+#ifdef CONFIG_SD_SEGMENT_DURATION_S
+#define SD_SEGMENT_MAX_DURATION_US (CONFIG_SD_SEGMENT_DURATION_S * 1000000LL)
+#else
+#define SD_SEGMENT_MAX_DURATION_US 0
+#endif
+
+// Longest line `outprintf` writes to the card.
+#define SD_PRINTF_BUFFER_SIZE 512
+
+int sd_fd = -1;
+
+#ifdef CONFIG_SEND_CSI_TO_SD
+/*
+ * `outwrite` only copies into `sd_buffer`; full buffers are written to the card by `sd_writer_task`.
+ * All output must therefore come from one task at a time (the CSI writer once it has been started).
+ */
+sd_buffer_t sd_buffer;
+sd_segment_t sd_segment;
+TaskHandle_t sd_writer_handle = NULL;
 
-        if (stat(filename, &st) != 0) {
-            break;
+void _sd_notify_writer() {
+    xTaskNotifyGive(sd_writer_handle);
+}
+
+void _sd_wait_for_writer() {
+    vTaskDelay(1);
+}
+
+void sd_writer_task(void *pvParameters) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (sd_buffer_flush_next(&sd_buffer, get_steady_clock_timestamp_us())) {
         }
+    }
+}
 
-        printf("File size: %li\n", st.st_size);
+/*
+ * Closes the current segment (with its footer) and continues in the next one.
+ */
+void _sd_rotate_segment(int64_t now_us) {
+    uint8_t footer[SD_SEGMENT_FOOTER_CSV_SIZE + 1];
+    size_t footer_len = sd_segment_footer(&sd_segment, footer, sizeof(footer));
+    sd_buffer_append(&sd_buffer, footer, footer_len, now_us);
+
+    int fd = sd_segment_open_next(&sd_segment);
+    if (fd < 0) {
+        ESP_LOGE("sd.h", "Failed to open %s, no longer writing to the SD card", sd_segment.path);
+        sd_buffer_switch_file(&sd_buffer, -1);
+        sd_fd = -1;
+        return;
     }
+    printf("Writing to %s\n", sd_segment.path);
+    sd_buffer_switch_file(&sd_buffer, fd);
+    sd_fd = fd;
+
+#if !CONFIG_CSI_OUTPUT_FORMAT_BINARY
+    // every segment can be read on its own
+    sd_buffer_append(&sd_buffer, CSI_CSV_HEADER, strlen(CSI_CSV_HEADER), now_us);
+    sd_segment_add(&sd_segment, strlen(CSI_CSV_HEADER), 0, now_us);
+#endif
 }
+#endif
 
 void sd_init() {
 #ifdef CONFIG_SEND_CSI_TO_SD
@@ -47,7 +122,8 @@ void sd_init() {
 
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
             .format_if_mount_failed = false,
-            .max_files = 1,
+            // the segment being closed, the next one and the index
+            .max_files = 3,
             .allocation_unit_size = 16 * 1024
     };
 
@@ -70,8 +146,42 @@ void sd_init() {
     } else {
         sdmmc_card_print_info(stdout, card);
 
-        _sd_pick_next_file();
-        f = fopen(filename, "a");
+        sd_segment_init(&sd_segment, "/sdcard", SD_FILE_EXTENSION, SD_FILE_BINARY,
+                        SD_SEGMENT_MAX_BYTES, SD_SEGMENT_MAX_DURATION_US);
+        sd_fd = sd_segment_open_next(&sd_segment);
+        if (sd_fd < 0) {
+            ESP_LOGE("sd.h", "Failed to open %s", sd_segment.path);
+            return;
+        }
+        printf("Writing to %s\n", sd_segment.path);
+
+        sd_buffer_init(&sd_buffer, sd_fd, SD_SYNC_INTERVAL_MS * 1000LL, SD_SYNC_BYTES,
+                       &_sd_notify_writer, &_sd_wait_for_writer);
+        xTaskCreatePinnedToCore(&sd_writer_task, "sd_writer", SD_WRITER_TASK_STACK_SIZE, NULL,
+                                SD_WRITER_TASK_PRIORITY, &sd_writer_handle, SD_WRITER_TASK_CORE);
+    }
+#endif
+}
+
+/*
+ * Raw write (text or binary records) for both serial AND sd card (if available and configured)
+ */
+void outwrite(const void *buf, size_t len) {
+#ifdef CONFIG_SEND_CSI_TO_SERIAL
+    fwrite(buf, 1, len, stdout);
+#endif
+
+#ifdef CONFIG_SEND_CSI_TO_SD
+    if (sd_fd >= 0) {
+        int64_t now_us = get_steady_clock_timestamp_us();
+        // segments only ever end between records
+        if (sd_segment_full(&sd_segment, now_us)) {
+            _sd_rotate_segment(now_us);
+        }
+        if (sd_fd >= 0) {
+            sd_buffer_append(&sd_buffer, buf, len, now_us);
+            sd_segment_add(&sd_segment, len, 1, now_us);
+        }
     }
 #endif
 }
@@ -84,23 +194,52 @@ void outprintf(const char *format, ...) {
     va_start(args, format);
 
 #ifdef CONFIG_SEND_CSI_TO_SERIAL
-    vprintf(format, args);
+    va_list serial_args;
+    va_copy(serial_args, args);
+    vprintf(format, serial_args);
+    va_end(serial_args);
 #endif
 
 #ifdef CONFIG_SEND_CSI_TO_SD
-    if (f != NULL) {
-        vfprintf(f, format, args);
+    if (sd_fd >= 0) {
+        char line[SD_PRINTF_BUFFER_SIZE];
+        int len = vsnprintf(line, sizeof(line), format, args);
+        if (len > 0) {
+            size_t n = len < (int) sizeof(line) ? len : sizeof(line) - 1;
+            int64_t now_us = get_steady_clock_timestamp_us();
+            sd_buffer_append(&sd_buffer, line, n, now_us);
+            sd_segment_add(&sd_segment, n, 0, now_us);
+        }
     }
 #endif
 
     va_end(args);
 }
 
+/*
+ * Called by the output task whenever it runs out of work (and at least every few hundred ms),
+ * so buffered output does not wait indefinitely.
+ */
+void outflush() {
+#ifdef CONFIG_SEND_CSI_TO_SERIAL
+    fflush(stdout);
+#endif
+
+#ifdef CONFIG_SEND_CSI_TO_SD
+    if (sd_fd >= 0) {
+        sd_buffer_poll(&sd_buffer, get_steady_clock_timestamp_us());
+    }
+#endif
+}
+
+/*
+ * Pushes everything buffered so far to the card and syncs it.
+ */
 void sd_flush() {
 #ifdef CONFIG_SEND_CSI_TO_SD
-    fflush(f);
-    fclose(f);
-    f = fopen(filename, "a");
+    if (sd_fd >= 0) {
+        sd_buffer_sync(&sd_buffer);
+    }
 #endif
 }
 
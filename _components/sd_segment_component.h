@@ -0,0 +1,220 @@
+#ifndef ESP32_CSI_SD_SEGMENT_COMPONENT_H
+#define ESP32_CSI_SD_SEGMENT_COMPONENT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "csi_binary_component.h"
+
+/*
+ * Splits an SD card capture into numbered segments (`0.csv`, `1.csv`, ...).
+ *
+ * The number of the next segment is kept in `index.txt`, so finding it at boot takes one read and (usually) one
+ * `stat`, no matter how many segments are already on the card. Should the index be stale (e.g. the card was used
+ * by another device) the search simply continues from there.
+ *
+ * A segment is closed once it reaches `max_bytes` or covers `max_duration_us`, and ends with a fixed size footer
+ * holding the number of records and the (steady clock) time at which the first and last were written, so tools can
+ * find the right segment without reading them all:
+ *
+ *   CSV:    CSI_SEGMENT,<segment>,<records>,<first timestamp us>,<last timestamp us>\n (zero padded, 76 bytes)
+ *   binary: a `CSI_BINARY_RECORD_SEGMENT` record (32 bytes)
+ */
+
+#define SD_SEGMENT_INDEX_FILE "index.txt"
+#define SD_SEGMENT_PATH_SIZE 128
+
+#define SD_SEGMENT_FOOTER_CSV_FORMAT "CSI_SEGMENT,%010u,%010u,%020lld,%020lld\n"
+#define SD_SEGMENT_FOOTER_CSV_SIZE 76
+#define SD_SEGMENT_FOOTER_BINARY_SIZE (CSI_BINARY_HEADER_SIZE + CSI_BINARY_SEGMENT_SIZE + CSI_BINARY_CRC_SIZE)
+
+typedef struct {
+    char dir[SD_SEGMENT_PATH_SIZE / 2];
+    const char *extension;
+    bool binary;
+
+    // 0 disables the limit
+    uint64_t max_bytes;
+    int64_t max_duration_us;
+
+    // current segment
+    uint32_t segment;
+    char path[SD_SEGMENT_PATH_SIZE];
+    uint64_t bytes;
+    uint32_t records;
+    int64_t first_us;
+    int64_t last_us;
+
+    // `stat` calls made by the last `sd_segment_open_next`
+    uint32_t probes;
+} sd_segment_t;
+
+typedef struct {
+    uint32_t segment;
+    uint32_t records;
+    int64_t first_us;
+    int64_t last_us;
+} sd_segment_footer_t;
+
+void sd_segment_init(sd_segment_t *s, const char *dir, const char *extension, bool binary,
+                     uint64_t max_bytes, int64_t max_duration_us) {
+    snprintf(s->dir, sizeof(s->dir), "%s", dir);
+    s->extension = extension;
+    s->binary = binary;
+    s->max_bytes = max_bytes;
+    s->max_duration_us = max_duration_us;
+    s->segment = 0;
+    s->path[0] = '\0';
+    s->bytes = 0;
+    s->records = 0;
+    s->first_us = 0;
+    s->last_us = 0;
+    s->probes = 0;
+}
+
+uint32_t _sd_segment_read_index(const sd_segment_t *s) {
+    char path[SD_SEGMENT_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/" SD_SEGMENT_INDEX_FILE, s->dir);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    unsigned next = 0;
+    if (fscanf(f, "%u", &next) != 1) {
+        next = 0;
+    }
+    fclose(f);
+    return next;
+}
+
+void _sd_segment_write_index(const sd_segment_t *s, uint32_t next) {
+    char path[SD_SEGMENT_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/" SD_SEGMENT_INDEX_FILE, s->dir);
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return;
+    }
+    fprintf(f, "%u\n", (unsigned) next);
+    fclose(f);
+}
+
+/*
+ * Creates the next segment and returns its file descriptor (or -1).
+ */
+int sd_segment_open_next(sd_segment_t *s) {
+    struct stat st;
+    uint32_t segment = _sd_segment_read_index(s);
+    s->probes = 0;
+    while (true) {
+        snprintf(s->path, sizeof(s->path), "%s/%u.%s", s->dir, (unsigned) segment, s->extension);
+        s->probes++;
+        if (stat(s->path, &st) != 0) {
+            break;
+        }
+        segment++;
+    }
+
+    int fd = open(s->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    _sd_segment_write_index(s, segment + 1);
+
+    s->segment = segment;
+    s->bytes = 0;
+    s->records = 0;
+    s->first_us = 0;
+    s->last_us = 0;
+    return fd;
+}
+
+/*
+ * Accounts for `bytes` written to the current segment, `records` of which are CSI (or dropped) records.
+ */
+void sd_segment_add(sd_segment_t *s, size_t bytes, uint32_t records, int64_t now_us) {
+    if (records > 0) {
+        if (s->records == 0) {
+            s->first_us = now_us;
+        }
+        s->last_us = now_us;
+        s->records += records;
+    }
+    s->bytes += bytes;
+}
+
+/*
+ * Whether the current segment should be closed before anything else is written to it.
+ */
+bool sd_segment_full(const sd_segment_t *s, int64_t now_us) {
+    if (s->max_bytes > 0 && s->bytes >= s->max_bytes) {
+        return true;
+    }
+    return s->max_duration_us > 0 && s->records > 0 && now_us - s->first_us >= s->max_duration_us;
+}
+
+/*
+ * Writes the footer of the current segment to `out` and returns its size (0 if `cap` is too small).
+ */
+size_t sd_segment_footer(const sd_segment_t *s, uint8_t *out, size_t cap) {
+    if (s->binary) {
+        return csi_binary_encode_segment(out, cap, s->segment, s->records, s->first_us, s->last_us);
+    }
+    if (cap <= SD_SEGMENT_FOOTER_CSV_SIZE) {
+        return 0;
+    }
+    return snprintf((char *) out, cap, SD_SEGMENT_FOOTER_CSV_FORMAT, (unsigned) s->segment, (unsigned) s->records,
+                    (long long) s->first_us, (long long) s->last_us);
+}
+
+/*
+ * Reads the footer at the end of a (CSV or binary) segment. Returns false if the segment was never closed,
+ * e.g. because power was lost while it was written.
+ */
+bool sd_segment_read_footer(const char *path, sd_segment_footer_t *out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t tail[SD_SEGMENT_FOOTER_CSV_SIZE + 1];
+    off_t size = lseek(fd, 0, SEEK_END);
+    bool ok = false;
+
+    if (size >= SD_SEGMENT_FOOTER_BINARY_SIZE
+        && pread(fd, tail, SD_SEGMENT_FOOTER_BINARY_SIZE, size - SD_SEGMENT_FOOTER_BINARY_SIZE)
+           == SD_SEGMENT_FOOTER_BINARY_SIZE) {
+        csi_binary_record_t record;
+        size_t consumed;
+        if (csi_binary_decode(tail, SD_SEGMENT_FOOTER_BINARY_SIZE, &consumed, &record) == CSI_BINARY_DECODED
+            && record.type == CSI_BINARY_RECORD_SEGMENT) {
+            out->segment = record.segment;
+            out->records = record.segment_records;
+            out->first_us = record.segment_first_us;
+            out->last_us = record.segment_last_us;
+            ok = true;
+        }
+    }
+
+    if (!ok && size >= SD_SEGMENT_FOOTER_CSV_SIZE
+        && pread(fd, tail, SD_SEGMENT_FOOTER_CSV_SIZE, size - SD_SEGMENT_FOOTER_CSV_SIZE)
+           == SD_SEGMENT_FOOTER_CSV_SIZE) {
+        tail[SD_SEGMENT_FOOTER_CSV_SIZE] = '\0';
+        unsigned segment, records;
+        long long first_us, last_us;
+        if (sscanf((const char *) tail, "CSI_SEGMENT,%u,%u,%lld,%lld", &segment, &records, &first_us, &last_us) == 4) {
+            out->segment = segment;
+            out->records = records;
+            out->first_us = first_us;
+            out->last_us = last_us;
+            ok = true;
+        }
+    }
+
+    close(fd);
+    return ok;
+}
+
+#endif //ESP32_CSI_SD_SEGMENT_COMPONENT_H
@@ -1,3 +1,6 @@
+#ifndef ESP32_CSI_SOCKETS_COMPONENT_H
+#define ESP32_CSI_SOCKETS_COMPONENT_H
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -7,16 +10,183 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <atomic>
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
 #include <esp_http_server.h>
 
-char *data = (char *) "1\n";
+#include "packet_scheduler_component.h"
+#include "probe_frame_component.h"
+#include "command_component.h"
+#include "clock_sync_component.h"
+#include "time_component.h"
+#include "sta_session_component.h"
+
+#ifdef CONFIG_PACKET_RATE
+#define PACKET_RATE CONFIG_PACKET_RATE
+#else
+#define PACKET_RATE 100
+#endif
+
+#ifdef CONFIG_PACKET_BURST
+#define PACKET_BURST CONFIG_PACKET_BURST
+#else
+#define PACKET_BURST 1
+#endif
+
+#ifdef CONFIG_PACKET_STATS_INTERVAL_S
+#define PACKET_STATS_INTERVAL_S CONFIG_PACKET_STATS_INTERVAL_S
+#else
+#define PACKET_STATS_INTERVAL_S 10
+#endif
+
+// waits shorter than this are busy-waited, as the esp_timer dispatch latency would be about as long
+#define PACKET_SPIN_WAIT_US 50
+
+#ifdef CONFIG_TIME_SYNC_INTERVAL_MS
+#define TIME_SYNC_INTERVAL_MS CONFIG_TIME_SYNC_INTERVAL_MS
+#else
+#define TIME_SYNC_INTERVAL_MS 1000
+#endif
+
+#ifdef CONFIG_TIME_SYNC_HOST
+#define TIME_SYNC_HOST CONFIG_TIME_SYNC_HOST
+#else
+#define TIME_SYNC_HOST "192.168.4.1"
+#endif
+
+#ifdef CONFIG_TIME_SYNC_PORT
+#define TIME_SYNC_PORT CONFIG_TIME_SYNC_PORT
+#else
+#define TIME_SYNC_PORT CLOCK_SYNC_PORT
+#endif
+
+// a clock sync reply later than this is taken as lost
+#define TIME_SYNC_TIMEOUT_MS 200
+// a `TIME_SYNC` line every this many exchanges
+#define TIME_SYNC_PRINT_EVERY 10
+#define TIME_SYNC_TASK_STACK_SIZE 4096
+// above the CSI writer, so datagrams are stamped as soon as they arrive
+#define TIME_SYNC_TASK_PRIORITY 15
+#define TIME_SYNC_TASK_CORE 0
+
+#ifdef CONFIG_STA_POLL_TARGET_FPS
+#define STA_POLL_TARGET_FPS CONFIG_STA_POLL_TARGET_FPS
+#else
+#define STA_POLL_TARGET_FPS 0
+#endif
+
+// a station can be solicited at most once per tick, so this bounds the target rate
+#define STA_POLL_TICK_MS 10
+// how often stations which got their address from DHCP since are looked up
+#define STA_POLL_ADDRESS_INTERVAL_MS 1000
+#define STA_POLL_ECHO_ID 0x4353
+#define STA_POLL_TASK_STACK_SIZE 4096
+#define STA_POLL_TASK_PRIORITY 5
+#define STA_POLL_TASK_CORE 0
+
+packet_scheduler_t packet_scheduler;
+// Set at startup and by `RATE` (see `_transmitter_apply_rate()`), kept when the transmitter reconnects.
+uint32_t packet_rate = PACKET_RATE;
+uint32_t packet_burst = PACKET_BURST;
+// `rate << 8 | burst` asked for by `RATE`, 0 for none
+std::atomic<uint32_t> packet_rate_requested(0);
+TaskHandle_t packet_transmitter_handle = NULL;
+uint32_t packet_send_errors = 0;
+// Numbers every packet sent since boot, whichever way it is sent, so receivers can count lost ones.
+uint32_t probe_sequence = 0;
+
+void _transmitter_timer_cb(void *arg) {
+    xTaskNotifyGive((TaskHandle_t) arg);
+}
+
+/*
+ * One-shot timer which wakes the calling task up, for `_transmitter_wait()`.
+ */
+esp_timer_handle_t _transmitter_timer_create() {
+    esp_timer_handle_t timer;
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = &_transmitter_timer_cb;
+    timer_args.arg = xTaskGetCurrentTaskHandle();
+    timer_args.name = "packet_rate";
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer));
+    packet_transmitter_handle = xTaskGetCurrentTaskHandle();
+    return timer;
+}
+
+/*
+ * Restarts the pacing with the rate asked for by `RATE`, if any.
+ */
+void _transmitter_apply_rate(int64_t now_us) {
+    uint32_t requested = packet_rate_requested.exchange(0);
+    if (requested != 0) {
+        packet_rate = requested >> 8;
+        packet_burst = requested & 0xFF;
+        packet_scheduler_init(&packet_scheduler, packet_rate, packet_burst, now_us);
+    }
+}
+
+/*
+ * Blocks until the next deadline of `packet_scheduler`. Even at 1000 Hz the tick is too coarse,
+ * so longer waits sleep on a one-shot esp_timer which wakes this task up.
+ */
+void _transmitter_wait(esp_timer_handle_t timer) {
+    int64_t wait_us;
+    while (true) {
+        // `RATE` wakes this task up, so a new rate applies right away instead of after a long wait at the old one
+        _transmitter_apply_rate(esp_timer_get_time());
+        wait_us = packet_scheduler_wait_us(&packet_scheduler, esp_timer_get_time());
+        if (wait_us <= 0) {
+            break;
+        }
+        if (wait_us < PACKET_SPIN_WAIT_US) {
+            ets_delay_us(wait_us);
+            continue;
+        }
+        esp_timer_stop(timer);
+        esp_timer_start_once(timer, wait_us);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+/*
+ * `TX_STATS,<rate>,<burst>,<interval ms>,<bursts>,<skipped>,<send errors>,late_us=<min>/<mean>/<p99>/<max>,
+ *  period_us=<min>/<mean>/<p99>/<max>`: how late each burst went out and the time between bursts.
+ */
+void _transmitter_print_stats(int64_t now_us) {
+    packet_scheduler_t *s = &packet_scheduler;
+    const csi_histogram_t *late = &s->lateness_us;
+    const csi_histogram_t *period = &s->interval_us;
+    printf("TX_STATS,%u,%u,%lld,%u,%u,%u,late_us=%u/%u/%u/%u,period_us=%u/%u/%u/%u\n",
+           s->rate, s->burst, (long long) (now_us - s->stats_start_us) / 1000, s->bursts, s->skipped,
+           packet_send_errors,
+           late->count ? late->min : 0, csi_histogram_mean(late), csi_histogram_percentile(late, 990), late->max,
+           period->count ? period->min : 0, csi_histogram_mean(period), csi_histogram_percentile(period, 990),
+           period->max);
+    packet_send_errors = 0;
+    packet_scheduler_reset_stats(s, now_us);
+}
+
+/*
+ * Call after sending the burst which was due, with the time it started.
+ */
+void _transmitter_sent(int64_t now_us) {
+    packet_scheduler_sent(&packet_scheduler, now_us);
+    if (PACKET_STATS_INTERVAL_S > 0
+        && now_us - packet_scheduler.stats_start_us >= (int64_t) PACKET_STATS_INTERVAL_S * 1000000) {
+        _transmitter_print_stats(now_us);
+    }
+}
 
 void socket_transmitter_sta_loop(bool (*is_wifi_connected)()) {
     int socket_fd = -1;
+    esp_timer_handle_t timer = _transmitter_timer_create();
+
     while (1) {
         close(socket_fd);
         char *ip = (char *) "192.168.4.1";
@@ -45,24 +215,274 @@ void socket_transmitter_sta_loop(bool (*is_wifi_connected)()) {
         }
 
         printf("sending frames.\n");
+        packet_scheduler_init(&packet_scheduler, packet_rate, packet_burst, esp_timer_get_time());
         while (1) {
             if (!is_wifi_connected()) {
                 printf("ERROR: wifi is not connected\n");
                 break;
             }
 
-            if (sendto(socket_fd, &data, strlen(data), 0, (const struct sockaddr *) &caddr, sizeof(caddr)) !=
-                strlen(data)) {
-                vTaskDelay(1);
-                continue;
+            _transmitter_wait(timer);
+            int64_t now_us = esp_timer_get_time();
+            for (uint32_t i = 0; i < packet_scheduler.burst; i++) {
+                uint8_t payload[PROBE_PAYLOAD_SIZE];
+                probe_payload_stamp(payload, probe_sequence++, esp_timer_get_time());
+                // not retried: a retry would only delay the following deadlines
+                if (sendto(socket_fd, payload, sizeof(payload), 0, (const struct sockaddr *) &caddr,
+                           sizeof(caddr)) != (ssize_t) sizeof(payload)) {
+                    packet_send_errors++;
+                }
             }
+            _transmitter_sent(now_us);
+        }
+    }
+}
 
-#ifdef CONFIG_PACKET_RATE
-            vTaskDelay(CONFIG_PACKET_RATE != 0 ? floor(1000 / CONFIG_PACKET_RATE) : 0);
-            ets_delay_us(((1000.0 / CONFIG_PACKET_RATE) - floor(1000 / CONFIG_PACKET_RATE)) * 1000);
-#else
-            vTaskDelay(10); // This limits TX to approximately 100 per second.
-#endif
+/*
+ * `RATE <packets per second>[:<burst>]`, within the limits of `CONFIG_PACKET_RATE` and `CONFIG_PACKET_BURST`.
+ * Without a burst the current one is kept.
+ */
+bool _transmitter_rate_command(const char *args, csi_format_buffer_t *reply) {
+    if (*args == '\0') {
+        csi_format_uint(reply, packet_rate);
+        csi_format_char(reply, ':');
+        csi_format_uint(reply, packet_burst);
+        return true;
+    }
+    const char *p = args;
+    uint32_t rate, burst = packet_burst;
+    bool ok = command_parse_uint(&p, 5000, &rate) && rate >= 1;
+    if (ok && *p == ':') {
+        p++;
+        ok = command_parse_uint(&p, 32, &burst) && burst >= 1;
+    }
+    if (!ok || *p != '\0') {
+        csi_format_str(reply, "expected <1-5000>[:<1-32>]");
+        return false;
+    }
+    packet_rate_requested.store(rate << 8 | burst);
+    if (packet_transmitter_handle != NULL) {
+        xTaskNotifyGive(packet_transmitter_handle);
+    }
+    return true;
+}
+
+void transmitter_register_command() {
+    command_register("RATE", &_transmitter_rate_command,
+                     "RATE [<packets per second>[:<burst>]]  shows or sets the transmit rate");
+}
+
+clock_sync_t clock_sync;
+
+/*
+ * `TIME_SYNC,<offset us>,<drift ppb>,<uncertainty us>,<min delay us>,<exchanges fitted>,<exchanges>,<rejected>,
+ *  <steps>`: the estimate of the server's clock, as the real time minus the steady clock.
+ */
+void _time_sync_print() {
+    const clock_sync_t *s = &clock_sync;
+    const clock_model_t *m = &s->model;
+    printf("TIME_SYNC,%lld,%lld,%u,%u,%d,%u,%u,%u\n", (long long) (m->remote_us - m->local_us),
+           (long long) ((m->drift_q32 * 1000000000) >> 32), m->uncertainty_us, s->min_delay_us, s->fitted,
+           s->exchanges, s->rejected, s->steps);
+}
+
+/*
+ * One request and its reply on `fd`, connected to the server. Updates the real time model if the exchange is used.
+ */
+void _time_sync_exchange(int fd, uint32_t sequence) {
+    uint8_t buf[CLOCK_SYNC_REPLY_SIZE + 1];
+    int64_t t1 = get_steady_clock_timestamp_us();
+    clock_sync_encode_request(buf, sequence, t1);
+    if (send(fd, buf, CLOCK_SYNC_REQUEST_SIZE, 0) != CLOCK_SYNC_REQUEST_SIZE) {
+        return;
+    }
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        int64_t t4 = get_steady_clock_timestamp_us();
+        if (n < 0) {
+            return;
+        }
+        clock_sync_message_t reply;
+        // a late reply to an earlier request is skipped
+        if (clock_sync_parse(buf, n, &reply) && reply.type == CLOCK_SYNC_REPLY && reply.sequence == sequence
+            && reply.t1 == t1) {
+            if (clock_sync_add(&clock_sync, t1, reply.t2, reply.t3, t4)) {
+                real_time_model_sync(&clock_sync.model, reply.flags & CLOCK_SYNC_FLAG_REAL_TIME_SET);
+            }
+            return;
+        }
+        if (t4 - t1 > TIME_SYNC_TIMEOUT_MS * 1000) {
+            return;
         }
     }
 }
+
+/*
+ * Keeps `real_timestamp` in sync with the clock of the server at `TIME_SYNC_HOST` (see `clock_sync_component.h`).
+ */
+void time_sync_client_loop(bool (*is_wifi_connected)()) {
+    clock_sync_init(&clock_sync);
+    uint32_t sequence = esp_random();
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TIME_SYNC_PORT);
+    if (inet_aton(TIME_SYNC_HOST, &addr.sin_addr) == 0) {
+        printf("ERROR: invalid clock sync host %s\n", TIME_SYNC_HOST);
+        return;
+    }
+
+    while (1) {
+        while (!is_wifi_connected()) {
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+        }
+        int fd = socket(PF_INET, SOCK_DGRAM, 0);
+        if (fd == -1) {
+            printf("ERROR: Socket creation error [%s]\n", strerror(errno));
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+        struct timeval timeout = {0, TIME_SYNC_TIMEOUT_MS * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, (const struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            while (is_wifi_connected()) {
+                _time_sync_exchange(fd, sequence++);
+                if (clock_sync.exchanges % TIME_SYNC_PRINT_EVERY == 0 && clock_sync.valid) {
+                    _time_sync_print();
+                }
+                vTaskDelay(TIME_SYNC_INTERVAL_MS / portTICK_PERIOD_MS);
+            }
+        }
+        close(fd);
+    }
+}
+
+/*
+ * Answers clock sync requests on `TIME_SYNC_PORT` with the real clock. Run it at a high priority: the time between
+ * a request arriving and this task stamping it counts as network delay, but only on the way there.
+ */
+void time_sync_server_loop() {
+    int fd = socket(PF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(TIME_SYNC_PORT);
+    if (fd == -1 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        printf("ERROR: cannot answer clock sync requests on port %d [%s]\n", TIME_SYNC_PORT, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    while (1) {
+        uint8_t request[CLOCK_SYNC_REQUEST_SIZE + 1];
+        uint8_t reply[CLOCK_SYNC_REPLY_SIZE];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, request, sizeof(request), 0, (struct sockaddr *) &from, &from_len);
+        int64_t t2 = get_real_clock_timestamp_us();
+        if (n <= 0) {
+            continue;
+        }
+        uint8_t flags = real_time_set.load() ? CLOCK_SYNC_FLAG_REAL_TIME_SET : 0;
+        size_t len = clock_sync_encode_reply(reply, request, n, t2, flags);
+        if (len == 0) {
+            continue;
+        }
+        clock_sync_stamp_reply(reply, get_real_clock_timestamp_us());
+        sendto(fd, reply, len, 0, (const struct sockaddr *) &from, from_len);
+    }
+}
+
+sta_session_table_t sta_sessions;
+// Guards `sta_sessions` between the WiFi event handler, `sta_poll_loop()` and the CSI writer task, which writes the
+// `STA_SESSION` records. `_wifi_csi_cb` only counts frames, which needs no lock.
+SemaphoreHandle_t sta_sessions_mutex = NULL;
+
+/*
+ * Starts the session table, before the WiFi event handler can report stations. Point `csi_sta_sessions` and
+ * `csi_sta_sessions_mutex` at it so the CSI frames of each station are counted and its records written.
+ */
+void sta_poll_init() {
+    sta_session_table_init(&sta_sessions, STA_POLL_TARGET_FPS, get_steady_clock_timestamp_us());
+    sta_sessions_mutex = xSemaphoreCreateMutex();
+}
+
+// For `WIFI_EVENT_AP_STACONNECTED`. False if there is no session left for the station.
+bool sta_poll_join(const uint8_t mac[6], uint16_t aid) {
+    xSemaphoreTake(sta_sessions_mutex, portMAX_DELAY);
+    bool joined = sta_session_join(&sta_sessions, mac, aid, get_steady_clock_timestamp_us());
+    xSemaphoreGive(sta_sessions_mutex);
+    return joined;
+}
+
+// For `WIFI_EVENT_AP_STADISCONNECTED`.
+void sta_poll_leave(const uint8_t mac[6]) {
+    xSemaphoreTake(sta_sessions_mutex, portMAX_DELAY);
+    sta_session_leave(&sta_sessions, mac);
+    xSemaphoreGive(sta_sessions_mutex);
+}
+
+/*
+ * Looks up the addresses DHCP handed out, which stations need before they can be solicited.
+ */
+void _sta_poll_addresses() {
+    wifi_sta_list_t wifi_list;
+    esp_netif_sta_list_t netif_list;
+    if (esp_wifi_ap_get_sta_list(&wifi_list) != ESP_OK || esp_netif_get_sta_list(&wifi_list, &netif_list) != ESP_OK) {
+        return;
+    }
+    xSemaphoreTake(sta_sessions_mutex, portMAX_DELAY);
+    for (int i = 0; i < netif_list.num; i++) {
+        sta_session_set_ip(&sta_sessions, netif_list.sta[i].mac, netif_list.sta[i].ip.addr);
+    }
+    xSemaphoreGive(sta_sessions_mutex);
+}
+
+/*
+ * Counts the CSI frames of each station of the AP and, with `STA_POLL_TARGET_FPS`, solicits frames from the quiet
+ * ones with ICMP echo requests so each of them yields that rate (see `sta_session_component.h`). Call
+ * `sta_poll_init()` first.
+ */
+void sta_poll_loop() {
+    int fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (fd == -1) {
+        printf("ERROR: cannot solicit frames from stations [%s]\n", strerror(errno));
+        return;
+    }
+    uint16_t sequence = 0;
+    int64_t addresses_us = 0;
+    while (1) {
+        int64_t now_us = get_steady_clock_timestamp_us();
+        if (now_us - addresses_us >= STA_POLL_ADDRESS_INTERVAL_MS * 1000) {
+            _sta_poll_addresses();
+            addresses_us = now_us;
+        }
+
+        // the addresses are copied out, so no event waits for the sends
+        sta_session_t *due[STA_SESSION_SLOTS];
+        uint32_t ips[STA_SESSION_SLOTS];
+        xSemaphoreTake(sta_sessions_mutex, portMAX_DELAY);
+        int n = sta_session_poll(&sta_sessions, now_us, due, STA_SESSION_SLOTS);
+        for (int i = 0; i < n; i++) {
+            ips[i] = due[i]->ip;
+        }
+        xSemaphoreGive(sta_sessions_mutex);
+        for (int i = 0; i < n; i++) {
+            uint8_t echo[STA_SESSION_ECHO_SIZE];
+            sta_session_encode_echo(echo, STA_POLL_ECHO_ID, sequence++);
+            struct sockaddr_in to;
+            memset(&to, 0, sizeof(to));
+            to.sin_family = AF_INET;
+            to.sin_addr.s_addr = ips[i];
+            sendto(fd, echo, sizeof(echo), 0, (const struct sockaddr *) &to, sizeof(to));
+        }
+        // the replies only matter as frames, which `_wifi_csi_cb` counted already
+        uint8_t reply[64];
+        while (recv(fd, reply, sizeof(reply), MSG_DONTWAIT) > 0) {
+        }
+        vTaskDelay(STA_POLL_TICK_MS / portTICK_PERIOD_MS);
+    }
+}
+
+#endif //ESP32_CSI_SOCKETS_COMPONENT_H
@@ -0,0 +1,273 @@
+#ifndef ESP32_CSI_STA_SESSION_COMPONENT_H
+#define ESP32_CSI_STA_SESSION_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#include "csi_format_component.h"
+#include "csi_filter_component.h"
+
+/*
+ * The stations connected to the active AP, and polling the quiet ones so every station yields about the same number
+ * of CSI frames per second however much traffic it sends on its own.
+ *
+ * Stations join and leave with the AP's `WIFI_EVENT_AP_STACONNECTED` / `STADISCONNECTED` events. `_wifi_csi_cb`
+ * counts the frames of each station (`sta_session_frame()`, lock free). Everything else happens in one task, which
+ * calls `sta_session_poll()` every tick:
+ *
+ *   credit         each station earns `target_fps` frames of credit per second and every frame it sent spends one,
+ *                  within `STA_SESSION_MAX_CREDIT` frames either way, so neither a burst nor a quiet spell carries
+ *                  over for long
+ *   solicitation   a station with a whole frame of credit which its own traffic left unused, and which is not already
+ *                  waiting for that many solicitations, is sent one (an ICMP echo request: the reply is a frame, and so
+ *                  CSI, from the station). Stations are visited round-robin from where the previous tick stopped, so
+ *                  a limit per tick is shared evenly. A solicitation unanswered for `STA_SESSION_REPLY_TIMEOUT_US` is
+ *                  given up.
+ *
+ * Stations which send more than the target are not slowed down here, the per-MAC rate limit
+ * (`csi_rate_limit_component.h`) does that. With both at the same rate every station yields the target rate.
+ *
+ * The polling task and the WiFi events are in `sockets_component.h` and `active_ap`.
+ */
+
+// `MAX_STA_CONN` of the AP
+#define STA_SESSION_SLOTS 16
+#define STA_SESSION_MAX_CREDIT 4
+#define STA_SESSION_MAX_PENDING 4
+#define STA_SESSION_REPLY_TIMEOUT_US 50000
+// credit is kept in millionths of a frame, so a second of `target_fps` is exact
+#define STA_SESSION_FRAME 1000000
+
+#define STA_SESSION_ECHO_SIZE 16
+
+typedef struct {
+    // MAC as in `csi_filter_component.h`, 0 for a free slot. Atomic because `_wifi_csi_cb` looks stations up.
+    std::atomic<uint64_t> key;
+    // counted by `_wifi_csi_cb`, taken by `sta_session_poll()`
+    std::atomic<uint32_t> frames;
+
+    uint8_t mac[6];
+    uint16_t aid;
+    // IPv4 address in network byte order, 0 until known: only then can the station be solicited
+    uint32_t ip;
+    int64_t joined_us;
+    int64_t credit;
+    // solicitations not answered yet, and when they were sent (oldest first)
+    uint32_t pending;
+    int64_t solicited_us[STA_SESSION_MAX_PENDING];
+
+    // since the last `sta_session_format()`
+    int64_t interval_start_us;
+    uint32_t interval_frames;
+    uint32_t interval_solicited;
+    uint32_t interval_unanswered;
+} sta_session_t;
+
+typedef struct {
+    sta_session_t sessions[STA_SESSION_SLOTS];
+    // 0 to only count frames
+    uint32_t target_fps;
+    int64_t last_poll_us;
+    // the slot the next round-robin visit starts at
+    int next;
+    uint32_t rejected_joins;
+} sta_session_table_t;
+
+void sta_session_table_init(sta_session_table_t *t, uint32_t target_fps, int64_t now_us) {
+    for (int i = 0; i < STA_SESSION_SLOTS; i++) {
+        t->sessions[i].key.store(0);
+        t->sessions[i].frames.store(0);
+    }
+    t->target_fps = target_fps;
+    t->last_poll_us = now_us;
+    t->next = 0;
+    t->rejected_joins = 0;
+}
+
+sta_session_t *sta_session_find(sta_session_table_t *t, const uint8_t mac[6]) {
+    uint64_t key = _csi_filter_key(mac);
+    for (int i = 0; i < STA_SESSION_SLOTS; i++) {
+        if (t->sessions[i].key.load(std::memory_order_relaxed) == key) {
+            return &t->sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * A station joined (or joined again, with a new AID). False if every slot is taken.
+ */
+bool sta_session_join(sta_session_table_t *t, const uint8_t mac[6], uint16_t aid, int64_t now_us) {
+    sta_session_t *s = sta_session_find(t, mac);
+    if (s == NULL) {
+        for (int i = 0; i < STA_SESSION_SLOTS && s == NULL; i++) {
+            if (t->sessions[i].key.load(std::memory_order_relaxed) == 0) {
+                s = &t->sessions[i];
+            }
+        }
+        if (s == NULL) {
+            t->rejected_joins++;
+            return false;
+        }
+        s->ip = 0;
+    }
+    memcpy(s->mac, mac, 6);
+    s->aid = aid;
+    s->joined_us = now_us;
+    s->credit = 0;
+    s->pending = 0;
+    s->interval_start_us = now_us;
+    s->interval_frames = 0;
+    s->interval_solicited = 0;
+    s->interval_unanswered = 0;
+    s->frames.store(0, std::memory_order_relaxed);
+    // the key last, so the callback only counts into a slot which is ready
+    s->key.store(_csi_filter_key(mac), std::memory_order_release);
+    return true;
+}
+
+/*
+ * A station left. False if it was not in the table.
+ */
+bool sta_session_leave(sta_session_table_t *t, const uint8_t mac[6]) {
+    sta_session_t *s = sta_session_find(t, mac);
+    if (s == NULL) {
+        return false;
+    }
+    s->key.store(0, std::memory_order_release);
+    return true;
+}
+
+void sta_session_set_ip(sta_session_table_t *t, const uint8_t mac[6], uint32_t ip) {
+    sta_session_t *s = sta_session_find(t, mac);
+    if (s != NULL) {
+        s->ip = ip;
+    }
+}
+
+/*
+ * Counts a frame from `mac`, if it is a station. Called from `_wifi_csi_cb`.
+ */
+void sta_session_frame(sta_session_table_t *t, const uint8_t mac[6]) {
+    sta_session_t *s = sta_session_find(t, mac);
+    if (s != NULL) {
+        s->frames.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Settles the credit of every station and picks (at most `max`) stations to solicit now, into `due`. The caller sends
+ * each of them a solicitation. Returns how many were picked.
+ */
+int sta_session_poll(sta_session_table_t *t, int64_t now_us, sta_session_t **due, int max) {
+    int64_t elapsed_us = now_us - t->last_poll_us;
+    t->last_poll_us = now_us;
+    int64_t max_credit = (int64_t) STA_SESSION_MAX_CREDIT * STA_SESSION_FRAME;
+    for (int i = 0; i < STA_SESSION_SLOTS; i++) {
+        sta_session_t *s = &t->sessions[i];
+        if (s->key.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        uint32_t frames = s->frames.exchange(0, std::memory_order_relaxed);
+        s->interval_frames += frames;
+        // frames cannot be told apart from answers, so any frame answers the oldest solicitation
+        uint32_t answered = frames < s->pending ? frames : s->pending;
+        while (answered < s->pending && now_us - s->solicited_us[answered] > STA_SESSION_REPLY_TIMEOUT_US) {
+            s->interval_unanswered++;
+            answered++;
+        }
+        s->pending -= answered;
+        memmove(s->solicited_us, s->solicited_us + answered, s->pending * sizeof(int64_t));
+        // what is still solicited does not count against the limit, so a lost answer is solicited again
+        int64_t limit = max_credit + (int64_t) s->pending * STA_SESSION_FRAME;
+        s->credit += (int64_t) t->target_fps * elapsed_us - (int64_t) frames * STA_SESSION_FRAME;
+        s->credit = s->credit > limit ? limit : (s->credit < -max_credit ? -max_credit : s->credit);
+    }
+    if (t->target_fps == 0) {
+        return 0;
+    }
+
+    int picked = 0;
+    for (int visited = 0; visited < STA_SESSION_SLOTS && picked < max; visited++) {
+        sta_session_t *s = &t->sessions[t->next];
+        t->next = (t->next + 1) % STA_SESSION_SLOTS;
+        if (s->key.load(std::memory_order_relaxed) == 0 || s->ip == 0 || s->pending >= STA_SESSION_MAX_PENDING
+            || s->credit - (int64_t) s->pending * STA_SESSION_FRAME < STA_SESSION_FRAME) {
+            continue;
+        }
+        s->solicited_us[s->pending++] = now_us;
+        s->interval_solicited++;
+        due[picked++] = s;
+    }
+    return picked;
+}
+
+/*
+ * `STA_SESSION,<role>,<mac>,<aid>,<ip>,<interval ms>,<frames>,<solicited>,<unanswered>` line for `s`, counting from
+ * the previous line (or the join). Starts the next interval.
+ */
+void sta_session_format(csi_format_buffer_t *b, const char *role, sta_session_t *s, int64_t now_us) {
+    csi_format_reset(b);
+    csi_format_str(b, "STA_SESSION,");
+    csi_format_str(b, role);
+    csi_format_char(b, ',');
+    csi_format_mac(b, s->mac);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->aid);
+    csi_format_char(b, ',');
+    const uint8_t *ip = (const uint8_t *) &s->ip;
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+            csi_format_char(b, '.');
+        }
+        csi_format_uint(b, ip[i]);
+    }
+    csi_format_char(b, ',');
+    csi_format_uint(b, (uint64_t) (now_us - s->interval_start_us) / 1000);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->interval_frames);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->interval_solicited);
+    csi_format_char(b, ',');
+    csi_format_uint(b, s->interval_unanswered);
+    csi_format_char(b, '\n');
+    s->interval_start_us = now_us;
+    s->interval_frames = 0;
+    s->interval_solicited = 0;
+    s->interval_unanswered = 0;
+}
+
+uint16_t _sta_session_checksum(const uint8_t *p, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        sum += (uint32_t) p[i] << 8 | p[i + 1];
+    }
+    if (len % 2 != 0) {
+        sum += (uint32_t) p[len - 1] << 8;
+    }
+    while (sum > 0xFFFF) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t) ~sum;
+}
+
+/*
+ * The ICMP echo request used as a solicitation (`STA_SESSION_ECHO_SIZE` bytes, without the IP header, as sent on a raw
+ * socket). Any IP stack answers it, not only an active_sta.
+ */
+void sta_session_encode_echo(uint8_t *out, uint16_t id, uint16_t sequence) {
+    memset(out, 0, STA_SESSION_ECHO_SIZE);
+    out[0] = 8;
+    out[4] = (uint8_t) (id >> 8);
+    out[5] = (uint8_t) id;
+    out[6] = (uint8_t) (sequence >> 8);
+    out[7] = (uint8_t) sequence;
+    memcpy(out + 8, "CSI_POLL", 8);
+    uint16_t checksum = _sta_session_checksum(out, STA_SESSION_ECHO_SIZE);
+    out[2] = (uint8_t) (checksum >> 8);
+    out[3] = (uint8_t) checksum;
+}
+
+#endif //ESP32_CSI_STA_SESSION_COMPONENT_H
@@ -1,22 +1,129 @@
 #ifndef ESP32_CSI_TIME_COMPONENT_H
 #define ESP32_CSI_TIME_COMPONENT_H
 
-#include <chrono>
+#include <atomic>
+#include <sys/time.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "clock_sync_component.h"
+
+/*
+ * Timestamps are integer microseconds: a double holding the seconds of a current epoch time only keeps about
+ * a quarter of a microsecond, and whatever prints it usually keeps far less.
+ *
+ * The real time is kept as a model of the steady clock (`clock_model_t`), so a frame gets both timestamps from a single
+ * clock read. `time_set()` sets an offset, clock sync (`clock_sync_component.h`) an offset, a drift and a bound on the
+ * error. Until either runs real timestamps are the time since boot.
+ *
+ * A local `time_set()` (`SETTIME`) takes priority over clock sync: once the time was set here, exchanges with the
+ * clock sync server no longer change it until the next reboot.
+ */
 
 static char *SET_TIMESTAMP_SIMPLE_TEMPLATE = (char *) "%li.%li";
 static char *SET_TIMESTAMP_TEMPLATE = (char *) "SETTIME: %li.%li";
 
-bool real_time_set = false;
+// false while real timestamps are the time since boot (of this node, or of a clock sync server whose time was not set)
+std::atomic<bool> real_time_set(false);
+// set by `time_set()`, after which clock sync leaves the model alone
+bool real_time_set_locally = false;
 
-bool match_set_timestamp_template(char *candidate_string) {
-    long int tv_sec;
-    long int tv_usec;
-    return sscanf(candidate_string, SET_TIMESTAMP_TEMPLATE, &tv_sec, &tv_usec) > 0;
+// Both writers, the input task (`time_set()`) and the clock sync task, fill the slot not in use and then switch to
+// it under `real_time_mutex`, so readers never see half a model.
+clock_model_t real_time_models[2] = {};
+std::atomic<int> real_time_model_index(0);
+std::atomic<uint32_t> real_time_model_readers[2];
+SemaphoreHandle_t real_time_mutex = NULL;
+
+/*
+ * Before any task can set the time.
+ */
+void time_init() {
+    real_time_mutex = xSemaphoreCreateMutex();
+}
+
+int64_t get_steady_clock_timestamp_us() {
+    // the same clock as std::chrono::steady_clock, without going through newlib's clock_gettime()
+    return esp_timer_get_time();
+}
+
+/*
+ * The slot in use, held until `_real_time_model_release()`.
+ */
+int _real_time_model_acquire() {
+    int i;
+    while (true) {
+        i = real_time_model_index.load();
+        real_time_model_readers[i].fetch_add(1);
+        // the slots may have been switched between the two lines above, in which case a writer may be filling it
+        if (real_time_model_index.load() == i) {
+            return i;
+        }
+        real_time_model_readers[i].fetch_sub(1);
+    }
+}
+
+void _real_time_model_release(int i) {
+    real_time_model_readers[i].fetch_sub(1);
+}
+
+/*
+ * The real time at `steady_us`, a timestamp taken with `get_steady_clock_timestamp_us()`.
+ */
+int64_t get_real_clock_timestamp_us(int64_t steady_us) {
+    int i = _real_time_model_acquire();
+    int64_t real_us = clock_model_remote_us(&real_time_models[i], steady_us);
+    _real_time_model_release(i);
+    return real_us;
+}
+
+/*
+ * The real time at `steady_us`, and a bound on its error (0 if unknown).
+ */
+void get_real_clock_timestamp_us(int64_t steady_us, int64_t *real_us, uint32_t *uncertainty_us) {
+    int i = _real_time_model_acquire();
+    *real_us = clock_model_remote_us(&real_time_models[i], steady_us);
+    *uncertainty_us = clock_model_uncertainty_us(&real_time_models[i], steady_us);
+    _real_time_model_release(i);
+}
+
+int64_t get_real_clock_timestamp_us() {
+    return get_real_clock_timestamp_us(get_steady_clock_timestamp_us());
+}
+
+/*
+ * Call with `real_time_mutex` held. `set` is false for a model of a clock counting from boot.
+ */
+void _real_time_model_set(const clock_model_t *model, bool set) {
+    int next = 1 - real_time_model_index.load();
+    // Readers still on the slot switched away from last time are in the middle of a single conversion. The Wi-Fi
+    // driver task has a higher priority than either writer, so they are never stuck behind this loop.
+    while (real_time_model_readers[next].load() != 0) {
+    }
+    real_time_models[next] = *model;
+    real_time_model_index.store(next);
+    real_time_set.store(set);
+}
+
+/*
+ * For clock sync: `set` tells whether the server's real time was set. False, without changing anything, once the
+ * time was set locally.
+ */
+bool real_time_model_sync(const clock_model_t *model, bool set) {
+    xSemaphoreTake(real_time_mutex, portMAX_DELAY);
+    bool applied = !real_time_set_locally;
+    if (applied) {
+        _real_time_model_set(model, set);
+    }
+    xSemaphoreGive(real_time_mutex);
+    return applied;
 }
 
 void time_set(char *timestamp_string) {
     long int tv_sec;
-    long int tv_usec;
+    long int tv_usec = 0;
 
     int res = sscanf(timestamp_string, SET_TIMESTAMP_TEMPLATE, &tv_sec, &tv_usec);
     if (res <= 0) {
@@ -25,19 +132,16 @@ void time_set(char *timestamp_string) {
 
     if (res > 0) {
         struct timeval now = {.tv_sec = tv_sec, .tv_usec = tv_usec};
+        int64_t steady_us = get_steady_clock_timestamp_us();
         settimeofday(&now, NULL);
-        real_time_set = true;
-    }
-}
 
-double get_system_clock_timestamp() {
-    // returns timestamp in seconds (with decimal places)
-    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
-}
-
-double get_steady_clock_timestamp() {
-    // returns timestamp in seconds (with decimal places)
-    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 1000000.0;
+        clock_model_t model;
+        clock_model_set(&model, steady_us, (int64_t) tv_sec * 1000000 + tv_usec);
+        xSemaphoreTake(real_time_mutex, portMAX_DELAY);
+        real_time_set_locally = true;
+        _real_time_model_set(&model, true);
+        xSemaphoreGive(real_time_mutex);
+    }
 }
 
 #endif //ESP32_CSI_TIME_COMPONENT_H
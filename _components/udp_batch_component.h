@@ -0,0 +1,110 @@
+#ifndef ESP32_CSI_UDP_BATCH_COMPONENT_H
+#define ESP32_CSI_UDP_BATCH_COMPONENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "csi_binary_component.h"
+
+/*
+ * Packs binary CSI records (`csi_binary_component.h`) into UDP datagrams of at most one MTU.
+ *
+ * Datagram layout (all integers little endian):
+ *
+ *   magic (0xC5 0x1E) | version (u8) | reserved (u8) | session (u32) | sequence (u32) | record count (u16)
+ *   | reserved (u16) | records
+ *
+ * `session` is picked at random on boot, `sequence` counts datagrams within a session (including ones which could
+ * not be sent), so a collector can tell lost and reordered datagrams from a device restart.
+ * Records are never split across datagrams.
+ */
+
+#define UDP_BATCH_MAGIC_0 0xC5
+#define UDP_BATCH_MAGIC_1 0x1E
+#define UDP_BATCH_VERSION 1
+#define UDP_BATCH_HEADER_SIZE 16
+
+// 1500 byte Wi-Fi/Ethernet MTU minus the IPv4 and UDP headers, so datagrams are never fragmented
+#ifndef UDP_BATCH_MAX_SIZE
+#define UDP_BATCH_MAX_SIZE 1472
+#endif
+
+static_assert(UDP_BATCH_MAX_SIZE >= UDP_BATCH_HEADER_SIZE + CSI_BINARY_MAX_RECORD_SIZE,
+              "every record must fit into a datagram on its own");
+
+typedef struct {
+    uint8_t data[UDP_BATCH_MAX_SIZE];
+    size_t len;
+    uint16_t records;
+    uint32_t session;
+    uint32_t sequence;
+} udp_batch_t;
+
+typedef struct {
+    uint32_t session;
+    uint32_t sequence;
+    uint16_t records;
+    const uint8_t *payload;
+    size_t payload_len;
+} udp_batch_header_t;
+
+void udp_batch_init(udp_batch_t *b, uint32_t session) {
+    b->len = UDP_BATCH_HEADER_SIZE;
+    b->records = 0;
+    b->session = session;
+    b->sequence = 0;
+}
+
+/*
+ * Appends one record. Returns false (and appends nothing) if it does not fit into the current datagram.
+ */
+bool udp_batch_add(udp_batch_t *b, const void *record, size_t len) {
+    if (len > UDP_BATCH_MAX_SIZE - b->len) {
+        return false;
+    }
+    memcpy(b->data + b->len, record, len);
+    b->len += len;
+    b->records++;
+    return true;
+}
+
+/*
+ * Fills in the header. The datagram is then `b->data[0 .. b->len)`.
+ */
+size_t udp_batch_finish(udp_batch_t *b) {
+    uint8_t *p = b->data;
+    p[0] = UDP_BATCH_MAGIC_0;
+    p[1] = UDP_BATCH_MAGIC_1;
+    p[2] = UDP_BATCH_VERSION;
+    p[3] = 0;
+    _csi_binary_put_u32(p + 4, b->session);
+    _csi_binary_put_u32(p + 8, b->sequence);
+    _csi_binary_put_u16(p + 12, b->records);
+    _csi_binary_put_u16(p + 14, 0);
+    return b->len;
+}
+
+/*
+ * Starts the next (empty) datagram.
+ */
+void udp_batch_next(udp_batch_t *b) {
+    b->len = UDP_BATCH_HEADER_SIZE;
+    b->records = 0;
+    b->sequence++;
+}
+
+bool udp_batch_parse_header(const uint8_t *datagram, size_t len, udp_batch_header_t *out) {
+    if (len < UDP_BATCH_HEADER_SIZE || datagram[0] != UDP_BATCH_MAGIC_0 || datagram[1] != UDP_BATCH_MAGIC_1
+        || datagram[2] != UDP_BATCH_VERSION) {
+        return false;
+    }
+    out->session = _csi_binary_get_u32(datagram + 4);
+    out->sequence = _csi_binary_get_u32(datagram + 8);
+    out->records = _csi_binary_get_u16(datagram + 12);
+    out->payload = datagram + UDP_BATCH_HEADER_SIZE;
+    out->payload_len = len - UDP_BATCH_HEADER_SIZE;
+    return true;
+}
+
+#endif //ESP32_CSI_UDP_BATCH_COMPONENT_H
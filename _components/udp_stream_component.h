@@ -0,0 +1,87 @@
+#ifndef ESP32_CSI_UDP_STREAM_COMPONENT_H
+#define ESP32_CSI_UDP_STREAM_COMPONENT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "esp_system.h"
+
+#include "udp_batch_component.h"
+
+/*
+ * Streams binary CSI records to `CONFIG_UDP_STREAM_HOST:CONFIG_UDP_STREAM_PORT`, many records per datagram.
+ * Received with `cpp_utils/csi_udp_collector.cc`.
+ *
+ * Only called from the CSI writer task, so `udp_stream_batch` needs no locking.
+ */
+
+// a part filled datagram is sent once it is this old (checked whenever the CSI writer task runs)
+#define UDP_STREAM_MAX_DELAY_US 20000
+
+int udp_stream_fd = -1;
+struct sockaddr_in udp_stream_addr;
+udp_batch_t udp_stream_batch;
+int64_t udp_stream_batch_started_us = 0;
+uint32_t udp_stream_send_errors = 0;
+
+void udp_stream_init() {
+    memset(&udp_stream_addr, 0, sizeof(udp_stream_addr));
+    udp_stream_addr.sin_family = AF_INET;
+    udp_stream_addr.sin_port = htons(CONFIG_UDP_STREAM_PORT);
+    if (inet_aton(CONFIG_UDP_STREAM_HOST, &udp_stream_addr.sin_addr) == 0) {
+        printf("ERROR: invalid UDP stream host %s\n", CONFIG_UDP_STREAM_HOST);
+        return;
+    }
+
+    udp_stream_fd = socket(PF_INET, SOCK_DGRAM, 0);
+    if (udp_stream_fd == -1) {
+        printf("ERROR: Socket creation error [%s]\n", strerror(errno));
+        return;
+    }
+    udp_batch_init(&udp_stream_batch, esp_random());
+}
+
+void _udp_stream_send() {
+    if (udp_stream_batch.records == 0) {
+        return;
+    }
+    size_t len = udp_batch_finish(&udp_stream_batch);
+    // not retried: the collector sees the missing sequence number instead
+    if (sendto(udp_stream_fd, udp_stream_batch.data, len, 0, (const struct sockaddr *) &udp_stream_addr,
+               sizeof(udp_stream_addr)) != (ssize_t) len) {
+        udp_stream_send_errors++;
+    }
+    udp_batch_next(&udp_stream_batch);
+}
+
+/*
+ * Queues one binary record, sending the current datagram first if it is full.
+ */
+void udp_stream_write(const void *record, size_t len, int64_t now_us) {
+    if (udp_stream_fd < 0) {
+        return;
+    }
+    if (!udp_batch_add(&udp_stream_batch, record, len)) {
+        _udp_stream_send();
+        udp_batch_add(&udp_stream_batch, record, len);
+    }
+    if (udp_stream_batch.records == 1) {
+        udp_stream_batch_started_us = now_us;
+    }
+}
+
+/*
+ * Sends a part filled datagram once it has waited long enough.
+ */
+void udp_stream_poll(int64_t now_us) {
+    if (udp_stream_fd >= 0 && udp_stream_batch.records > 0
+        && now_us - udp_stream_batch_started_us >= UDP_STREAM_MAX_DELAY_US) {
+        _udp_stream_send();
+    }
+}
+
+#endif //ESP32_CSI_UDP_STREAM_COMPONENT_H
@@ -60,6 +60,24 @@
 #define SEND_CSI_TO_SD 0
 #endif
 
+#ifdef CONFIG_SEND_CSI_TO_UDP
+#define SEND_CSI_TO_UDP 1
+#else
+#define SEND_CSI_TO_UDP 0
+#endif
+
+#ifdef CONFIG_CSI_PROBE_TAGS
+#define CSI_PROBE_TAGS 1
+#else
+#define CSI_PROBE_TAGS 0
+#endif
+
+#ifdef CONFIG_TIME_SYNC_SERVER
+#define TIME_SYNC_SERVER 1
+#else
+#define TIME_SYNC_SERVER 0
+#endif
+
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
 
@@ -70,10 +88,14 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
         wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data;
         ESP_LOGI(TAG, "station " MACSTR " join, AID=%d",
                  MAC2STR(event->mac), event->aid);
+        if (!sta_poll_join(event->mac, event->aid)) {
+            ESP_LOGE(TAG, "no session left for station " MACSTR, MAC2STR(event->mac));
+        }
     } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
         wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data;
         ESP_LOGI(TAG, "station " MACSTR " leave, AID=%d",
                  MAC2STR(event->mac), event->aid);
+        sta_poll_leave(event->mac);
     }
 }
 
@@ -87,6 +109,9 @@ void softap_init() {
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
+    sta_poll_init();
+    csi_sta_sessions = &sta_sessions;
+    csi_sta_sessions_mutex = sta_sessions_mutex;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &wifi_event_handler,
@@ -115,9 +140,28 @@ void softap_init() {
 
     esp_wifi_set_ps(WIFI_PS_NONE);
 
+#if CSI_PROBE_TAGS
+    // the AP keeps working normally, promiscuous mode only adds a copy of every frame for `_wifi_probe_cb`
+    const wifi_promiscuous_filter_t filt = {
+            .filter_mask = WIFI_PROMIS_FILTER_MASK_DATA | WIFI_PROMIS_FILTER_MASK_MGMT
+    };
+    esp_wifi_set_promiscuous_filter(&filt);
+    esp_wifi_set_promiscuous(true);
+#endif
+
     ESP_LOGI(TAG, "softap_init finished. SSID:%s password:%s", ESP_WIFI_SSID, ESP_WIFI_PASS);
 }
 
+void vTask_time_sync_server_loop(void *pvParameters) {
+    time_sync_server_loop();
+    vTaskDelete(NULL);
+}
+
+void vTask_sta_poll_loop(void *pvParameters) {
+    sta_poll_loop();
+    vTaskDelete(NULL);
+}
+
 void config_print() {
     printf("\n\n\n\n\n\n\n\n");
     printf("-----------------------\n");
@@ -133,14 +177,34 @@ void config_print() {
     printf("ESP_WIFI_PASSWORD: %s\n", ESP_WIFI_PASS);
     printf("SHOULD_COLLECT_CSI: %d\n", SHOULD_COLLECT_CSI);
     printf("SHOULD_COLLECT_ONLY_LLTF: %d\n", SHOULD_COLLECT_ONLY_LLTF);
+    printf("CSI_COLLECT_SEGMENTS: %d\n", CSI_COLLECT_SEGMENTS);
     printf("SEND_CSI_TO_SERIAL: %d\n", SEND_CSI_TO_SERIAL);
     printf("SEND_CSI_TO_SD: %d\n", SEND_CSI_TO_SD);
+    printf("CSI_STATS_INTERVAL_MS: %u\n", (unsigned) csi_stats_interval_ms);
+    printf("CSI_FILTER_RULES: %s\n", CSI_FILTER_RULES);
+    printf("CSI_RATE_LIMIT_FPS: %d\n", CSI_RATE_LIMIT_FPS);
+    printf("CSI_RATE_LIMIT_BURST: %d\n", CSI_RATE_LIMIT_BURST);
+    printf("CSI_DECIMATE: %d/%d\n", CSI_DECIMATE_KEEP, CSI_DECIMATE_EVERY);
+    printf("CSI_FEATURES: %d\n", CSI_FEATURES_MODE);
+    printf("CSI_FEATURES_GROUP: %d\n", CSI_FEATURES_GROUP);
+    printf("CSI_FEATURES_SUMMARY_MS: %d\n", CSI_FEATURES_SUMMARY_MS);
+    printf("CSI_FEATURES_MOTION_THRESHOLD_PPM: %d\n", CSI_FEATURES_MOTION_THRESHOLD_PPM);
+    printf("CSI_BINARY_DELTA: %d (keyframe every %d)\n", CSI_BINARY_DELTA, CSI_DELTA_KEYFRAME_EVERY);
+    printf("CSI_PROBE_TAGS: %d\n", CSI_PROBE_TAGS);
+    printf("SEND_CSI_TO_UDP: %d\n", SEND_CSI_TO_UDP);
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    printf("UDP_STREAM: %s:%d\n", CONFIG_UDP_STREAM_HOST, CONFIG_UDP_STREAM_PORT);
+#endif
+    printf("TIME_SYNC_SERVER: %d (port %d)\n", TIME_SYNC_SERVER, TIME_SYNC_PORT);
+    printf("STA_POLL_TARGET_FPS: %d\n", STA_POLL_TARGET_FPS);
+    printf("STA_POLL_STATS_INTERVAL_S: %d\n", STA_POLL_STATS_INTERVAL_S);
     printf("-----------------------\n");
     printf("\n\n\n\n\n\n\n\n");
 }
 
 extern "C" void app_main() {
     config_print();
+    time_init();
     nvs_init();
     sd_init();
     softap_init();
@@ -150,4 +214,11 @@ extern "C" void app_main() {
 #endif
 
     csi_init((char *) "AP");
+#if TIME_SYNC_SERVER
+    xTaskCreatePinnedToCore(&vTask_time_sync_server_loop, "time_sync_server", TIME_SYNC_TASK_STACK_SIZE, NULL,
+                            TIME_SYNC_TASK_PRIORITY, NULL, TIME_SYNC_TASK_CORE);
+#endif
+    xTaskCreatePinnedToCore(&vTask_sta_poll_loop, "sta_poll", STA_POLL_TASK_STACK_SIZE, NULL, STA_POLL_TASK_PRIORITY,
+                            NULL, STA_POLL_TASK_CORE);
+    input_loop();
 }
@@ -19,6 +19,7 @@
 #include "../../_components/time_component.h"
 #include "../../_components/input_component.h"
 #include "../../_components/sockets_component.h"
+#include "../../_components/injection_component.h"
 
 /*
  * The examples use WiFi configuration that you can set via 'idf.py menuconfig'.
@@ -59,6 +60,20 @@
 #define SEND_CSI_TO_SD 0
 #endif
 
+#ifdef CONFIG_SEND_CSI_TO_UDP
+#define SEND_CSI_TO_UDP 1
+#else
+#define SEND_CSI_TO_UDP 0
+#endif
+
+#if CONFIG_PACKET_TX_RAW_DATA
+#define PACKET_TX_METHOD "RAW_DATA"
+#elif CONFIG_PACKET_TX_RAW_ACTION
+#define PACKET_TX_METHOD "RAW_ACTION"
+#else
+#define PACKET_TX_METHOD "UDP"
+#endif
+
 /* FreeRTOS event group to signal when we are connected*/
 static EventGroupHandle_t s_wifi_event_group;
 
@@ -94,7 +109,12 @@ esp_err_t esp_wifi_80211_tx(wifi_interface_t ifx, const void *buffer, int len, b
 static void event_handler(void* arg, esp_event_base_t event_base,
                           int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+#if CONFIG_PACKET_TX_RAW_ACTION
+        // broadcast frames need no AP; connecting would scan other channels
+        ESP_ERROR_CHECK(esp_wifi_set_channel(WIFI_CHANNEL, WIFI_SECOND_CHAN_NONE));
+#else
         esp_wifi_connect();
+#endif
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         ESP_LOGI(TAG, "Retry connecting to the AP");
         esp_wifi_connect();
@@ -156,10 +176,19 @@ TaskHandle_t xHandle = NULL;
 
 void vTask_socket_transmitter_sta_loop(void *pvParameters) {
     for (;;) {
+#if CONFIG_PACKET_TX_RAW_DATA || CONFIG_PACKET_TX_RAW_ACTION
+        injection_transmitter_sta_loop(&is_wifi_connected);
+#else
         socket_transmitter_sta_loop(&is_wifi_connected);
+#endif
     }
 }
 
+void vTask_time_sync_loop(void *pvParameters) {
+    time_sync_client_loop(&is_wifi_connected);
+    vTaskDelete(NULL);
+}
+
 void config_print() {
     printf("\n\n\n\n\n\n\n\n");
     printf("-----------------------\n");
@@ -174,16 +203,36 @@ void config_print() {
     printf("ESP_WIFI_SSID: %s\n", ESP_WIFI_SSID);
     printf("ESP_WIFI_PASSWORD: %s\n", ESP_WIFI_PASS);
     printf("PACKET_RATE: %i\n", CONFIG_PACKET_RATE);
+    printf("PACKET_BURST: %i\n", PACKET_BURST);
+    printf("PACKET_TX_METHOD: %s\n", PACKET_TX_METHOD);
     printf("SHOULD_COLLECT_CSI: %d\n", SHOULD_COLLECT_CSI);
     printf("SHOULD_COLLECT_ONLY_LLTF: %d\n", SHOULD_COLLECT_ONLY_LLTF);
+    printf("CSI_COLLECT_SEGMENTS: %d\n", CSI_COLLECT_SEGMENTS);
     printf("SEND_CSI_TO_SERIAL: %d\n", SEND_CSI_TO_SERIAL);
     printf("SEND_CSI_TO_SD: %d\n", SEND_CSI_TO_SD);
+    printf("CSI_STATS_INTERVAL_MS: %u\n", (unsigned) csi_stats_interval_ms);
+    printf("CSI_FILTER_RULES: %s\n", CSI_FILTER_RULES);
+    printf("CSI_RATE_LIMIT_FPS: %d\n", CSI_RATE_LIMIT_FPS);
+    printf("CSI_RATE_LIMIT_BURST: %d\n", CSI_RATE_LIMIT_BURST);
+    printf("CSI_DECIMATE: %d/%d\n", CSI_DECIMATE_KEEP, CSI_DECIMATE_EVERY);
+    printf("CSI_FEATURES: %d\n", CSI_FEATURES_MODE);
+    printf("CSI_FEATURES_GROUP: %d\n", CSI_FEATURES_GROUP);
+    printf("CSI_FEATURES_SUMMARY_MS: %d\n", CSI_FEATURES_SUMMARY_MS);
+    printf("CSI_FEATURES_MOTION_THRESHOLD_PPM: %d\n", CSI_FEATURES_MOTION_THRESHOLD_PPM);
+    printf("CSI_BINARY_DELTA: %d (keyframe every %d)\n", CSI_BINARY_DELTA, CSI_DELTA_KEYFRAME_EVERY);
+    printf("SEND_CSI_TO_UDP: %d\n", SEND_CSI_TO_UDP);
+#ifdef CONFIG_SEND_CSI_TO_UDP
+    printf("UDP_STREAM: %s:%d\n", CONFIG_UDP_STREAM_HOST, CONFIG_UDP_STREAM_PORT);
+#endif
+    printf("TIME_SYNC_INTERVAL_MS: %d\n", TIME_SYNC_INTERVAL_MS);
+    printf("TIME_SYNC_SERVER: %s:%d\n", TIME_SYNC_HOST, TIME_SYNC_PORT);
     printf("-----------------------\n");
     printf("\n\n\n\n\n\n\n\n");
 }
 
 extern "C" void app_main() {
     config_print();
+    time_init();
     nvs_init();
     sd_init();
     station_init();
@@ -195,4 +244,11 @@ extern "C" void app_main() {
 
     xTaskCreatePinnedToCore(&vTask_socket_transmitter_sta_loop, "socket_transmitter_sta_loop",
                             10000, (void *) &is_wifi_connected, 100, &xHandle, 1);
+#if TIME_SYNC_INTERVAL_MS > 0
+    xTaskCreatePinnedToCore(&vTask_time_sync_loop, "time_sync_loop", TIME_SYNC_TASK_STACK_SIZE, NULL,
+                            TIME_SYNC_TASK_PRIORITY, NULL, TIME_SYNC_TASK_CORE);
+#endif
+
+    transmitter_register_command();
+    input_loop();
 }
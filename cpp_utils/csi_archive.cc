@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../_components/csi_format_component.h"
+#include "csi_log_parser.h"
+#include "csi_archive.h"
+
+//
+// Imports CSI CSV captures into an indexed archive (see `csi_archive.h`) and answers time range and MAC queries on
+// it, printing the matching rows as CSV (`CSI_CSV_HEADER`, whichever version of it they were imported from).
+//
+// Build:
+// `g++ -O2 -std=c++17 -pthread -o csi_archive csi_archive.cc`
+//
+// Run:
+// `./csi_archive import experiment.csia my-experiment-file.csv`
+// `./csi_archive import experiment.csia captures/experiment.*.csv`
+// `./csi_archive info experiment.csia`
+// `./csi_archive query experiment.csia --mac 24:0A:C4:01:02:03 --from 1700000000 --to 1700000060 > subset.csv`
+// `./csi_archive query experiment.csia --from 1700000000.5 --count`
+//
+// Times are `real_timestamp` values (seconds, up to 6 decimals), both ends included. Rows come out in the order of
+// the imported files.
+//
+
+static int import(const char *path, const std::vector<const char *> &inputs, uint32_t chunk_rows, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    csi_archive_writer_t w;
+    if (!csi_archive_create(&w, path, chunk_rows)) {
+        fprintf(stderr, "ERROR: cannot write %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    size_t malformed = 0;
+    for (const char *input : inputs) {
+        // one file at a time, so memory is bounded by the largest of them
+        csi_columns_t columns;
+        if (!csi_log_parse_file(input, threads, &columns)) {
+            fprintf(stderr, "ERROR: cannot read %s\n", input);
+            close(w.fd);
+            return 1;
+        }
+        csi_archive_append(&w, columns);
+        malformed += columns.malformed_lines;
+    }
+    if (!csi_archive_finish(&w)) {
+        fprintf(stderr, "ERROR: cannot write %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%llu rows (%zu malformed lines skipped) in %zu chunks, %.1f MB, in %.2f s\n",
+            (unsigned long long) w.rows, malformed, w.chunks.size(), w.offset / 1e6, seconds);
+    return 0;
+}
+
+static int info(const char *path) {
+    csi_archive_t a;
+    if (!csi_archive_open(&a, path)) {
+        fprintf(stderr, "ERROR: %s is not a readable archive\n", path);
+        return 1;
+    }
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    for (const csi_archive_chunk_t &c : a.chunks) {
+        first = std::min(first, c.min_real_timestamp_us);
+        last = std::max(last, c.max_real_timestamp_us);
+    }
+    printf("rows:        %llu\n", (unsigned long long) a.rows);
+    printf("chunks:      %zu of up to %u rows\n", a.chunks.size(), a.chunk_rows);
+    printf("size:        %.1f MB\n", a.size / 1e6);
+    printf("roles:      ");
+    for (const std::string &role : a.roles) {
+        printf(" %s", role.c_str());
+    }
+    printf("\n");
+    if (!a.chunks.empty()) {
+        printf("real time:   %lld.%06lld to %lld.%06lld\n", (long long) (first / 1000000),
+               (long long) llabs(first % 1000000), (long long) (last / 1000000), (long long) llabs(last % 1000000));
+    }
+    csi_archive_close(&a);
+    return 0;
+}
+
+static bool parse_time(const char *s, int64_t *out) {
+    // the terminating NUL ends the value
+    _csi_log_cursor_t c = {s, s + strlen(s) + 1};
+    return _csi_log_timestamp_us(&c, out, '\0');
+}
+
+static bool parse_mac(const char *s, uint64_t *out) {
+    std::string field = std::string(s) + ",";
+    _csi_log_cursor_t c = {field.data(), field.data() + field.size()};
+    return field.size() == 18 && _csi_log_mac(&c, out);
+}
+
+static int query(const char *path, const csi_archive_query_t &q, bool count_only) {
+    csi_archive_t a;
+    if (!csi_archive_open(&a, path)) {
+        fprintf(stderr, "ERROR: %s is not a readable archive\n", path);
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool header = false;
+    csi_format_buffer_t b;
+    csi_record_t record;
+    csi_archive_query_stats_t stats;
+    csi_archive_query(&a, q, [&](const csi_archive_view_t &v, uint32_t i) {
+        if (count_only) {
+            return;
+        }
+        bool stamped = !std::isnan(v.host_timestamp[i]);
+        if (!header) {
+            // with a `timestamp` column if the rows have one, as `csi_ingest` writes them
+            fwrite(CSI_CSV_HEADER, 1, strlen(CSI_CSV_HEADER) - 1, stdout);
+            fputs(stamped ? ",timestamp\n" : "\n", stdout);
+            header = true;
+        }
+        csi_archive_record(v, i, &record);
+        csi_format_reset(&b);
+        csi_format_csv_prefix(&b, a.roles[v.role[i]].c_str(), &record);
+        csi_format_csv_values(&b, v.row_values(i), (int) v.row_value_count(i));
+        csi_format_char(&b, ']');
+        fwrite(b.buf, 1, b.len, stdout);
+        if (stamped) {
+            printf(",%.6f", v.host_timestamp[i]);
+        }
+        fputc('\n', stdout);
+    }, &stats);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (count_only) {
+        printf("%llu\n", (unsigned long long) stats.rows_matched);
+    }
+    fprintf(stderr, "%llu rows matched, %llu scanned, %llu of %llu chunks read (%llu skipped by time, %llu by MAC), "
+                    "in %.3f ms\n", (unsigned long long) stats.rows_matched, (unsigned long long) stats.rows_scanned,
+            (unsigned long long) stats.chunks_read, (unsigned long long) stats.chunks,
+            (unsigned long long) stats.skipped_by_time, (unsigned long long) stats.skipped_by_mac, seconds * 1e3);
+    if (stats.chunks_invalid > 0) {
+        fprintf(stderr, "WARNING: %llu damaged chunks skipped\n", (unsigned long long) stats.chunks_invalid);
+    }
+    csi_archive_close(&a);
+    return stats.chunks_invalid > 0 ? 1 : 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: csi_archive import <archive> <capture.csv>... [--chunk-rows 4096] [--threads N]\n");
+    fprintf(stderr, "       csi_archive info <archive>\n");
+    fprintf(stderr, "       csi_archive query <archive> [--mac AA:BB:CC:DD:EE:FF] [--from T] [--to T] [--count]\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    std::string mode = argv[1];
+    const char *path = argv[2];
+
+    if (mode == "import") {
+        std::vector<const char *> inputs;
+        uint32_t chunk_rows = CSI_ARCHIVE_CHUNK_ROWS;
+        unsigned threads = 0;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--chunk-rows") == 0 && i + 1 < argc) {
+                chunk_rows = strtoul(argv[++i], NULL, 10);
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                threads = strtoul(argv[++i], NULL, 10);
+            } else {
+                inputs.push_back(argv[i]);
+            }
+        }
+        if (inputs.empty() || chunk_rows == 0) {
+            usage();
+            return 1;
+        }
+        return import(path, inputs, chunk_rows, threads);
+    }
+    if (mode == "info") {
+        return info(path);
+    }
+    if (mode == "query") {
+        csi_archive_query_t q;
+        bool count_only = false;
+        for (int i = 3; i < argc; i++) {
+            bool ok = true;
+            if (strcmp(argv[i], "--mac") == 0 && i + 1 < argc) {
+                q.by_mac = true;
+                ok = parse_mac(argv[++i], &q.mac);
+            } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+                ok = parse_time(argv[++i], &q.from_us);
+            } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+                ok = parse_time(argv[++i], &q.to_us);
+            } else if (strcmp(argv[i], "--count") == 0) {
+                count_only = true;
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                fprintf(stderr, "ERROR: cannot read %s\n", argv[i]);
+                usage();
+                return 1;
+            }
+        }
+        return query(path, q, count_only);
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,622 @@
+#ifndef ESP32_CSI_CSI_ARCHIVE_H
+#define ESP32_CSI_CSI_ARCHIVE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../_components/csi_format_component.h"
+#include "csi_log_parser.h"
+
+//
+// Indexed archive of CSI captures, so that e.g. "all frames of one MAC between two times" only reads the parts of a
+// capture which can hold them instead of parsing all of it.
+//
+// Rows are stored in file order in chunks of `chunk_rows` (the last one may be shorter), each holding one array per
+// column of `csi_columns_t` (the CSV header fields, `real_timestamp_us`, the host timestamp) and the CSI values of its
+// rows one after the other with their offsets. A footer at the end of the file indexes the chunks: where each is,
+// the range of its `real_timestamp_us` and a Bloom filter of its MACs. A query only looks at chunks whose range and
+// filter allow a match, and of those only at the pages of the columns it compares until a row matches.
+//
+// Layout, little-endian like the hosts it is written on:
+//
+//   csi_archive_header_t, padded to CSI_ARCHIVE_ALIGN
+//   chunk 0, chunk 1, ...       each padded to CSI_ARCHIVE_ALIGN, columns 8-byte aligned within it
+//   footer                      row count, role names, csi_archive_chunk_t of every chunk
+//   csi_archive_trailer_t       where the footer starts
+//
+// The reader memory-maps the file and validates the footer on open, and the columns of a chunk before handing it
+// out, so a truncated or damaged archive is refused rather than read out of bounds.
+//
+
+#define CSI_ARCHIVE_MAGIC "CSIARCH\x01"
+#define CSI_ARCHIVE_TRAILER_MAGIC "CSIAIDX\x01"
+#define CSI_ARCHIVE_VERSION 1
+#define CSI_ARCHIVE_CHUNK_ROWS 4096
+// chunks start on page boundaries, so the pages of one are never shared with another
+#define CSI_ARCHIVE_ALIGN 4096
+// 512 bits and 3 hashes: about 2% false positives with 50 distinct MACs in a chunk
+#define CSI_ARCHIVE_BLOOM_WORDS 8
+#define CSI_ARCHIVE_BLOOM_HASHES 3
+
+enum csi_archive_column_t {
+    CSI_ARCHIVE_ROLE,
+    CSI_ARCHIVE_MAC,
+    CSI_ARCHIVE_RSSI,
+    CSI_ARCHIVE_RATE,
+    CSI_ARCHIVE_SIG_MODE,
+    CSI_ARCHIVE_MCS,
+    CSI_ARCHIVE_BANDWIDTH,
+    CSI_ARCHIVE_SMOOTHING,
+    CSI_ARCHIVE_NOT_SOUNDING,
+    CSI_ARCHIVE_AGGREGATION,
+    CSI_ARCHIVE_STBC,
+    CSI_ARCHIVE_FEC_CODING,
+    CSI_ARCHIVE_SGI,
+    CSI_ARCHIVE_NOISE_FLOOR,
+    CSI_ARCHIVE_AMPDU_CNT,
+    CSI_ARCHIVE_CHANNEL,
+    CSI_ARCHIVE_SECONDARY_CHANNEL,
+    CSI_ARCHIVE_LOCAL_TIMESTAMP,
+    CSI_ARCHIVE_ANT,
+    CSI_ARCHIVE_SIG_LEN,
+    CSI_ARCHIVE_RX_STATE,
+    CSI_ARCHIVE_REAL_TIME_SET,
+    CSI_ARCHIVE_REAL_TIMESTAMP_US,
+    CSI_ARCHIVE_REAL_TIME_UNCERTAINTY_US,
+    CSI_ARCHIVE_LEN,
+    CSI_ARCHIVE_HOST_TIMESTAMP,
+    // `rows + 1` offsets into CSI_ARCHIVE_CSI, from 0 to the chunk's `values`
+    CSI_ARCHIVE_CSI_OFFSET,
+    CSI_ARCHIVE_CSI,
+    CSI_ARCHIVE_COLUMNS,
+};
+
+// bytes per row (per value for CSI_ARCHIVE_CSI) of each column
+static const uint8_t CSI_ARCHIVE_COLUMN_SIZE[CSI_ARCHIVE_COLUMNS] = {
+        1, 8, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 4, 1, 2, 1, 1, 8, 4, 2, 8, 4, 1,
+};
+
+struct csi_archive_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunk_rows;
+};
+
+struct csi_archive_chunk_t {
+    // from the start of the file
+    uint64_t offset;
+    uint64_t size;
+    uint32_t rows;
+    // CSI values of all rows
+    uint32_t values;
+    int64_t min_real_timestamp_us;
+    int64_t max_real_timestamp_us;
+    uint64_t bloom[CSI_ARCHIVE_BLOOM_WORDS];
+    // from the start of the chunk
+    uint64_t columns[CSI_ARCHIVE_COLUMNS];
+};
+
+struct csi_archive_trailer_t {
+    uint64_t footer_offset;
+    char magic[8];
+};
+
+/*
+ * The rows of one chunk. Pointers into the mapped file; pages are only read once touched.
+ */
+struct csi_archive_view_t {
+    uint32_t rows = 0;
+    const uint8_t *role;
+    const uint64_t *mac;
+    const int8_t *rssi;
+    const uint8_t *rate;
+    const uint8_t *sig_mode;
+    const uint8_t *mcs;
+    const uint8_t *bandwidth;
+    const uint8_t *smoothing;
+    const uint8_t *not_sounding;
+    const uint8_t *aggregation;
+    const uint8_t *stbc;
+    const uint8_t *fec_coding;
+    const uint8_t *sgi;
+    const int8_t *noise_floor;
+    const uint8_t *ampdu_cnt;
+    const uint8_t *channel;
+    const uint8_t *secondary_channel;
+    const uint32_t *local_timestamp;
+    const uint8_t *ant;
+    const uint16_t *sig_len;
+    const uint8_t *rx_state;
+    const uint8_t *real_time_set;
+    const int64_t *real_timestamp_us;
+    const uint32_t *real_time_uncertainty_us;
+    const uint16_t *len;
+    const double *host_timestamp;
+    const uint32_t *csi_offset;
+    const int8_t *csi;
+
+    const int8_t *row_values(uint32_t i) const {
+        return csi + csi_offset[i];
+    }
+
+    uint32_t row_value_count(uint32_t i) const {
+        return csi_offset[i + 1] - csi_offset[i];
+    }
+};
+
+uint64_t _csi_archive_hash(uint64_t mac) {
+    // splitmix64 finalizer
+    mac += 0x9E3779B97F4A7C15ULL;
+    mac = (mac ^ (mac >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    mac = (mac ^ (mac >> 27)) * 0x94D049BB133111EBULL;
+    return mac ^ (mac >> 31);
+}
+
+void _csi_archive_bloom_add(uint64_t *bloom, uint64_t mac) {
+    uint64_t h = _csi_archive_hash(mac);
+    for (int i = 0; i < CSI_ARCHIVE_BLOOM_HASHES; i++, h >>= 9) {
+        bloom[(h >> 6) & (CSI_ARCHIVE_BLOOM_WORDS - 1)] |= 1ULL << (h & 63);
+    }
+}
+
+/*
+ * False if the chunk certainly has no row of `mac`.
+ */
+bool csi_archive_bloom_may_contain(const uint64_t *bloom, uint64_t mac) {
+    uint64_t h = _csi_archive_hash(mac);
+    for (int i = 0; i < CSI_ARCHIVE_BLOOM_HASHES; i++, h >>= 9) {
+        if (!(bloom[(h >> 6) & (CSI_ARCHIVE_BLOOM_WORDS - 1)] & (1ULL << (h & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t _csi_archive_column_bytes(int column, uint32_t rows, uint32_t values) {
+    if (column == CSI_ARCHIVE_CSI_OFFSET) {
+        return (uint64_t) (rows + 1) * 4;
+    }
+    return (uint64_t) (column == CSI_ARCHIVE_CSI ? values : rows) * CSI_ARCHIVE_COLUMN_SIZE[column];
+}
+
+uint64_t _csi_archive_align(uint64_t n, uint64_t to) {
+    return (n + to - 1) / to * to;
+}
+
+struct csi_archive_writer_t {
+    int fd = -1;
+    uint32_t chunk_rows = CSI_ARCHIVE_CHUNK_ROWS;
+    // bytes written so far
+    uint64_t offset = 0;
+    uint64_t rows = 0;
+    std::vector<std::string> roles;
+    std::vector<csi_archive_chunk_t> chunks;
+    // set once a write failed
+    bool failed = false;
+
+    // the chunk being filled
+    std::vector<uint8_t> columns[CSI_ARCHIVE_COLUMNS];
+    csi_archive_chunk_t chunk;
+};
+
+void _csi_archive_write(csi_archive_writer_t *w, const void *data, size_t len) {
+    for (size_t done = 0; done < len && !w->failed;) {
+        ssize_t n = write(w->fd, (const uint8_t *) data + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            w->failed = true;
+            return;
+        }
+        done += n;
+    }
+    w->offset += len;
+}
+
+void _csi_archive_pad(csi_archive_writer_t *w, uint64_t to) {
+    static const uint8_t zeros[CSI_ARCHIVE_ALIGN] = {};
+    _csi_archive_write(w, zeros, _csi_archive_align(w->offset, to) - w->offset);
+}
+
+void _csi_archive_start_chunk(csi_archive_writer_t *w) {
+    for (std::vector<uint8_t> &column : w->columns) {
+        column.clear();
+    }
+    uint32_t zero = 0;
+    w->columns[CSI_ARCHIVE_CSI_OFFSET].insert(w->columns[CSI_ARCHIVE_CSI_OFFSET].end(), (uint8_t *) &zero,
+                                              (uint8_t *) &zero + 4);
+    memset(&w->chunk, 0, sizeof(w->chunk));
+    w->chunk.min_real_timestamp_us = INT64_MAX;
+    w->chunk.max_real_timestamp_us = INT64_MIN;
+}
+
+void _csi_archive_flush_chunk(csi_archive_writer_t *w) {
+    if (w->chunk.rows == 0) {
+        return;
+    }
+    csi_archive_chunk_t *c = &w->chunk;
+    c->offset = w->offset;
+    uint64_t at = 0;
+    for (int i = 0; i < CSI_ARCHIVE_COLUMNS; i++) {
+        c->columns[i] = at;
+        at = _csi_archive_align(at + w->columns[i].size(), 8);
+    }
+    for (const std::vector<uint8_t> &column : w->columns) {
+        _csi_archive_write(w, column.data(), column.size());
+        _csi_archive_pad(w, 8);
+    }
+    c->size = w->offset - c->offset;
+    _csi_archive_pad(w, CSI_ARCHIVE_ALIGN);
+    w->chunks.push_back(*c);
+    _csi_archive_start_chunk(w);
+}
+
+/*
+ * Creates (or truncates) `path` with chunks of `chunk_rows`. False if it cannot be written.
+ */
+bool csi_archive_create(csi_archive_writer_t *w, const char *path, uint32_t chunk_rows) {
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        return false;
+    }
+    w->chunk_rows = chunk_rows > 0 ? chunk_rows : CSI_ARCHIVE_CHUNK_ROWS;
+    csi_archive_header_t header = {};
+    memcpy(header.magic, CSI_ARCHIVE_MAGIC, 8);
+    header.version = CSI_ARCHIVE_VERSION;
+    header.chunk_rows = w->chunk_rows;
+    _csi_archive_write(w, &header, sizeof(header));
+    _csi_archive_pad(w, CSI_ARCHIVE_ALIGN);
+    _csi_archive_start_chunk(w);
+    return !w->failed;
+}
+
+template<typename T>
+void _csi_archive_put(csi_archive_writer_t *w, int column, const T &value) {
+    const uint8_t *bytes = (const uint8_t *) &value;
+    w->columns[column].insert(w->columns[column].end(), bytes, bytes + sizeof(T));
+}
+
+/*
+ * Appends every row of `c`, e.g. as parsed by `csi_log_parse_file()`.
+ */
+void csi_archive_append(csi_archive_writer_t *w, const csi_columns_t &c) {
+    std::vector<uint8_t> role_map;
+    for (const std::string &name : c.roles) {
+        size_t i = 0;
+        while (i < w->roles.size() && w->roles[i] != name) {
+            i++;
+        }
+        if (i == w->roles.size()) {
+            w->roles.push_back(name);
+        }
+        role_map.push_back((uint8_t) i);
+    }
+
+    for (size_t i = 0; i < c.rows(); i++) {
+        csi_archive_chunk_t *k = &w->chunk;
+        _csi_archive_put(w, CSI_ARCHIVE_ROLE, role_map[c.role[i]]);
+        _csi_archive_put(w, CSI_ARCHIVE_MAC, c.mac[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_RSSI, c.rssi[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_RATE, c.rate[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_SIG_MODE, c.sig_mode[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_MCS, c.mcs[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_BANDWIDTH, c.bandwidth[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_SMOOTHING, c.smoothing[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_NOT_SOUNDING, c.not_sounding[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_AGGREGATION, c.aggregation[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_STBC, c.stbc[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_FEC_CODING, c.fec_coding[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_SGI, c.sgi[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_NOISE_FLOOR, c.noise_floor[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_AMPDU_CNT, c.ampdu_cnt[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_CHANNEL, c.channel[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_SECONDARY_CHANNEL, c.secondary_channel[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_LOCAL_TIMESTAMP, c.local_timestamp[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_ANT, c.ant[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_SIG_LEN, c.sig_len[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_RX_STATE, c.rx_state[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_REAL_TIME_SET, c.real_time_set[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_REAL_TIMESTAMP_US, c.real_timestamp_us[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_REAL_TIME_UNCERTAINTY_US, c.real_time_uncertainty_us[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_LEN, c.len[i]);
+        _csi_archive_put(w, CSI_ARCHIVE_HOST_TIMESTAMP, c.host_timestamp[i]);
+
+        const int8_t *values = c.row_values(i);
+        w->columns[CSI_ARCHIVE_CSI].insert(w->columns[CSI_ARCHIVE_CSI].end(), values, values + c.row_value_count(i));
+        k->values += (uint32_t) c.row_value_count(i);
+        _csi_archive_put(w, CSI_ARCHIVE_CSI_OFFSET, k->values);
+
+        k->min_real_timestamp_us = std::min(k->min_real_timestamp_us, c.real_timestamp_us[i]);
+        k->max_real_timestamp_us = std::max(k->max_real_timestamp_us, c.real_timestamp_us[i]);
+        _csi_archive_bloom_add(k->bloom, c.mac[i]);
+        w->rows++;
+        if (++k->rows == w->chunk_rows) {
+            _csi_archive_flush_chunk(w);
+        }
+    }
+}
+
+/*
+ * Writes the last chunk and the footer, and closes the file. False if any write failed.
+ */
+bool csi_archive_finish(csi_archive_writer_t *w) {
+    _csi_archive_flush_chunk(w);
+    uint64_t footer_offset = w->offset;
+    uint32_t counts[2] = {(uint32_t) w->chunks.size(), (uint32_t) w->roles.size()};
+    _csi_archive_write(w, &w->rows, sizeof(w->rows));
+    _csi_archive_write(w, counts, sizeof(counts));
+    for (const std::string &role : w->roles) {
+        uint8_t len = (uint8_t) std::min<size_t>(role.size(), 255);
+        _csi_archive_write(w, &len, 1);
+        _csi_archive_write(w, role.data(), len);
+    }
+    _csi_archive_pad(w, 8);
+    _csi_archive_write(w, w->chunks.data(), w->chunks.size() * sizeof(csi_archive_chunk_t));
+
+    csi_archive_trailer_t trailer = {};
+    trailer.footer_offset = footer_offset;
+    memcpy(trailer.magic, CSI_ARCHIVE_TRAILER_MAGIC, 8);
+    _csi_archive_write(w, &trailer, sizeof(trailer));
+    bool ok = !w->failed;
+    ok &= close(w->fd) == 0;
+    w->fd = -1;
+    return ok;
+}
+
+struct csi_archive_t {
+    const uint8_t *data = NULL;
+    size_t size = 0;
+    uint32_t chunk_rows = 0;
+    uint64_t rows = 0;
+    std::vector<std::string> roles;
+    std::vector<csi_archive_chunk_t> chunks;
+};
+
+void csi_archive_close(csi_archive_t *a) {
+    if (a->data != NULL) {
+        munmap((void *) a->data, a->size);
+    }
+    *a = csi_archive_t();
+}
+
+bool _csi_archive_chunk_valid(const csi_archive_t *a, const csi_archive_chunk_t &c, uint64_t footer_offset) {
+    if (c.rows == 0 || c.rows > a->chunk_rows || c.offset % CSI_ARCHIVE_ALIGN != 0 || c.offset > footer_offset
+        || c.size > footer_offset - c.offset) {
+        return false;
+    }
+    for (int i = 0; i < CSI_ARCHIVE_COLUMNS; i++) {
+        if (c.columns[i] % 8 != 0 || c.columns[i] > c.size
+            || _csi_archive_column_bytes(i, c.rows, c.values) > c.size - c.columns[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Memory-maps `path` and reads its index. False if it cannot be read or is not a complete archive.
+ */
+bool csi_archive_open(csi_archive_t *a, const char *path) {
+    *a = csi_archive_t();
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) (CSI_ARCHIVE_ALIGN + sizeof(csi_archive_trailer_t))) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    a->data = (const uint8_t *) data;
+    a->size = st.st_size;
+    // only the chunks a query needs are read, so read-ahead past them would be wasted
+    madvise(data, a->size, MADV_RANDOM);
+
+    csi_archive_header_t header;
+    csi_archive_trailer_t trailer;
+    memcpy(&header, a->data, sizeof(header));
+    memcpy(&trailer, a->data + a->size - sizeof(trailer), sizeof(trailer));
+    uint64_t footer_end = a->size - sizeof(trailer);
+    if (memcmp(header.magic, CSI_ARCHIVE_MAGIC, 8) != 0 || header.version != CSI_ARCHIVE_VERSION
+        || header.chunk_rows == 0 || memcmp(trailer.magic, CSI_ARCHIVE_TRAILER_MAGIC, 8) != 0
+        || trailer.footer_offset < CSI_ARCHIVE_ALIGN || trailer.footer_offset > footer_end - 16) {
+        csi_archive_close(a);
+        return false;
+    }
+    a->chunk_rows = header.chunk_rows;
+
+    const uint8_t *p = a->data + trailer.footer_offset, *end = a->data + footer_end;
+    uint32_t counts[2];
+    memcpy(&a->rows, p, 8);
+    memcpy(counts, p + 8, 8);
+    p += 16;
+    for (uint32_t i = 0; i < counts[1]; i++) {
+        if (p >= end || *p > end - p - 1) {
+            csi_archive_close(a);
+            return false;
+        }
+        a->roles.emplace_back((const char *) p + 1, *p);
+        p += 1 + *p;
+    }
+    p = a->data + _csi_archive_align(p - a->data, 8);
+    if (p > end || (uint64_t) (end - p) != (uint64_t) counts[0] * sizeof(csi_archive_chunk_t)) {
+        csi_archive_close(a);
+        return false;
+    }
+    a->chunks.resize(counts[0]);
+    memcpy(a->chunks.data(), p, end - p);
+
+    uint64_t rows = 0;
+    for (const csi_archive_chunk_t &c : a->chunks) {
+        if (!_csi_archive_chunk_valid(a, c, trailer.footer_offset)) {
+            csi_archive_close(a);
+            return false;
+        }
+        rows += c.rows;
+    }
+    if (rows != a->rows) {
+        csi_archive_close(a);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The rows of chunk `index`. False if its CSI offsets or roles are out of bounds.
+ */
+bool csi_archive_chunk_view(const csi_archive_t *a, size_t index, csi_archive_view_t *v) {
+    const csi_archive_chunk_t &c = a->chunks[index];
+    const uint8_t *base = a->data + c.offset;
+    const void *columns[CSI_ARCHIVE_COLUMNS];
+    for (int i = 0; i < CSI_ARCHIVE_COLUMNS; i++) {
+        columns[i] = base + c.columns[i];
+    }
+    v->rows = c.rows;
+    v->role = (const uint8_t *) columns[CSI_ARCHIVE_ROLE];
+    v->mac = (const uint64_t *) columns[CSI_ARCHIVE_MAC];
+    v->rssi = (const int8_t *) columns[CSI_ARCHIVE_RSSI];
+    v->rate = (const uint8_t *) columns[CSI_ARCHIVE_RATE];
+    v->sig_mode = (const uint8_t *) columns[CSI_ARCHIVE_SIG_MODE];
+    v->mcs = (const uint8_t *) columns[CSI_ARCHIVE_MCS];
+    v->bandwidth = (const uint8_t *) columns[CSI_ARCHIVE_BANDWIDTH];
+    v->smoothing = (const uint8_t *) columns[CSI_ARCHIVE_SMOOTHING];
+    v->not_sounding = (const uint8_t *) columns[CSI_ARCHIVE_NOT_SOUNDING];
+    v->aggregation = (const uint8_t *) columns[CSI_ARCHIVE_AGGREGATION];
+    v->stbc = (const uint8_t *) columns[CSI_ARCHIVE_STBC];
+    v->fec_coding = (const uint8_t *) columns[CSI_ARCHIVE_FEC_CODING];
+    v->sgi = (const uint8_t *) columns[CSI_ARCHIVE_SGI];
+    v->noise_floor = (const int8_t *) columns[CSI_ARCHIVE_NOISE_FLOOR];
+    v->ampdu_cnt = (const uint8_t *) columns[CSI_ARCHIVE_AMPDU_CNT];
+    v->channel = (const uint8_t *) columns[CSI_ARCHIVE_CHANNEL];
+    v->secondary_channel = (const uint8_t *) columns[CSI_ARCHIVE_SECONDARY_CHANNEL];
+    v->local_timestamp = (const uint32_t *) columns[CSI_ARCHIVE_LOCAL_TIMESTAMP];
+    v->ant = (const uint8_t *) columns[CSI_ARCHIVE_ANT];
+    v->sig_len = (const uint16_t *) columns[CSI_ARCHIVE_SIG_LEN];
+    v->rx_state = (const uint8_t *) columns[CSI_ARCHIVE_RX_STATE];
+    v->real_time_set = (const uint8_t *) columns[CSI_ARCHIVE_REAL_TIME_SET];
+    v->real_timestamp_us = (const int64_t *) columns[CSI_ARCHIVE_REAL_TIMESTAMP_US];
+    v->real_time_uncertainty_us = (const uint32_t *) columns[CSI_ARCHIVE_REAL_TIME_UNCERTAINTY_US];
+    v->len = (const uint16_t *) columns[CSI_ARCHIVE_LEN];
+    v->host_timestamp = (const double *) columns[CSI_ARCHIVE_HOST_TIMESTAMP];
+    v->csi_offset = (const uint32_t *) columns[CSI_ARCHIVE_CSI_OFFSET];
+    v->csi = (const int8_t *) columns[CSI_ARCHIVE_CSI];
+
+    if (v->csi_offset[0] != 0 || v->csi_offset[c.rows] != c.values) {
+        return false;
+    }
+    for (uint32_t i = 0; i < c.rows; i++) {
+        if (v->csi_offset[i] > v->csi_offset[i + 1] || v->role[i] >= a->roles.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Row `i` of `v` as a record, e.g. for `csi_format_csv_prefix()`.
+ */
+void csi_archive_record(const csi_archive_view_t &v, uint32_t i, csi_record_t *r) {
+    for (int k = 0; k < 6; k++) {
+        r->mac[k] = (uint8_t) (v.mac[i] >> (40 - 8 * k));
+    }
+    r->rssi = v.rssi[i];
+    r->rate = v.rate[i];
+    r->sig_mode = v.sig_mode[i];
+    r->mcs = v.mcs[i];
+    r->cwb = v.bandwidth[i];
+    r->smoothing = v.smoothing[i];
+    r->not_sounding = v.not_sounding[i];
+    r->aggregation = v.aggregation[i];
+    r->stbc = v.stbc[i];
+    r->fec_coding = v.fec_coding[i];
+    r->sgi = v.sgi[i];
+    r->noise_floor = v.noise_floor[i];
+    r->ampdu_cnt = v.ampdu_cnt[i];
+    r->channel = v.channel[i];
+    r->secondary_channel = v.secondary_channel[i];
+    r->local_timestamp = v.local_timestamp[i];
+    r->ant = v.ant[i];
+    r->sig_len = v.sig_len[i];
+    r->rx_state = v.rx_state[i];
+    r->real_time_set = v.real_time_set[i];
+    r->real_timestamp_us = v.real_timestamp_us[i];
+    r->real_time_uncertainty_us = v.real_time_uncertainty_us[i];
+    r->len = v.len[i];
+}
+
+struct csi_archive_query_t {
+    // inclusive range of `real_timestamp_us`
+    int64_t from_us = INT64_MIN;
+    int64_t to_us = INT64_MAX;
+    bool by_mac = false;
+    uint64_t mac = 0;
+};
+
+struct csi_archive_query_stats_t {
+    uint64_t chunks = 0;
+    uint64_t skipped_by_time = 0;
+    // Bloom filter said no
+    uint64_t skipped_by_mac = 0;
+    uint64_t chunks_read = 0;
+    // damaged, skipped
+    uint64_t chunks_invalid = 0;
+    uint64_t rows_scanned = 0;
+    uint64_t rows_matched = 0;
+};
+
+/*
+ * Calls `on_row` for every row matching `q`, in file order.
+ */
+void csi_archive_query(const csi_archive_t *a, const csi_archive_query_t &q,
+                       const std::function<void(const csi_archive_view_t &, uint32_t)> &on_row,
+                       csi_archive_query_stats_t *stats) {
+    csi_archive_query_stats_t s;
+    s.chunks = a->chunks.size();
+    for (size_t k = 0; k < a->chunks.size(); k++) {
+        const csi_archive_chunk_t &c = a->chunks[k];
+        if (c.max_real_timestamp_us < q.from_us || c.min_real_timestamp_us > q.to_us) {
+            s.skipped_by_time++;
+            continue;
+        }
+        if (q.by_mac && !csi_archive_bloom_may_contain(c.bloom, q.mac)) {
+            s.skipped_by_mac++;
+            continue;
+        }
+        // the header columns are small and all of them are likely to be needed
+        madvise((void *) (a->data + c.offset), c.columns[CSI_ARCHIVE_CSI_OFFSET], MADV_WILLNEED);
+        csi_archive_view_t v;
+        if (!csi_archive_chunk_view(a, k, &v)) {
+            s.chunks_invalid++;
+            continue;
+        }
+        s.chunks_read++;
+        s.rows_scanned += v.rows;
+        for (uint32_t i = 0; i < v.rows; i++) {
+            if ((q.by_mac && v.mac[i] != q.mac) || v.real_timestamp_us[i] < q.from_us
+                || v.real_timestamp_us[i] > q.to_us) {
+                continue;
+            }
+            s.rows_matched++;
+            on_row(v, i);
+        }
+    }
+    if (stats != NULL) {
+        *stats = s;
+    }
+}
+
+#endif //ESP32_CSI_CSI_ARCHIVE_H
@@ -0,0 +1,4239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../_components/csi_format_component.h"
+#include "../_components/csi_ring_component.h"
+#include "../_components/csi_binary_component.h"
+#include "../_components/csi_math_component.h"
+#include "../_components/sd_buffer_component.h"
+#include "../_components/sd_segment_component.h"
+#include "../_components/csi_stats_component.h"
+#include "../_components/packet_scheduler_component.h"
+#include "../_components/probe_frame_component.h"
+#include "../_components/probe_rx_component.h"
+#include "../_components/channel_scheduler_component.h"
+#include "../_components/csi_filter_component.h"
+#include "../_components/csi_rate_limit_component.h"
+#include "../_components/command_frame_component.h"
+#include "../_components/command_component.h"
+#include "../_components/clock_sync_component.h"
+#include "../_components/csi_features_component.h"
+#include "../_components/sta_session_component.h"
+#include "../_components/csi_delta_component.h"
+#include "../_components/csi_layout_component.h"
+#include "csi_log_parser.h"
+#include "csi_udp_collector.h"
+#include "csi_probe_analyzer.h"
+#include "csi_time_server.h"
+#include "csi_serial_port.h"
+#include "csi_ingest.h"
+#include "csi_archive.h"
+
+//
+// Host-side checks and micro-benchmarks for the hot-path code in `_components/`.
+//
+// Build:
+// `g++ -O2 -std=c++17 -pthread -o csi_bench csi_bench.cc`
+//
+// Run:
+// `./csi_bench format ../python_utils/example_csi.csv`
+// `./csi_bench ring 10000000`
+// `./csi_bench binary ../python_utils/example_csi.csv 921600`
+// `./csi_bench parse ../python_utils/example_csi.csv /tmp/synthetic.csv 4000`
+// `./csi_bench math 1000000`
+// `./csi_bench sd /tmp/sd_bench.csv 200`
+// `./csi_bench segment /tmp/sd_segments 5000`
+// `./csi_bench udp ../python_utils/example_csi.csv 100000`
+// `./csi_bench stats 10000000`
+// `./csi_bench scheduler 3600`
+// `./csi_bench frame 10000000`
+// `./csi_bench probe 1000000`
+// `./csi_bench channel 3600`
+// `./csi_bench filter 100000000`
+// `./csi_bench limit 600`
+// `./csi_bench command 20000`
+// `./csi_bench time 10000000`
+// `./csi_bench sync 6`
+// `./csi_bench features 600`
+// `./csi_bench sessions 600`
+// `./csi_bench delta ../python_utils/example_csi.csv 100000`
+// `./csi_bench layout ../python_utils/example_csi.csv 10000000`
+// `./csi_bench ingest ../python_utils/example_csi.csv /tmp/csi_ingest 200000`
+// `./csi_bench archive ../python_utils/example_csi.csv /tmp/csi_archive 200000`
+//
+// Add `-mavx2` to benchmark the AVX2 kernels of `csi_math_component.h` instead of SSE2.
+//
+
+struct frame_t {
+    csi_record_t record;
+    std::vector<int8_t> values;
+};
+
+static bool parse_frame(const std::string &line, frame_t *frame) {
+    size_t open = line.find('[');
+    size_t close = line.find(']', open);
+    if (line.compare(0, 9, "CSI_DATA,") != 0 || open == std::string::npos || close == std::string::npos) {
+        return false;
+    }
+
+    std::vector<std::string> fields;
+    std::stringstream header(line.substr(0, open));
+    std::string field;
+    while (std::getline(header, field, ',')) {
+        fields.push_back(field);
+    }
+    // captures from before clock sync have no `real_time_uncertainty_us` column
+    if (fields.size() != 25 && fields.size() != 26) {
+        return false;
+    }
+    size_t len_field = fields.size() - 1;
+
+    csi_record_t &r = frame->record;
+    unsigned int mac[6];
+    if (sscanf(fields[2].c_str(), "%02X:%02X:%02X:%02X:%02X:%02X",
+               &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        r.mac[i] = mac[i];
+    }
+    r.rssi = atoi(fields[3].c_str());
+    r.rate = atoi(fields[4].c_str());
+    r.sig_mode = atoi(fields[5].c_str());
+    r.mcs = atoi(fields[6].c_str());
+    r.cwb = atoi(fields[7].c_str());
+    r.smoothing = atoi(fields[8].c_str());
+    r.not_sounding = atoi(fields[9].c_str());
+    r.aggregation = atoi(fields[10].c_str());
+    r.stbc = atoi(fields[11].c_str());
+    r.fec_coding = atoi(fields[12].c_str());
+    r.sgi = atoi(fields[13].c_str());
+    r.noise_floor = atoi(fields[14].c_str());
+    r.ampdu_cnt = atoi(fields[15].c_str());
+    r.channel = atoi(fields[16].c_str());
+    r.secondary_channel = atoi(fields[17].c_str());
+    r.local_timestamp = strtoul(fields[18].c_str(), NULL, 10);
+    r.ant = atoi(fields[19].c_str());
+    r.sig_len = atoi(fields[20].c_str());
+    r.rx_state = atoi(fields[21].c_str());
+    r.real_time_set = atoi(fields[22].c_str());
+    std::string timestamp = fields[23] + ",";
+    _csi_log_cursor_t cursor = {timestamp.data(), timestamp.data() + timestamp.size()};
+    if (!_csi_log_timestamp_us(&cursor, &r.real_timestamp_us, ',')) {
+        return false;
+    }
+    r.real_time_uncertainty_us = len_field == 25 ? strtoul(fields[24].c_str(), NULL, 10) : 0;
+    r.len = atoi(fields[len_field].c_str());
+
+    std::stringstream values(line.substr(open + 1, close - open - 1));
+    int v;
+    frame->values.clear();
+    while (values >> v) {
+        frame->values.push_back(v);
+    }
+    return true;
+}
+
+/*
+ * The std::stringstream implementation `_wifi_csi_cb` used before `csi_format_component.h`, with the timestamp printed
+ * as `<seconds>.<6 digits>` like it is now, instead of `<< seconds` (see `bench_time()`).
+ */
+static std::string legacy_format(const char *type, const csi_record_t &d, const int8_t *buf, int data_len) {
+    std::stringstream ss;
+
+    char mac[20] = {0};
+    sprintf(mac, "%02X:%02X:%02X:%02X:%02X:%02X", d.mac[0], d.mac[1], d.mac[2], d.mac[3], d.mac[4], d.mac[5]);
+
+    ss << "CSI_DATA,"
+       << type << ","
+       << mac << ","
+       << (int) d.rssi << ","
+       << (int) d.rate << ","
+       << (int) d.sig_mode << ","
+       << (int) d.mcs << ","
+       << (int) d.cwb << ","
+       << (int) d.smoothing << ","
+       << (int) d.not_sounding << ","
+       << (int) d.aggregation << ","
+       << (int) d.stbc << ","
+       << (int) d.fec_coding << ","
+       << (int) d.sgi << ","
+       << (int) d.noise_floor << ","
+       << (int) d.ampdu_cnt << ","
+       << (int) d.channel << ","
+       << (int) d.secondary_channel << ","
+       << d.local_timestamp << ","
+       << (int) d.ant << ","
+       << (int) d.sig_len << ","
+       << (int) d.rx_state << ","
+       << (bool) d.real_time_set << ","
+       << d.real_timestamp_us / 1000000 << "." << std::setw(6) << std::setfill('0') << d.real_timestamp_us % 1000000
+       << std::setfill(' ') << ","
+       << d.real_time_uncertainty_us << ","
+       << d.len << ",[";
+
+    for (int i = 0; i < data_len; i++) {
+        ss << (int) buf[i] << " ";
+    }
+    ss << "]\n";
+    return ss.str();
+}
+
+static std::string fast_format(csi_format_buffer_t *b, const char *type, const csi_record_t &r,
+                               const int8_t *buf, int data_len) {
+    csi_format_reset(b);
+    csi_format_csv_prefix(b, type, &r);
+    csi_format_csv_values(b, buf, data_len);
+    csi_format_csv_suffix(b);
+    return std::string(b->buf, b->len);
+}
+
+static bool load_frames(const char *file_name, std::vector<frame_t> *frames) {
+    std::ifstream f(file_name);
+    if (!f) {
+        printf("ERROR: cannot open %s\n", file_name);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(f, line)) {
+        frame_t frame;
+        if (parse_frame(line, &frame)) {
+            frames->push_back(frame);
+        }
+    }
+    if (frames->empty()) {
+        printf("ERROR: no CSI_DATA lines in %s\n", file_name);
+        return false;
+    }
+    return true;
+}
+
+static int bench_format(const char *file_name, int iterations) {
+    std::vector<frame_t> frames;
+    if (!load_frames(file_name, &frames)) {
+        return 1;
+    }
+
+    static csi_format_buffer_t b;
+    const char *type = "AP";
+
+    int mismatches = 0;
+    for (const frame_t &frame : frames) {
+        std::string expected = legacy_format(type, frame.record, frame.values.data(), frame.values.size());
+        std::string actual = fast_format(&b, type, frame.record, frame.values.data(), frame.values.size());
+        if (expected != actual) {
+            if (mismatches++ < 10) {
+                printf("line mismatch:\n  stringstream: %s  formatter:    %s", expected.c_str(), actual.c_str());
+            }
+        }
+    }
+    printf("frames checked: %zu, mismatches: %d\n", frames.size(), mismatches);
+
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        const frame_t &frame = frames[i % frames.size()];
+        sink += legacy_format(type, frame.record, frame.values.data(), frame.values.size()).size();
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        const frame_t &frame = frames[i % frames.size()];
+        csi_format_reset(&b);
+        csi_format_csv_prefix(&b, type, &frame.record);
+        csi_format_csv_values(&b, frame.values.data(), frame.values.size());
+        csi_format_csv_suffix(&b);
+        sink += b.len;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double legacy_ns = std::chrono::duration<double, std::nano>(middle - start).count() / iterations;
+    double fast_ns = std::chrono::duration<double, std::nano>(end - middle).count() / iterations;
+    printf("stringstream: %10.1f ns/frame\n", legacy_ns);
+    printf("formatter:    %10.1f ns/frame (%.1fx)\n", fast_ns, legacy_ns / fast_ns);
+    printf("(%zu bytes formatted)\n", sink);
+
+    return mismatches == 0 ? 0 : 1;
+}
+
+/*
+ * Checks that real timestamps keep every microsecond through `csi_format_timestamp_us()` and the log parser, shows
+ * what the previous double seconds printed with `<<` kept of a current epoch time, and times the timestamp path of a
+ * frame (clock read and formatting) both ways.
+ */
+static int bench_time(uint32_t iterations) {
+    static csi_format_buffer_t b;
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> candidates = {0, 1, -1, 999999, -999999, 1000000, -1000000, -1500000, 1700000000000000LL,
+                                       INT64_MAX, INT64_MIN};
+    for (int64_t scale = 1; scale < 1000000000000000000LL; scale *= 10) {
+        for (int i = 0; i < 2000; i++) {
+            int64_t us = (int64_t) (rng() % (uint64_t) (scale * 10));
+            candidates.push_back(us);
+            candidates.push_back(-us);
+        }
+    }
+
+    int mismatches = 0;
+    for (int64_t us : candidates) {
+        uint64_t magnitude = us < 0 ? 0 - (uint64_t) us : (uint64_t) us;
+        char expected[32];
+        snprintf(expected, sizeof(expected), "%s%llu.%06llu", us < 0 ? "-" : "",
+                 (unsigned long long) (magnitude / 1000000), (unsigned long long) (magnitude % 1000000));
+        csi_format_reset(&b);
+        csi_format_timestamp_us(&b, us);
+        std::string actual(b.buf, b.len);
+
+        // the parser covers every timestamp up to a few hundred thousand years
+        int64_t parsed = 0;
+        bool parse_ok = true;
+        if (magnitude < 1000000000000000000ULL) {
+            std::string field = actual + ",";
+            _csi_log_cursor_t cursor = {field.data(), field.data() + field.size()};
+            parse_ok = _csi_log_timestamp_us(&cursor, &parsed, ',') && parsed == us;
+        }
+        if (actual != expected || !parse_ok) {
+            if (mismatches++ < 10) {
+                printf("timestamp mismatch for %lld us: expected %s, formatter %s, parsed %lld\n", (long long) us,
+                       expected, actual.c_str(), (long long) parsed);
+            }
+        }
+    }
+    printf("timestamps checked: %zu, mismatches: %d\n", candidates.size(), mismatches);
+
+    // a millisecond worth of consecutive microseconds at a current epoch time, written out and read back
+    const int64_t epoch_us = 1700000000123456LL;
+    const int consecutive = 1000;
+    std::set<std::string> legacy_distinct, distinct;
+    int64_t legacy_error = 0, error = 0;
+    for (int i = 0; i < consecutive; i++) {
+        int64_t us = epoch_us + i;
+        std::stringstream ss;
+        ss << us / 1000000.0;
+        legacy_distinct.insert(ss.str());
+        legacy_error = std::max(legacy_error, std::abs((int64_t) llround(strtod(ss.str().c_str(), NULL) * 1000000.0) - us));
+
+        csi_format_reset(&b);
+        csi_format_timestamp_us(&b, us);
+        std::string field(b.buf, b.len);
+        distinct.insert(field);
+        field += ",";
+        _csi_log_cursor_t cursor = {field.data(), field.data() + field.size()};
+        int64_t parsed = 0;
+        _csi_log_timestamp_us(&cursor, &parsed, ',');
+        error = std::max(error, std::abs(parsed - us));
+    }
+    printf("%d consecutive us at %lld.%06lld s:\n", consecutive, (long long) (epoch_us / 1000000),
+           (long long) (epoch_us % 1000000));
+    printf("  double seconds: %4zu distinct values, read back off by up to %lld us (e.g. %s)\n",
+           legacy_distinct.size(), (long long) legacy_error, legacy_distinct.begin()->c_str());
+    printf("  integer us:     %4zu distinct values, read back off by up to %lld us\n", distinct.size(),
+           (long long) error);
+    if (distinct.size() != (size_t) consecutive || error != 0) {
+        mismatches++;
+    }
+
+    // per frame: the clock read and the timestamp's share of formatting the line
+    int64_t offsets_us[2] = {0, 1700000000000000LL};
+    std::atomic<int> offset_index(1);
+    std::stringstream ss;
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
+        ss.str("");
+        ss << seconds;
+        sink += ss.tellp();
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        int64_t steady_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t real_us = steady_us + offsets_us[offset_index.load(std::memory_order_acquire)];
+        csi_format_reset(&b);
+        csi_format_timestamp_us(&b, real_us);
+        sink += b.len;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double legacy_ns = std::chrono::duration<double, std::nano>(middle - start).count() / iterations;
+    double fast_ns = std::chrono::duration<double, std::nano>(end - middle).count() / iterations;
+    printf("double seconds, <<:                 %6.1f ns/frame\n", legacy_ns);
+    printf("integer us, csi_format_timestamp_us: %6.1f ns/frame (%.1fx)\n", fast_ns, legacy_ns / fast_ns);
+    printf("(%zu bytes formatted)\n", sink);
+
+    return mismatches == 0 ? 0 : 1;
+}
+
+/*
+ * Bytes per frame and the frame rate a UART (8N1, so 10 bits per byte) could sustain for CSV and binary output.
+ */
+static int bench_binary(const char *file_name, int baud, int iterations) {
+    std::vector<frame_t> frames;
+    if (!load_frames(file_name, &frames)) {
+        return 1;
+    }
+
+    static csi_format_buffer_t b;
+    static uint8_t out[CSI_BINARY_MAX_RECORD_SIZE];
+    const char *type = "AP";
+
+    size_t csv_bytes = 0;
+    size_t binary_bytes = 0;
+    int mismatches = 0;
+    for (const frame_t &frame : frames) {
+        std::string csv = fast_format(&b, type, frame.record, frame.values.data(), frame.values.size());
+        size_t len = csi_binary_encode_csi(out, sizeof(out), &frame.record, frame.values.data(), frame.values.size());
+        csv_bytes += csv.size();
+        binary_bytes += len;
+
+        csi_binary_record_t record;
+        size_t consumed;
+        if (csi_binary_decode(out, len, &consumed, &record) != CSI_BINARY_DECODED || consumed != len
+            || fast_format(&b, type, record.record, record.values, record.value_count) != csv) {
+            mismatches++;
+        }
+    }
+
+    double csv_per_frame = (double) csv_bytes / frames.size();
+    double binary_per_frame = (double) binary_bytes / frames.size();
+    printf("round trip mismatches: %d\n", mismatches);
+    printf("csv:    %7.1f bytes/frame, %7.1f frames/s at %d baud\n", csv_per_frame, baud / 10.0 / csv_per_frame, baud);
+    printf("binary: %7.1f bytes/frame, %7.1f frames/s at %d baud\n", binary_per_frame, baud / 10.0 / binary_per_frame, baud);
+
+    size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        const frame_t &frame = frames[i % frames.size()];
+        sink += csi_binary_encode_csi(out, sizeof(out), &frame.record, frame.values.data(), frame.values.size());
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        csi_binary_record_t record;
+        size_t consumed;
+        csi_binary_decode(out, sizeof(out), &consumed, &record);
+        sink += consumed;
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("encode: %7.1f ns/frame\n", std::chrono::duration<double, std::nano>(middle - start).count() / iterations);
+    printf("decode: %7.1f ns/frame\n", std::chrono::duration<double, std::nano>(end - middle).count() / iterations);
+    printf("(%zu bytes processed)\n", sink);
+
+    return mismatches == 0 ? 0 : 1;
+}
+
+/*
+ * Writes roughly `megabytes` of CSV built from the rows of `file_name`, damaging every 997th line the way
+ * a serial capture would (truncated, or with bytes missing), then parses it with one and with all threads.
+ */
+static int bench_parse(const char *file_name, const char *synthetic_name, size_t megabytes) {
+    std::ifstream f(file_name);
+    std::vector<std::string> rows;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.compare(0, 9, "CSI_DATA,") == 0) {
+            rows.push_back(line + "\n");
+        }
+    }
+    if (rows.empty()) {
+        printf("ERROR: no CSI_DATA lines in %s\n", file_name);
+        return 1;
+    }
+
+    FILE *out = fopen(synthetic_name, "wb");
+    if (out == NULL) {
+        printf("ERROR: cannot write %s\n", synthetic_name);
+        return 1;
+    }
+    fputs(CSI_CSV_HEADER, out);
+    size_t written = 0;
+    size_t good = 0;
+    size_t damaged = 0;
+    for (size_t i = 0; written < megabytes * 1000000; i++) {
+        const std::string &row = rows[i % rows.size()];
+        if (i % 997 == 996) {
+            std::string bad = (damaged % 2 == 0) ? row.substr(0, row.size() / 2) + "\n"
+                                                 : row.substr(0, 60) + row.substr(64);
+            fwrite(bad.data(), 1, bad.size(), out);
+            written += bad.size();
+            damaged++;
+        } else {
+            fwrite(row.data(), 1, row.size(), out);
+            written += row.size();
+            good++;
+        }
+    }
+    fclose(out);
+    printf("wrote %.1f MB: %zu good lines, %zu damaged lines\n", written / 1e6, good, damaged);
+
+    int failures = 0;
+    for (unsigned threads : {1u, std::max(1u, std::thread::hardware_concurrency())}) {
+        csi_columns_t columns;
+        auto start = std::chrono::steady_clock::now();
+        csi_log_parse_file(synthetic_name, threads, &columns);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bool ok = columns.rows() == good && columns.malformed_lines == damaged;
+        failures += !ok;
+        printf("%2u threads: %zu rows, %zu malformed, %.3f s, %.1f MB/s, %.2f M rows/s%s\n",
+               threads, columns.rows(), columns.malformed_lines, seconds, written / 1e6 / seconds,
+               columns.rows() / seconds / 1e6, ok ? "" : " (MISMATCH)");
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+/*
+ * Checks the amplitude/phase kernels against the double precision formulas over every possible (imag, real) pair,
+ * then times them against the per-value loop the firmware used before.
+ */
+static int bench_math(int frames) {
+    const int pairs = 256 * 256;
+    std::vector<int8_t> iq(pairs * 2);
+    for (int k = 0; k < pairs; k++) {
+        iq[k * 2] = (int8_t) (k >> 8);
+        iq[k * 2 + 1] = (int8_t) (k & 0xFF);
+    }
+
+    std::vector<float> amplitude(pairs), phase(pairs);
+    std::vector<uint16_t> amplitude_q8(pairs);
+    std::vector<int16_t> phase_q15(pairs);
+    csi_amplitude_f32(iq.data(), pairs, amplitude.data());
+    csi_phase_f32(iq.data(), pairs, phase.data());
+    csi_amplitude_q8(iq.data(), pairs, amplitude_q8.data());
+    csi_phase_q15(iq.data(), pairs, phase_q15.data());
+
+    double amplitude_error = 0, phase_error = 0, scalar_phase_error = 0;
+    int q8_error = 0, q15_error = 0, truncation_mismatches = 0;
+    for (int k = 0; k < pairs; k++) {
+        int imag = iq[k * 2];
+        int real = iq[k * 2 + 1];
+        double a = sqrt(pow(imag, 2) + pow(real, 2));
+        double p = atan2(imag, real);
+        amplitude_error = std::max(amplitude_error, fabs(amplitude[k] - a));
+        phase_error = std::max(phase_error, fabs(phase[k] - p));
+        scalar_phase_error = std::max(scalar_phase_error, fabs(csi_math_atan2(imag, real) - p));
+        q8_error = std::max(q8_error, abs(amplitude_q8[k] - (int) lround(a * 256)));
+        int expected_q15 = std::min(32767L, lround(p * 32768 / M_PI));
+        q15_error = std::max(q15_error, abs(phase_q15[k] - expected_q15));
+        // the CSI_AMPLITUDE / CSI_PHASE output must not change
+        if ((int) amplitude[k] != (int) a || (int) phase[k] != (int) p) {
+            truncation_mismatches++;
+        }
+    }
+    printf("max error: amplitude %.3g, phase %.3g rad (scalar %.3g rad), amplitude_q8 %d LSB, phase_q15 %d LSB\n",
+           amplitude_error, phase_error, scalar_phase_error, q8_error, q15_error);
+    printf("(int) output mismatches against sqrt(pow(..)) / atan2(imag, real): %d\n", truncation_mismatches);
+
+    // imag comes first in the buffer: (imag 1, real 0) is +pi/2, (imag 0, real -1) is pi
+    int8_t order[4] = {1, 0, 0, -1};
+    float order_phase[2];
+    csi_phase_f32(order, 2, order_phase);
+    bool order_ok = fabs(order_phase[0] - M_PI / 2) < 1e-6 && fabs(order_phase[1] - M_PI) < 1e-6;
+    printf("imag/real order: %s\n", order_ok ? "ok" : "WRONG");
+
+    const int frame_pairs = 64;
+    size_t frame_count = pairs / frame_pairs;
+    std::vector<float> out(frame_pairs);
+    double sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        const int8_t *frame = iq.data() + (f % frame_count) * frame_pairs * 2;
+        for (int i = 0; i < frame_pairs; i++) {
+            out[i] = sqrt(pow(frame[i * 2], 2) + pow(frame[(i * 2) + 1], 2));
+            out[i] += atan2(frame[i * 2], frame[(i * 2) + 1]);
+        }
+        sink += out[f % frame_pairs];
+    }
+    auto middle = std::chrono::steady_clock::now();
+    std::vector<float> out_phase(frame_pairs);
+    for (int f = 0; f < frames; f++) {
+        const int8_t *frame = iq.data() + (f % frame_count) * frame_pairs * 2;
+        csi_amplitude_f32(frame, frame_pairs, out.data());
+        csi_phase_f32(frame, frame_pairs, out_phase.data());
+        sink += out[f % frame_pairs] + out_phase[f % frame_pairs];
+    }
+    auto end = std::chrono::steady_clock::now();
+
+#if defined(__AVX2__)
+    const char *kernel = "avx2";
+#elif defined(__SSE2__)
+    const char *kernel = "sse2";
+#else
+    const char *kernel = "scalar";
+#endif
+    double reference_ns = std::chrono::duration<double, std::nano>(middle - start).count() / frames;
+    double kernel_ns = std::chrono::duration<double, std::nano>(end - middle).count() / frames;
+    printf("double sqrt/atan2: %8.1f ns/frame (%d subcarriers)\n", reference_ns, frame_pairs);
+    printf("%-17s: %8.1f ns/frame (%.1fx)\n", kernel, kernel_ns, reference_ns / kernel_ns);
+    printf("(%g)\n", sink);
+
+    bool ok = phase_error < 1e-6 && amplitude_error < 1e-4 && q8_error <= 1 && q15_error <= 1
+              && truncation_mismatches == 0 && order_ok;
+    return ok ? 0 : 1;
+}
+
+static void fill_slot(csi_ring_slot_t *slot, uint32_t seq) {
+    slot->record.local_timestamp = seq;
+    slot->data_len = 128 + seq % (CSI_RING_SLOT_DATA_SIZE - 128);
+    for (int i = 0; i < slot->data_len; i++) {
+        slot->data[i] = (int8_t) (seq + i);
+    }
+}
+
+static bool slot_intact(const csi_ring_slot_t *slot) {
+    uint32_t seq = slot->record.local_timestamp;
+    if (slot->data_len != 128 + seq % (CSI_RING_SLOT_DATA_SIZE - 128)) {
+        return false;
+    }
+    for (int i = 0; i < slot->data_len; i++) {
+        if (slot->data[i] != (int8_t) (seq + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Drives `csi_ring_t` from a producer and a consumer thread, the same way the Wi-Fi callback and CSI writer task do.
+ * With `paced` set the producer never gets more than a ring ahead, so nothing may be dropped.
+ */
+static int stress_ring(uint32_t frames, bool paced) {
+    static csi_ring_t ring;
+    csi_ring_reset(&ring);
+
+    uint32_t received = 0;
+    uint32_t corrupt = 0;
+    uint32_t out_of_order = 0;
+    std::atomic<bool> done(false);
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        int64_t last_seq = -1;
+        while (true) {
+            csi_ring_slot_t *slot = csi_ring_peek(&ring);
+            if (slot == NULL) {
+                if (done.load() && csi_ring_peek(&ring) == NULL) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            if (!slot_intact(slot)) {
+                corrupt++;
+            }
+            if ((int64_t) slot->record.local_timestamp <= last_seq) {
+                out_of_order++;
+            }
+            last_seq = slot->record.local_timestamp;
+            received++;
+            csi_ring_release(&ring);
+        }
+    });
+
+    for (uint32_t seq = 0; seq < frames; seq++) {
+        if (paced) {
+            while (ring.head.load() - ring.tail.load() >= CSI_RING_SLOT_COUNT) {
+                std::this_thread::yield();
+            }
+        }
+        csi_ring_slot_t *slot = csi_ring_acquire(&ring);
+        if (slot != NULL) {
+            fill_slot(slot, seq);
+            csi_ring_publish(&ring);
+        }
+    }
+    done.store(true);
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+
+    uint32_t dropped = csi_ring_dropped(&ring);
+    double seconds = std::chrono::duration<double>(end - start).count();
+    printf("%s: sent %u, received %u, dropped %u, corrupt %u, out of order %u (%.2f M frames/s)\n",
+           paced ? "paced" : "unpaced", frames, received, dropped, corrupt, out_of_order, frames / seconds / 1e6);
+
+    bool ok = corrupt == 0 && out_of_order == 0 && received + dropped == frames && (!paced || dropped == 0);
+    return ok ? 0 : 1;
+}
+
+static int bench_ring(uint32_t frames) {
+    return stress_ring(frames, true) | stress_ring(frames, false);
+}
+
+// flusher side of `sd_buffer_t`, standing in for `sd_writer_task`
+static std::mutex sd_mutex;
+static std::condition_variable sd_wake;
+static bool sd_pending = false;
+
+static void sd_notify_flusher() {
+    {
+        std::lock_guard<std::mutex> lock(sd_mutex);
+        sd_pending = true;
+    }
+    sd_wake.notify_one();
+}
+
+static void sd_wait_for_flusher() {
+    std::this_thread::yield();
+}
+
+// record `seq` is "REC,<seq>,<payload>\n" with a payload of 40 to 1239 bytes derived from `seq`
+static size_t sd_record(char *out, uint64_t seq) {
+    size_t len = sprintf(out, "REC,%llu,", (unsigned long long) seq);
+    size_t payload = 40 + (seq * 2654435761u) % 1200;
+    for (size_t i = 0; i < payload; i++) {
+        out[len++] = 'a' + (seq + i) % 26;
+    }
+    out[len++] = '\n';
+    return len;
+}
+
+struct sd_run_t {
+    uint64_t records;
+    uint64_t bytes;
+    double seconds;
+    uint32_t unaligned_writes;
+};
+
+/*
+ * Writes `bytes` worth of records through `sd_buffer_t` into `file_name`, with a flusher thread in place of the
+ * SD writer task. With `simulated_clock` each record advances time by 1 ms and the sync interval is 50 ms,
+ * so buffers are regularly handed over part filled.
+ */
+static sd_run_t sd_run(const char *file_name, uint64_t bytes, bool simulated_clock) {
+    static sd_buffer_t buffer;
+    sd_run_t run = {0, 0, 0, 0};
+    int fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: cannot write %s\n", file_name);
+        return run;
+    }
+    int64_t sync_interval_us = simulated_clock ? 50000 : 1000000;
+    sd_buffer_init(&buffer, fd, sync_interval_us, 256 * 1024, &sd_notify_flusher, &sd_wait_for_flusher);
+
+    std::atomic<bool> done(false);
+    auto start = std::chrono::steady_clock::now();
+    auto now_us = [&](uint64_t record) -> int64_t {
+        if (simulated_clock) {
+            return record * 1000;
+        }
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    std::thread flusher([&]() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(sd_mutex);
+                sd_wake.wait(lock, [&]() { return sd_pending || done.load(); });
+                sd_pending = false;
+            }
+            while (true) {
+                // full buffers must end on a cluster boundary, only synced (part filled) ones may not
+                bool partial = buffer.sync_requested[buffer.next_flush];
+                if (!sd_buffer_flush_next(&buffer, now_us(run.records))) {
+                    break;
+                }
+                if (!partial && buffer.bytes_written.load() % SD_BUFFER_SIZE != 0) {
+                    run.unaligned_writes++;
+                }
+            }
+            if (done.load() && buffer.state[buffer.next_flush].load() == SD_BUFFER_FREE) {
+                break;
+            }
+        }
+    });
+
+    char record[1300];
+    while (run.bytes < bytes) {
+        size_t len = sd_record(record, run.records);
+        sd_buffer_append(&buffer, record, len, now_us(run.records));
+        run.records++;
+        run.bytes += len;
+        if (run.records % 16 == 0) {
+            sd_buffer_poll(&buffer, now_us(run.records));
+        }
+    }
+    sd_buffer_sync(&buffer);
+    done.store(true);
+    sd_notify_flusher();
+    flusher.join();
+    close(fd);
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s clock: %llu records, %.1f MB in %u writes (%u syncs, %u stalls, %u errors), %.1f MB/s\n",
+           simulated_clock ? "simulated" : "real", (unsigned long long) run.records, run.bytes / 1e6,
+           buffer.writes.load(), buffer.syncs.load(), buffer.stalls.load(), buffer.write_errors.load(),
+           run.bytes / 1e6 / run.seconds);
+    return run;
+}
+
+/*
+ * Checks that `file_name` holds exactly records 0 .. `records` - 1, in order and intact.
+ */
+static bool sd_verify(const char *file_name, uint64_t records) {
+    std::ifstream in(file_name, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    char expected[1300];
+    size_t pos = 0;
+    for (uint64_t seq = 0; seq < records; seq++) {
+        size_t len = sd_record(expected, seq);
+        if (contents.compare(pos, len, expected, len) != 0) {
+            printf("record %llu missing or damaged at offset %zu\n", (unsigned long long) seq, pos);
+            return false;
+        }
+        pos += len;
+    }
+    if (pos != contents.size()) {
+        printf("%zu unexpected trailing bytes\n", contents.size() - pos);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The previous SD path: every record went through `vfprintf` on a FILE with newlib's small default buffer.
+ */
+static double sd_line_by_line(const char *file_name, uint64_t bytes) {
+    FILE *f = fopen(file_name, "w");
+    if (f == NULL) {
+        return 0;
+    }
+    setvbuf(f, NULL, _IOFBF, 128);
+    char record[1300];
+    uint64_t written = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t seq = 0; written < bytes; seq++) {
+        size_t len = sd_record(record, seq);
+        fprintf(f, "%.*s", (int) len, record);
+        written += len;
+    }
+    fclose(f);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // on the card every one of these writes is a separate (unaligned) sector update
+    printf("line by line: %.1f MB in ~%llu writes of 128 bytes, %.1f MB/s\n", written / 1e6,
+           (unsigned long long) (written / 128), written / 1e6 / seconds);
+    return written / seconds;
+}
+
+static int bench_sd(const char *file_name, uint64_t megabytes) {
+    uint64_t bytes = megabytes * 1000000;
+    sd_line_by_line(file_name, bytes);
+
+    sd_run_t real = sd_run(file_name, bytes, false);
+    bool real_ok = sd_verify(file_name, real.records);
+    sd_run_t simulated = sd_run(file_name, bytes / 10, true);
+    bool simulated_ok = sd_verify(file_name, simulated.records);
+
+    printf("records intact: %s / %s, unaligned full-buffer writes: %u / %u\n", real_ok ? "yes" : "NO",
+           simulated_ok ? "yes" : "NO", real.unaligned_writes, simulated.unaligned_writes);
+    bool ok = real_ok && simulated_ok && real.unaligned_writes == 0 && simulated.unaligned_writes == 0;
+    return ok ? 0 : 1;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Times finding the next segment in a directory which already holds `existing` segments,
+ * without an index (first boot after an update), with an up to date index and with a stale one.
+ */
+static bool segment_startup(const std::string &dir, uint32_t existing) {
+    for (uint32_t i = 0; i < existing; i++) {
+        close(open((dir + "/" + std::to_string(i) + ".csv").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    }
+    sd_segment_t s;
+    sd_segment_init(&s, dir.c_str(), "csv", false, 0, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    int fd = sd_segment_open_next(&s);
+    double no_index = seconds_since(start);
+    close(fd);
+    uint32_t no_index_probes = s.probes;
+    bool ok = s.segment == existing;
+
+    start = std::chrono::steady_clock::now();
+    fd = sd_segment_open_next(&s);
+    double with_index = seconds_since(start);
+    close(fd);
+    ok = ok && s.segment == existing + 1 && s.probes == 1;
+
+    _sd_segment_write_index(&s, existing - 10);
+    fd = sd_segment_open_next(&s);
+    close(fd);
+    ok = ok && s.segment == existing + 2 && s.probes == 13;
+
+    printf("%u segments: next segment without index %.3f ms (%u stats), with index %.3f ms (%u stat), "
+           "stale index %u stats\n", existing, no_index * 1e3, no_index_probes, with_index * 1e3, 1u, s.probes);
+    return ok;
+}
+
+/*
+ * Writes `records` records through `sd_buffer_t` into segments of at most `max_bytes`, rotating the same way as
+ * `outwrite`, then checks every footer and that the segments together hold every record exactly once.
+ */
+static bool segment_rotation(const std::string &dir, uint64_t records, uint64_t max_bytes) {
+    static sd_buffer_t buffer;
+    sd_segment_t s;
+    sd_segment_init(&s, dir.c_str(), "csv", false, max_bytes, 0);
+    int fd = sd_segment_open_next(&s);
+    uint32_t first_segment = s.segment;
+    sd_buffer_init(&buffer, fd, 1000000, 256 * 1024, &sd_notify_flusher, &sd_wait_for_flusher);
+
+    std::atomic<bool> done(false);
+    std::thread flusher([&]() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(sd_mutex);
+                sd_wake.wait(lock, [&]() { return sd_pending || done.load(); });
+                sd_pending = false;
+            }
+            while (sd_buffer_flush_next(&buffer, 0)) {
+            }
+            if (done.load() && buffer.state[buffer.next_flush].load() == SD_BUFFER_FREE) {
+                break;
+            }
+        }
+    });
+
+    auto header = [&](int64_t now_us) {
+        sd_buffer_append(&buffer, CSI_CSV_HEADER, strlen(CSI_CSV_HEADER), now_us);
+        sd_segment_add(&s, strlen(CSI_CSV_HEADER), 0, now_us);
+    };
+    auto footer = [&](int64_t now_us) {
+        uint8_t out[SD_SEGMENT_FOOTER_CSV_SIZE + 1];
+        sd_buffer_append(&buffer, out, sd_segment_footer(&s, out, sizeof(out)), now_us);
+    };
+
+    header(0);
+    char record[1300];
+    for (uint64_t seq = 0; seq < records; seq++) {
+        int64_t now_us = seq * 1000;
+        if (sd_segment_full(&s, now_us)) {
+            footer(now_us);
+            sd_buffer_switch_file(&buffer, sd_segment_open_next(&s));
+            header(now_us);
+        }
+        size_t len = sd_record(record, seq);
+        sd_buffer_append(&buffer, record, len, now_us);
+        sd_segment_add(&s, len, 1, now_us);
+    }
+    footer(records * 1000);
+    sd_buffer_switch_file(&buffer, -1);
+    done.store(true);
+    sd_notify_flusher();
+    flusher.join();
+
+    // read every segment back, using only the footers to locate records
+    uint64_t seq = 0;
+    bool ok = true;
+    for (uint32_t segment = first_segment; segment <= s.segment && ok; segment++) {
+        std::string path = dir + "/" + std::to_string(segment) + ".csv";
+        sd_segment_footer_t f;
+        if (!sd_segment_read_footer(path.c_str(), &f) || f.segment != segment
+            || f.first_us != (int64_t) seq * 1000 || f.last_us != (int64_t) (seq + f.records - 1) * 1000) {
+            printf("bad footer in %s\n", path.c_str());
+            ok = false;
+            break;
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        size_t pos = strlen(CSI_CSV_HEADER);
+        ok = contents.compare(0, pos, CSI_CSV_HEADER) == 0;
+        for (uint32_t i = 0; i < f.records && ok; i++, seq++) {
+            size_t len = sd_record(record, seq);
+            ok = contents.compare(pos, len, record, len) == 0;
+            pos += len;
+        }
+        ok = ok && contents.size() == pos + SD_SEGMENT_FOOTER_CSV_SIZE;
+        if (!ok) {
+            printf("%s does not hold the expected records\n", path.c_str());
+        }
+    }
+    ok = ok && seq == records;
+
+    printf("rotation: %llu records in %u segments of ~%llu bytes, footers and contents %s (%u stalls)\n",
+           (unsigned long long) records, s.segment - first_segment + 1, (unsigned long long) max_bytes,
+           ok ? "ok" : "WRONG", buffer.stalls.load());
+    return ok;
+}
+
+static int bench_segment(const char *dir, uint32_t existing) {
+    std::string startup_dir = std::string(dir) + "/startup";
+    std::string rotation_dir = std::string(dir) + "/rotation";
+    if (system(("rm -rf '" + std::string(dir) + "' && mkdir -p '" + startup_dir + "' '" + rotation_dir + "'").c_str())
+        != 0) {
+        fprintf(stderr, "ERROR: cannot create %s\n", dir);
+        return 1;
+    }
+    bool ok = segment_startup(startup_dir, existing) && segment_rotation(rotation_dir, 20000, 256 * 1024);
+    return ok ? 0 : 1;
+}
+
+/*
+ * Synthetic sender for `csi_udp_collector.h` over loopback. Datagrams are packed like `udp_stream_component.h`
+ * does, then some are deliberately not sent, sent late or sent twice. Checks that the collector reports exactly
+ * those, and that its CSV holds exactly the records of the datagrams which were delivered.
+ */
+static int bench_udp(const char *file_name, uint32_t frame_count) {
+    std::vector<frame_t> frames;
+    if (!load_frames(file_name, &frames)) {
+        return 1;
+    }
+
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    struct timeval timeout = {0, 100000};
+    setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (bind(rx, (struct sockaddr *) &addr, sizeof(addr)) != 0 || getsockname(rx, (struct sockaddr *) &addr, &addr_len) != 0) {
+        printf("ERROR: cannot bind a loopback socket\n");
+        return 1;
+    }
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(tx, (struct sockaddr *) &addr, sizeof(addr));
+
+    char *csv = NULL;
+    size_t csv_len = 0;
+    udp_collector_t collector;
+    collector.out = open_memstream(&csv, &csv_len);
+
+    std::atomic<uint64_t> handled(0);
+    std::atomic<bool> done(false);
+    std::thread receiver([&]() {
+        std::vector<uint8_t> buf(UDP_BATCH_MAX_SIZE);
+        struct sockaddr_in sender;
+        while (!done.load()) {
+            socklen_t sender_len = sizeof(sender);
+            ssize_t n = recvfrom(rx, buf.data(), buf.size(), 0, (struct sockaddr *) &sender, &sender_len);
+            if (n > 0) {
+                udp_collector_datagram(&collector, ((uint64_t) ntohl(sender.sin_addr.s_addr) << 16) | ntohs(sender.sin_port),
+                                       buf.data(), n);
+                handled++;
+            }
+        }
+    });
+
+    std::vector<std::vector<uint8_t>> sent;
+    auto send = [&](const std::vector<uint8_t> &datagram) {
+        ::send(tx, datagram.data(), datagram.size(), 0);
+        sent.push_back(datagram);
+        // keep the socket buffer from overflowing, which would make the loss count unpredictable
+        while (sent.size() - handled.load() > 32) {
+            std::this_thread::yield();
+        }
+    };
+
+    static csi_format_buffer_t b;
+    static udp_batch_t batch;
+    udp_batch_init(&batch, 0x5EED);
+    std::vector<std::string> expected;
+    std::vector<std::string> pending;
+    std::vector<uint8_t> held;
+    uint64_t planned_lost = 0, planned_reordered = 0, planned_duplicates = 0;
+
+    auto flush = [&](bool last) {
+        udp_batch_finish(&batch);
+        std::vector<uint8_t> datagram(batch.data, batch.data + batch.len);
+        uint32_t k = batch.sequence;
+        // (a lost final datagram cannot be noticed)
+        if (k % 50 == 49 && !last) {
+            planned_lost++;
+        } else {
+            expected.insert(expected.end(), pending.begin(), pending.end());
+            if (k % 37 == 36 && !last) {
+                held = datagram;
+                planned_reordered++;
+            } else {
+                send(datagram);
+                if (!held.empty()) {
+                    send(held);
+                    held.clear();
+                }
+                if (k % 101 == 100) {
+                    send(datagram);
+                    planned_duplicates++;
+                }
+            }
+        }
+        pending.clear();
+        udp_batch_next(&batch);
+    };
+    auto add = [&](const uint8_t *record, size_t len, const std::string &line) {
+        if (!udp_batch_add(&batch, record, len)) {
+            flush(false);
+            udp_batch_add(&batch, record, len);
+        }
+        if (!line.empty()) {
+            pending.push_back(line);
+        }
+    };
+
+    uint8_t record[CSI_BINARY_MAX_RECORD_SIZE];
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frame_count; i++) {
+        if (i % 256 == 0) {
+            add(record, csi_binary_encode_role(record, sizeof(record), "STA"), "");
+        }
+        if (i % 1000 == 999) {
+            add(record, csi_binary_encode_dropped(record, sizeof(record), i, 1),
+                "CSI_DROPPED,STA," + std::to_string(i) + ",1\n");
+        }
+        frame_t frame = frames[i % frames.size()];
+        frame.record.local_timestamp = i;
+        add(record, csi_binary_encode_csi(record, sizeof(record), &frame.record, frame.values.data(), frame.values.size()),
+            fast_format(&b, "STA", frame.record, frame.values.data(), frame.values.size()));
+    }
+    flush(true);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (handled.load() < sent.size() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    double seconds = seconds_since(start);
+    done.store(true);
+    receiver.join();
+    fclose(collector.out);
+
+    std::vector<std::string> lines;
+    for (size_t pos = 0; pos < csv_len;) {
+        const char *eol = (const char *) memchr(csv + pos, '\n', csv_len - pos);
+        size_t len = eol == NULL ? csv_len - pos : eol - (csv + pos) + 1;
+        lines.emplace_back(csv + pos, len);
+        pos += len;
+    }
+    free(csv);
+    std::sort(lines.begin(), lines.end());
+    std::sort(expected.begin(), expected.end());
+
+    const udp_source_t &source = collector.sources.begin()->second;
+    printf("loopback: %u frames in %zu datagrams (%.1f frames/datagram), %.0f frames/s\n", frame_count, sent.size(),
+           (double) frame_count / sent.size(), frame_count / seconds);
+    udp_collector_print_stats(&collector, stdout);
+    printf("planned: %llu lost, %llu reordered, %llu duplicates\n", (unsigned long long) planned_lost,
+           (unsigned long long) planned_reordered, (unsigned long long) planned_duplicates);
+
+    bool ok = collector.sources.size() == 1 && source.sequence.lost == planned_lost
+              && source.sequence.reordered == planned_reordered && source.sequence.duplicates == planned_duplicates
+              && lines == expected;
+    printf("CSV rows as expected: %s\n", lines == expected ? "yes" : "NO");
+
+    // collector cost on its own, without the sockets
+    udp_collector_t replay;
+    replay.out = fopen("/dev/null", "w");
+    start = std::chrono::steady_clock::now();
+    for (const std::vector<uint8_t> &datagram : sent) {
+        udp_collector_datagram(&replay, 1, datagram.data(), datagram.size());
+    }
+    seconds = seconds_since(start);
+    fclose(replay.out);
+    printf("collector: %.0f datagrams/s, %.0f CSI records/s per core\n", sent.size() / seconds,
+           replay.sources.begin()->second.csi_records / seconds);
+
+    close(tx);
+    close(rx);
+    return ok ? 0 : 1;
+}
+
+// nearest rank percentile of sorted `values`, as `csi_histogram_percentile()` estimates it
+static uint32_t exact_percentile(const std::vector<uint32_t> &sorted, uint32_t permille) {
+    uint64_t rank = std::max<uint64_t>(1, ((uint64_t) sorted.size() * permille + 999) / 1000);
+    return sorted[rank - 1];
+}
+
+static bool check_histogram(const char *name, const std::vector<uint32_t> &values) {
+    csi_histogram_t h, first, second;
+    csi_histogram_reset(&h);
+    csi_histogram_reset(&first);
+    csi_histogram_reset(&second);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        csi_histogram_add(&h, values[i]);
+        csi_histogram_add(i % 2 ? &second : &first, values[i]);
+        sum += values[i];
+    }
+    csi_histogram_merge(&first, &second);
+
+    std::vector<uint32_t> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+    bool ok = h.count == values.size() && h.min == sorted.front() && h.max == sorted.back()
+              && csi_histogram_mean(&h) == (uint32_t) (sum / values.size())
+              && memcmp(&first, &h, sizeof(h)) == 0;
+    double worst = 0;
+    for (uint32_t permille : {1u, 100u, 500u, 900u, 990u, 999u, 1000u}) {
+        uint32_t exact = exact_percentile(sorted, permille);
+        uint32_t estimate = csi_histogram_percentile(&h, permille);
+        // never below the true value, and at most one bucket (1/8 of the value) above it
+        if (estimate < exact || estimate - exact > exact / 8) {
+            ok = false;
+        }
+        if (exact > 0) {
+            worst = std::max(worst, (double) (estimate - exact) / exact);
+        }
+    }
+    printf("%-12s %zu values, p99 exact %u, histogram %u, worst percentile error %.1f%%: %s\n", name, values.size(),
+           exact_percentile(sorted, 990), csi_histogram_percentile(&h, 990), worst * 100, ok ? "ok" : "WRONG");
+    return ok;
+}
+
+static int bench_stats(uint32_t samples) {
+    bool ok = true;
+
+    // every bucket boundary maps back onto itself, and buckets are ordered
+    uint32_t previous_max = 0;
+    for (uint32_t i = 0; i < CSI_HISTOGRAM_BUCKETS; i++) {
+        uint32_t max = _csi_histogram_bucket_max(i);
+        if (_csi_histogram_bucket(max) != i
+            || (i > 0 && (max <= previous_max || _csi_histogram_bucket(previous_max + 1) != i))) {
+            ok = false;
+        }
+        previous_max = max;
+    }
+    ok = ok && previous_max == UINT32_MAX;
+    printf("%d buckets (%zu bytes per histogram), bucket boundaries: %s\n", CSI_HISTOGRAM_BUCKETS,
+           sizeof(csi_histogram_t), ok ? "ok" : "WRONG");
+
+    std::mt19937 rng(1);
+    std::vector<uint32_t> values(samples);
+    std::lognormal_distribution<double> latency(8, 1);
+    for (uint32_t &v : values) {
+        v = (uint32_t) std::min(4e9, latency(rng));
+    }
+    ok = check_histogram("lognormal", values) && ok;
+    std::uniform_int_distribution<uint32_t> any;
+    for (uint32_t &v : values) {
+        v = any(rng);
+    }
+    ok = check_histogram("uniform", values) && ok;
+    for (uint32_t i = 0; i < samples; i++) {
+        values[i] = i % 100 == 0 ? 1000000 : 1000 + i % 7;
+    }
+    ok = check_histogram("1% outliers", values) && ok;
+    ok = check_histogram("single", std::vector<uint32_t>(1, 12345)) && ok;
+
+    // more MACs than the table keeps: the first ones are counted exactly, the rest in `other_frames`
+    csi_mac_counts_t macs;
+    csi_mac_counts_reset(&macs);
+    const int mac_count = 100;
+    std::vector<uint32_t> expected(mac_count);
+    uint64_t frames = 0;
+    for (uint32_t i = 0; i < samples; i++) {
+        int m = (int) (i * 7919u % mac_count);
+        uint8_t mac[6] = {0x24, 0x0A, 0xC4, 0x00, (uint8_t) (m >> 8), (uint8_t) m};
+        csi_mac_counts_add(&macs, mac);
+        expected[m]++;
+        frames++;
+    }
+    uint64_t counted = macs.other_frames;
+    bool macs_ok = macs.used == CSI_STATS_MAC_SLOTS * 3 / 4;
+    for (const csi_mac_count_t &entry : macs.entries) {
+        if (entry.used) {
+            counted += entry.frames;
+            macs_ok = macs_ok && entry.frames == expected[entry.mac[4] << 8 | entry.mac[5]];
+        }
+    }
+    macs_ok = macs_ok && counted == frames;
+    printf("%d MACs: %u tracked, %u frames from other MACs, counts: %s\n", mac_count, macs.used, macs.other_frames,
+           macs_ok ? "ok" : "WRONG");
+    ok = ok && macs_ok;
+
+    csi_stats_t stats;
+    csi_stats_reset(&stats, 0);
+    uint8_t macs_seen[8][6] = {};
+    for (int m = 0; m < 8; m++) {
+        macs_seen[m][5] = m;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < samples; i++) {
+        csi_stats_frame(&stats, macs_seen[i & 7], 1 + (i % 3) * 5);
+        csi_stats_add(&stats, CSI_STATS_CALLBACK, values[i]);
+        csi_stats_add(&stats, CSI_STATS_QUEUE, values[i] * 3);
+        csi_stats_add(&stats, CSI_STATS_FORMAT, values[i] * 5);
+        csi_stats_add(&stats, CSI_STATS_OUTPUT, values[i] * 7);
+    }
+    double seconds = seconds_since(start);
+    printf("per frame (MAC count + 4 stages): %.1f ns\n", seconds * 1e9 / samples);
+
+    csi_format_buffer_t line;
+    start = std::chrono::steady_clock::now();
+    const int reports = 10000;
+    size_t report_bytes = 0;
+    for (int i = 0; i < reports; i++) {
+        csi_stats_format_summary(&line, "STA", &stats, 1000000);
+        report_bytes += line.len;
+    }
+    seconds = seconds_since(start);
+    printf("summary record (%zu bytes): %.2f us\n", report_bytes / reports, seconds * 1e6 / reports);
+    fwrite(line.buf, 1, line.len, stdout);
+    bool line_ok = strncmp(line.buf, "CSI_STATS,STA,1000,", 19) == 0 && !line.overflow
+                   && strstr(line.buf, ",callback_ns=") && strstr(line.buf, ",output_ns=")
+                   && line.buf[line.len - 1] == '\n';
+    printf("summary record: %s\n", line_ok ? "ok" : "WRONG");
+    ok = ok && line_ok;
+
+    return ok ? 0 : 1;
+}
+
+//
+// Simulated transmitter: wake-ups are late by a few tens of microseconds (occasionally by a lot more, as when
+// Wi-Fi stalls) and every send takes time. The clock is simulated, so an hour runs in well under a second.
+//
+struct tx_simulation_t {
+    std::mt19937 rng{7};
+
+    int64_t wake_latency_us() {
+        uint32_t r = rng() % 10000;
+        if (r == 0) {
+            return 20000 + rng() % 30000; // Wi-Fi stall
+        }
+        if (r < 100) {
+            return 200 + rng() % 800;
+        }
+        return 10 + rng() % 30;
+    }
+
+    int64_t send_cost_us() {
+        return 30 + rng() % 170;
+    }
+};
+
+struct tx_result_t {
+    uint64_t packets;
+    uint32_t skipped;
+    uint32_t late_p99_us;
+    uint32_t period_min_us;
+    uint32_t period_p99_us;
+    uint32_t period_max_us;
+};
+
+static tx_result_t simulate_scheduler(uint32_t rate, uint32_t burst, int64_t seconds) {
+    tx_simulation_t sim;
+    packet_scheduler_t s;
+    int64_t now_us = 0;
+    packet_scheduler_init(&s, rate, burst, now_us);
+    uint64_t packets = 0;
+    uint32_t skipped = 0;
+    while (now_us < seconds * 1000000) {
+        int64_t wait_us = packet_scheduler_wait_us(&s, now_us);
+        if (wait_us > 0) {
+            // short waits are busy-waited and exact, longer ones sleep on an esp_timer
+            now_us += wait_us < 50 ? wait_us : wait_us + sim.wake_latency_us();
+        }
+        if (now_us >= seconds * 1000000) {
+            break;
+        }
+        int64_t sent_us = now_us;
+        for (uint32_t i = 0; i < burst; i++) {
+            now_us += sim.send_cost_us();
+        }
+        packets += burst;
+        packet_scheduler_sent(&s, sent_us);
+        skipped += s.skipped;
+        s.skipped = 0;
+    }
+    return {packets, skipped, csi_histogram_percentile(&s.lateness_us, 990),
+            s.interval_us.min, csi_histogram_percentile(&s.interval_us, 990), s.interval_us.max};
+}
+
+// the previous `vTaskDelay(floor(1000 / rate))` + `ets_delay_us(remainder)` loop, at 1000 Hz ticks
+static uint64_t simulate_tick_delay(uint32_t rate, int64_t seconds) {
+    tx_simulation_t sim;
+    int64_t now_us = 0;
+    uint64_t packets = 0;
+    while (now_us < seconds * 1000000) {
+        now_us += sim.send_cost_us();
+        packets++;
+        int64_t ticks = 1000 / rate;
+        if (ticks > 0) {
+            // vTaskDelay(n) returns n tick interrupts later, the first of which comes after less than a tick
+            now_us = (now_us / 1000 + ticks) * 1000 + sim.wake_latency_us();
+        }
+        now_us += (int64_t) (((1000.0 / rate) - (1000 / rate)) * 1000);
+    }
+    return packets;
+}
+
+static int bench_scheduler(int64_t seconds) {
+    bool ok = true;
+    printf("%lld simulated seconds per row\n", (long long) seconds);
+    printf("rate burst   packets   expected  error  skipped  late p99  period min/p99/max us    old loop packets\n");
+    struct {
+        uint32_t rate;
+        uint32_t burst;
+    } cases[] = {{1, 1}, {3, 1}, {30, 1}, {100, 1}, {333, 1}, {1000, 1}, {2000, 1}, {1000, 4}, {4000, 8}};
+    for (const auto &c : cases) {
+        tx_result_t r = simulate_scheduler(c.rate, c.burst, seconds);
+        uint64_t expected = (uint64_t) c.rate * seconds;
+        // every skipped deadline is a whole burst which was never sent; apart from those the count must be
+        // within one burst of the ideal, however long the run
+        int64_t error = (int64_t) r.packets + (int64_t) r.skipped * c.burst - (int64_t) expected;
+        bool row_ok = error >= 0 && error <= (int64_t) c.burst;
+        ok = ok && row_ok;
+        uint64_t old_packets = c.burst == 1 ? simulate_tick_delay(c.rate, seconds) : 0;
+        printf("%4u %5u %9llu %10llu %6lld %8u %9u %8u/%u/%u %13s%s\n", c.rate, c.burst,
+               (unsigned long long) r.packets, (unsigned long long) expected, (long long) error, r.skipped,
+               r.late_p99_us, r.period_min_us, r.period_p99_us, r.period_max_us,
+               c.burst == 1 ? std::to_string(old_packets).c_str() : "-", row_ok ? "" : "  WRONG");
+    }
+    printf("long-run packet count (sent + skipped) within one burst of rate * time: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+static std::vector<uint8_t> from_hex(const char *hex) {
+    std::vector<uint8_t> bytes;
+    for (const char *p = hex; *p != '\0';) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        bytes.push_back((uint8_t) strtoul(std::string(p, 2).c_str(), NULL, 16));
+        p += 2;
+    }
+    return bytes;
+}
+
+static int bench_frame(uint32_t frames) {
+    bool ok = true;
+    const uint8_t bssid[6] = {0x3C, 0x71, 0xBF, 0x6D, 0x2A, 0x78};
+    const uint8_t self[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+
+    probe_frame_t data, action;
+    probe_frame_build_data(&data, bssid, self, PROBE_BROADCAST);
+    probe_frame_build_action(&action, self);
+    probe_frame_stamp(&data, 0x01020304, 0x1122334455667788);
+    probe_frame_stamp(&action, 0xFFFFFFFF, 1);
+
+    // templates byte for byte: header, body prefix, payload
+    struct {
+        const char *name;
+        const probe_frame_t *frame;
+        const char *hex;
+    } templates[] = {
+            {"data", &data,
+             "0801 0000 3C71BF6D2A78 240AC4000001 FFFFFFFFFFFF 0000 AAAA03000000 88B5"
+             " 43534950 01000000 04030201 8877665544332211"},
+            {"action", &action,
+             "D000 0000 FFFFFFFFFFFF 240AC4000001 240AC4000001 0000 7F 02C51D"
+             " 43534950 01000000 FFFFFFFF 0100000000000000"},
+    };
+    for (const auto &t : templates) {
+        std::vector<uint8_t> expected = from_hex(t.hex);
+        bool same = expected.size() == t.frame->len && memcmp(expected.data(), t.frame->data, t.frame->len) == 0;
+        printf("%-6s template (%zu bytes): %s\n", t.name, t.frame->len, same ? "ok" : "WRONG");
+        ok = ok && same;
+    }
+
+    // round trips, including the sequence number wrapping around and negative timestamps
+    struct {
+        uint32_t sequence;
+        int64_t timestamp_us;
+    } stamps[] = {{0, 0}, {1, 1}, {0x7FFFFFFF, -1}, {0xFFFFFFFF, INT64_MAX}, {12345, (int64_t) 1 << 40}};
+    bool round_trips = true;
+    for (const probe_frame_t *f : {&data, &action}) {
+        for (const auto &stamp : stamps) {
+            probe_frame_t copy = *f;
+            probe_frame_stamp(&copy, stamp.sequence, stamp.timestamp_us);
+            probe_payload_t payload;
+            round_trips = round_trips && probe_frame_parse(copy.data, copy.len, &payload)
+                          && payload.sequence == stamp.sequence && payload.tx_timestamp_us == stamp.timestamp_us
+                          // stamping only touches the payload fields
+                          && memcmp(copy.data, f->data, f->payload_offset + 8) == 0;
+        }
+    }
+    printf("stamp / parse round trips: %s\n", round_trips ? "ok" : "WRONG");
+    ok = ok && round_trips;
+
+    // anything else must not be taken for a probe: every truncation, and a changed byte in each checked field
+    bool rejects = true;
+    probe_payload_t payload;
+    for (const probe_frame_t *f : {&data, &action}) {
+        for (size_t len = 0; len < f->len; len++) {
+            rejects = rejects && !probe_frame_parse(f->data, len, &payload);
+        }
+        std::vector<size_t> checked = {0, f->payload_offset, f->payload_offset + 3, f->payload_offset + 4};
+        if (f == &data) {
+            checked.insert(checked.end(), {24, 25, 30, 31});
+        } else {
+            checked.insert(checked.end(), {24, 25, 26, 27});
+        }
+        for (size_t offset : checked) {
+            probe_frame_t copy = *f;
+            copy.data[offset] ^= 0x40;
+            rejects = rejects && !probe_frame_parse(copy.data, copy.len, &payload);
+        }
+    }
+    printf("truncated / foreign frames rejected: %s\n", rejects ? "ok" : "WRONG");
+    ok = ok && rejects;
+
+    // a datagram of the UDP transmitter on an open network: QoS data, LLC/SNAP, IPv4, UDP to `PROBE_UDP_PORT`
+    std::vector<uint8_t> udp = from_hex(
+            "8801 0000 3C71BF6D2A78 240AC4000001 FFFFFFFFFFFF 0000 0000 AAAA03000000 0800"
+            " 4500 0030 0000 4000 4011 0000 C0A80402 C0A804FF"
+            " 1F40 08AF 001C 0000");
+    uint8_t udp_payload[PROBE_PAYLOAD_SIZE];
+    probe_payload_stamp(udp_payload, 77, -5);
+    udp.insert(udp.end(), udp_payload, udp_payload + sizeof(udp_payload));
+    bool udp_ok = probe_frame_parse(udp.data(), udp.size(), &payload) && payload.sequence == 77
+                  && payload.tx_timestamp_us == -5;
+    // other port, encrypted frame, and UDP-in-IPv4 with options
+    for (size_t offset : {(size_t) 57, (size_t) 1}) {
+        std::vector<uint8_t> copy = udp;
+        copy[offset] ^= 0x40;
+        udp_ok = udp_ok && !probe_frame_parse(copy.data(), copy.size(), &payload);
+    }
+    std::vector<uint8_t> options = udp;
+    options[34] = 0x46;
+    options.insert(options.begin() + 54, {0x01, 0x01, 0x01, 0x00});
+    udp_ok = udp_ok && probe_frame_parse(options.data(), options.size(), &payload) && payload.sequence == 77;
+    printf("UDP probes on an open network: %s\n", udp_ok ? "ok" : "WRONG");
+    ok = ok && udp_ok;
+
+    // the transmitter numbers every frame, so a receiver sees consecutive numbers across the wrap around
+    uint32_t sequence = 0xFFFFFFF0;
+    uint32_t previous = 0;
+    bool consecutive = true;
+    for (int i = 0; i < 64; i++) {
+        probe_frame_stamp(&data, sequence++, i);
+        consecutive = consecutive && probe_frame_parse(data.data, data.len, &payload)
+                      && (i == 0 || payload.sequence == previous + 1);
+        previous = payload.sequence;
+    }
+    printf("sequence numbers across the wrap around: %s\n", consecutive ? "ok" : "WRONG");
+    ok = ok && consecutive;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sink = 0;
+    for (uint32_t i = 0; i < frames; i++) {
+        probe_frame_stamp(&data, i, i);
+        sink += data.data[data.len - 1];
+    }
+    double stamp_seconds = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        data.data[data.payload_offset + 8] = (uint8_t) i;
+        sink += probe_frame_parse(data.data, data.len, &payload) ? payload.sequence : 0;
+    }
+    double parse_seconds = seconds_since(start);
+    printf("stamp %.1f ns, parse %.1f ns per frame (%llu)\n", stamp_seconds * 1e9 / frames,
+           parse_seconds * 1e9 / frames, (unsigned long long) (sink & 1));
+    return ok ? 0 : 1;
+}
+
+struct probe_plan_t {
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t bursts = 0;
+    uint64_t max_burst = 0;
+    uint64_t without_csi = 0;
+};
+
+/*
+ * Appends the log a receiver would write for `probes` probes of `mac`, every `period_us`, losing and mangling
+ * them as planned if `impaired`, and returns what the analyzer should find.
+ */
+static probe_plan_t probe_log(std::string *log, const uint8_t mac[6], uint32_t probes, uint32_t period_us,
+                              bool impaired) {
+    // the receiver clock wraps around half way through
+    uint32_t first_rx_us = 0xFFFFFFFFu - probes / 2 * period_us;
+    std::vector<uint32_t> order;
+    std::vector<bool> lost(probes, false);
+    for (uint32_t i = 0; i < probes; i++) {
+        order.push_back(i);
+    }
+    probe_plan_t plan;
+    if (impaired && probes >= 1000) {
+        // a burst of 5, two single losses, one probe so late it counts as lost (at 600),
+        // a swapped pair and a duplicate
+        for (uint32_t i : {100, 101, 102, 103, 104, 200, 300}) {
+            lost[i] = true;
+        }
+        auto at = [&order](uint32_t sequence) {
+            return std::find(order.begin(), order.end(), sequence);
+        };
+        std::iter_swap(at(400), at(401));
+        order.insert(at(500) + 1, 500);
+        order.erase(at(600));
+        order.insert(at(700), 600);
+        plan.lost = 8;
+        plan.bursts = 4;
+        plan.max_burst = 5;
+    }
+
+    csi_format_buffer_t b;
+    csi_record_t record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.mac, mac, 6);
+    record.sig_len = 52;
+    record.len = 128;
+    int8_t values[128];
+    for (int i = 0; i < 128; i++) {
+        values[i] = (int8_t) (i - 64);
+    }
+    std::vector<bool> seen(probes, false);
+    for (uint32_t i : order) {
+        if (lost[i]) {
+            continue;
+        }
+        uint32_t rx_us = first_rx_us + i * period_us + (i % 7);
+        record.local_timestamp = rx_us;
+        csi_format_reset(&b);
+        csi_format_csv_prefix(&b, "AP", &record);
+        csi_format_csv_values(&b, values, 128);
+        csi_format_csv_suffix(&b);
+        std::string csi(b.buf, b.len);
+
+        probe_rx_record_t probe;
+        memcpy(probe.mac, mac, 6);
+        probe.local_timestamp = rx_us;
+        probe.payload.sequence = i;
+        probe.payload.tx_timestamp_us = 5000000000LL + (int64_t) i * period_us;
+        probe_rx_format(&b, "AP", &probe);
+
+        bool with_csi = !(impaired && i % 1000 == 7);
+        // the two lines can come in either order
+        if (with_csi && i % 2 == 0) {
+            log->append(csi);
+        }
+        log->append(b.buf, b.len);
+        if (with_csi && i % 2 == 1) {
+            log->append(csi);
+        }
+        bool counted = !seen[i] && !(impaired && i == 600);
+        if (counted) {
+            plan.received++;
+            plan.without_csi += with_csi ? 0 : 1;
+        }
+        seen[i] = true;
+    }
+    return plan;
+}
+
+static int bench_probe(uint32_t probes) {
+    bool ok = true;
+    const uint8_t impaired_mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    const uint8_t clean_mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x02};
+    if (probes < 1000) {
+        probes = 1000;
+    }
+
+    std::string log = "garbage line\nCSI_DROPPED,AP,3,3\nCSI_PROBE_DROPPED,AP,2,2\nCSI_PROBE,AP,bad\n";
+    probe_plan_t impaired = probe_log(&log, impaired_mac, probes, 1000, true);
+    probe_plan_t clean = probe_log(&log, clean_mac, probes, 1000, false);
+
+    // fed in odd-sized chunks, so lines are cut everywhere
+    probe_analyzer_t a;
+    std::string carry;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < log.size(); pos += 4093) {
+        probe_analyzer_feed(&a, log.data() + pos, std::min<size_t>(4093, log.size() - pos), &carry);
+    }
+    probe_analyzer_finish(&a, &carry);
+    double seconds = seconds_since(start);
+
+    struct {
+        const char *name;
+        const uint8_t *mac;
+        const probe_plan_t *plan;
+    } expected[] = {{"impaired", impaired_mac, &impaired}, {"clean", clean_mac, &clean}};
+    for (const auto &e : expected) {
+        uint64_t key = 0;
+        for (int i = 0; i < 6; i++) {
+            key = (key << 8) | e.mac[i];
+        }
+        const probe_transmitter_t &t = a.transmitters[key];
+        const probe_loss_t &l = t.loss;
+        bool impaired_counts = e.plan != &impaired || (l.reordered == 1 && l.duplicates == 1 && l.too_late == 1);
+        bool same = l.received == e.plan->received && l.lost == e.plan->lost && l.bursts.count == e.plan->bursts
+                    && l.max_burst == e.plan->max_burst && impaired_counts
+                    && t.without_csi == e.plan->without_csi && t.with_csi == l.received - e.plan->without_csi
+                    // constant period on both clocks
+                    && (e.plan != &clean || (t.jitter_us < 10 && csi_histogram_percentile(&t.inter_arrival_us, 500)
+                                                                 <= 1000 * 9 / 8));
+        printf("%-8s %llu received, %llu lost in %u bursts (max %llu), %llu reordered, %llu duplicates, "
+               "%llu too late, %llu without CSI, jitter %.1f us: %s\n", e.name, (unsigned long long) l.received,
+               (unsigned long long) l.lost, l.bursts.count, (unsigned long long) l.max_burst,
+               (unsigned long long) l.reordered, (unsigned long long) l.duplicates,
+               (unsigned long long) l.too_late, (unsigned long long) t.without_csi, t.jitter_us,
+               same ? "ok" : "WRONG");
+        ok = ok && same;
+    }
+    bool totals = a.csi_dropped == 3 && a.probe_dropped == 2 && a.malformed == 1 && a.transmitters.size() == 2;
+    printf("drop totals and malformed lines: %s\n", totals ? "ok" : "WRONG");
+    ok = ok && totals;
+
+    printf("%.2f M lines/s, %.0f MB/s (%llu lines)\n", a.lines / seconds / 1e6, log.size() / seconds / 1e6,
+           (unsigned long long) a.lines);
+    return ok ? 0 : 1;
+}
+
+static int bench_channel(int64_t seconds) {
+    bool ok = true;
+
+    // table parsing: entries are checked field by field, anything doubtful rejects the whole table
+    channel_scheduler_t s;
+    bool parsed = channel_scheduler_parse(&s, "1,6:400:3,11", 200) && s.count == 3 && s.total_priority == 5
+                  && s.entries[0].channel == 1 && s.entries[0].dwell_ms == 200 && s.entries[0].priority == 1
+                  && s.entries[1].channel == 6 && s.entries[1].dwell_ms == 400 && s.entries[1].priority == 3
+                  && s.entries[2].channel == 11 && s.entries[2].dwell_ms == 200;
+    parsed = parsed && channel_scheduler_parse(&s, " 1 , 6::2 ,14:60000:100", 50) && s.count == 3
+             && s.entries[1].dwell_ms == 50 && s.entries[1].priority == 2 && s.entries[2].priority == 100;
+    for (const char *bad : {"", "0", "15", "1,1", "1:9", "1:60001", "1:x", "1::0", "1::101", "1,,6", "6:", "1;6",
+                            "1,2,3,4,5,6,7,8,9,10,11,12,13,14,1"}) {
+        parsed = parsed && !channel_scheduler_parse(&s, bad, 200) && s.count == 0;
+    }
+    printf("channel tables: %s\n", parsed ? "ok" : "WRONG");
+    ok = ok && parsed;
+
+    // `esp_timer` wake-ups as for the transmitter, and `esp_wifi_set_channel` takes a few hundred us to a couple of ms
+    tx_simulation_t sim;
+    std::uniform_int_distribution<int64_t> switch_cost_us(200, 1500);
+    // shorter runs are dominated by the odd Wi-Fi stall and by the last, incomplete round
+    if (seconds < 60) {
+        seconds = 60;
+    }
+    printf("%lld simulated seconds per table\n", (long long) seconds);
+    for (const char *table : {"1,6,11", "1,6:400:3,11", "1:50,2:50:2,3:50:4,4:50:8", "1:1000,6:20:7"}) {
+        channel_scheduler_parse(&s, table, 200);
+        std::vector<uint64_t> visits(s.count), dwell_us(s.count);
+        std::vector<uint64_t> last_pick(s.count, 0), max_gap(s.count, 0);
+        uint64_t picks = 0;
+        int64_t switching_us = 0;
+        int64_t now_us = 0;
+        int64_t next_report_us = 1000000;
+        while (now_us < seconds * 1000000) {
+            int entry = channel_scheduler_next(&s, now_us);
+            picks++;
+            if (last_pick[entry] > 0 || picks > 1) {
+                max_gap[entry] = std::max<uint64_t>(max_gap[entry], picks - last_pick[entry]);
+            }
+            last_pick[entry] = picks;
+            int64_t cost = switch_cost_us(sim.rng);
+            now_us += cost;
+            switching_us += cost;
+            channel_scheduler_switched(&s, now_us);
+            now_us += channel_scheduler_wait_us(&s, now_us) + sim.wake_latency_us();
+            if (now_us >= next_report_us) {
+                // as the writer task does every statistics interval
+                for (int i = 0; i < s.count; i++) {
+                    uint32_t v, d;
+                    channel_scheduler_take(&s, i, &v, &d);
+                    visits[i] += v;
+                    dwell_us[i] += d;
+                }
+                next_report_us += 1000000;
+            }
+        }
+        channel_scheduler_next(&s, now_us);
+        uint64_t weighted_total = 0;
+        for (int i = 0; i < s.count; i++) {
+            uint32_t v, d;
+            channel_scheduler_take(&s, i, &v, &d);
+            visits[i] += v;
+            dwell_us[i] += d;
+            weighted_total += (uint64_t) s.entries[i].priority * s.entries[i].dwell_ms;
+        }
+
+        printf("%s:\n  ch prio dwell   visits  mean dwell ms  time share (expected)  max gap\n", table);
+        uint64_t total_dwell_us = 0;
+        uint64_t planned_ms = 0;
+        for (int i = 0; i < s.count; i++) {
+            total_dwell_us += dwell_us[i];
+            planned_ms += visits[i] * s.entries[i].dwell_ms;
+        }
+        bool table_ok = true;
+        for (int i = 0; i < s.count; i++) {
+            const channel_scheduler_entry_t &e = s.entries[i];
+            double mean_ms = visits[i] == 0 ? 0 : dwell_us[i] / 1000.0 / visits[i];
+            double share = (double) dwell_us[i] / total_dwell_us;
+            double expected_share = (double) e.priority * e.dwell_ms / weighted_total;
+            // visits in proportion to priority (within one round), dwell never short and less than 1 ms long,
+            // time shares within 1% of those planned for the visits made (which converge on the table's),
+            // and visits spread out: never more than twice the ideal spacing apart
+            double rounds = (double) picks / s.total_priority;
+            double planned_share = (double) visits[i] * e.dwell_ms / planned_ms;
+            bool row_ok = fabs(visits[i] - rounds * e.priority) <= 1.5 && mean_ms >= e.dwell_ms
+                          && mean_ms <= e.dwell_ms + 1.0 && fabs(share / planned_share - 1) < 0.01
+                          && max_gap[i] <= (uint64_t) (2 * s.total_priority / e.priority);
+            printf("  %2u %4u %5u %8llu %14.2f %8.3f (%.3f) %10llu%s\n", e.channel, e.priority, e.dwell_ms,
+                   (unsigned long long) visits[i], mean_ms, share, expected_share, (unsigned long long) max_gap[i],
+                   row_ok ? "" : "  WRONG");
+            table_ok = table_ok && row_ok;
+        }
+        printf("  time spent switching: %.2f%%\n", 100.0 * switching_us / now_us);
+        ok = ok && table_ok;
+    }
+
+    channel_scheduler_parse(&s, "1,2:50:2,3:50:4,4:50:8,5,6,7,8,9,10,11,12,13,14", 200);
+    const uint32_t decisions = 10000000;
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < decisions; i++) {
+        sink += channel_scheduler_next(&s, i);
+    }
+    printf("next channel out of 14: %.1f ns (%llu)\n", seconds_since(start) * 1e9 / decisions,
+           (unsigned long long) (sink & 1));
+    printf("visits, dwell times and time shares: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+static void filter_mac(uint32_t n, uint8_t mac[6]) {
+    // one vendor prefix, as in a room full of ESP32s, so the hash has little to work with
+    uint8_t m[6] = {0x24, 0x0A, 0xC4, (uint8_t) (n >> 16), (uint8_t) (n >> 8), (uint8_t) n};
+    memcpy(mac, m, 6);
+}
+
+static bool filter_accepts(csi_filter_t *f, uint32_t n, int8_t rssi, uint8_t sig_mode, uint8_t cwb) {
+    uint8_t mac[6];
+    filter_mac(n, mac);
+    return csi_filter_accept(f, mac, rssi, sig_mode, cwb);
+}
+
+static int bench_filter(uint32_t lookups) {
+    bool ok = true;
+    csi_filter_t f;
+    csi_format_buffer_t reply;
+    auto reply_is = [&](const char *expected) { return std::string(reply.buf, reply.len) == expected; };
+
+    // random adds and removes against a std::set: removal must keep every remaining MAC reachable
+    csi_filter_rules_t rules;
+    _csi_filter_rules_reset(&rules);
+    std::set<uint32_t> expected;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<uint32_t> pick(0, 99);
+    bool churn_ok = true;
+    for (int i = 0; i < 200000 && churn_ok; i++) {
+        uint32_t n = pick(rng);
+        uint8_t mac[6];
+        filter_mac(n, mac);
+        if (rng() % 2 == 0) {
+            bool fits = expected.size() < CSI_FILTER_MAX_MACS || expected.count(n) > 0;
+            churn_ok = csi_filter_rules_add(&rules, mac) == fits;
+            if (fits) {
+                expected.insert(n);
+            }
+        } else {
+            csi_filter_rules_remove(&rules, mac);
+            expected.erase(n);
+        }
+        churn_ok = churn_ok && rules.count == expected.size();
+        for (uint32_t m = 0; m < 100 && churn_ok; m++) {
+            filter_mac(m, mac);
+            churn_ok = csi_filter_rules_contains(&rules, mac) == (expected.count(m) > 0);
+        }
+    }
+    printf("MAC table (%d slots, at most %d MACs), random adds and removes: %s\n", CSI_FILTER_SLOTS,
+           CSI_FILTER_MAX_MACS, churn_ok ? "ok" : "WRONG");
+    ok = ok && churn_ok;
+
+    // each line applied to a fresh filter, then MAC 1 / MAC 2 with the given rssi, sig_mode and cwb
+    struct {
+        const char *line;
+        uint32_t mac;
+        int8_t rssi;
+        uint8_t sig_mode, cwb;
+        bool accept;
+    } cases[] = {
+            {"FILTER: OFF", 2, -90, 0, 0, true},
+            {"FILTER: ALLOW; ADD 24:0a:c4:00:00:01", 1, -90, 0, 0, true},
+            {"FILTER: ALLOW; ADD 24:0a:c4:00:00:01", 2, -90, 0, 0, false},
+            {"FILTER: ALLOW", 1, -50, 1, 0, false},
+            {"FILTER: DENY; ADD 24:0A:C4:00:00:01,24:0a:c4:00:00:03", 1, -50, 1, 0, false},
+            {"FILTER: DENY; ADD 24:0a:c4:00:00:01", 2, -50, 1, 0, true},
+            {"FILTER: DENY; ADD 24:0a:c4:00:00:01; REMOVE 24:0a:c4:00:00:01", 1, -50, 1, 0, true},
+            {"FILTER: ADD 24:0a:c4:00:00:01; ALLOW; CLEAR", 1, -50, 1, 0, false},
+            {"FILTER: ALLOW; ADD 24:0a:c4:00:00:01; OFF", 2, -50, 1, 0, true},
+            {"FILTER: RSSI -70", 2, -70, 0, 0, true},
+            {"FILTER: RSSI -70", 2, -71, 0, 0, false},
+            {"FILTER: RSSI -70; RSSI ANY", 2, -100, 0, 0, true},
+            {"FILTER: SIG_MODE 1,3", 2, -50, 1, 0, true},
+            {"FILTER: SIG_MODE 1,3", 2, -50, 0, 0, false},
+            {"FILTER: SIG_MODE 0; SIG_MODE ANY", 2, -50, 1, 0, true},
+            {"FILTER: BANDWIDTH 40", 2, -50, 1, 1, true},
+            {"FILTER: BANDWIDTH 40", 2, -50, 1, 0, false},
+            {"FILTER: BANDWIDTH 20", 2, -50, 1, 0, true},
+            {"FILTER:ALLOW;ADD 24:0a:c4:00:00:02;RSSI -60;BANDWIDTH 20", 2, -59, 0, 0, true},
+            {"FILTER:ALLOW;ADD 24:0a:c4:00:00:02;RSSI -60;BANDWIDTH 20", 2, -61, 0, 0, false},
+    };
+    bool rules_ok = true;
+    for (const auto &c : cases) {
+        csi_filter_reset(&f);
+        bool row_ok = csi_filter_command(&f, c.line, &reply) && reply_is("")
+                      && filter_accepts(&f, c.mac, c.rssi, c.sig_mode, c.cwb) == c.accept;
+        if (!row_ok) {
+            printf("  %s, MAC %u: WRONG\n", c.line, c.mac);
+        }
+        rules_ok = rules_ok && row_ok;
+    }
+    // OFF with no conditions is the no-op fast path, anything else is looked up
+    csi_filter_reset(&f);
+    csi_filter_command(&f, "FILTER: RSSI -70", &reply);
+    rules_ok = rules_ok && f.enabled.load();
+    csi_filter_command(&f, "FILTER: RSSI ANY", &reply);
+    rules_ok = rules_ok && !f.enabled.load();
+    printf("allow, deny, rssi, sig_mode and bandwidth rules: %s\n", rules_ok ? "ok" : "WRONG");
+    ok = ok && rules_ok;
+
+    // a line with one bad command changes nothing, and the reply points at that command
+    csi_filter_reset(&f);
+    csi_filter_command(&f, "FILTER: ALLOW; ADD 24:0a:c4:00:00:01; RSSI -70", &reply);
+    csi_filter_rules_t before = *csi_filter_rules(&f);
+    bool commands_ok = true;
+    for (const char *bad : {"FILTER: DENY; ADD 24:0a:c4:00:00", "FILTER: CLEAR; ADD 24:0a:c4:00:00:1",
+                            "FILTER: OFF; RSSI", "FILTER: RSSI -200", "FILTER: SIG_MODE 8", "FILTER: SIG_MODE 1,",
+                            "FILTER: BANDWIDTH 80", "FILTER: CLEAR; ALLOWED", "FILTER: OFF x", "FILTER: REMOVE ;",
+                            "FILTER: ADD 24:0a:c4:00:00:02 24:0a:c4:00:00:03", "FILTER: RSSI -70dBm"}) {
+        bool rejected = !csi_filter_command(&f, bad, &reply)
+                        && std::string(reply.buf, reply.len).compare(0, 20, "invalid command at \"") == 0
+                        && memcmp(csi_filter_rules(&f), &before, sizeof(before)) == 0;
+        if (!rejected) {
+            printf("  %s: WRONG\n", bad);
+        }
+        commands_ok = commands_ok && rejected;
+    }
+    csi_filter_command(&f, "FILTER: DENY; RSSI -70; OFF x", &reply);
+    commands_ok = commands_ok && reply_is("invalid command at \"OFF x\"\n");
+    // more MACs than fit
+    std::string many = "FILTER: CLEAR; ADD ";
+    for (uint32_t n = 0; n <= CSI_FILTER_MAX_MACS; n++) {
+        char mac[20];
+        snprintf(mac, sizeof(mac), "%s24:0a:c4:00:00:%02x", n == 0 ? "" : ",", n);
+        many += mac;
+    }
+    commands_ok = commands_ok && !csi_filter_command(&f, many.c_str(), &reply)
+                  && memcmp(csi_filter_rules(&f), &before, sizeof(before)) == 0;
+    filter_accepts(&f, 1, -60, 1, 0);
+    filter_accepts(&f, 2, -60, 1, 0);
+    commands_ok = commands_ok && csi_filter_command(&f, "FILTER: STATUS", &reply)
+                  && reply_is("CSI_FILTER,ALLOW,1,-70,255,255,1,1\nCSI_FILTER_MAC,24:0A:C4:00:00:01\n");
+    printf("command parsing, all-or-nothing lines and STATUS: %s\n", commands_ok ? "ok" : "WRONG");
+    ok = ok && commands_ok;
+
+    // Lookups from a "driver" thread while another thread keeps replacing the rules. MAC 1 is allowed and MAC 2 is
+    // denied by every published version, so any other answer means a lookup saw a copy while it was edited.
+    csi_filter_reset(&f);
+    csi_filter_command(&f, "FILTER: ALLOW; ADD 24:0a:c4:00:00:01", &reply);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> wrong(0), reads(0);
+    std::thread reader([&]() {
+        uint64_t n = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (!filter_accepts(&f, 1, -50, 1, 0) || filter_accepts(&f, 2, -50, 1, 0)) {
+                wrong++;
+            }
+            n++;
+        }
+        reads = n;
+    });
+    const uint32_t updates = 200000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < updates; i++) {
+        // CLEAR empties the table in the edited copy before MAC 1 is added back
+        csi_filter_command(&f, i % 2 ? "FILTER: CLEAR; ADD 24:0a:c4:00:00:01,24:0a:c4:00:00:03"
+                                     : "FILTER: CLEAR; ADD 24:0a:c4:00:00:04,24:0a:c4:00:00:01; RSSI -90",
+                           &reply);
+    }
+    double update_seconds = seconds_since(start);
+    stop = true;
+    reader.join();
+    bool concurrent_ok = wrong.load() == 0 && f.readers[0].load() == 0 && f.readers[1].load() == 0;
+    printf("%u updates during %llu lookups (%.2f us per update): %s\n", updates, (unsigned long long) reads.load(),
+           update_seconds * 1e6 / updates, concurrent_ok ? "ok" : "WRONG");
+    ok = ok && concurrent_ok;
+
+    // lookup cost: the no-op fast path, and a full allowlist against the linear scan it replaces
+    std::vector<std::array<uint8_t, 6>> frames(1024);
+    for (size_t i = 0; i < frames.size(); i++) {
+        // half of the frames come from an allowed MAC
+        filter_mac(i % 2 ? (uint32_t) (i * 7919 % CSI_FILTER_MAX_MACS) : 1000 + (uint32_t) i, frames[i].data());
+    }
+    std::vector<std::array<uint8_t, 6>> allowed(CSI_FILTER_MAX_MACS);
+    csi_filter_reset(&f);
+    for (uint32_t n = 0; n < CSI_FILTER_MAX_MACS; n++) {
+        filter_mac(n, allowed[n].data());
+        csi_filter_rules_add(csi_filter_edit(&f), allowed[n].data());
+        csi_filter_publish(&f);
+    }
+    auto time_lookups = [&](const char *name, const std::function<bool(const uint8_t *)> &accept) {
+        uint64_t passed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < lookups; i++) {
+            passed += accept(frames[i & (frames.size() - 1)].data());
+        }
+        printf("  %-38s %6.1f ns per frame (%llu passed)\n", name, seconds_since(start) * 1e9 / lookups,
+               (unsigned long long) passed);
+        return passed;
+    };
+    printf("%u lookups, half of them from one of %d allowed MACs:\n", lookups, CSI_FILTER_MAX_MACS);
+    uint64_t passed_off = time_lookups("filter off", [&](const uint8_t *mac) {
+        return csi_filter_accept(&f, mac, -50, 1, 0);
+    });
+    csi_filter_command(&f, "FILTER: ALLOW", &reply);
+    uint64_t passed_accept = time_lookups("allowlist, csi_filter_accept", [&](const uint8_t *mac) {
+        return csi_filter_accept(&f, mac, -50, 1, 0);
+    });
+    // without the reader count of `csi_filter_accept`, which costs the same whatever the rules
+    uint64_t passed_table = time_lookups("allowlist, hash table lookup", [&](const uint8_t *mac) {
+        return csi_filter_rules_accept(csi_filter_rules(&f), mac, -50, 1, 0);
+    });
+    uint64_t passed_scan = time_lookups("allowlist, linear scan (baseline)", [&](const uint8_t *mac) {
+        for (const auto &a : allowed) {
+            if (memcmp(a.data(), mac, 6) == 0) {
+                return true;
+            }
+        }
+        return false;
+    });
+    bool lookups_ok = passed_off == lookups && passed_accept == passed_table && passed_table == passed_scan
+                      && passed_table == lookups / 2;
+    ok = ok && lookups_ok;
+    printf("lookups: %s\n", lookups_ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+struct limit_arrival_t {
+    uint32_t us;
+    uint32_t source;
+};
+
+// Straightforward token bucket and N-of-M decimation for one MAC. Tokens are counted in millionths of a frame, which
+// a double holds exactly at these magnitudes.
+struct limit_reference_t {
+    double tokens = -1;
+    uint32_t last_us = 0;
+    uint64_t frames = 0;
+
+    bool accept(uint32_t now_us, uint32_t rate_fps, uint32_t burst, uint32_t keep, uint32_t every) {
+        if (tokens < 0) {
+            tokens = burst * 1e6;
+            last_us = now_us;
+        }
+        tokens = std::min<double>(burst * 1e6, tokens + (double) (now_us - last_us) * rate_fps);
+        last_us = now_us;
+        // the frame is kept if it completes another `keep` out of `every`
+        frames++;
+        if ((every - keep + frames * keep) / every == (every - keep + (frames - 1) * keep) / every) {
+            return false;
+        }
+        if (rate_fps > 0) {
+            if (tokens < 1e6) {
+                return false;
+            }
+            tokens -= 1e6;
+        }
+        return true;
+    }
+};
+
+static int bench_limit(int64_t seconds) {
+    bool ok = true;
+    if (seconds < 10) {
+        seconds = 10;
+    }
+
+    // A busy AP floods the channel (Poisson, 2000 frames/s), five stations send 30 frames/s with some jitter and
+    // one device sends bursts of 50 frames every 2 s.
+    std::mt19937 rng(1);
+    std::vector<limit_arrival_t> trace;
+    std::exponential_distribution<double> flood_gap(2000 / 1e6);
+    for (double t = 0; t < seconds * 1e6; t += flood_gap(rng)) {
+        trace.push_back({(uint32_t) t, 0});
+    }
+    std::uniform_int_distribution<int> jitter_us(-3000, 3000);
+    for (uint32_t s = 1; s <= 5; s++) {
+        for (int64_t t = 10000 + s * 1000; t < seconds * 1000000; t += 33333) {
+            trace.push_back({(uint32_t) (t + jitter_us(rng)), s});
+        }
+    }
+    for (int64_t t = 500000; t < seconds * 1000000; t += 2000000) {
+        for (int i = 0; i < 50; i++) {
+            trace.push_back({(uint32_t) (t + i * 200), 6});
+        }
+    }
+    std::stable_sort(trace.begin(), trace.end(),
+                     [](const limit_arrival_t &a, const limit_arrival_t &b) { return a.us < b.us; });
+    const uint32_t sources = 7;
+    const char *names[sources] = {"busy AP", "station 1", "station 2", "station 3", "station 4", "station 5",
+                                  "bursty"};
+    printf("%lld s trace: %zu frames from %u MACs\n", (long long) seconds, trace.size(), sources);
+
+    csi_rate_limit_t limit;
+    struct {
+        uint32_t rate_fps, burst, keep, every;
+    } policies[] = {{100, 10, 1, 1}, {0, 1, 1, 4}, {0, 1, 3, 7}, {50, 5, 1, 2}, {20, 1, 1, 1}};
+    for (const auto &p : policies) {
+        csi_rate_limit_configure(&limit, p.rate_fps, p.burst, p.keep, p.every);
+        std::vector<limit_reference_t> reference(sources);
+        std::vector<uint64_t> offered(sources), passed(sources), expected(sources), dropped(sources);
+        bool decisions_ok = true;
+        for (const limit_arrival_t &a : trace) {
+            uint8_t mac[6];
+            filter_mac(a.source, mac);
+            bool accepted = csi_rate_limit_accept(&limit, mac, a.us);
+            bool reference_accepted = reference[a.source].accept(a.us, p.rate_fps, p.burst, p.keep, p.every);
+            decisions_ok = decisions_ok && accepted == reference_accepted;
+            offered[a.source]++;
+            passed[a.source] += accepted;
+            expected[a.source] += reference_accepted;
+        }
+        // the counters reported with CSI_STATS add up to the same
+        bool counters_ok = true;
+        uint64_t total_dropped = 0;
+        for (int i = 0; i <= CSI_RATE_LIMIT_SLOTS; i++) {
+            uint8_t mac[6];
+            uint32_t n_passed, n_decimated, n_limited;
+            if (csi_rate_limit_take(&limit, i, mac, &n_passed, &n_decimated, &n_limited)) {
+                uint32_t source = mac[5];
+                counters_ok = counters_ok && n_passed == passed[source]
+                              && n_passed + n_decimated + n_limited == offered[source];
+            } else {
+                counters_ok = counters_ok && n_passed + n_decimated + n_limited == 0;
+            }
+            total_dropped += n_decimated + n_limited;
+        }
+        counters_ok = counters_ok && total_dropped == limit.dropped.load();
+        printf("%u frames/s (burst %u), %u of %u:\n", p.rate_fps, p.burst, p.keep, p.every);
+        for (uint32_t s = 0; s < sources; s++) {
+            // nobody gets more than the bucket allows, or than decimation keeps
+            double allowed = p.rate_fps > 0 ? p.burst + p.rate_fps * (double) seconds : 1e18;
+            double kept = (double) offered[s] * p.keep / p.every + 1;
+            bool row_ok = passed[s] == expected[s] && passed[s] <= allowed && passed[s] <= kept;
+            printf("  %-10s %8llu offered %8llu passed (%6.1f/s)%s\n", names[s], (unsigned long long) offered[s],
+                   (unsigned long long) passed[s], passed[s] / (double) seconds, row_ok ? "" : "  WRONG");
+            ok = ok && row_ok;
+        }
+        printf("  decisions as the reference: %s, counters: %s\n", decisions_ok ? "ok" : "WRONG",
+               counters_ok ? "ok" : "WRONG");
+        ok = ok && decisions_ok && counters_ok;
+    }
+
+    // The stations stay below 100 frames/s, so each of them keeps every frame however hard the AP floods.
+    csi_rate_limit_configure(&limit, 100, 10, 1, 1);
+    std::vector<uint64_t> offered(sources), passed(sources);
+    for (const limit_arrival_t &a : trace) {
+        uint8_t mac[6];
+        filter_mac(a.source, mac);
+        offered[a.source]++;
+        passed[a.source] += csi_rate_limit_accept(&limit, mac, a.us);
+    }
+    bool guaranteed = passed[0] < offered[0] / 10;
+    for (uint32_t s = 1; s <= 5; s++) {
+        guaranteed = guaranteed && passed[s] == offered[s];
+    }
+    printf("stations below the limit keep every frame next to the flood: %s\n", guaranteed ? "ok" : "WRONG");
+    ok = ok && guaranteed;
+
+    // More MACs than the table tracks: the first ones keep their own budget and the rest share one. Once half of
+    // the tracked MACs have been quiet for longer than CSI_RATE_LIMIT_IDLE_US, a new MAC gets the entry of one.
+    csi_rate_limit_configure(&limit, 10, 1, 1, 1);
+    uint32_t now_us = 0;
+    uint64_t tracked_passed = 0, other_passed = 0, active_passed = 0;
+    for (int round = 0; round < 100; round++, now_us += 100000) {
+        for (uint32_t m = 0; m < 100; m++) {
+            uint8_t mac[6];
+            filter_mac(100 + m, mac);
+            bool accepted = csi_rate_limit_accept(&limit, mac, now_us + m);
+            (m < CSI_RATE_LIMIT_MAX_MACS ? tracked_passed : other_passed) += accepted;
+        }
+    }
+    // 10 s at 10 frames/s, each
+    bool overflow_ok = tracked_passed == CSI_RATE_LIMIT_MAX_MACS * 100 && other_passed <= 101
+                       && limit.used == CSI_RATE_LIMIT_MAX_MACS;
+    const uint32_t active = CSI_RATE_LIMIT_MAX_MACS / 2;
+    for (int round = 0; round < 110; round++, now_us += 100000) {
+        for (uint32_t m = 0; m < active; m++) {
+            uint8_t mac[6];
+            filter_mac(100 + m, mac);
+            active_passed += csi_rate_limit_accept(&limit, mac, now_us + m);
+        }
+    }
+    uint8_t newcomer[6];
+    filter_mac(1000, newcomer);
+    csi_rate_limit_accept(&limit, newcomer, now_us);
+    // every MAC still sending is found exactly once, after the entries around it were removed
+    std::vector<uint32_t> found(1001, 0);
+    for (int i = 0; i < CSI_RATE_LIMIT_SLOTS; i++) {
+        uint8_t mac[6];
+        uint32_t n_passed, n_decimated, n_limited;
+        if (csi_rate_limit_take(&limit, i, mac, &n_passed, &n_decimated, &n_limited)) {
+            found[mac[4] << 8 | mac[5]]++;
+        }
+    }
+    overflow_ok = overflow_ok && active_passed == active * 110 && limit.used == active + 1 && found[1000] == 1;
+    for (uint32_t m = 0; m < active; m++) {
+        overflow_ok = overflow_ok && found[100 + m] == 1;
+    }
+    printf("%d tracked MACs, %u sharing the rest: %llu / %llu passed, idle entries expired: %s\n",
+           CSI_RATE_LIMIT_MAX_MACS, 100 - CSI_RATE_LIMIT_MAX_MACS, (unsigned long long) tracked_passed,
+           (unsigned long long) other_passed, overflow_ok ? "ok" : "WRONG");
+    ok = ok && overflow_ok;
+
+    // cost per frame in the callback
+    const uint32_t frames = 20000000;
+    std::vector<std::array<uint8_t, 6>> macs(CSI_RATE_LIMIT_MAX_MACS);
+    for (uint32_t m = 0; m < macs.size(); m++) {
+        filter_mac(m, macs[m].data());
+    }
+    for (bool enabled : {false, true}) {
+        csi_rate_limit_configure(&limit, enabled ? 100 : 0, 10, 1, enabled ? 2 : 1);
+        uint64_t accepted = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++) {
+            accepted += csi_rate_limit_accept(&limit, macs[i % macs.size()].data(), i);
+        }
+        printf("%s: %.1f ns per frame (%llu passed)\n",
+               enabled ? "100 frames/s and 1 of 2, 48 MACs" : "disabled", seconds_since(start) * 1e9 / frames,
+               (unsigned long long) accepted);
+    }
+    printf("rate limit and decimation: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+struct command_event_t {
+    command_frame_event_t event;
+    std::string text;
+
+    bool operator==(const command_event_t &o) const {
+        return event == o.event && text == o.text;
+    }
+};
+
+// Feeds `input` to a fresh parser in chunks of `chunk` bytes (0 for byte by byte through `command_frame_parser_push`).
+static std::vector<command_event_t> command_parse(command_frame_parser_t *p, const std::string &input, size_t chunk) {
+    std::vector<command_event_t> events;
+    command_frame_parser_reset(p);
+    auto add = [&](command_frame_event_t event) {
+        if (event == COMMAND_FRAME_ERROR) {
+            events.push_back({event, p->error});
+        } else if (event != COMMAND_FRAME_NONE) {
+            bool terminated = p->len <= COMMAND_FRAME_MAX_PAYLOAD && p->payload[p->len] == '\0';
+            events.push_back({event, terminated ? std::string(p->payload, p->len) : "NOT TERMINATED"});
+        }
+    };
+    for (size_t pos = 0; pos < input.size();) {
+        if (chunk == 0) {
+            add(command_frame_parser_push(p, input[pos++]));
+            continue;
+        }
+        size_t n = std::min(chunk, input.size() - pos);
+        size_t consumed;
+        add(command_frame_parser_feed(p, input.data() + pos, n, &consumed));
+        pos += consumed;
+    }
+    return events;
+}
+
+static std::string command_frame(const std::string &payload) {
+    static csi_format_buffer_t b;
+    csi_format_reset(&b);
+    command_frame_encode(&b, payload.data(), payload.size());
+    return std::string(b.buf, b.len);
+}
+
+static bool command_fail(const char *args, csi_format_buffer_t *reply) {
+    (void) args;
+    csi_format_str(reply, "failed on purpose\n");
+    return false;
+}
+
+static bool command_long(const char *args, csi_format_buffer_t *reply) {
+    (void) args;
+    for (int i = 0; i < 3000; i++) {
+        csi_format_char(reply, 'x');
+    }
+    return true;
+}
+
+// Runs one framed request through `command_dispatch_frame()` and returns the payload of the reply frame.
+static std::string command_request(command_frame_parser_t *p, const std::string &payload) {
+    static csi_format_buffer_t text, out;
+    command_dispatch_frame(payload.data(), payload.size(), &text, &out);
+    std::vector<command_event_t> events = command_parse(p, std::string(out.buf, out.len), 64);
+    return events.size() == 1 && events[0].event == COMMAND_FRAME_PAYLOAD ? events[0].text : "NO REPLY FRAME";
+}
+
+/*
+ * Round trips of `PING` requests to a "device" thread which parses and dispatches them like `input_component.h`,
+ * over a socket pair. The device sleeps in `select()` until input arrives like `input_loop()`, or with `poll_ms` > 0
+ * polls for it every `poll_ms` instead.
+ */
+static std::vector<uint32_t> command_round_trips(uint32_t count, int poll_ms) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return {};
+    }
+    std::thread device([&]() {
+        static command_frame_parser_t parser;
+        static csi_format_buffer_t text, out;
+        command_frame_parser_reset(&parser);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        char buf[64];
+        while (true) {
+            if (poll_ms > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms));
+            } else {
+                fd_set readable;
+                FD_ZERO(&readable);
+                FD_SET(fds[1], &readable);
+                select(fds[1] + 1, &readable, NULL, NULL, NULL);
+            }
+            // everything which arrived, like `input_check()`
+            ssize_t n;
+            while ((n = read(fds[1], buf, sizeof(buf))) > 0) {
+                for (size_t pos = 0; pos < (size_t) n;) {
+                    size_t consumed;
+                    command_frame_event_t event = command_frame_parser_feed(&parser, buf + pos, n - pos, &consumed);
+                    pos += consumed;
+                    if (event == COMMAND_FRAME_PAYLOAD) {
+                        command_dispatch_frame(parser.payload, parser.len, &text, &out);
+                        if (write(fds[1], out.buf, out.len) != (ssize_t) out.len) {
+                            return;
+                        }
+                    }
+                }
+            }
+            if (n == 0) {
+                break;
+            }
+        }
+    });
+
+    command_frame_parser_t parser;
+    command_frame_parser_reset(&parser);
+    std::vector<uint32_t> round_trip_us;
+    char buf[256];
+    for (uint32_t id = 1; id <= count; id++) {
+        std::string request = command_frame(std::to_string(id) + " PING " + std::to_string(id * 7));
+        std::string expected = std::to_string(id) + " OK " + std::to_string(id * 7);
+        auto start = std::chrono::steady_clock::now();
+        if (write(fds[0], request.data(), request.size()) != (ssize_t) request.size()) {
+            break;
+        }
+        bool replied = false;
+        while (!replied) {
+            ssize_t n = read(fds[0], buf, sizeof(buf));
+            if (n <= 0) {
+                break;
+            }
+            for (size_t pos = 0; pos < (size_t) n;) {
+                size_t consumed;
+                command_frame_event_t event = command_frame_parser_feed(&parser, buf + pos, n - pos, &consumed);
+                pos += consumed;
+                replied = replied || (event == COMMAND_FRAME_PAYLOAD && std::string(parser.payload) == expected);
+            }
+        }
+        if (!replied) {
+            break;
+        }
+        round_trip_us.push_back((uint32_t) (seconds_since(start) * 1e6));
+    }
+    close(fds[0]);
+    device.join();
+    close(fds[1]);
+    std::sort(round_trip_us.begin(), round_trip_us.end());
+    return round_trip_us;
+}
+
+static int bench_command(uint32_t streams) {
+    bool ok = true;
+    static command_frame_parser_t parser;
+
+    // framing, and whole frames coming out the same however the bytes are split up
+    std::string ping = command_frame("1 PING");
+    std::string binary_payload("7 PING \n$*\r\0\xff", 13);
+    struct {
+        std::string input;
+        std::vector<command_event_t> expected;
+    } cases[] = {
+            {ping, {{COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {ping.substr(0, ping.size() - 1) + "\r\n", {{COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {command_frame(binary_payload), {{COMMAND_FRAME_PAYLOAD, binary_payload}}},
+            {"SETTIME: 1700000000.5\r\n\r\n" + ping,
+             {{COMMAND_FRAME_LINE, "SETTIME: 1700000000.5"}, {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {"$6:1 PING*0000\n" + ping, {{COMMAND_FRAME_ERROR, "frame checksum does not match"},
+                                          {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {"$7:1 PING*" + ping.substr(ping.size() - 5) + ping,
+             {{COMMAND_FRAME_ERROR, "frame length does not match"}, {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {"$5:1 PING*1234\n" + ping, {{COMMAND_FRAME_ERROR, "frame length does not match"},
+                                          {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {"$0:\n$x\n$:x\n", {{COMMAND_FRAME_ERROR, "bad frame length"}, {COMMAND_FRAME_ERROR, "bad frame length"},
+                                {COMMAND_FRAME_ERROR, "bad frame length"}}},
+            {"$99999:" + std::string(5000, 'x') + "\n" + ping,
+             {{COMMAND_FRAME_ERROR, "frame too long"}, {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {"$6:1 PING*12G4\n" + ping.substr(0, ping.size() - 1) + "x\n" + ping,
+             {{COMMAND_FRAME_ERROR, "bad frame checksum"}, {COMMAND_FRAME_ERROR, "frame not followed by a line break"},
+              {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {std::string(COMMAND_FRAME_MAX_LINE, 'a') + "\n" + std::string(COMMAND_FRAME_MAX_LINE + 1, 'a') + "\n"
+             + ping,
+             {{COMMAND_FRAME_LINE, std::string(COMMAND_FRAME_MAX_LINE, 'a')}, {COMMAND_FRAME_ERROR, "line too long"},
+              {COMMAND_FRAME_PAYLOAD, "1 PING"}}},
+            {command_frame(std::string(COMMAND_FRAME_MAX_PAYLOAD, '$')) + "PING: x",
+             {{COMMAND_FRAME_PAYLOAD, std::string(COMMAND_FRAME_MAX_PAYLOAD, '$')}}},
+    };
+    bool framing_ok = true;
+    for (const auto &c : cases) {
+        for (size_t chunk : {(size_t) 0, (size_t) 1, (size_t) 2, (size_t) 3, (size_t) 7, (size_t) 64, c.input.size()}) {
+            framing_ok = framing_ok && command_parse(&parser, c.input, chunk) == c.expected;
+        }
+    }
+    printf("framing, errors and resynchronisation: %s\n", framing_ok ? "ok" : "WRONG");
+    ok = ok && framing_ok;
+
+    // requests and replies
+    command_count = 0;
+    command_register_builtin();
+    command_register("FAIL", &command_fail, "FAIL  fails");
+    command_register("LONG", &command_long, "LONG  replies with more than fits into a frame");
+    static csi_format_buffer_t text, out;
+    auto line_reply = [&](const char *line) {
+        return command_dispatch_line(line, &text, &out) ? std::string(out.buf, out.len) : "NOT A COMMAND";
+    };
+    auto starts_with = [](const std::string &s, const std::string &prefix) {
+        return s.compare(0, prefix.size(), prefix) == 0;
+    };
+    std::string long_reply = command_request(&parser, "3 LONG");
+    bool dispatch_ok = command_request(&parser, "42 PING hello") == "42 OK hello"
+                       && command_request(&parser, "43 PING") == "43 OK"
+                       && command_request(&parser, "44 FAIL") == "44 ERR failed on purpose"
+                       && command_request(&parser, "45 NOPE") == "45 ERR unknown command"
+                       && command_request(&parser, "46 PINGS") == "46 ERR unknown command"
+                       && command_request(&parser, "PING") == "0 ERR malformed request"
+                       && command_request(&parser, "12345678901 PING") == "0 ERR malformed request"
+                       && command_request(&parser, std::string("47 PING a\0b", 10)) == "47 ERR malformed request"
+                       && starts_with(command_request(&parser, "48 HELP"),
+                                      "48 OK PING [text]  replies with the text\nHELP")
+                       && long_reply.size() == COMMAND_FRAME_MAX_PAYLOAD && starts_with(long_reply, "3 OK xx")
+                       && line_reply("PING: hi") == "PING: OK hi\n"
+                       && line_reply("  PING") == "PING: OK\n"
+                       && line_reply("FAIL x") == "FAIL: ERR failed on purpose\n"
+                       && line_reply("PINGER") == "NOT A COMMAND"
+                       && line_reply("1700000000.5") == "NOT A COMMAND";
+    const char *numbers[] = {"0", "5000", "5001", "4294967295", "4294967296", "99999999999", "", "x"};
+    uint32_t expected_numbers[] = {1, 1, 0, 1, 0, 0, 0, 0};
+    for (int i = 0; i < 8; i++) {
+        const char *p = numbers[i];
+        uint32_t v;
+        uint32_t max = i < 3 ? 5000 : UINT32_MAX;
+        dispatch_ok = dispatch_ok && command_parse_uint(&p, max, &v) == (expected_numbers[i] == 1);
+    }
+    printf("requests and replies: %s\n", dispatch_ok ? "ok" : "WRONG");
+    ok = ok && dispatch_ok;
+
+    // Fuzzing: streams of frames (some corrupted) and plain lines, fed in random chunks. A corrupted frame is never
+    // taken for a good one, and a good frame right after one which was recognised is always recognised.
+    std::mt19937 rng(17);
+    std::uniform_int_distribution<int> byte(0, 255);
+    uint64_t frames = 0, corrupted = 0, recovered = 0, false_accepts = 0, missed = 0, chunk_mismatches = 0;
+    for (uint32_t s = 0; s < streams; s++) {
+        std::string input;
+        struct sent_t {
+            std::string payload;
+            bool intact;
+        };
+        std::vector<sent_t> sent;
+        int count = 1 + rng() % 40;
+        for (int i = 0; i < count; i++) {
+            if (rng() % 8 == 0) {
+                input += "CSI_DATA,PASSIVE,24:0A:C4:00:00:01,-50\n";
+            }
+            std::string payload;
+            size_t len = 1 + rng() % (rng() % 4 == 0 ? COMMAND_FRAME_MAX_PAYLOAD : 40);
+            for (size_t j = 0; j < len; j++) {
+                // anything, '\n' and '$' included, as long as it is not the same as an earlier payload
+                payload += (char) byte(rng);
+            }
+            payload = std::to_string(frames) + " " + payload;
+            payload.resize(std::min(payload.size(), (size_t) COMMAND_FRAME_MAX_PAYLOAD));
+            std::string frame = command_frame(payload);
+            bool intact = rng() % 3 != 0;
+            if (!intact) {
+                size_t at = rng() % frame.size();
+                switch (rng() % 4) {
+                    case 0:
+                        frame[at] = (char) (frame[at] ^ (1 + rng() % 255));
+                        break;
+                    case 1:
+                        frame.erase(at, 1);
+                        break;
+                    case 2:
+                        // a '\r' before the frame or its '\n' would not change anything
+                        frame.insert(at, 1, at == 0 || at == frame.size() - 1 ? 'x' : (char) byte(rng));
+                        break;
+                    default:
+                        frame.resize(at);
+                        break;
+                }
+                corrupted++;
+            }
+            frames++;
+            input += frame;
+            sent.push_back({payload, intact});
+        }
+
+        std::vector<command_event_t> events = command_parse(&parser, input, 0);
+        size_t chunk = 1 + rng() % 100;
+        chunk_mismatches += command_parse(&parser, input, chunk) != events;
+        std::set<std::string> received;
+        for (const command_event_t &e : events) {
+            if (e.event == COMMAND_FRAME_PAYLOAD) {
+                received.insert(e.text);
+            }
+        }
+        bool previous_received = true;
+        for (const sent_t &f : sent) {
+            bool got = received.erase(f.payload) > 0;
+            recovered += got && f.intact;
+            false_accepts += got && !f.intact;
+            missed += !got && f.intact && previous_received;
+            previous_received = got;
+        }
+        // anything else received would be a frame which was never sent
+        false_accepts += received.size();
+    }
+    bool fuzz_ok = false_accepts == 0 && missed == 0 && chunk_mismatches == 0;
+    printf("%u streams, %llu frames (%llu corrupted): %llu intact frames recovered, %llu missed, %llu false accepts, "
+           "%llu chunking mismatches: %s\n", streams, (unsigned long long) frames, (unsigned long long) corrupted,
+           (unsigned long long) recovered, (unsigned long long) missed, (unsigned long long) false_accepts,
+           (unsigned long long) chunk_mismatches, fuzz_ok ? "ok" : "WRONG");
+    ok = ok && fuzz_ok;
+
+    // parser throughput, 64 byte reads as from the UART driver
+    std::string stream;
+    while (stream.size() < 64 * 1024 * 1024) {
+        stream += command_frame("123 FILTER ALLOW; ADD 24:0a:c4:00:00:01,24:0a:c4:00:00:02; RSSI -70");
+        stream += "SETTIME: 1700000000.123456\n";
+    }
+    uint64_t payloads = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < stream.size();) {
+        size_t n = std::min((size_t) 64, stream.size() - pos), consumed;
+        payloads += command_frame_parser_feed(&parser, stream.data() + pos, n, &consumed) != COMMAND_FRAME_NONE;
+        pos += consumed;
+    }
+    double seconds = seconds_since(start);
+    printf("parser: %.0f MB/s, %.0f ns per command (%llu)\n", stream.size() / seconds / 1e6,
+           seconds * 1e9 / payloads, (unsigned long long) payloads);
+
+    // round trips
+    for (int poll_ms : {0, 10}) {
+        std::vector<uint32_t> us = command_round_trips(poll_ms > 0 ? 200 : 20000, poll_ms);
+        if (us.empty()) {
+            printf("round trips: WRONG\n");
+            ok = false;
+            continue;
+        }
+        printf("round trip, %s: %zu PINGs, p50 %u us, p99 %u us, max %u us\n",
+               poll_ms > 0 ? "device polling every 10 ms" : "device woken by input", us.size(),
+               exact_percentile(us, 500), exact_percentile(us, 990), us.back());
+    }
+
+    printf("command frames: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+/*
+ * Two clocks as functions of the true time (all in microseconds): the node's steady clock and the server's real clock,
+ * each running at a rate which changes once, and the server's clock optionally set to another time once.
+ */
+struct sync_clocks_t {
+    double node_skew_ppm = 40, node_skew_after_ppm = 40;
+    double server_skew_ppm = -15;
+    double skew_change_us = 0;
+    double server_start_us = 1700000000e6;
+    double server_step_us = 0, server_step_at_us = -1;
+
+    double node(double t) const {
+        double before = std::min(t, skew_change_us), after = std::max(0.0, t - skew_change_us);
+        return 5e6 + t + before * node_skew_ppm * 1e-6 + after * node_skew_after_ppm * 1e-6;
+    }
+
+    double server(double t) const {
+        double step = server_step_at_us >= 0 && t >= server_step_at_us ? server_step_us : 0;
+        return server_start_us + t * (1 + server_skew_ppm * 1e-6) + step;
+    }
+
+    // server microseconds gained per node microsecond, at `t`
+    double relative_drift(double t) const {
+        double node_ppm = t < skew_change_us ? node_skew_ppm : node_skew_after_ppm;
+        return (1 + server_skew_ppm * 1e-6) / (1 + node_ppm * 1e-6) - 1;
+    }
+};
+
+struct sync_scenario_t {
+    const char *name;
+    sync_clocks_t clocks;
+    double interval_us;
+    // each way: a fixed delay, exponential jitter of this mean, and now and then a much longer one
+    double delay_us, jitter_us, spike_us, spike_rate;
+    double loss_rate;
+};
+
+/*
+ * Runs one scenario through `clock_sync_t` and checks the estimate at random frame times between exchanges against
+ * the true server time. Frames between a step of the server's clock and the estimate starting over are counted apart.
+ */
+static bool check_sync_scenario(const sync_scenario_t &scenario, double seconds, std::mt19937_64 &rng) {
+    const sync_clocks_t &c = scenario.clocks;
+    std::exponential_distribution<double> jitter(1.0 / scenario.jitter_us);
+    std::uniform_real_distribution<double> unit(0, 1);
+    auto one_way = [&]() {
+        return scenario.delay_us + jitter(rng) + (unit(rng) < scenario.spike_rate ? scenario.spike_us * unit(rng) : 0);
+    };
+
+    static clock_sync_t s;
+    clock_sync_init(&s);
+    std::vector<uint32_t> errors, bounds;
+    size_t frames = 0, violations = 0, stepping = 0, unsynced = 0;
+    double worst_excess = 0;
+    // steps before the server's clock was set
+    uint32_t steps_before = 0;
+    for (double t = 0; t < seconds * 1e6; t += scenario.interval_us) {
+        if (unit(rng) >= scenario.loss_rate) {
+            double arrive = t + one_way();
+            double leave = arrive + 50 + 250 * unit(rng);
+            double back = leave + one_way();
+            clock_sync_add(&s, llround(c.node(t)), llround(c.server(arrive)), llround(c.server(leave)),
+                           llround(c.node(back)));
+        }
+        for (int i = 0; i < 10; i++) {
+            double frame = t + scenario.interval_us * unit(rng);
+            frames++;
+            if (!s.valid) {
+                unsynced++;
+                continue;
+            }
+            int64_t local = llround(c.node(frame));
+            double error = std::fabs((double) clock_model_remote_us(&s.model, local) - c.server(frame));
+            uint32_t bound = clock_model_uncertainty_us(&s.model, local);
+            // the server's clock was set, and the estimate has not started over yet
+            bool stepped = c.server_step_at_us >= 0 && frame >= c.server_step_at_us && s.steps == steps_before;
+            if (stepped) {
+                stepping++;
+                continue;
+            }
+            errors.push_back((uint32_t) std::min(error, 4e9));
+            bounds.push_back(bound);
+            if (error > bound + 0.5) {
+                violations++;
+                worst_excess = std::max(worst_excess, error - bound);
+            }
+        }
+        if (c.server_step_at_us < 0 || t + scenario.interval_us < c.server_step_at_us) {
+            steps_before = s.steps;
+        }
+    }
+
+    std::sort(errors.begin(), errors.end());
+    std::sort(bounds.begin(), bounds.end());
+    double drift_error_ppb = (s.model.drift_q32 / 4294967296.0 - c.relative_drift(seconds * 1e6)) * 1e9;
+    bool ok = violations == 0 && !errors.empty();
+    printf("%-12s error p50 %5u us, p99 %5u us, max %6u us | bound p50 %6u us | outside the bound %zu of %zu "
+           "(by up to %.0f us) | drift off by %6.0f ppb | %u steps, %zu frames stepping, %zu before the first "
+           "exchange | %s\n",
+           scenario.name, exact_percentile(errors, 500), exact_percentile(errors, 990), errors.back(),
+           exact_percentile(bounds, 500), violations, errors.size(), worst_excess, drift_error_ppb, s.steps, stepping,
+           unsynced, ok ? "ok" : "WRONG");
+    return ok;
+}
+
+/*
+ * Runs `exchanges` clock sync exchanges over loopback against `time_server_answer()` answering with a clock running
+ * `skew_ppm` fast and an hour ahead, dropping every 10th request, and checks the estimate against that clock.
+ */
+static bool check_sync_loopback(uint32_t exchanges, int interval_ms, double skew_ppm) {
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int client_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+    if (bind(server_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+        || getsockname(server_fd, (struct sockaddr *) &addr, &addr_len) != 0
+        || connect(client_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        printf("ERROR: cannot set up loopback sockets\n");
+        return false;
+    }
+    struct timeval timeout = {0, 100000};
+    setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    auto steady_us = []() {
+        return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    const int64_t start_us = steady_us();
+    auto server_clock = [&]() {
+        int64_t elapsed = steady_us() - start_us;
+        return 1700000000000000LL + 3600000000LL + elapsed + (int64_t) (elapsed * skew_ppm * 1e-6);
+    };
+
+    std::atomic<bool> stop(false);
+    std::thread server([&]() {
+        uint32_t requests = 0;
+        while (!stop) {
+            uint8_t peek[CLOCK_SYNC_REQUEST_SIZE];
+            if (recv(server_fd, peek, sizeof(peek), MSG_PEEK) <= 0) {
+                continue;
+            }
+            // every 10th request is dropped, as a lost datagram
+            if (++requests % 10 == 0) {
+                recv(server_fd, peek, sizeof(peek), 0);
+                continue;
+            }
+            time_server_answer(server_fd, server_clock, CLOCK_SYNC_FLAG_REAL_TIME_SET);
+        }
+    });
+
+    static clock_sync_t s;
+    clock_sync_init(&s);
+    uint32_t replies = 0, timeouts = 0, wrong = 0;
+    for (uint32_t sequence = 0; sequence < exchanges; sequence++) {
+        uint8_t buf[CLOCK_SYNC_REPLY_SIZE + 1];
+        int64_t t1 = steady_us();
+        clock_sync_encode_request(buf, sequence, t1);
+        send(client_fd, buf, CLOCK_SYNC_REQUEST_SIZE, 0);
+        while (true) {
+            ssize_t n = recv(client_fd, buf, sizeof(buf), 0);
+            int64_t t4 = steady_us();
+            clock_sync_message_t reply;
+            if (n < 0) {
+                timeouts++;
+                break;
+            }
+            if (clock_sync_parse(buf, n, &reply) && reply.type == CLOCK_SYNC_REPLY && reply.sequence == sequence
+                && reply.t1 == t1) {
+                wrong += (reply.flags & CLOCK_SYNC_FLAG_REAL_TIME_SET) == 0;
+                clock_sync_add(&s, t1, reply.t2, reply.t3, t4);
+                replies++;
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+    stop = true;
+    server.join();
+    close(server_fd);
+    close(client_fd);
+
+    int64_t local = steady_us();
+    int64_t truth = server_clock();
+    int64_t error = clock_model_remote_us(&s.model, local) - truth;
+    uint32_t bound = clock_model_uncertainty_us(&s.model, local);
+    double drift_ppm = s.model.drift_q32 / 4294967296.0 * 1e6;
+    bool ok = s.valid && replies + timeouts == exchanges && timeouts == exchanges / 10 && wrong == 0
+              && std::abs(error) <= (int64_t) bound + 1 && std::fabs(drift_ppm - skew_ppm) < 10;
+    printf("loopback: %u exchanges, %u replies, %u lost | error %lld us, bound %u us, min delay %u us | drift "
+           "%.2f ppm (server runs %.2f ppm fast) | %s\n", exchanges, replies, timeouts, (long long) error, bound,
+           s.min_delay_us, drift_ppm, skew_ppm, ok ? "ok" : "WRONG");
+    return ok;
+}
+
+/*
+ * Clock sync (`_components/clock_sync_component.h`): the estimator against simulated clocks and networks, the
+ * protocol over loopback, and the cost of stamping a frame with the model.
+ */
+static int bench_sync(double hours) {
+    std::mt19937_64 rng(42);
+    bool ok = true;
+
+    // encoding round trip and rejection of anything else
+    uint8_t request[CLOCK_SYNC_REQUEST_SIZE], reply[CLOCK_SYNC_REPLY_SIZE];
+    clock_sync_message_t m;
+    clock_sync_encode_request(request, 0xDEADBEEF, -42);
+    size_t reply_len = clock_sync_encode_reply(reply, request, sizeof(request), 1700000000000001LL, 1);
+    clock_sync_stamp_reply(reply, 1700000000000002LL);
+    bool format_ok = clock_sync_parse(request, sizeof(request), &m) && m.type == CLOCK_SYNC_REQUEST
+                     && m.sequence == 0xDEADBEEF && m.t1 == -42
+                     && reply_len == CLOCK_SYNC_REPLY_SIZE && clock_sync_parse(reply, reply_len, &m)
+                     && m.type == CLOCK_SYNC_REPLY && m.flags == 1 && m.t1 == -42 && m.t2 == 1700000000000001LL
+                     && m.t3 == 1700000000000002LL
+                     && clock_sync_encode_reply(reply, reply, reply_len, 0, 0) == 0
+                     && !clock_sync_parse(request, sizeof(request) - 1, &m);
+    request[0] = 'X';
+    format_ok = format_ok && !clock_sync_parse(request, sizeof(request), &m);
+    printf("datagram format: %s\n", format_ok ? "ok" : "WRONG");
+    ok = ok && format_ok;
+
+    sync_scenario_t lan = {"wifi", {}, 1e6, 1500, 300, 20000, 0.05, 0.02};
+    sync_scenario_t busy = {"busy", {}, 1e6, 2000, 3000, 50000, 0.2, 0.1};
+    sync_scenario_t warming = lan;
+    warming.name = "temperature";
+    warming.clocks.skew_change_us = hours * 3600e6 / 2;
+    warming.clocks.node_skew_after_ppm = 48;
+    sync_scenario_t stepped = lan;
+    stepped.name = "server set";
+    stepped.clocks.server_step_at_us = hours * 3600e6 * 0.75;
+    stepped.clocks.server_step_us = 3600e6;
+    sync_scenario_t sparse = lan;
+    sparse.name = "every 30 s";
+    sparse.interval_us = 30e6;
+    for (const sync_scenario_t &scenario : {lan, busy, warming, stepped, sparse}) {
+        ok = check_sync_scenario(scenario, hours * 3600, rng) && ok;
+    }
+
+    ok = check_sync_loopback(60, 100, 80) && ok;
+
+    // per frame: the real timestamp from a plain offset, and from the model with its bound
+    static clock_sync_t s;
+    clock_sync_init(&s);
+    for (int i = 0; i < 64; i++) {
+        int64_t t = 5000000 + i * 1000000LL;
+        clock_sync_add(&s, t, 1700000000000000LL + t + i * 40 + 1500, 1700000000000000LL + t + i * 40 + 1600, t + 3100);
+    }
+    const int frames = 10000000;
+    std::vector<int64_t> locals(1024);
+    for (size_t i = 0; i < locals.size(); i++) {
+        locals[i] = 70000000 + (int64_t) (rng() % 1000000);
+    }
+    volatile int64_t offset_us = 1700000000000000LL;
+    int64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        sink += locals[i & 1023] + offset_us;
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        int64_t local_us = locals[i & 1023];
+        sink += clock_model_remote_us(&s.model, local_us) + clock_model_uncertainty_us(&s.model, local_us);
+    }
+    auto end = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100000; i++) {
+        int64_t t = 70000000 + i * 1000000LL;
+        clock_sync_add(&s, t, 1700000000000000LL + t + 1500, 1700000000000000LL + t + 1600, t + 3100 + (i % 7) * 100);
+    }
+    auto fitted = std::chrono::steady_clock::now();
+    auto ns_per_frame = [&](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::nano>(d).count() / frames;
+    };
+    printf("offset:          %6.2f ns/frame\n", ns_per_frame(middle - start));
+    printf("model and bound: %6.2f ns/frame\n", ns_per_frame(end - middle));
+    printf("exchange (fit of %d): %.2f us\n", CLOCK_SYNC_WINDOW,
+           std::chrono::duration<double, std::micro>(fitted - end).count() / 100000);
+    printf("(%lld)\n", (long long) (sink & 0xFF));
+    return ok ? 0 : 1;
+}
+
+/*
+ * Floating-point reference of `csi_features_component.h` for one MAC: the same window, from scratch every frame.
+ */
+struct features_reference_t {
+    int group;
+    std::vector<std::vector<double>> window;
+    bool motion = false;
+
+    // score in ppm, or -1 until the window is full
+    double add(const int8_t *iq, int len) {
+        int pairs = std::min(len / 2, CSI_FEATURES_MAX_PAIRS);
+        std::vector<double> groups;
+        for (int k = 0; k < pairs; k += group) {
+            int n = std::min(group, pairs - k);
+            double sum = 0;
+            for (int i = 0; i < n; i++) {
+                sum += sqrt(pow(iq[(k + i) * 2], 2) + pow(iq[(k + i) * 2 + 1], 2));
+            }
+            groups.push_back(sum / n);
+        }
+        window.push_back(groups);
+        if (window.size() > CSI_FEATURES_WINDOW) {
+            window.erase(window.begin());
+        }
+        if (window.size() < CSI_FEATURES_WINDOW) {
+            return -1;
+        }
+        double variances = 0, squared_means = 0;
+        for (size_t g = 0; g < groups.size(); g++) {
+            double mean = 0, variance = 0;
+            for (const std::vector<double> &frame : window) {
+                mean += frame[g] / CSI_FEATURES_WINDOW;
+            }
+            for (const std::vector<double> &frame : window) {
+                variance += (frame[g] - mean) * (frame[g] - mean) / CSI_FEATURES_WINDOW;
+            }
+            variances += variance;
+            squared_means += mean * mean;
+        }
+        return squared_means > 0 ? variances / squared_means * 1e6 : 0;
+    }
+};
+
+/*
+ * A synthetic frame of 64 subcarriers: a fixed amplitude profile, scaled by `gain`, which people moving around
+ * modulate by up to `motion` (as a fraction), plus receiver noise.
+ */
+static void features_frame(int8_t *iq, double t, double gain, double motion, std::mt19937_64 &rng) {
+    std::normal_distribution<double> noise(0, 0.7);
+    for (int k = 0; k < 64; k++) {
+        double amplitude = gain * (20 + 8 * sin(k / 5.0)) * (1 + motion * sin(2 * M_PI * 1.5 * t + k * 0.3));
+        double phase = k * 0.7;
+        double imag = amplitude * sin(phase) + noise(rng), real = amplitude * cos(phase) + noise(rng);
+        iq[k * 2] = (int8_t) std::max(-128L, std::min(127L, lround(imag)));
+        iq[k * 2 + 1] = (int8_t) std::max(-128L, std::min(127L, lround(real)));
+    }
+}
+
+static int bench_features(int64_t seconds) {
+    std::mt19937_64 rng(42);
+    bool ok = true;
+
+    // every possible pair against the rounded exact amplitude, and the square root against libm
+    int amplitude_mismatches = 0, isqrt_mismatches = 0;
+    std::vector<int8_t> iq(256 * 256 * 2);
+    for (int k = 0; k < 256 * 256; k++) {
+        iq[k * 2] = (int8_t) (k >> 8);
+        iq[k * 2 + 1] = (int8_t) (k & 0xFF);
+    }
+    std::vector<uint16_t> amplitude(256 * 256);
+    csi_features_amplitude_q8(iq.data(), 256 * 256, amplitude.data());
+    for (int k = 0; k < 256 * 256; k++) {
+        double a = sqrt(pow(iq[k * 2], 2) + pow(iq[k * 2 + 1], 2));
+        amplitude_mismatches += amplitude[k] != lround(a * 256);
+    }
+    std::vector<uint32_t> roots = {0, 1, 2, 3, 4, 5, 6, 99, 100, 101, UINT32_MAX, UINT32_MAX - 1, 0xFFFE0001u};
+    for (int i = 0; i < 1000000; i++) {
+        roots.push_back((uint32_t) rng() >> (rng() % 32));
+    }
+    for (uint32_t x : roots) {
+        isqrt_mismatches += csi_features_isqrt(x) != (uint32_t) llround(sqrt((double) x));
+    }
+    printf("fixed-point amplitude: %d of %d pairs differ from the rounded exact one, isqrt: %d of %zu differ\n",
+           amplitude_mismatches, 256 * 256, isqrt_mismatches, roots.size());
+    ok = ok && amplitude_mismatches == 0 && isqrt_mismatches == 0;
+
+    // grouping, including a last group which is not full
+    uint16_t values[10] = {100, 200, 300, 400, 500, 600, 700, 800, 900, 1000}, grouped[10];
+    int groups = csi_features_group_q8(values, 10, 4, grouped);
+    bool group_ok = groups == 3 && grouped[0] == 250 && grouped[1] == 650 && grouped[2] == 950
+                    && csi_features_group_q8(values, 10, 1, grouped) == 10 && grouped[9] == 1000;
+    printf("grouping: %s\n", group_ok ? "ok" : "WRONG");
+    ok = ok && group_ok;
+
+    // 100 frames/s from a MAC with people moving around now and then, interleaved with a still one
+    const int rate = 100;
+    const uint8_t moving_mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    const uint8_t still_mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x02};
+    std::vector<std::pair<double, double>> movements = {{20, 30}, {45, 50}};
+    for (double start = 70; start + 12 < seconds; start += 40) {
+        movements.push_back({start, start + 12});
+    }
+    static csi_features_t features;
+    csi_features_configure(&features, 4, 5000, 1000);
+    features_reference_t reference = {4, {}, false};
+    std::vector<int8_t> frame(128);
+    std::vector<double> starts, ends;
+    double worst_score_error = 0, worst_still_score = 0;
+    int64_t moving_frames = 0, moving_flagged = 0;
+    int still_events = 0, reference_disagreements = 0, summaries = 0;
+    uint64_t raw_bytes = 0, feature_bytes = 0;
+    csi_format_buffer_t b;
+    csi_record_t record = {};
+    for (int64_t i = 0; i < seconds * rate; i++) {
+        double t = (double) i / rate;
+        bool moving = false;
+        for (const std::pair<double, double> &m : movements) {
+            moving = moving || (t >= m.first && t < m.second);
+        }
+        for (int source = 0; source < 2; source++) {
+            // the gain of the moving MAC changes while people move (where it cannot be told apart from them)
+            double gain = source == 0 && t >= 30 ? 0.6 : 1.0;
+            features_frame(frame.data(), t, gain, source == 0 && moving ? 0.25 : 0, rng);
+            csi_features_link_t *link;
+            int64_t now_us = (int64_t) i * 1000000 / rate + source * 100;
+            uint32_t due = csi_features_add(&features, source == 0 ? moving_mac : still_mac, -50, frame.data(),
+                                            (int) frame.size(), now_us, &link);
+
+            memcpy(record.mac, link->mac, 6);
+            record.len = (uint16_t) frame.size();
+            csi_format_reset(&b);
+            csi_format_csv_prefix(&b, "STA", &record);
+            csi_format_csv_values(&b, frame.data(), (int) frame.size());
+            csi_format_csv_suffix(&b);
+            raw_bytes += b.len;
+
+            if (due & CSI_FEATURES_MOTION_CHANGED) {
+                csi_features_format_motion(&b, "STA", link, now_us);
+                feature_bytes += b.len;
+                if (source == 1) {
+                    still_events++;
+                } else {
+                    (link->motion ? starts : ends).push_back(t);
+                }
+            }
+            if (due & CSI_FEATURES_SUMMARY_DUE) {
+                csi_features_format_summary(&b, "STA", link, now_us);
+                feature_bytes += b.len;
+                summaries++;
+                csi_features_summary_done(link, now_us);
+            }
+            if (source == 0) {
+                double expected = reference.add(frame.data(), (int) frame.size());
+                if (expected < 0) {
+                    continue;
+                }
+                worst_score_error = std::max(worst_score_error, fabs(link->score_ppm - expected) / (expected + 100));
+                bool reference_motion = reference.motion ? expected >= 2500 : expected >= 5000;
+                reference.motion = reference_motion;
+                // only right at the threshold may rounding tip the balance
+                if (reference_motion != link->motion && fabs(expected - 5000) > 100 && fabs(expected - 2500) > 100) {
+                    reference_disagreements++;
+                }
+                // still, and the window holds no frames of a movement either
+                if (!moving) {
+                    bool settled = true;
+                    for (const std::pair<double, double> &m : movements) {
+                        settled = settled && (t < m.first || t >= m.second + 0.5);
+                    }
+                    if (settled) {
+                        worst_still_score = std::max(worst_still_score, (double) link->score_ppm);
+                    }
+                }
+                if (moving) {
+                    moving_frames++;
+                    moving_flagged += link->motion;
+                }
+            }
+        }
+    }
+
+    // every movement is one start and one end, found within half a second
+    bool events_ok = starts.size() == movements.size() && ends.size() == movements.size() && still_events == 0;
+    double worst_delay = 0;
+    for (size_t m = 0; events_ok && m < movements.size(); m++) {
+        double delay = std::max(fabs(starts[m] - movements[m].first), fabs(ends[m] - movements[m].second));
+        worst_delay = std::max(worst_delay, delay);
+    }
+    events_ok = events_ok && worst_delay < 0.5;
+    printf("score against the double reference: off by up to %.2f%% (+100 ppm), %d motion decisions differ\n",
+           worst_score_error * 100, reference_disagreements);
+    printf("scores: still up to %.0f ppm (threshold 5000), motion flagged for %.1f%% of the time people move\n",
+           worst_still_score, 100.0 * moving_flagged / moving_frames);
+    printf("motion: %zu movements, %zu starts, %zu ends, events from the still MAC %d, detected within %.2f s: %s\n",
+           movements.size(), starts.size(), ends.size(), still_events, worst_delay, events_ok ? "ok" : "WRONG");
+    printf("output: %.1f MB of raw CSV, %.1f kB of features (%d summaries and the events), %.0fx smaller\n",
+           raw_bytes / 1e6, feature_bytes / 1e3, summaries, (double) raw_bytes / feature_bytes);
+    ok = ok && events_ok && worst_score_error < 0.02 && reference_disagreements == 0;
+
+    // a summary line as the firmware writes it
+    csi_features_configure(&features, 16, 5000, 1000);
+    csi_features_link_t *link;
+    int8_t flat[128];
+    for (int k = 0; k < 64; k++) {
+        flat[k * 2] = (int8_t) (k < 16 ? 3 : 0);
+        flat[k * 2 + 1] = (int8_t) (k < 16 ? 4 : k / 16);
+    }
+    csi_features_add(&features, moving_mac, -41, flat, 128, 0, &link);
+    csi_features_add(&features, moving_mac, -44, flat, 128, 1000, &link);
+    csi_features_format_summary(&b, "AP", link, 1700000000000250LL);
+    std::string summary(b.buf, b.len);
+    bool summary_ok =
+            summary == "CSI_FEATURES,AP,24:0A:C4:00:00:01,1700000000.000250,2,-42,0,0,0,4,[5.00 1.00 2.00 3.00]\n";
+    csi_features_format_motion(&b, "AP", link, -500000);
+    summary_ok = summary_ok && std::string(b.buf, b.len) == "CSI_MOTION,AP,24:0A:C4:00:00:01,-0.500000,0,0\n";
+    printf("record format: %s\n", summary_ok ? "ok" : ("WRONG: " + summary).c_str());
+    ok = ok && summary_ok;
+
+    // per frame: the double reference, and the fixed-point features
+    const int frames = 20000;
+    std::vector<std::vector<int8_t>> trace(256, std::vector<int8_t>(128));
+    for (size_t i = 0; i < trace.size(); i++) {
+        features_frame(trace[i].data(), i / 100.0, 1, 0.25, rng);
+    }
+    csi_features_configure(&features, 4, 5000, 1000);
+    features_reference_t timed_reference = {4, {}, false};
+    double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        sink += timed_reference.add(trace[i & 255].data(), 128);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames * 10; i++) {
+        sink += csi_features_add(&features, moving_mac, -50, trace[i & 255].data(), 128, i * 10000LL, &link);
+        sink += link->score_ppm;
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("double reference: %8.1f ns/frame\n",
+           std::chrono::duration<double, std::nano>(middle - start).count() / frames);
+    printf("fixed point:      %8.1f ns/frame\n",
+           std::chrono::duration<double, std::nano>(end - middle).count() / (frames * 10));
+    printf("(%g)\n", sink);
+    return ok ? 0 : 1;
+}
+
+// One simulated station of `bench_sessions`.
+struct session_station_t {
+    uint32_t natural_fps;
+    // when it joins (s), leaves and associates again without leaving first (-1 for never), and how long after joining
+    // DHCP gives it an address
+    double join_s, leave_s, rejoin_s, ip_delay_s;
+    bool joined, rejoined, has_ip;
+    int64_t count_from_us, ip_us;
+    uint64_t frames, counted_us, solicited, solicited_absent;
+};
+
+/*
+ * `seconds` of an AP with `stations`, which answer 95 % of the solicitations 2 to 5 ms later. Frames are counted from
+ * 2 s after a station joined (or got its address), while it stays. With `target_fps` 0 nothing is solicited or
+ * limited (the AP as it was). Returns the table for a look at the sessions left.
+ */
+static sta_session_table_t *session_run(std::vector<session_station_t> &stations, uint32_t target_fps,
+                                        int64_t seconds) {
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    sta_session_table_t *table = new sta_session_table_t;
+    sta_session_table_init(table, target_fps, 0);
+    csi_rate_limit_t limit;
+    csi_rate_limit_configure(&limit, target_fps, 5, 1, 1);
+    // (time us, station) of the frames on their way, soonest first
+    typedef std::pair<int64_t, uint32_t> arrival_t;
+    std::priority_queue<arrival_t, std::vector<arrival_t>, std::greater<arrival_t>> arrivals;
+    for (uint32_t s = 0; s < stations.size(); s++) {
+        session_station_t &st = stations[s];
+        st.joined = st.rejoined = st.has_ip = false;
+        st.frames = st.counted_us = st.solicited = st.solicited_absent = 0;
+        if (st.natural_fps > 0) {
+            std::exponential_distribution<double> gap(st.natural_fps / 1e6);
+            for (double t = st.join_s * 1e6; t < seconds * 1e6; t += gap(rng)) {
+                arrivals.push({(int64_t) t, s});
+            }
+        }
+    }
+
+    const int64_t tick_us = 10000;
+    for (int64_t now_us = 0; now_us < seconds * 1000000; now_us += tick_us) {
+        for (uint32_t s = 0; s < stations.size(); s++) {
+            session_station_t &st = stations[s];
+            uint8_t mac[6];
+            filter_mac(s, mac);
+            bool present = now_us >= st.join_s * 1e6 && (st.leave_s < 0 || now_us < st.leave_s * 1e6);
+            if (!st.joined && present) {
+                // a station which found the table full tries again
+                st.joined = sta_session_join(table, mac, (uint16_t) (s + 1), now_us);
+                st.ip_us = st.ip_delay_s < 0 ? INT64_MAX : now_us + (int64_t) (st.ip_delay_s * 1e6);
+                // a station without an address can only yield what it sends
+                st.count_from_us = std::max(now_us + 2000000, st.ip_delay_s < 0 ? 0 : st.ip_us);
+            } else if (st.joined && !present) {
+                sta_session_leave(table, mac);
+                st.joined = st.has_ip = false;
+            } else if (st.joined && !st.rejoined && st.rejoin_s >= 0 && now_us >= st.rejoin_s * 1e6) {
+                // keeps its slot and address
+                st.rejoined = sta_session_join(table, mac, (uint16_t) (s + 100), now_us);
+            }
+            if (st.joined && !st.has_ip && now_us >= st.ip_us) {
+                sta_session_set_ip(table, mac, htonl(0xC0A80402 + s));
+                st.has_ip = true;
+            }
+            st.counted_us += st.joined && now_us >= st.count_from_us ? tick_us : 0;
+        }
+        while (!arrivals.empty() && arrivals.top().first < now_us) {
+            arrival_t a = arrivals.top();
+            arrivals.pop();
+            session_station_t &st = stations[a.second];
+            if (!st.joined) {
+                continue;
+            }
+            uint8_t mac[6];
+            filter_mac(a.second, mac);
+            // as in `_wifi_csi_cb`: the rate limit, then the station's count
+            if (target_fps > 0 && !csi_rate_limit_accept(&limit, mac, (uint32_t) a.first)) {
+                continue;
+            }
+            sta_session_frame(table, mac);
+            st.frames += a.first >= st.count_from_us;
+        }
+
+        sta_session_t *due[STA_SESSION_SLOTS];
+        int n = sta_session_poll(table, now_us, due, STA_SESSION_SLOTS);
+        for (int i = 0; i < n; i++) {
+            session_station_t &st = stations[due[i]->mac[5]];
+            st.solicited++;
+            st.solicited_absent += !st.joined || !st.has_ip;
+            if (uniform(rng) < 0.95) {
+                arrivals.push({now_us + 2000 + (int64_t) (uniform(rng) * 3000), due[i]->mac[5]});
+            }
+        }
+    }
+    return table;
+}
+
+// Jain's fairness index: 1 when all rates are the same, 1/n when one station gets everything.
+static double jain_index(const std::vector<double> &rates) {
+    double sum = 0, square_sum = 0;
+    for (double r : rates) {
+        sum += r;
+        square_sum += r * r;
+    }
+    return square_sum == 0 ? 0 : sum * sum / (rates.size() * square_sum);
+}
+
+static int bench_sessions(int64_t seconds) {
+    bool ok = true;
+    if (seconds < 60) {
+        seconds = 60;
+    }
+    const uint32_t target_fps = 50;
+    // A chatty station (500 frames/s), some sending 30 or 5 frames/s and the rest idle. Station 7 gets its address
+    // late and station 8 never. Station 9 leaves half way, station 10 associates again (with a new AID) after a third,
+    // and a 17th station finds the table full until station 9 left.
+    std::vector<session_station_t> stations(STA_SESSION_SLOTS + 1);
+    for (uint32_t s = 0; s < stations.size(); s++) {
+        stations[s].natural_fps = s == 0 ? 500 : (s <= 3 ? 30 : (s <= 6 ? 5 : 0));
+        stations[s].join_s = s * 0.1;
+        stations[s].leave_s = -1;
+        stations[s].rejoin_s = -1;
+        stations[s].ip_delay_s = 1;
+    }
+    stations[7].ip_delay_s = 10;
+    stations[8].ip_delay_s = -1;
+    stations[9].leave_s = seconds / 2.0;
+    stations[10].rejoin_s = seconds / 3.0;
+    stations[STA_SESSION_SLOTS].join_s = 2;
+
+    std::vector<session_station_t> before = stations;
+    delete session_run(before, 0, seconds);
+    sta_session_table_t *table = session_run(stations, target_fps, seconds);
+
+    printf("%lld s, %zu stations, target %u frames/s:\n", (long long) seconds, stations.size(), target_fps);
+    printf("  station  natural  before/s   after/s  solicited\n");
+    std::vector<double> fair_before, fair_after;
+    for (uint32_t s = 0; s < stations.size(); s++) {
+        const session_station_t &st = stations[s];
+        double fps = st.frames / (st.counted_us / 1e6), fps_before = before[s].frames / (before[s].counted_us / 1e6);
+        // nothing goes to a station which is not there (or has no address) or to the chatty one, which the rate
+        // limit holds down; station 8 keeps its own rate
+        bool row_ok = st.solicited_absent == 0 && (s != 0 || st.solicited == 0);
+        if (s == 8) {
+            row_ok = row_ok && st.solicited == 0 && fps == 0;
+        } else {
+            row_ok = row_ok && std::abs(fps - target_fps) < target_fps * 0.1;
+            fair_before.push_back(fps_before);
+            fair_after.push_back(fps);
+        }
+        printf("  %7u %8u %9.1f %9.1f %10llu%s\n", s, st.natural_fps, fps_before, fps,
+               (unsigned long long) st.solicited, row_ok ? "" : "  WRONG");
+        ok = ok && row_ok;
+    }
+
+    // the sessions left: everyone but station 9, station 10 with its new AID and the 17th in the slot of station 9
+    uint32_t sessions = 0;
+    for (int i = 0; i < STA_SESSION_SLOTS; i++) {
+        sessions += table->sessions[i].key.load() != 0;
+    }
+    uint8_t mac[6];
+    filter_mac(9, mac);
+    bool table_ok = sessions == STA_SESSION_SLOTS && sta_session_find(table, mac) == NULL;
+    filter_mac(10, mac);
+    table_ok = table_ok && sta_session_find(table, mac) != NULL && sta_session_find(table, mac)->aid == 110;
+    table_ok = table_ok && table->rejected_joins > 0 && stations[STA_SESSION_SLOTS].counted_us > 0;
+    printf("join, leave and associate again, %u joins rejected while the table was full: %s\n", table->rejected_joins,
+           table_ok ? "ok" : "WRONG");
+    ok = ok && table_ok;
+
+    double jain_before = jain_index(fair_before), jain_after = jain_index(fair_after);
+    bool fair = jain_after > 0.99;
+    printf("Jain fairness index of the stations with an address: %.3f before, %.3f after: %s\n", jain_before,
+           jain_after, fair ? "ok" : "WRONG");
+    ok = ok && fair;
+
+    // the `STA_SESSION` line, and the echo request (its checksum over all of it adds up to 0xFFFF)
+    sta_session_t *s = sta_session_find(table, mac);
+    csi_format_buffer_t line;
+    sta_session_format(&line, "AP", s, s->interval_start_us + 10000000);
+    std::string text(line.buf, line.len);
+    bool format_ok = text.compare(0, 43, "STA_SESSION,AP,24:0A:C4:00:00:0A,110,192.16") == 0
+                     && text.find(",10000,") != std::string::npos && s->interval_frames == 0;
+    uint8_t echo[STA_SESSION_ECHO_SIZE];
+    sta_session_encode_echo(echo, 0x4353, 0x1234);
+    bool echo_ok = echo[0] == 8 && _sta_session_checksum(echo, sizeof(echo)) == 0;
+    echo[15] ^= 1;
+    echo_ok = echo_ok && _sta_session_checksum(echo, sizeof(echo)) != 0;
+    printf("%s", text.c_str());
+    printf("record and echo request: %s\n", format_ok && echo_ok ? "ok" : "WRONG");
+    ok = ok && format_ok && echo_ok;
+
+    // cost per frame in the callback (the MAC found after a scan of all 16), and per poll of a full table
+    const uint32_t frames = 20000000, polls = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < frames; i++) {
+        filter_mac(i % STA_SESSION_SLOTS, mac);
+        sta_session_frame(table, mac);
+    }
+    double frame_ns = seconds_since(start) * 1e9 / frames;
+    start = std::chrono::steady_clock::now();
+    uint64_t picked = 0;
+    for (uint32_t i = 0; i < polls; i++) {
+        sta_session_t *due[STA_SESSION_SLOTS];
+        picked += sta_session_poll(table, (int64_t) (seconds + i / 100) * 1000000 + i % 100 * 10000, due,
+                                   STA_SESSION_SLOTS);
+    }
+    printf("frame: %.1f ns, poll of %d sessions: %.1f ns (%llu picked)\n", frame_ns, STA_SESSION_SLOTS,
+           seconds_since(start) * 1e9 / polls, (unsigned long long) picked);
+    delete table;
+    printf("sessions and polling: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+/*
+ * A frame of `count` values (subcarrier pairs of imaginary and real parts) from a slowly moving scene. With
+ * `random_phase` the whole frame is rotated by a random angle, as the phase offset of real receivers changes from one
+ * frame to the next.
+ */
+static void delta_frame(int8_t *iq, uint16_t count, double t, uint32_t source, bool random_phase,
+                        std::mt19937_64 &rng) {
+    std::normal_distribution<double> noise(0, 0.7);
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    double rotation = random_phase ? angle(rng) : 0.3 * source;
+    for (int k = 0; k < count / 2; k++) {
+        double amplitude = (18 + 6 * sin(k / 7.0 + source)) * (1 + 0.05 * sin(2 * M_PI * 0.5 * t + k * 0.1));
+        double phase = k * (0.2 + 0.05 * source) + rotation;
+        double imag = amplitude * sin(phase) + noise(rng), real = amplitude * cos(phase) + noise(rng);
+        iq[k * 2] = (int8_t) std::max(-128L, std::min(127L, lround(imag)));
+        iq[k * 2 + 1] = (int8_t) std::max(-128L, std::min(127L, lround(real)));
+    }
+}
+
+/*
+ * Encodes `frames` with a fresh encoder and decodes them with a fresh decoder, returning the number of frames which
+ * did not come back exactly.
+ */
+static size_t delta_round_trip(const std::vector<frame_t> &frames, uint16_t keyframe_every, size_t *delta_bytes,
+                               size_t *binary_bytes) {
+    static csi_delta_t encoder, decoder;
+    static uint8_t out[CSI_BINARY_MAX_RECORD_SIZE];
+    csi_delta_init(&encoder, keyframe_every);
+    csi_delta_init(&decoder, 1);
+    size_t mismatches = 0;
+    for (const frame_t &frame : frames) {
+        uint16_t count = (uint16_t) frame.values.size();
+        *binary_bytes += csi_binary_encode_csi(out, sizeof(out), &frame.record, frame.values.data(), count);
+        size_t len = csi_delta_encode(&encoder, out, sizeof(out), &frame.record, frame.values.data(), count);
+        *delta_bytes += len;
+
+        csi_binary_record_t record;
+        size_t consumed;
+        if (csi_binary_decode(out, len, &consumed, &record) != CSI_BINARY_DECODED || consumed != len
+            || record.type != CSI_BINARY_RECORD_CSI_DELTA || !csi_delta_decode(&decoder, &record)
+            || memcmp(&record.record, &frame.record, offsetof(csi_record_t, real_time_uncertainty_us)) != 0
+            || record.value_count != count || memcmp(record.values, frame.values.data(), count) != 0) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/*
+ * A trace of `sources` MACs taking turns, `count` values per frame.
+ */
+static std::vector<frame_t> delta_trace(uint32_t frames, uint32_t sources, uint16_t count, bool random_phase,
+                                        std::mt19937_64 &rng) {
+    std::vector<frame_t> trace(frames);
+    for (uint32_t i = 0; i < frames; i++) {
+        frame_t &frame = trace[i];
+        memset(&frame.record, 0, sizeof(frame.record));
+        uint32_t source = i % sources;
+        filter_mac(source, frame.record.mac);
+        frame.record.rssi = -50 - (int8_t) source;
+        frame.record.channel = 6;
+        frame.record.len = 100;
+        frame.record.local_timestamp = i * 10000;
+        frame.values.resize(count);
+        delta_frame(frame.values.data(), count, i / 100.0, source, random_phase, rng);
+    }
+    return trace;
+}
+
+static int bench_delta(const char *file_name, uint32_t frame_count) {
+    std::vector<frame_t> recorded;
+    if (!load_frames(file_name, &recorded)) {
+        return 1;
+    }
+    std::mt19937_64 rng(42);
+    bool ok = true;
+    static csi_format_buffer_t b;
+
+    // the recorded log, against its CSV and plain binary records
+    size_t csv_bytes = 0, binary_bytes = 0, delta_bytes = 0;
+    for (const frame_t &frame : recorded) {
+        csv_bytes += fast_format(&b, "AP", frame.record, frame.values.data(), frame.values.size()).size();
+    }
+    size_t mismatches = delta_round_trip(recorded, 32, &delta_bytes, &binary_bytes);
+    ok &= mismatches == 0;
+    printf("%s (%zu frames): csv %.1f, binary %.1f, delta %.1f bytes/frame, %.2fx binary, %.2fx csv, "
+           "%zu mismatches\n", file_name, recorded.size(), (double) csv_bytes / recorded.size(),
+           (double) binary_bytes / recorded.size(), (double) delta_bytes / recorded.size(),
+           (double) binary_bytes / delta_bytes, (double) csv_bytes / delta_bytes, mismatches);
+
+    // long synthetic traces of 4 MACs, with a stable and with a random phase offset per frame
+    std::vector<frame_t> stable = delta_trace(frame_count, 4, 384, false, rng);
+    std::vector<frame_t> rotating = delta_trace(frame_count, 4, 384, true, rng);
+    for (const auto &trace : {std::make_pair("stable phase", &stable), std::make_pair("random phase", &rotating)}) {
+        for (uint16_t keyframe_every : {1, 8, 32, 255}) {
+            binary_bytes = delta_bytes = 0;
+            mismatches = delta_round_trip(*trace.second, keyframe_every, &delta_bytes, &binary_bytes);
+            ok &= mismatches == 0;
+            printf("%s, keyframe every %3u: binary %.1f, delta %.1f bytes/frame, %.2fx, %zu mismatches\n",
+                   trace.first, keyframe_every, (double) binary_bytes / frame_count, (double) delta_bytes / frame_count,
+                   (double) binary_bytes / delta_bytes, mismatches);
+        }
+    }
+
+    // odd inputs: the number of values changing, no values, incompressible noise, more MACs than sources
+    std::vector<frame_t> odd = delta_trace(2000, CSI_DELTA_SOURCES + 3, 384, false, rng);
+    std::uniform_int_distribution<int> byte(-128, 127);
+    for (uint32_t i = 0; i < odd.size(); i++) {
+        if (i % 7 == 3) {
+            odd[i].values.resize(i % 2 ? 128 : 0);
+        } else if (i % 11 == 5) {
+            for (int8_t &v : odd[i].values) {
+                v = (int8_t) byte(rng);
+            }
+        }
+    }
+    binary_bytes = delta_bytes = 0;
+    mismatches = delta_round_trip(odd, 32, &delta_bytes, &binary_bytes);
+    ok &= mismatches == 0 && delta_bytes <= binary_bytes + odd.size() * CSI_BINARY_DELTA_HEADER_SIZE;
+    printf("odd frames: %zu mismatches, delta %.1f bytes/frame, binary %.1f\n", mismatches,
+           (double) delta_bytes / odd.size(), (double) binary_bytes / odd.size());
+
+    // losses: records dropped or corrupted on the way must never decode wrongly, and each MAC comes back at its
+    // next keyframe
+    static csi_delta_t encoder, decoder;
+    static uint8_t out[CSI_BINARY_MAX_RECORD_SIZE];
+    const uint16_t keyframe_every = 16;
+    csi_delta_init(&encoder, keyframe_every);
+    csi_delta_init(&decoder, 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    // frames of each MAC since the last one lost, and the most decoded after that before one was undecodable
+    std::vector<int> since_lost(4, -1);
+    size_t lost = 0, corrupted = 0, wrong = 0, undecodable = 0, late = 0;
+    for (const frame_t &frame : stable) {
+        uint32_t source = frame.record.mac[5] % 4;
+        uint16_t count = (uint16_t) frame.values.size();
+        size_t len = csi_delta_encode(&encoder, out, sizeof(out), &frame.record, frame.values.data(), count);
+        int fate = percent(rng);
+        if (fate < 2) {
+            lost++;
+            since_lost[source] = 0;
+            continue;
+        }
+        if (fate < 3) {
+            // the CRC catches a flipped bit
+            out[CSI_BINARY_HEADER_SIZE + CSI_BINARY_CSI_FIXED_SIZE + 4 + len % 32] ^= 0x10;
+            corrupted++;
+        }
+        csi_binary_record_t record;
+        size_t consumed;
+        if (csi_binary_decode(out, len, &consumed, &record) != CSI_BINARY_DECODED) {
+            since_lost[source] = 0;
+            continue;
+        }
+        if (!csi_delta_decode(&decoder, &record)) {
+            undecodable++;
+            // a MAC is back by its next keyframe at the latest
+            if (since_lost[source] < 0 || ++since_lost[source] >= keyframe_every) {
+                late++;
+            }
+            continue;
+        }
+        since_lost[source] = -1;
+        if (record.value_count != count || memcmp(record.values, frame.values.data(), count) != 0) {
+            wrong++;
+        }
+    }
+    ok &= wrong == 0 && late == 0 && decoder.undecodable == undecodable;
+    printf("losses: %zu lost, %zu corrupted, %zu undecodable after them, %zu decoded wrongly, "
+           "%zu undecodable past a keyframe\n", lost, corrupted, undecodable, wrong, late);
+
+    // speed over the stable trace, which takes the temporal and the intra prediction every frame
+    csi_delta_init(&encoder, 32);
+    std::vector<uint8_t> stream;
+    auto start = std::chrono::steady_clock::now();
+    for (const frame_t &frame : stable) {
+        size_t len = csi_delta_encode(&encoder, out, sizeof(out), &frame.record, frame.values.data(),
+                                      (uint16_t) frame.values.size());
+        stream.insert(stream.end(), out, out + len);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    csi_delta_init(&decoder, 1);
+    size_t decoded = 0;
+    for (size_t pos = 0; pos < stream.size();) {
+        csi_binary_record_t record;
+        size_t consumed;
+        csi_binary_decode(stream.data() + pos, stream.size() - pos, &consumed, &record);
+        decoded += csi_delta_decode(&decoder, &record);
+        pos += consumed;
+    }
+    auto end = std::chrono::steady_clock::now();
+    ok &= decoded == stable.size();
+    printf("encode: %7.1f ns/frame, decode: %7.1f ns/frame (384 values, %u keyframes, %u deltas)\n",
+           std::chrono::duration<double, std::nano>(middle - start).count() / frame_count,
+           std::chrono::duration<double, std::nano>(end - middle).count() / frame_count, encoder.keyframes,
+           encoder.deltas);
+
+    // the encoder's RAM on the ESP32, per output
+    ok &= sizeof(csi_delta_t) <= 8192;
+    printf("sizeof(csi_delta_t): %zu bytes\n", sizeof(csi_delta_t));
+
+    printf("delta codec: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+struct layout_case_t {
+    uint8_t secondary_channel, sig_mode, cwb, stbc;
+    // subcarriers of the LLTF, HT-LTF and STBC-HT-LTF as in the ESP-IDF table, "" for none
+    const char *spans[CSI_LAYOUT_MAX_SEGMENTS];
+    uint16_t total_len;
+};
+
+/*
+ * The subcarriers of a span such as "0~31,-32~-1", in order.
+ */
+static std::vector<int> layout_span(const char *span) {
+    std::vector<int> subcarriers;
+    int first, last, n;
+    while (sscanf(span, "%d~%d%n", &first, &last, &n) == 2) {
+        for (int k = first; k <= last; k++) {
+            subcarriers.push_back(k);
+        }
+        span += n;
+        span += *span == ',';
+    }
+    return subcarriers;
+}
+
+static int bench_layout(const char *file_name, uint32_t lookups) {
+    // secondary channel: 0 none, 1 above, 2 below
+    static const layout_case_t cases[] = {
+            {0, 0, 0, 0, {"0~31,-32~-1", "", ""}, 128},
+            {0, 1, 0, 0, {"0~31,-32~-1", "0~31,-32~-1", ""}, 256},
+            {0, 1, 0, 1, {"0~31,-32~-1", "0~31,-32~-1", "0~31,-32~-1"}, 384},
+            {2, 0, 0, 0, {"0~63", "", ""}, 128},
+            {2, 1, 0, 0, {"0~63", "0~63", ""}, 256},
+            {2, 1, 0, 1, {"0~63", "0~62", "0~62"}, 380},
+            {2, 1, 1, 0, {"0~63", "0~63,-64~-1", ""}, 384},
+            {2, 1, 1, 1, {"0~63", "0~60,-60~-1", "0~60,-60~-1"}, 612},
+            {1, 0, 0, 0, {"-64~-1", "", ""}, 128},
+            {1, 1, 0, 0, {"-64~-1", "-64~-1", ""}, 256},
+            {1, 1, 0, 1, {"-64~-1", "-62~-1", "-62~-1"}, 376},
+            {1, 1, 1, 0, {"-64~-1", "0~63,-64~-1", ""}, 384},
+            {1, 1, 1, 1, {"-64~-1", "0~60,-60~-1", "0~60,-60~-1"}, 612},
+    };
+    // the subcarriers which carry something: 52 of the LLTF, 56 of a 20 MHz and 114 of a 40 MHz HT-LTF
+    auto carries = [](int field, int cwb, int secondary_channel, int k) {
+        int center = secondary_channel == 2 ? 32 : (secondary_channel == 1 ? -32 : 0);
+        if (field > 0 && cwb == 1) {
+            return abs(k) >= 2 && abs(k) <= 58;
+        }
+        int distance = abs(k - center);
+        return distance >= 1 && distance <= (field == 0 ? 26 : 28);
+    };
+    bool ok = true;
+    int8_t buf[CSI_BINARY_MAX_VALUES];
+    for (int i = 0; i < CSI_BINARY_MAX_VALUES; i++) {
+        buf[i] = (int8_t) (i * 7 + 3);
+    }
+
+    int failures = 0;
+    for (const layout_case_t &c : cases) {
+        // non-HT frames have no STBC, either way
+        for (uint8_t stbc : c.sig_mode == 0 ? std::vector<uint8_t>{0, 1} : std::vector<uint8_t>{c.stbc}) {
+            csi_layout_t layout;
+            bool good = csi_layout_init(&layout, c.sig_mode, c.cwb, c.secondary_channel, stbc)
+                        && layout.total_len == c.total_len && csi_layout_fit(&layout, c.total_len);
+            uint16_t offset = 0;
+            int used_total = 0;
+            for (int f = 0; good && f < CSI_LAYOUT_MAX_SEGMENTS; f++) {
+                std::vector<int> expected = layout_span(c.spans[f]);
+                if (expected.empty()) {
+                    good &= layout.segment_total == f;
+                    break;
+                }
+                csi_segment_view_t view;
+                good &= csi_layout_view(&layout, buf, (csi_field_t) f, &view) && view.segment->field == f
+                        && view.segment->count == expected.size() && view.data == buf + offset;
+                for (size_t i = 0; good && i < expected.size(); i++) {
+                    int k = expected[i];
+                    bool used = carries(f, c.cwb, c.secondary_channel, k);
+                    int8_t imag = 0, real = 0;
+                    good &= csi_segment_subcarrier(view.segment, (int) i) == k
+                            && csi_segment_find(view.segment, k) == (int) i
+                            && csi_view_imag(&view, (int) i) == buf[offset + 2 * i]
+                            && csi_view_real(&view, (int) i) == buf[offset + 2 * i + 1]
+                            && csi_view_get(&view, k, &imag, &real) == used
+                            && (!used || (imag == buf[offset + 2 * i] && real == buf[offset + 2 * i + 1]));
+                    used_total += used;
+                }
+                // subcarriers the segment does not list are not found
+                for (int k = -128; good && k < 128; k++) {
+                    good &= (csi_segment_find(view.segment, k) >= 0)
+                            == (std::find(expected.begin(), expected.end(), k) != expected.end());
+                }
+                offset += 2 * expected.size();
+                // a buffer holding just the segments up to this one
+                csi_layout_t prefix;
+                good &= csi_layout_init(&prefix, c.sig_mode, c.cwb, c.secondary_channel, stbc)
+                        && csi_layout_prefix_len(&prefix, f + 1) == offset && csi_layout_fit(&prefix, offset)
+                        && prefix.segment_count == f + 1
+                        && !csi_layout_view(&prefix, buf, (csi_field_t) (f + 1), &view);
+            }
+            good &= offset == c.total_len && !csi_layout_fit(&layout, c.total_len - 2)
+                    && !csi_layout_fit(&layout, c.total_len + 2);
+            if (!good) {
+                failures++;
+                printf("WRONG: secondary %u, sig_mode %u, cwb %u, stbc %u\n", c.secondary_channel, c.sig_mode, c.cwb,
+                       stbc);
+            } else {
+                printf("secondary %u, sig_mode %u, cwb %u, stbc %u: %3u values, %3d subcarriers carry something\n",
+                       c.secondary_channel, c.sig_mode, c.cwb, stbc, c.total_len, used_total);
+            }
+        }
+    }
+    ok &= failures == 0;
+
+    // combinations the driver does not hand over
+    csi_layout_t layout;
+    int accepted = 0;
+    for (int secondary_channel = 0; secondary_channel < 4; secondary_channel++) {
+        for (int sig_mode = 0; sig_mode < 4; sig_mode++) {
+            for (int cwb = 0; cwb < 2; cwb++) {
+                for (int stbc = 0; stbc < 2; stbc++) {
+                    accepted += csi_layout_init(&layout, sig_mode, cwb, secondary_channel, stbc);
+                }
+            }
+        }
+    }
+    ok &= accepted == 16;
+    printf("combinations accepted: %d of 64 (16 expected)\n", accepted);
+
+    // the recorded log: every frame fits, and the null subcarriers are weaker than the others
+    std::vector<frame_t> frames;
+    if (!load_frames(file_name, &frames)) {
+        return 1;
+    }
+    size_t fitted = 0;
+    double power[2] = {0, 0};
+    size_t counted[2] = {0, 0};
+    for (const frame_t &frame : frames) {
+        if (!csi_layout_from_record(&layout, &frame.record, (uint16_t) frame.values.size())) {
+            continue;
+        }
+        fitted++;
+        for (int f = 0; f < layout.segment_count; f++) {
+            csi_segment_view_t view;
+            csi_layout_view(&layout, frame.values.data(), (csi_field_t) f, &view);
+            // the first pair of a buffer is not valid
+            for (int i = f == 0 ? 1 : 0; i < view.segment->count; i++) {
+                bool used = csi_segment_used(view.segment, csi_segment_subcarrier(view.segment, i));
+                double imag = csi_view_imag(&view, i), real = csi_view_real(&view, i);
+                power[used] += imag * imag + real * real;
+                counted[used]++;
+            }
+        }
+    }
+    double null_power = counted[0] ? power[0] / counted[0] : 0, used_power = counted[1] ? power[1] / counted[1] : 0;
+    ok &= fitted == frames.size() && used_power > 10 * null_power;
+    printf("%s: %zu of %zu frames fit, mean power %.1f on used and %.1f on null subcarriers\n", file_name, fitted,
+           frames.size(), used_power, null_power);
+
+    // what the CSI callback pays to find the segments of a frame
+    uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < lookups; i++) {
+        const layout_case_t &c = cases[i % (sizeof(cases) / sizeof(cases[0]))];
+        csi_layout_init(&layout, c.sig_mode, c.cwb, c.secondary_channel, c.stbc);
+        csi_layout_fit(&layout, c.total_len);
+        sink += csi_layout_prefix_len(&layout, 2);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+    printf("layout of a frame: %.1f ns (%llu)\n", ns, (unsigned long long) sink);
+
+    printf("segment layout: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+struct ingest_stream_t {
+    std::string bytes;
+    // the valid CSI lines, without line breaks, in order
+    std::vector<std::string> lines;
+    uint64_t malformed = 0;
+    uint64_t other = 0;
+};
+
+/*
+ * `count` CSI lines with CRLF line breaks, as the ESP32 writes them, each with its number as `local_timestamp`, mixed
+ * with log lines, lines cut short and overlong garbage.
+ */
+static ingest_stream_t ingest_stream(const std::vector<frame_t> &frames, uint32_t count) {
+    static csi_format_buffer_t b;
+    ingest_stream_t s;
+    for (uint32_t i = 0; i < count; i++) {
+        frame_t frame = frames[i % frames.size()];
+        frame.record.local_timestamp = i;
+        std::string line = fast_format(&b, "AP", frame.record, frame.values.data(), frame.values.size());
+        line.pop_back();
+        if (i % 100 == 50) {
+            s.bytes += "I (" + std::to_string(i) + ") wifi:station: 24:0a:c4:00:00:01 join, AID=1, bgn, 20\r\n";
+            s.other++;
+        }
+        if (i % 997 == 500) {
+            s.bytes += line.substr(0, line.size() / 2) + "\r\n";
+            s.malformed++;
+        }
+        if (i % 5003 == 2500) {
+            s.bytes += "CSI_DATA," + std::string(CSI_INGEST_MAX_LINE + 100, '7') + "\n";
+            s.malformed++;
+        }
+        s.bytes += line + "\r\n";
+        s.lines.push_back(line);
+    }
+    return s;
+}
+
+/*
+ * Checks that `paths` hold the header and then exactly `expected`, each with a timestamp, which never goes back.
+ * The timestamps are returned in `stamps_us`.
+ */
+static bool ingest_verify(const std::vector<std::string> &paths, const std::vector<std::string> &expected,
+                          std::vector<int64_t> *stamps_us) {
+    std::string header = std::string(CSI_CSV_HEADER, strlen(CSI_CSV_HEADER) - 1) + ",timestamp";
+    size_t k = 0;
+    int64_t last_us = 0;
+    for (const std::string &path : paths) {
+        std::ifstream f(path);
+        std::string line;
+        if (!std::getline(f, line) || line != header) {
+            return false;
+        }
+        while (std::getline(f, line)) {
+            size_t comma = line.rfind(',');
+            long long seconds, micros;
+            if (k >= expected.size() || comma == std::string::npos || line.compare(0, comma, expected[k]) != 0
+                || sscanf(line.c_str() + comma + 1, "%lld.%6lld", &seconds, &micros) != 2) {
+                return false;
+            }
+            int64_t stamp_us = seconds * 1000000 + micros;
+            if (stamp_us < last_us) {
+                return false;
+            }
+            last_us = stamp_us;
+            stamps_us->push_back(stamp_us);
+            k++;
+        }
+    }
+    return k == expected.size();
+}
+
+static bool ingest_counts(const csi_ingest_t &g, const ingest_stream_t &s) {
+    return g.stats.csi_lines == s.lines.size() && g.stats.malformed_lines == s.malformed
+           && g.stats.other_lines == s.other && g.stats.bytes == s.bytes.size();
+}
+
+/*
+ * Writes `s` to the master side of a pseudo-terminal, paced to one line every `pace_us` (0 for as fast as it
+ * goes), while `csi_ingest_run()` reads the slave side as it would read a serial port. `sent_us` gets the time
+ * each line was written.
+ */
+static bool ingest_pty(const ingest_stream_t &s, const std::string &prefix, uint64_t rotate_bytes, uint32_t pace_us,
+                       csi_ingest_t *g, double *seconds, std::vector<int64_t> *sent_us) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        printf("ERROR: no pseudo-terminal: %s\n", strerror(errno));
+        return false;
+    }
+    int slave = csi_serial_open(ptsname(master), 921600, O_NONBLOCK);
+    if (slave < 0 || !csi_ingest_start(g, prefix, rotate_bytes)) {
+        printf("ERROR: cannot open %s or write %s\n", ptsname(master), prefix.c_str());
+        close(master);
+        return false;
+    }
+
+    std::atomic<bool> written(false), stop(false);
+    auto start = std::chrono::steady_clock::now();
+    std::thread writer([&]() {
+        size_t pos = 0;
+        while (pos < s.bytes.size()) {
+            size_t len = std::min<size_t>(s.bytes.size() - pos, 64 * 1024);
+            if (pace_us > 0) {
+                len = s.bytes.find('\n', pos) + 1 - pos;
+                std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t) pace_us * sent_us->size()));
+                sent_us->push_back(csi_ingest_now_us());
+            }
+            ssize_t n = write(master, s.bytes.data() + pos, len);
+            if (n <= 0) {
+                break;
+            }
+            pos += n;
+        }
+        written.store(true);
+    });
+    bool ok = csi_ingest_run(g, slave, stop, [&]() {
+        if (written.load() && g->stats.bytes == s.bytes.size()) {
+            stop.store(true);
+        }
+    });
+    *seconds = seconds_since(start);
+    writer.join();
+    ok &= csi_ingest_finish(g, csi_ingest_now_us());
+    close(slave);
+    close(master);
+    return ok;
+}
+
+static int bench_ingest(const char *file_name, const char *dir, uint32_t count) {
+    std::vector<frame_t> frames;
+    if (!load_frames(file_name, &frames)) {
+        return 1;
+    }
+    if (system(("rm -rf '" + std::string(dir) + "' && mkdir -p '" + std::string(dir) + "'").c_str()) != 0) {
+        fprintf(stderr, "ERROR: cannot create %s\n", dir);
+        return 1;
+    }
+    ingest_stream_t s = ingest_stream(frames, count);
+    bool ok = true;
+
+    // the same stream in reads of every size, from a pipe or a busy port, gives the same output
+    std::mt19937_64 rng(42);
+    for (size_t max_read : {1, 7, 4096, CSI_INGEST_READ_SIZE}) {
+        csi_ingest_t g;
+        std::string path = std::string(dir) + "/chunked.csv";
+        g.out_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        csi_ingest_start(&g, "", 0);
+        std::uniform_int_distribution<size_t> read_size(1, max_read);
+        int64_t read_index = 0;
+        for (size_t pos = 0; pos < s.bytes.size(); read_index++) {
+            size_t len = std::min(read_size(rng), s.bytes.size() - pos);
+            csi_ingest_feed(&g, s.bytes.data() + pos, len, read_index);
+            pos += len;
+        }
+        bool good = csi_ingest_finish(&g, read_index);
+        close(g.out_fd);
+        std::vector<int64_t> stamps;
+        good &= ingest_counts(g, s) && ingest_verify({path}, s.lines, &stamps);
+        ok &= good;
+        printf("reads of up to %5zu bytes: %llu CSI lines, %llu malformed, %llu other: %s\n", max_read,
+               (unsigned long long) g.stats.csi_lines, (unsigned long long) g.stats.malformed_lines,
+               (unsigned long long) g.stats.other_lines, good ? "ok" : "WRONG");
+    }
+
+    // as fast as a pseudo-terminal goes, into files of 1 MB
+    {
+        csi_ingest_t g;
+        double seconds;
+        std::vector<int64_t> sent_us, stamps;
+        const uint64_t rotate_bytes = 1000000;
+        bool good = ingest_pty(s, std::string(dir) + "/fast", rotate_bytes, 0, &g, &seconds, &sent_us);
+        std::vector<std::string> paths;
+        uint64_t largest = 0;
+        for (uint32_t i = 0; i < g.stats.files; i++) {
+            paths.push_back(std::string(dir) + "/fast." + std::to_string(i) + ".csv");
+            struct stat st;
+            stat(paths.back().c_str(), &st);
+            largest = std::max<uint64_t>(largest, st.st_size);
+        }
+        // a file is only closed after the line which took it past the limit
+        good &= ingest_counts(g, s) && ingest_verify(paths, s.lines, &stamps)
+                && largest <= rotate_bytes + CSI_INGEST_MAX_LINE + 32;
+        ok &= good;
+        printf("pseudo-terminal: %llu CSI lines in %.2f s, %.0f lines/s, %.1f MB/s (%.1f Mbaud) in %llu reads, "
+               "%llu files of at most %llu bytes: %s\n", (unsigned long long) g.stats.csi_lines, seconds,
+               g.stats.csi_lines / seconds, g.stats.bytes / seconds / 1e6, g.stats.bytes * 10 / seconds / 1e6,
+               (unsigned long long) g.stats.reads, (unsigned long long) g.stats.files, (unsigned long long) largest,
+               good ? "ok" : "WRONG");
+    }
+
+    // one line every ms: how long after it was written is a line stamped
+    {
+        uint32_t paced = std::min<uint32_t>(count, 3000);
+        ingest_stream_t p = ingest_stream(frames, paced);
+        p.bytes.clear();
+        for (const std::string &line : p.lines) {
+            p.bytes += line + "\r\n";
+        }
+        p.malformed = p.other = 0;
+        csi_ingest_t g;
+        double seconds;
+        std::vector<int64_t> sent_us, stamps;
+        std::string path = std::string(dir) + "/paced";
+        bool good = ingest_pty(p, path, 0, 1000, &g, &seconds, &sent_us) && ingest_counts(g, p)
+                    && ingest_verify({path + ".0.csv"}, p.lines, &stamps) && stamps.size() == sent_us.size();
+        std::vector<int64_t> delays;
+        for (size_t i = 0; good && i < stamps.size(); i++) {
+            // never stamped before it was sent
+            good &= stamps[i] >= sent_us[i];
+            delays.push_back(stamps[i] - sent_us[i]);
+        }
+        std::sort(delays.begin(), delays.end());
+        ok &= good && !delays.empty();
+        if (!delays.empty()) {
+            printf("paced, 1000 lines/s: stamped %lld us after being written at the median, %lld us at p99, "
+                   "%lld us at most: %s\n", (long long) delays[delays.size() / 2],
+                   (long long) delays[delays.size() * 99 / 100], (long long) delays.back(), good ? "ok" : "WRONG");
+        }
+    }
+
+    printf("memory: %d bytes of line, %d of read and %d of output buffer, whatever the input\n", CSI_INGEST_MAX_LINE,
+           CSI_INGEST_READ_SIZE, CSI_INGEST_OUT_BUFFER);
+    printf("serial ingest: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+static uint64_t archive_row_signature(uint64_t mac, int64_t real_timestamp_us, const int8_t *values, size_t count) {
+    uint64_t h = mac * 0x9E3779B97F4A7C15ULL ^ (uint64_t) real_timestamp_us;
+    for (size_t i = 0; i < count; i++) {
+        h = (h ^ (uint8_t) values[i]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+static bool archive_row_same(const csi_archive_t &a, const csi_archive_view_t &v, uint32_t i, const csi_columns_t &c,
+                             size_t g) {
+    return a.roles[v.role[i]] == c.roles[c.role[g]] && v.mac[i] == c.mac[g] && v.rssi[i] == c.rssi[g]
+           && v.rate[i] == c.rate[g] && v.sig_mode[i] == c.sig_mode[g] && v.mcs[i] == c.mcs[g]
+           && v.bandwidth[i] == c.bandwidth[g] && v.smoothing[i] == c.smoothing[g]
+           && v.not_sounding[i] == c.not_sounding[g] && v.aggregation[i] == c.aggregation[g]
+           && v.stbc[i] == c.stbc[g] && v.fec_coding[i] == c.fec_coding[g] && v.sgi[i] == c.sgi[g]
+           && v.noise_floor[i] == c.noise_floor[g] && v.ampdu_cnt[i] == c.ampdu_cnt[g]
+           && v.channel[i] == c.channel[g] && v.secondary_channel[i] == c.secondary_channel[g]
+           && v.local_timestamp[i] == c.local_timestamp[g] && v.ant[i] == c.ant[g] && v.sig_len[i] == c.sig_len[g]
+           && v.rx_state[i] == c.rx_state[g] && v.real_time_set[i] == c.real_time_set[g]
+           && v.real_timestamp_us[i] == c.real_timestamp_us[g]
+           && v.real_time_uncertainty_us[i] == c.real_time_uncertainty_us[g] && v.len[i] == c.len[g]
+           // NaN for the rows without one
+           && memcmp(&v.host_timestamp[i], &c.host_timestamp[g], sizeof(double)) == 0
+           && v.row_value_count(i) == c.row_value_count(g)
+           && memcmp(v.row_values(i), c.row_values(g), c.row_value_count(g)) == 0;
+}
+
+/*
+ * Imports a synthetic capture of devices coming and going into an archive, checks that every row comes back as
+ * parsed from the CSV and that queries match a full scan of it, and times both.
+ */
+static int bench_archive(const char *file_name, const char *dir, uint32_t count) {
+    std::vector<frame_t> frames;
+    if (!load_frames(file_name, &frames)) {
+        return 1;
+    }
+    if (system(("rm -rf '" + std::string(dir) + "' && mkdir -p '" + std::string(dir) + "'").c_str()) != 0) {
+        fprintf(stderr, "ERROR: cannot create %s\n", dir);
+        return 1;
+    }
+    std::string csv_path = std::string(dir) + "/capture.csv";
+    std::string archive_path = std::string(dir) + "/capture.csia";
+
+    // 64 devices, 4 of them in range at a time for 5 s, one frame every ms
+    const int devices = 64, active = 4;
+    const uint32_t session_rows = 5000;
+    const int64_t start_us = 1700000000000000LL;
+    std::vector<int> order(devices);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 rng(11);
+    FILE *out = fopen(csv_path.c_str(), "wb");
+    if (out == NULL) {
+        printf("ERROR: cannot write %s\n", csv_path.c_str());
+        return 1;
+    }
+    fputs(CSI_CSV_HEADER, out);
+    csi_format_buffer_t b;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i % session_rows == 0) {
+            std::shuffle(order.begin(), order.end(), rng);
+        }
+        const frame_t &f = frames[i % frames.size()];
+        csi_record_t r = f.record;
+        uint64_t mac = 0x240AC4000000ULL + order[rng() % active];
+        for (int k = 0; k < 6; k++) {
+            r.mac[k] = (uint8_t) (mac >> (40 - 8 * k));
+        }
+        r.real_time_set = 1;
+        r.real_timestamp_us = start_us + (int64_t) i * 1000;
+        std::string line = fast_format(&b, i % 3 == 0 ? "STA" : "AP", r, f.values.data(), (int) f.values.size());
+        if (i % 2 == 1) {
+            // every other row with the host timestamp `csi_ingest` appends
+            char stamp[32];
+            snprintf(stamp, sizeof(stamp), ",%.6f\n", (r.real_timestamp_us + 1500) / 1e6);
+            line.pop_back();
+            line += stamp;
+        }
+        fwrite(line.data(), 1, line.size(), out);
+    }
+    fclose(out);
+
+    csi_columns_t ref;
+    if (!csi_log_parse_file(csv_path.c_str(), 0, &ref) || ref.rows() != count) {
+        printf("ERROR: cannot read back %s\n", csv_path.c_str());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        csi_columns_t columns;
+        csi_log_parse_file(csv_path.c_str(), 0, &columns);
+        csi_archive_writer_t w;
+        csi_archive_create(&w, archive_path.c_str(), CSI_ARCHIVE_CHUNK_ROWS);
+        csi_archive_append(&w, columns);
+        if (!csi_archive_finish(&w)) {
+            printf("ERROR: cannot write %s\n", archive_path.c_str());
+            return 1;
+        }
+    }
+    double import_seconds = seconds_since(start);
+    struct stat csv_st, archive_st;
+    stat(csv_path.c_str(), &csv_st);
+    stat(archive_path.c_str(), &archive_st);
+
+    csi_archive_t a;
+    if (!csi_archive_open(&a, archive_path.c_str())) {
+        printf("ERROR: cannot open %s\n", archive_path.c_str());
+        return 1;
+    }
+    bool ok = a.rows == count;
+    size_t g = 0;
+    for (size_t k = 0; k < a.chunks.size() && ok; k++) {
+        csi_archive_view_t v;
+        ok &= csi_archive_chunk_view(&a, k, &v);
+        for (uint32_t i = 0; ok && i < v.rows; i++, g++) {
+            ok &= archive_row_same(a, v, i, ref, g);
+        }
+    }
+    ok &= g == count;
+    printf("imported %u rows, %.1f MB of CSV into %zu chunks, %.1f MB, in %.2f s, every column as parsed: %s\n",
+           count, csv_st.st_size / 1e6, a.chunks.size(), archive_st.st_size / 1e6, import_seconds,
+           ok ? "ok" : "WRONG");
+
+    const int64_t span_us = (int64_t) count * 1000;
+    const int64_t middle_us = start_us + span_us / 2;
+    const uint64_t some_mac = ref.mac[count / 2];
+    struct {
+        const char *name;
+        csi_archive_query_t q;
+    } queries[4];
+    queries[0].name = "one MAC, 1% of the time";
+    queries[0].q.by_mac = true;
+    queries[0].q.mac = some_mac;
+    queries[0].q.from_us = middle_us;
+    queries[0].q.to_us = middle_us + span_us / 100;
+    queries[1].name = "one MAC, all of the time";
+    queries[1].q.by_mac = true;
+    queries[1].q.mac = some_mac;
+    queries[2].name = "every MAC, 1% of the time";
+    queries[2].q.from_us = middle_us;
+    queries[2].q.to_us = middle_us + span_us / 100;
+    queries[3].name = "MAC not in the capture";
+    queries[3].q.by_mac = true;
+    queries[3].q.mac = 0x240AC4FFFFFFULL;
+
+    for (const auto &query : queries) {
+        const csi_archive_query_t &q = query.q;
+        std::vector<uint64_t> found, expected;
+        csi_archive_query_stats_t stats;
+        // best of 5, the archive being in the page cache as the CSV is
+        double best = 1e9;
+        for (int run = 0; run < 5; run++) {
+            found.clear();
+            start = std::chrono::steady_clock::now();
+            csi_archive_query(&a, q, [&](const csi_archive_view_t &v, uint32_t i) {
+                found.push_back(archive_row_signature(v.mac[i], v.real_timestamp_us[i], v.row_values(i),
+                                                      v.row_value_count(i)));
+            }, &stats);
+            best = std::min(best, seconds_since(start));
+        }
+
+        // what answering it took before: parsing all of the CSV, then filtering
+        start = std::chrono::steady_clock::now();
+        csi_columns_t columns;
+        csi_log_parse_file(csv_path.c_str(), 0, &columns);
+        for (size_t i = 0; i < columns.rows(); i++) {
+            if ((!q.by_mac || columns.mac[i] == q.mac) && columns.real_timestamp_us[i] >= q.from_us
+                && columns.real_timestamp_us[i] <= q.to_us) {
+                expected.push_back(archive_row_signature(columns.mac[i], columns.real_timestamp_us[i],
+                                                         columns.row_values(i), columns.row_value_count(i)));
+            }
+        }
+        double scan = seconds_since(start);
+
+        bool good = found == expected && stats.chunks_invalid == 0;
+        ok &= good;
+        printf("%-26s %6zu rows, %3llu of %llu chunks read (%llu skipped by time, %llu by MAC): %8.3f ms, "
+               "CSV scan %7.1f ms, %6.0fx: %s\n", query.name, found.size(), (unsigned long long) stats.chunks_read,
+               (unsigned long long) stats.chunks, (unsigned long long) stats.skipped_by_time,
+               (unsigned long long) stats.skipped_by_mac, best * 1e3, scan * 1e3, scan / best, good ? "ok" : "WRONG");
+    }
+
+    // damage: a truncated archive is refused, a chunk with broken offsets is skipped and reported
+    std::string bytes;
+    {
+        std::ifstream f(archive_path, std::ios::binary);
+        std::stringstream ss;
+        ss << f.rdbuf();
+        bytes = ss.str();
+    }
+    std::string damaged_path = std::string(dir) + "/damaged.csia";
+    auto write_file = [&](const std::string &data) {
+        std::ofstream f(damaged_path, std::ios::binary | std::ios::trunc);
+        f.write(data.data(), data.size());
+    };
+    write_file(bytes.substr(0, bytes.size() - 100));
+    csi_archive_t damaged;
+    bool refused = !csi_archive_open(&damaged, damaged_path.c_str());
+
+    const csi_archive_chunk_t &first = a.chunks[0];
+    std::string broken = bytes;
+    uint32_t past_end = first.values + 1;
+    memcpy(&broken[first.offset + first.columns[CSI_ARCHIVE_CSI_OFFSET] + (uint64_t) first.rows * 4], &past_end, 4);
+    write_file(broken);
+    csi_archive_query_stats_t stats;
+    bool skipped = csi_archive_open(&damaged, damaged_path.c_str());
+    if (skipped) {
+        csi_archive_query(&damaged, csi_archive_query_t(), [](const csi_archive_view_t &, uint32_t) {}, &stats);
+        skipped = stats.chunks_invalid == 1 && stats.rows_matched == count - first.rows;
+        csi_archive_close(&damaged);
+    }
+    ok &= refused && skipped;
+    printf("truncated archive refused: %s, chunk with broken offsets skipped: %s\n", refused ? "ok" : "WRONG",
+           skipped ? "ok" : "WRONG");
+
+    csi_archive_close(&a);
+    printf("archive: %s\n", ok ? "ok" : "WRONG");
+    return ok ? 0 : 1;
+}
+
+static void usage() {
+    printf("usage: csi_bench format <csi.csv> [iterations]\n");
+    printf("       csi_bench ring <frames>\n");
+    printf("       csi_bench binary <csi.csv> [baud] [iterations]\n");
+    printf("       csi_bench parse <csi.csv> <synthetic.csv> <megabytes>\n");
+    printf("       csi_bench math <frames>\n");
+    printf("       csi_bench sd <output file> <megabytes>\n");
+    printf("       csi_bench segment <scratch directory> <existing segments>\n");
+    printf("       csi_bench udp <csi.csv> <frames>\n");
+    printf("       csi_bench stats <samples>\n");
+    printf("       csi_bench scheduler <simulated seconds>\n");
+    printf("       csi_bench frame <frames>\n");
+    printf("       csi_bench probe <probes>\n");
+    printf("       csi_bench channel <simulated seconds>\n");
+    printf("       csi_bench filter <lookups>\n");
+    printf("       csi_bench limit <trace seconds>\n");
+    printf("       csi_bench command <fuzzed streams>\n");
+    printf("       csi_bench time <frames>\n");
+    printf("       csi_bench sync <simulated hours>\n");
+    printf("       csi_bench features <trace seconds>\n");
+    printf("       csi_bench sessions <simulated seconds>\n");
+    printf("       csi_bench delta <csi.csv> <frames>\n");
+    printf("       csi_bench layout <csi.csv> <lookups>\n");
+    printf("       csi_bench ingest <csi.csv> <scratch directory> <lines>\n");
+    printf("       csi_bench archive <csi.csv> <scratch directory> <rows>\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+
+    std::string mode = argv[1];
+    int iterations = argc > 3 ? atoi(argv[3]) : 200000;
+
+    if (mode == "format") {
+        return bench_format(argv[2], iterations);
+    }
+    if (mode == "binary") {
+        return bench_binary(argv[2], argc > 3 ? atoi(argv[3]) : 921600, argc > 4 ? atoi(argv[4]) : 200000);
+    }
+    if (mode == "parse" && argc > 4) {
+        return bench_parse(argv[2], argv[3], strtoul(argv[4], NULL, 10));
+    }
+    if (mode == "math") {
+        return bench_math(atoi(argv[2]));
+    }
+    if (mode == "sd" && argc > 3) {
+        return bench_sd(argv[2], strtoull(argv[3], NULL, 10));
+    }
+    if (mode == "segment" && argc > 3) {
+        return bench_segment(argv[2], strtoul(argv[3], NULL, 10));
+    }
+    if (mode == "udp" && argc > 3) {
+        return bench_udp(argv[2], strtoul(argv[3], NULL, 10));
+    }
+    if (mode == "stats") {
+        return bench_stats(strtoul(argv[2], NULL, 10));
+    }
+    if (mode == "scheduler") {
+        return bench_scheduler(strtoll(argv[2], NULL, 10));
+    }
+    if (mode == "frame") {
+        return bench_frame(strtoul(argv[2], NULL, 10));
+    }
+    if (mode == "probe") {
+        return bench_probe(strtoul(argv[2], NULL, 10));
+    }
+    if (mode == "channel") {
+        return bench_channel(strtoll(argv[2], NULL, 10));
+    }
+    if (mode == "filter") {
+        return bench_filter(strtoul(argv[2], NULL, 10));
+    }
+    if (mode == "limit") {
+        return bench_limit(strtoll(argv[2], NULL, 10));
+    }
+    if (mode == "command") {
+        return bench_command(strtoul(argv[2], NULL, 10));
+    }
+    if (mode == "time") {
+        return bench_time(strtoul(argv[2], NULL, 10));
+    }
+    if (mode == "sync") {
+        return bench_sync(atof(argv[2]));
+    }
+    if (mode == "features") {
+        return bench_features(strtoll(argv[2], NULL, 10));
+    }
+    if (mode == "sessions") {
+        return bench_sessions(strtoll(argv[2], NULL, 10));
+    }
+    if (mode == "delta" && argc > 3) {
+        return bench_delta(argv[2], strtoul(argv[3], NULL, 10));
+    }
+    if (mode == "layout" && argc > 3) {
+        return bench_layout(argv[2], strtoul(argv[3], NULL, 10));
+    }
+    if (mode == "ingest" && argc > 4) {
+        return bench_ingest(argv[2], argv[3], strtoul(argv[4], NULL, 10));
+    }
+    if (mode == "archive" && argc > 4) {
+        return bench_archive(argv[2], argv[3], strtoul(argv[4], NULL, 10));
+    }
+    if (mode == "ring") {
+        return bench_ring(strtoul(argv[2], NULL, 10));
+    }
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../_components/csi_format_component.h"
+#include "../_components/csi_binary_component.h"
+#include "../_components/csi_delta_component.h"
+#include "../_components/sd_segment_component.h"
+
+//
+// Converts binary CSI records (`CONFIG_CSI_OUTPUT_FORMAT_BINARY`) back into the CSV produced in text mode,
+// including the header line. Anything which is not a valid record (boot logs, corrupted bytes) is skipped.
+//
+// Build:
+// `g++ -O2 -std=c++17 -o csi_binary_decode csi_binary_decode.cc`
+//
+// Run:
+// `./csi_binary_decode 0.bin > my-experiment-file.csv`
+// `cat /dev/ttyUSB0 | ./csi_binary_decode --role STA > my-experiment-file.csv`
+//
+// `--role` is only used until the first role record in the stream has been seen.
+//
+// Compressed records (`CONFIG_CSI_BINARY_DELTA`) are decoded as well. Those of a MAC which depend on a record that is
+// missing (the start of a capture, corrupted bytes) are skipped until its next keyframe and counted as undecodable.
+//
+
+struct decode_stats_t {
+    size_t csi_records = 0;
+    size_t dropped_records = 0;
+    size_t skipped_bytes = 0;
+    size_t undecodable_records = 0;
+};
+
+static void write_record(const csi_binary_record_t &record, std::string &role, csi_format_buffer_t *b,
+                         decode_stats_t *stats) {
+    csi_format_reset(b);
+    if (record.type == CSI_BINARY_RECORD_ROLE) {
+        role = record.role;
+        return;
+    } else if (record.type == CSI_BINARY_RECORD_CSI) {
+        csi_format_csv_prefix(b, role.c_str(), &record.record);
+        csi_format_csv_values(b, record.values, record.value_count);
+        csi_format_csv_suffix(b);
+        stats->csi_records++;
+    } else if (record.type == CSI_BINARY_RECORD_DROPPED) {
+        csi_format_str(b, "CSI_DROPPED,");
+        csi_format_str(b, role.c_str());
+        csi_format_char(b, ',');
+        csi_format_uint(b, record.dropped_total);
+        csi_format_char(b, ',');
+        csi_format_uint(b, record.dropped_since_last);
+        csi_format_char(b, '\n');
+        stats->dropped_records++;
+    } else if (record.type == CSI_BINARY_RECORD_SEGMENT) {
+        // keeps the footer at the end of a converted segment
+        printf(SD_SEGMENT_FOOTER_CSV_FORMAT, (unsigned) record.segment, (unsigned) record.segment_records,
+               (long long) record.segment_first_us, (long long) record.segment_last_us);
+        return;
+    } else if (record.type == CSI_BINARY_RECORD_TEXT) {
+        fwrite(record.text, 1, record.text_len, stdout);
+        return;
+    }
+    fwrite(b->buf, 1, b->len, stdout);
+}
+
+int main(int argc, char **argv) {
+    std::string role = "UNKNOWN";
+    const char *file_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--role") == 0 && i + 1 < argc) {
+            role = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            fprintf(stderr, "usage: csi_binary_decode [--role NAME] [input.bin]\n");
+            return 1;
+        } else {
+            file_name = argv[i];
+        }
+    }
+
+    FILE *in = stdin;
+    if (file_name != NULL && strcmp(file_name, "-") != 0) {
+        in = fopen(file_name, "rb");
+        if (in == NULL) {
+            fprintf(stderr, "ERROR: cannot open %s\n", file_name);
+            return 1;
+        }
+    }
+
+    static csi_format_buffer_t b;
+    static csi_delta_t delta;
+    csi_delta_init(&delta, 1);
+    decode_stats_t stats;
+    std::vector<uint8_t> buf(1 << 20);
+    size_t filled = 0;
+
+    fputs(CSI_CSV_HEADER, stdout);
+
+    while (true) {
+        size_t n = fread(buf.data() + filled, 1, buf.size() - filled, in);
+        filled += n;
+        bool eof = n == 0;
+
+        size_t pos = 0;
+        while (pos < filled) {
+            csi_binary_record_t record;
+            size_t consumed;
+            csi_binary_result_t result = csi_binary_decode(buf.data() + pos, filled - pos, &consumed, &record);
+            if (result == CSI_BINARY_NEED_MORE) {
+                if (eof) {
+                    // truncated final record
+                    stats.skipped_bytes += filled - pos;
+                    pos = filled;
+                }
+                break;
+            }
+            if (result == CSI_BINARY_SKIPPED) {
+                stats.skipped_bytes += consumed;
+            } else if (record.type == CSI_BINARY_RECORD_CSI_DELTA && !csi_delta_decode(&delta, &record)) {
+                stats.undecodable_records++;
+            } else {
+                write_record(record, role, &b, &stats);
+            }
+            pos += consumed;
+        }
+
+        memmove(buf.data(), buf.data() + pos, filled - pos);
+        filled -= pos;
+        if (eof) {
+            break;
+        }
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "CSI records: %zu, dropped reports: %zu, skipped bytes: %zu, undecodable records: %zu\n",
+            stats.csi_records, stats.dropped_records, stats.skipped_bytes, stats.undecodable_records);
+    return 0;
+}
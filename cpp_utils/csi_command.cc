@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../_components/command_frame_component.h"
+#include "csi_serial_port.h"
+
+//
+// Sends a command (`_components/command_component.h`) to an ESP32 over its serial port and prints the reply,
+// while the ESP32 keeps streaming CSI. With `--repeat` it sends the command that many times and reports the
+// round trip times.
+//
+// Build:
+// `g++ -O2 -std=c++17 -o csi_command csi_command.cc`
+//
+// Run:
+// `./csi_command /dev/ttyUSB0 FILTER STATUS`
+// `./csi_command /dev/ttyUSB0 --baud 921600 FORMAT BINARY`
+// `./csi_command /dev/ttyUSB0 --repeat 1000 PING`
+//
+// Exits with 0 for OK, 1 for ERR and 2 if no reply came.
+//
+
+/*
+ * Sends one request and waits for the reply with the same id. Returns 0 for OK, 1 for ERR and 2 without a reply,
+ * with the text of the reply in `*text`.
+ */
+static int request(int fd, command_frame_parser_t *parser, uint32_t id, const std::string &command, int timeout_ms,
+                   std::string *text) {
+    static csi_format_buffer_t frame;
+    std::string payload = std::to_string(id) + " " + command;
+    csi_format_reset(&frame);
+    command_frame_encode(&frame, payload.data(), payload.size());
+    if (write(fd, frame.buf, frame.len) != (ssize_t) frame.len) {
+        return 2;
+    }
+
+    std::string ok_prefix = std::to_string(id) + " OK", err_prefix = std::to_string(id) + " ERR";
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    char buf[4096];
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        struct pollfd p = {fd, POLLIN, 0};
+        if (left.count() <= 0 || poll(&p, 1, (int) left.count()) <= 0) {
+            return 2;
+        }
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            return 2;
+        }
+        // CSI lines (and binary records) come out as lines or errors, and are skipped
+        for (size_t pos = 0; pos < (size_t) n;) {
+            size_t consumed;
+            command_frame_event_t event = command_frame_parser_feed(parser, buf + pos, n - pos, &consumed);
+            pos += consumed;
+            if (event != COMMAND_FRAME_PAYLOAD) {
+                continue;
+            }
+            std::string reply(parser->payload, parser->len);
+            for (const std::string *prefix : {&ok_prefix, &err_prefix}) {
+                if (reply.compare(0, prefix->size(), *prefix) == 0
+                    && (reply.size() == prefix->size() || reply[prefix->size()] == ' ')) {
+                    *text = reply.size() > prefix->size() ? reply.substr(prefix->size() + 1) : "";
+                    return prefix == &ok_prefix ? 0 : 1;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *port = NULL;
+    long baud = 921600;
+    int timeout_ms = 1000;
+    uint32_t repeat = 0;
+    std::string command;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baud" && i + 1 < argc) {
+            baud = strtol(argv[++i], NULL, 10);
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            timeout_ms = atoi(argv[++i]);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = strtoul(argv[++i], NULL, 10);
+        } else if (port == NULL) {
+            port = argv[i];
+        } else {
+            command += (command.empty() ? "" : " ") + arg;
+        }
+    }
+    if (port == NULL || command.empty() || csi_serial_baud(baud) == B0) {
+        fprintf(stderr, "usage: csi_command <serial port> [--baud 921600] [--timeout ms] [--repeat n] <command>\n");
+        return 2;
+    }
+    int fd = csi_serial_open(port, baud, 0);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: cannot open %s: %s\n", port, strerror(errno));
+        return 2;
+    }
+
+    static command_frame_parser_t parser;
+    command_frame_parser_reset(&parser);
+    // ids only have to differ from those of replies still on their way from an earlier run
+    uint32_t id = (uint32_t) (std::chrono::steady_clock::now().time_since_epoch().count() / 1000 % 1000000000);
+    std::string text;
+    int result = 0;
+    std::vector<double> round_trip_us;
+    for (uint32_t i = 0; i < std::max<uint32_t>(repeat, 1); i++) {
+        auto start = std::chrono::steady_clock::now();
+        result = request(fd, &parser, id++, command, timeout_ms, &text);
+        if (result == 2) {
+            break;
+        }
+        round_trip_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+                                        .count());
+    }
+    close(fd);
+
+    if (result == 2) {
+        fprintf(stderr, "ERROR: no reply within %d ms\n", timeout_ms);
+        return 2;
+    }
+    printf("%s%s\n", result == 0 ? "OK" : "ERR", text.empty() ? "" : (" " + text).c_str());
+    if (repeat > 0) {
+        std::sort(round_trip_us.begin(), round_trip_us.end());
+        auto at = [&](double q) { return round_trip_us[(size_t) (q * (round_trip_us.size() - 1))]; };
+        fprintf(stderr, "%zu round trips: p50 %.0f us, p99 %.0f us, max %.0f us\n", round_trip_us.size(), at(0.5),
+                at(0.99), round_trip_us.back());
+    }
+    return result;
+}
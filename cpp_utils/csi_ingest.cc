@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "csi_serial_port.h"
+#include "csi_ingest.h"
+
+//
+// Reads CSI lines from the serial port of an ESP32 (or a pipe) and writes them as CSV with the time each line was
+// received appended, replacing `python_utils/serial_append_time.py`. Only valid `CSI_DATA` lines are kept; the
+// numbers of lines kept, malformed (cut short or corrupted) and other (logs, `CSI_DROPPED`) go to stderr every
+// 10 seconds and on exit (Ctrl+C).
+//
+// Build:
+// `g++ -O2 -std=c++17 -o csi_ingest csi_ingest.cc`
+//
+// Run:
+// `./csi_ingest /dev/ttyUSB0 --baud 921600 > my-experiment-file.csv`
+// `./csi_ingest /dev/ttyUSB0 --out captures/experiment --rotate-mb 100`
+// `idf.py monitor | ./csi_ingest - > my-experiment-file.csv`
+//
+// With `--out PREFIX` the output goes to `PREFIX.0.csv`, `PREFIX.1.csv`, ..., each starting with the header, a new
+// one started once `--rotate-mb` have been written to the current one.
+//
+// A line's timestamp is taken just before the read which completed it, with the serial driver asked to hand bytes
+// over without delay (`ASYNC_LOW_LATENCY`), so it is within a read (and the driver's latency) of the line's arrival.
+// Lines read together share a timestamp.
+//
+
+static std::atomic<bool> stop(false);
+
+static void on_signal(int) {
+    stop.store(true);
+}
+
+static void print_stats(const csi_ingest_t &g, double seconds) {
+    const csi_ingest_stats_t &s = g.stats;
+    fprintf(stderr, "%.0f s: %llu CSI lines (%.0f/s), %llu malformed, %llu other lines, %.1f MB in %llu reads, "
+                    "%llu files\n", seconds, (unsigned long long) s.csi_lines, seconds > 0 ? s.csi_lines / seconds : 0,
+            (unsigned long long) s.malformed_lines, (unsigned long long) s.other_lines, s.bytes / 1e6,
+            (unsigned long long) s.reads, (unsigned long long) s.files);
+}
+
+int main(int argc, char **argv) {
+    const char *input = NULL;
+    const char *prefix = "";
+    long baud = 921600;
+    double rotate_mb = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if (strcmp(argv[i], "--rotate-mb") == 0 && i + 1 < argc) {
+            rotate_mb = atof(argv[++i]);
+        } else if (input == NULL && (argv[i][0] != '-' || argv[i][1] == '\0')) {
+            input = argv[i];
+        } else {
+            input = NULL;
+            break;
+        }
+    }
+    if (input == NULL || csi_serial_baud(baud) == B0) {
+        fprintf(stderr, "usage: csi_ingest <serial port | -> [--baud 921600] [--out PREFIX [--rotate-mb N]]\n");
+        return 1;
+    }
+
+    int fd = STDIN_FILENO;
+    if (strcmp(input, "-") != 0) {
+        // a named pipe or a file is read as it is
+        struct stat st;
+        bool device = stat(input, &st) == 0 && S_ISCHR(st.st_mode);
+        fd = device ? csi_serial_open(input, baud, O_NONBLOCK) : open(input, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            fprintf(stderr, "ERROR: cannot open %s: %s\n", input, strerror(errno));
+            return 1;
+        }
+        if (isatty(fd) && !csi_serial_low_latency(fd)) {
+            fprintf(stderr, "%s does not support low latency mode, timestamps may lag by a few ms\n", input);
+        }
+    }
+
+    csi_ingest_t g;
+    if (!csi_ingest_start(&g, prefix, (uint64_t) (rotate_mb * 1e6))) {
+        fprintf(stderr, "ERROR: cannot write %s.0.csv: %s\n", prefix, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    auto start = std::chrono::steady_clock::now();
+    auto last_stats = start;
+    bool ok = csi_ingest_run(&g, fd, stop, [&]() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_stats >= std::chrono::seconds(10)) {
+            print_stats(g, std::chrono::duration<double>(now - start).count());
+            last_stats = now;
+        }
+    });
+    if (!ok) {
+        fprintf(stderr, "ERROR: %s: %s\n", g.failed ? "cannot write the output" : "cannot read", strerror(errno));
+    }
+    ok &= csi_ingest_finish(&g, csi_ingest_now_us());
+    print_stats(g, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return ok ? 0 : 1;
+}
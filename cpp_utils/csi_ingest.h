@@ -0,0 +1,270 @@
+#ifndef ESP32_CSI_CSI_INGEST_H
+#define ESP32_CSI_CSI_INGEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../_components/csi_format_component.h"
+#include "csi_log_parser.h"
+
+//
+// Core of `csi_ingest.cc`: splits what is read from a serial port (or a pipe) into lines, keeps the valid `CSI_DATA`
+// lines with the time they were read appended (the `timestamp` column of `serial_append_time.py`), counts the rest,
+// and writes them out, optionally into files of a bounded size.
+//
+// Memory does not grow with the input: a partial line is kept in `CSI_INGEST_MAX_LINE` bytes (longer lines are
+// dropped as malformed), reads go into `CSI_INGEST_READ_SIZE` bytes and output through `CSI_INGEST_OUT_BUFFER` bytes.
+//
+
+#define CSI_INGEST_MAX_LINE 4096
+#define CSI_INGEST_READ_SIZE (64 * 1024)
+#define CSI_INGEST_OUT_BUFFER (256 * 1024)
+// the parser's columns are only needed to validate a line, and are dropped after this many
+#define CSI_INGEST_SCRATCH_ROWS 4096
+
+struct csi_ingest_stats_t {
+    uint64_t bytes = 0;
+    uint64_t reads = 0;
+    uint64_t csi_lines = 0;
+    // `CSI_DATA` lines which are cut short, corrupted or too long
+    uint64_t malformed_lines = 0;
+    // the CSV header, `CSI_DROPPED`, logs and anything else
+    uint64_t other_lines = 0;
+    uint64_t files = 0;
+};
+
+struct csi_ingest_t {
+    // output goes to `<prefix>.<n>.csv`, a new one started once `rotate_bytes` (0 for never) have been written to
+    // the current one, or to `out_fd` if `prefix` is empty
+    std::string prefix;
+    uint64_t rotate_bytes = 0;
+    int out_fd = STDOUT_FILENO;
+    uint32_t file_index = 0;
+    uint64_t file_bytes = 0;
+    // set once a write failed
+    bool failed = false;
+
+    std::vector<char> line = std::vector<char>(CSI_INGEST_MAX_LINE);
+    size_t line_len = 0;
+    // skipping the rest of a line which did not fit into `line`
+    bool overlong = false;
+    std::vector<char> out = std::vector<char>(CSI_INGEST_OUT_BUFFER);
+    size_t out_len = 0;
+    csi_columns_t scratch;
+
+    csi_ingest_stats_t stats;
+};
+
+int64_t csi_ingest_now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool csi_ingest_flush(csi_ingest_t *g) {
+    for (size_t done = 0; done < g->out_len && !g->failed;) {
+        ssize_t n = write(g->out_fd, g->out.data() + done, g->out_len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            g->failed = true;
+            break;
+        }
+        done += n;
+    }
+    g->out_len = 0;
+    return !g->failed;
+}
+
+void _csi_ingest_append(csi_ingest_t *g, const char *data, size_t len) {
+    if (g->out_len + len > g->out.size()) {
+        csi_ingest_flush(g);
+    }
+    memcpy(g->out.data() + g->out_len, data, len);
+    g->out_len += len;
+    g->file_bytes += len;
+}
+
+void _csi_ingest_header(csi_ingest_t *g) {
+    // `CSI_CSV_HEADER` with the `timestamp` column before its line break
+    _csi_ingest_append(g, CSI_CSV_HEADER, strlen(CSI_CSV_HEADER) - 1);
+    _csi_ingest_append(g, ",timestamp\n", 11);
+}
+
+bool _csi_ingest_next_file(csi_ingest_t *g) {
+    if (!csi_ingest_flush(g)) {
+        return false;
+    }
+    if (g->stats.files > 0) {
+        close(g->out_fd);
+        g->file_index++;
+    }
+    std::string path = g->prefix + "." + std::to_string(g->file_index) + ".csv";
+    g->out_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (g->out_fd < 0) {
+        g->failed = true;
+        return false;
+    }
+    g->stats.files++;
+    g->file_bytes = 0;
+    _csi_ingest_header(g);
+    return true;
+}
+
+/*
+ * Starts the output, with the header line. False if the first file cannot be created.
+ */
+bool csi_ingest_start(csi_ingest_t *g, const std::string &prefix, uint64_t rotate_bytes) {
+    g->prefix = prefix;
+    g->rotate_bytes = rotate_bytes;
+    if (prefix.empty()) {
+        _csi_ingest_header(g);
+        return true;
+    }
+    return _csi_ingest_next_file(g);
+}
+
+/*
+ * Handles one line (without its line break), read by `stamp_us`.
+ */
+void _csi_ingest_line(csi_ingest_t *g, const char *begin, const char *end, int64_t stamp_us) {
+    if (end > begin && end[-1] == '\r') {
+        end--;
+    }
+    if (end == begin) {
+        return;
+    }
+    // whatever came before `CSI_DATA` (the end of a log line, boot noise) is not part of the row
+    const char *start = (const char *) memmem(begin, end - begin, "CSI_DATA,", 9);
+    if (start == NULL) {
+        g->stats.other_lines++;
+        return;
+    }
+    if (g->scratch.rows() >= CSI_INGEST_SCRATCH_ROWS) {
+        g->scratch = csi_columns_t();
+    }
+    // a line which already has a timestamp column would get a second one
+    if (!csi_log_parse_line(start, end, &g->scratch) || !std::isnan(g->scratch.host_timestamp.back())) {
+        g->stats.malformed_lines++;
+        return;
+    }
+    g->stats.csi_lines++;
+
+    if (g->rotate_bytes > 0 && !g->prefix.empty() && g->file_bytes >= g->rotate_bytes) {
+        _csi_ingest_next_file(g);
+    }
+    char stamp[32];
+    int stamp_len = snprintf(stamp, sizeof(stamp), ",%lld.%06lld\n", (long long) (stamp_us / 1000000),
+                             (long long) (stamp_us % 1000000));
+    _csi_ingest_append(g, start, end - start);
+    _csi_ingest_append(g, stamp, stamp_len);
+}
+
+/*
+ * Takes `len` bytes, all of which had been received by `stamp_us`. Each line is stamped with the time of the bytes
+ * which completed it.
+ */
+void csi_ingest_feed(csi_ingest_t *g, const char *data, size_t len, int64_t stamp_us) {
+    g->stats.bytes += len;
+    const char *p = data, *end = data + len;
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            // kept for the next read
+            size_t n = end - p;
+            if (!g->overlong && g->line_len + n <= g->line.size()) {
+                memcpy(g->line.data() + g->line_len, p, n);
+                g->line_len += n;
+            } else {
+                g->overlong = true;
+                g->line_len = 0;
+            }
+            return;
+        }
+        if (g->overlong) {
+            g->overlong = false;
+            g->stats.malformed_lines++;
+        } else if (g->line_len == 0) {
+            // a whole line within the read, handled where it is
+            _csi_ingest_line(g, p, eol, stamp_us);
+        } else if (g->line_len + (eol - p) <= g->line.size()) {
+            memcpy(g->line.data() + g->line_len, p, eol - p);
+            _csi_ingest_line(g, g->line.data(), g->line.data() + g->line_len + (eol - p), stamp_us);
+        } else {
+            g->stats.malformed_lines++;
+        }
+        g->line_len = 0;
+        p = eol + 1;
+    }
+}
+
+/*
+ * Handles a last line without a line break, and flushes and closes the output.
+ */
+bool csi_ingest_finish(csi_ingest_t *g, int64_t stamp_us) {
+    if (g->overlong) {
+        g->stats.malformed_lines++;
+    } else if (g->line_len > 0) {
+        _csi_ingest_line(g, g->line.data(), g->line.data() + g->line_len, stamp_us);
+    }
+    g->overlong = false;
+    g->line_len = 0;
+    bool ok = csi_ingest_flush(g);
+    if (!g->prefix.empty() && g->stats.files > 0) {
+        ok &= close(g->out_fd) == 0;
+    }
+    return ok && !g->failed;
+}
+
+/*
+ * Reads `fd` (made non-blocking) until it ends, `stop` is set or output fails, calling `tick` about every 100 ms.
+ * Output is flushed whenever nothing is left to read. False if reading or writing failed.
+ */
+bool csi_ingest_run(csi_ingest_t *g, int fd, const std::atomic<bool> &stop, const std::function<void()> &tick) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    std::vector<char> buf(CSI_INGEST_READ_SIZE);
+    while (!stop.load() && !g->failed) {
+        struct pollfd p = {fd, POLLIN, 0};
+        int r = poll(&p, 1, 100);
+        if (r < 0 && errno != EINTR) {
+            return false;
+        }
+        tick();
+        if (r <= 0) {
+            continue;
+        }
+        // large reads until the port is drained, each stamped just before it is made
+        while (true) {
+            int64_t stamp_us = csi_ingest_now_us();
+            ssize_t n = read(fd, buf.data(), buf.size());
+            if (n > 0) {
+                g->stats.reads++;
+                csi_ingest_feed(g, buf.data(), n, stamp_us);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            // end of a pipe or file, or EIO once the other side of a (pseudo-)terminal is gone
+            return n == 0 || errno == EIO;
+        }
+        csi_ingest_flush(g);
+    }
+    return !g->failed;
+}
+
+#endif //ESP32_CSI_CSI_INGEST_H
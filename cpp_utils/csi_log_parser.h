@@ -0,0 +1,441 @@
+#ifndef ESP32_CSI_CSI_LOG_PARSER_H
+#define ESP32_CSI_CSI_LOG_PARSER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <charconv>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// Parser for CSI CSV captures (the `CSI_CSV_HEADER` schema), producing one array per column.
+//
+// The file is memory-mapped, split on line boundaries into one chunk per thread, and every chunk is parsed
+// independently before the columns are concatenated in file order.
+// Lines which are cut short or corrupted (as happens on serial captures) are counted and skipped.
+//
+
+#define CSI_LOG_MAX_VALUES 612
+
+struct csi_columns_t {
+    // index into `roles`, which only holds each distinct role string once
+    std::vector<uint8_t> role;
+    std::vector<std::string> roles;
+
+    // 48-bit MAC address, first octet in the most significant byte
+    std::vector<uint64_t> mac;
+
+    std::vector<int8_t> rssi;
+    std::vector<uint8_t> rate;
+    std::vector<uint8_t> sig_mode;
+    std::vector<uint8_t> mcs;
+    std::vector<uint8_t> bandwidth;
+    std::vector<uint8_t> smoothing;
+    std::vector<uint8_t> not_sounding;
+    std::vector<uint8_t> aggregation;
+    std::vector<uint8_t> stbc;
+    std::vector<uint8_t> fec_coding;
+    std::vector<uint8_t> sgi;
+    std::vector<int8_t> noise_floor;
+    std::vector<uint8_t> ampdu_cnt;
+    std::vector<uint8_t> channel;
+    std::vector<uint8_t> secondary_channel;
+    std::vector<uint32_t> local_timestamp;
+    std::vector<uint8_t> ant;
+    std::vector<uint16_t> sig_len;
+    std::vector<uint8_t> rx_state;
+    std::vector<uint8_t> real_time_set;
+    // microseconds, exact for `<seconds>.<6 digits>` and rounded from older `%g` captures
+    std::vector<int64_t> real_timestamp_us;
+    // 0 if unknown, and in captures from before clock sync
+    std::vector<uint32_t> real_time_uncertainty_us;
+    std::vector<uint16_t> len;
+
+    // timestamp appended by `serial_append_time.py`, NaN if the line has none
+    std::vector<double> host_timestamp;
+
+    // Interleaved CSI values of row `i` are `csi[csi_offset[i] .. csi_offset[i + 1])`.
+    // When every row has the same number of values this is a dense row-major matrix.
+    std::vector<int8_t> csi;
+    std::vector<uint64_t> csi_offset = {0};
+
+    size_t malformed_lines = 0;
+    size_t other_lines = 0;
+
+    size_t rows() const {
+        return mac.size();
+    }
+
+    const int8_t *row_values(size_t i) const {
+        return csi.data() + csi_offset[i];
+    }
+
+    size_t row_value_count(size_t i) const {
+        return csi_offset[i + 1] - csi_offset[i];
+    }
+};
+
+struct _csi_log_cursor_t {
+    const char *p;
+    const char *end;
+};
+
+template<typename T>
+bool _csi_log_int(_csi_log_cursor_t *c, T *out, char terminator) {
+    auto result = std::from_chars(c->p, c->end, *out);
+    if (result.ec != std::errc() || result.ptr >= c->end || *result.ptr != terminator) {
+        return false;
+    }
+    c->p = result.ptr + 1;
+    return true;
+}
+
+bool _csi_log_double(_csi_log_cursor_t *c, double *out, char terminator) {
+    auto result = std::from_chars(c->p, c->end, *out);
+    if (result.ec != std::errc() || result.ptr >= c->end || *result.ptr != terminator) {
+        return false;
+    }
+    c->p = result.ptr + 1;
+    return true;
+}
+
+/*
+ * `[-]<seconds>[.<up to 6 digits>]` as microseconds, without going through a double. Anything else (e.g. the
+ * `1.7e+09` of older captures) is read as a double and rounded.
+ */
+bool _csi_log_timestamp_us(_csi_log_cursor_t *c, int64_t *out, char terminator) {
+    const char *p = c->p;
+    bool negative = p < c->end && *p == '-';
+    if (negative) {
+        p++;
+    }
+    uint64_t seconds;
+    auto result = std::from_chars(p, c->end, seconds);
+    bool exact = result.ec == std::errc() && seconds < (uint64_t) INT64_MAX / 1000000;
+    p = result.ptr;
+    int64_t fraction = 0;
+    if (exact && p < c->end && *p == '.') {
+        int digits = 0;
+        for (p++; p < c->end && *p >= '0' && *p <= '9' && digits < 6; p++, digits++) {
+            fraction = fraction * 10 + (*p - '0');
+        }
+        for (; digits < 6; digits++) {
+            fraction *= 10;
+        }
+    }
+    if (exact && p < c->end && *p == terminator) {
+        int64_t us = (int64_t) seconds * 1000000 + fraction;
+        *out = negative ? -us : us;
+        c->p = p + 1;
+        return true;
+    }
+
+    double value;
+    if (!_csi_log_double(c, &value, terminator)) {
+        return false;
+    }
+    *out = llround(value * 1000000.0);
+    return true;
+}
+
+int _csi_log_hex(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    return -1;
+}
+
+bool _csi_log_mac(_csi_log_cursor_t *c, uint64_t *out) {
+    if (c->end - c->p < 18) {
+        return false;
+    }
+    uint64_t mac = 0;
+    for (int i = 0; i < 6; i++) {
+        int hi = _csi_log_hex(c->p[i * 3]);
+        int lo = _csi_log_hex(c->p[i * 3 + 1]);
+        char separator = c->p[i * 3 + 2];
+        if (hi < 0 || lo < 0 || separator != (i < 5 ? ':' : ',')) {
+            return false;
+        }
+        mac = (mac << 8) | (hi << 4) | lo;
+    }
+    c->p += 18;
+    *out = mac;
+    return true;
+}
+
+uint8_t _csi_log_role(csi_columns_t *cols, const char *start, size_t n) {
+    for (size_t i = 0; i < cols->roles.size(); i++) {
+        if (cols->roles[i].size() == n && memcmp(cols->roles[i].data(), start, n) == 0) {
+            return i;
+        }
+    }
+    cols->roles.emplace_back(start, n);
+    return cols->roles.size() - 1;
+}
+
+/*
+ * Parses a single line (without the trailing newline). Columns are only appended once the whole line is valid.
+ */
+bool csi_log_parse_line(const char *line, const char *end, csi_columns_t *cols) {
+    const char *start = (const char *) memmem(line, end - line, "CSI_DATA,", 9);
+    if (start == NULL) {
+        return false;
+    }
+    _csi_log_cursor_t c = {start + 9, end};
+
+    const char *role_end = (const char *) memchr(c.p, ',', c.end - c.p);
+    if (role_end == NULL) {
+        return false;
+    }
+    const char *role_start = c.p;
+    c.p = role_end + 1;
+
+    uint64_t mac;
+    int rssi, rate, sig_mode, mcs, bandwidth, smoothing, not_sounding, aggregation, stbc, fec_coding, sgi;
+    int noise_floor, ampdu_cnt, channel, secondary_channel, ant, sig_len, rx_state, real_time_set, len;
+    uint32_t local_timestamp;
+    int64_t real_timestamp_us;
+    uint32_t real_time_uncertainty_us = 0;
+    int64_t after_timestamp;
+    if (!_csi_log_mac(&c, &mac)
+        || !_csi_log_int(&c, &rssi, ',') || !_csi_log_int(&c, &rate, ',')
+        || !_csi_log_int(&c, &sig_mode, ',') || !_csi_log_int(&c, &mcs, ',')
+        || !_csi_log_int(&c, &bandwidth, ',') || !_csi_log_int(&c, &smoothing, ',')
+        || !_csi_log_int(&c, &not_sounding, ',') || !_csi_log_int(&c, &aggregation, ',')
+        || !_csi_log_int(&c, &stbc, ',') || !_csi_log_int(&c, &fec_coding, ',')
+        || !_csi_log_int(&c, &sgi, ',') || !_csi_log_int(&c, &noise_floor, ',')
+        || !_csi_log_int(&c, &ampdu_cnt, ',') || !_csi_log_int(&c, &channel, ',')
+        || !_csi_log_int(&c, &secondary_channel, ',') || !_csi_log_int(&c, &local_timestamp, ',')
+        || !_csi_log_int(&c, &ant, ',') || !_csi_log_int(&c, &sig_len, ',')
+        || !_csi_log_int(&c, &rx_state, ',') || !_csi_log_int(&c, &real_time_set, ',')
+        || !_csi_log_timestamp_us(&c, &real_timestamp_us, ',') || !_csi_log_int(&c, &after_timestamp, ',')) {
+        return false;
+    }
+    // captures from before clock sync go straight from `real_timestamp` to `len`
+    if (c.p < c.end && *c.p == '[') {
+        len = (int) after_timestamp;
+    } else if (after_timestamp < 0 || after_timestamp > UINT32_MAX || !_csi_log_int(&c, &len, ',')) {
+        return false;
+    } else {
+        real_time_uncertainty_us = (uint32_t) after_timestamp;
+    }
+    if (c.p >= c.end || *c.p != '[') {
+        return false;
+    }
+    c.p++;
+
+    // values are appended speculatively and rolled back if the list turns out to be damaged
+    size_t values_start = cols->csi.size();
+    while (true) {
+        while (c.p < c.end && *c.p == ' ') {
+            c.p++;
+        }
+        if (c.p >= c.end) {
+            cols->csi.resize(values_start);
+            return false;
+        }
+        if (*c.p == ']') {
+            c.p++;
+            break;
+        }
+        int v;
+        auto result = std::from_chars(c.p, c.end, v);
+        if (result.ec != std::errc() || v < -128 || v > 127 || cols->csi.size() - values_start >= CSI_LOG_MAX_VALUES
+            || result.ptr >= c.end || (*result.ptr != ' ' && *result.ptr != ']')) {
+            cols->csi.resize(values_start);
+            return false;
+        }
+        cols->csi.push_back(v);
+        c.p = result.ptr;
+    }
+    size_t value_count = cols->csi.size() - values_start;
+    if (value_count % 2 != 0) {
+        cols->csi.resize(values_start);
+        return false;
+    }
+
+    double host_timestamp = NAN;
+    if (c.p < c.end) {
+        auto result = std::from_chars(c.p + 1, c.end, host_timestamp);
+        if (*c.p != ',' || result.ec != std::errc()) {
+            cols->csi.resize(values_start);
+            return false;
+        }
+    }
+
+    cols->role.push_back(_csi_log_role(cols, role_start, role_end - role_start));
+    cols->mac.push_back(mac);
+    cols->rssi.push_back(rssi);
+    cols->rate.push_back(rate);
+    cols->sig_mode.push_back(sig_mode);
+    cols->mcs.push_back(mcs);
+    cols->bandwidth.push_back(bandwidth);
+    cols->smoothing.push_back(smoothing);
+    cols->not_sounding.push_back(not_sounding);
+    cols->aggregation.push_back(aggregation);
+    cols->stbc.push_back(stbc);
+    cols->fec_coding.push_back(fec_coding);
+    cols->sgi.push_back(sgi);
+    cols->noise_floor.push_back(noise_floor);
+    cols->ampdu_cnt.push_back(ampdu_cnt);
+    cols->channel.push_back(channel);
+    cols->secondary_channel.push_back(secondary_channel);
+    cols->local_timestamp.push_back(local_timestamp);
+    cols->ant.push_back(ant);
+    cols->sig_len.push_back(sig_len);
+    cols->rx_state.push_back(rx_state);
+    cols->real_time_set.push_back(real_time_set);
+    cols->real_timestamp_us.push_back(real_timestamp_us);
+    cols->real_time_uncertainty_us.push_back(real_time_uncertainty_us);
+    cols->len.push_back(len);
+    cols->host_timestamp.push_back(host_timestamp);
+    cols->csi_offset.push_back(cols->csi.size());
+    return true;
+}
+
+void csi_log_parse_chunk(const char *begin, const char *end, csi_columns_t *cols) {
+    const char *p = begin;
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        const char *line_end = eol != NULL ? eol : end;
+        if (line_end > p && line_end[-1] == '\r') {
+            line_end--;
+        }
+
+        if (line_end > p && !csi_log_parse_line(p, line_end, cols)) {
+            // the header ends in `CSI_DATA,timestamp` with a timestamp column
+            if (memmem(p, line_end - p, "CSI_DATA,", 9) != NULL && (line_end - p < 5 || memcmp(p, "type,", 5) != 0)) {
+                cols->malformed_lines++;
+            } else {
+                // header, CSI_DROPPED and any other console output
+                cols->other_lines++;
+            }
+        }
+        p = eol != NULL ? eol + 1 : end;
+    }
+}
+
+template<typename T>
+void _csi_log_append(std::vector<T> *dst, const std::vector<T> &src) {
+    dst->insert(dst->end(), src.begin(), src.end());
+}
+
+void _csi_log_merge(csi_columns_t *dst, const csi_columns_t &src) {
+    for (uint8_t role : src.role) {
+        const std::string &name = src.roles[role];
+        dst->role.push_back(_csi_log_role(dst, name.data(), name.size()));
+    }
+    _csi_log_append(&dst->mac, src.mac);
+    _csi_log_append(&dst->rssi, src.rssi);
+    _csi_log_append(&dst->rate, src.rate);
+    _csi_log_append(&dst->sig_mode, src.sig_mode);
+    _csi_log_append(&dst->mcs, src.mcs);
+    _csi_log_append(&dst->bandwidth, src.bandwidth);
+    _csi_log_append(&dst->smoothing, src.smoothing);
+    _csi_log_append(&dst->not_sounding, src.not_sounding);
+    _csi_log_append(&dst->aggregation, src.aggregation);
+    _csi_log_append(&dst->stbc, src.stbc);
+    _csi_log_append(&dst->fec_coding, src.fec_coding);
+    _csi_log_append(&dst->sgi, src.sgi);
+    _csi_log_append(&dst->noise_floor, src.noise_floor);
+    _csi_log_append(&dst->ampdu_cnt, src.ampdu_cnt);
+    _csi_log_append(&dst->channel, src.channel);
+    _csi_log_append(&dst->secondary_channel, src.secondary_channel);
+    _csi_log_append(&dst->local_timestamp, src.local_timestamp);
+    _csi_log_append(&dst->ant, src.ant);
+    _csi_log_append(&dst->sig_len, src.sig_len);
+    _csi_log_append(&dst->rx_state, src.rx_state);
+    _csi_log_append(&dst->real_time_set, src.real_time_set);
+    _csi_log_append(&dst->real_timestamp_us, src.real_timestamp_us);
+    _csi_log_append(&dst->real_time_uncertainty_us, src.real_time_uncertainty_us);
+    _csi_log_append(&dst->len, src.len);
+    _csi_log_append(&dst->host_timestamp, src.host_timestamp);
+
+    uint64_t base = dst->csi.size();
+    _csi_log_append(&dst->csi, src.csi);
+    for (size_t i = 1; i < src.csi_offset.size(); i++) {
+        dst->csi_offset.push_back(base + src.csi_offset[i]);
+    }
+    dst->malformed_lines += src.malformed_lines;
+    dst->other_lines += src.other_lines;
+}
+
+/*
+ * Parses `size` bytes of CSV using up to `threads` threads (0 = one per core).
+ */
+void csi_log_parse_buffer(const char *data, size_t size, unsigned threads, csi_columns_t *out) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // not worth splitting small inputs
+    threads = std::max<size_t>(1, std::min<size_t>(threads, size / (1 << 20) + 1));
+
+    std::vector<const char *> bounds = {data};
+    for (unsigned i = 1; i < threads; i++) {
+        const char *split = std::max(bounds.back(), data + size * i / threads);
+        const char *eol = (const char *) memchr(split, '\n', data + size - split);
+        bounds.push_back(eol != NULL ? eol + 1 : data + size);
+    }
+    bounds.push_back(data + size);
+
+    std::vector<csi_columns_t> parts(threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([&, i]() {
+            // roughly 500 bytes and 128 values per line, to avoid most reallocations
+            size_t expected_rows = (bounds[i + 1] - bounds[i]) / 500;
+            parts[i].csi.reserve(expected_rows * 128);
+            csi_log_parse_chunk(bounds[i], bounds[i + 1], &parts[i]);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    *out = std::move(parts[0]);
+    for (unsigned i = 1; i < threads; i++) {
+        _csi_log_merge(out, parts[i]);
+        parts[i] = csi_columns_t();
+    }
+}
+
+/*
+ * Memory-maps and parses `file_name`. Returns false if the file cannot be opened.
+ */
+bool csi_log_parse_file(const char *file_name, unsigned threads, csi_columns_t *out) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        *out = csi_columns_t();
+        return true;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    csi_log_parse_buffer((const char *) data, st.st_size, threads, out);
+    munmap(data, st.st_size);
+    return true;
+}
+
+#endif //ESP32_CSI_CSI_LOG_PARSER_H
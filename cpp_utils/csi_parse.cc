@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../_components/csi_layout_component.h"
+#include "../_components/csi_math_component.h"
+#include "csi_log_parser.h"
+
+//
+// Parses a CSI CSV capture in parallel and prints a summary. With `--export` every column is also written as
+// a raw little-endian array, e.g. for `numpy.fromfile("out/rssi.i8", dtype=numpy.int8)`.
+//
+// The CSI of each training field is exported on its own as well: `lltf.i8`, `ht_ltf.i8` and `stbc_ht_ltf.i8` hold
+// 256 values per row, the imaginary and real parts of subcarriers -64 to 63 as numbered by
+// `_components/csi_layout_component.h`, with 0 where the frame does not have the subcarrier or it is null.
+//
+// `amplitude.f32` and `phase.f32` hold the amplitude and phase (radians) of each imaginary/real pair of `csi.i8`, as
+// the firmware computes them (`_components/csi_math_component.h`): those of row `i` start at `csi_offset[i] / 2`
+// (a row with an odd number of values leaves its last one out).
+//
+// Build:
+// `g++ -O2 -std=c++17 -pthread -o csi_parse csi_parse.cc`
+//
+// Run:
+// `./csi_parse my-experiment-file.csv`
+// `./csi_parse --threads 8 --export out/ my-experiment-file.csv`
+//
+
+template<typename T>
+static bool export_column(const std::string &dir, const char *name, const char *dtype, const std::vector<T> &column) {
+    std::string path = dir + "/" + name + "." + dtype;
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == NULL) {
+        fprintf(stderr, "ERROR: cannot write %s\n", path.c_str());
+        return false;
+    }
+    fwrite(column.data(), sizeof(T), column.size(), f);
+    fclose(f);
+    return true;
+}
+
+static bool export_columns(const std::string &dir, const csi_columns_t &c) {
+    std::string roles_path = dir + "/roles.txt";
+    FILE *roles = fopen(roles_path.c_str(), "w");
+    if (roles == NULL) {
+        fprintf(stderr, "ERROR: cannot write %s\n", roles_path.c_str());
+        return false;
+    }
+    for (const std::string &role : c.roles) {
+        fprintf(roles, "%s\n", role.c_str());
+    }
+    fclose(roles);
+
+    return export_column(dir, "role", "u8", c.role)
+           && export_column(dir, "mac", "u64", c.mac)
+           && export_column(dir, "rssi", "i8", c.rssi)
+           && export_column(dir, "rate", "u8", c.rate)
+           && export_column(dir, "sig_mode", "u8", c.sig_mode)
+           && export_column(dir, "mcs", "u8", c.mcs)
+           && export_column(dir, "bandwidth", "u8", c.bandwidth)
+           && export_column(dir, "smoothing", "u8", c.smoothing)
+           && export_column(dir, "not_sounding", "u8", c.not_sounding)
+           && export_column(dir, "aggregation", "u8", c.aggregation)
+           && export_column(dir, "stbc", "u8", c.stbc)
+           && export_column(dir, "fec_coding", "u8", c.fec_coding)
+           && export_column(dir, "sgi", "u8", c.sgi)
+           && export_column(dir, "noise_floor", "i8", c.noise_floor)
+           && export_column(dir, "ampdu_cnt", "u8", c.ampdu_cnt)
+           && export_column(dir, "channel", "u8", c.channel)
+           && export_column(dir, "secondary_channel", "u8", c.secondary_channel)
+           && export_column(dir, "local_timestamp", "u32", c.local_timestamp)
+           && export_column(dir, "ant", "u8", c.ant)
+           && export_column(dir, "sig_len", "u16", c.sig_len)
+           && export_column(dir, "rx_state", "u8", c.rx_state)
+           && export_column(dir, "real_time_set", "u8", c.real_time_set)
+           && export_column(dir, "real_timestamp_us", "i64", c.real_timestamp_us)
+           && export_column(dir, "real_time_uncertainty_us", "u32", c.real_time_uncertainty_us)
+           && export_column(dir, "len", "u16", c.len)
+           && export_column(dir, "host_timestamp", "f64", c.host_timestamp)
+           && export_column(dir, "csi", "i8", c.csi)
+           && export_column(dir, "csi_offset", "u64", c.csi_offset);
+}
+
+static bool export_fields(const std::string &dir, const csi_columns_t &c) {
+    static const char *names[CSI_LAYOUT_MAX_SEGMENTS] = {"lltf", "ht_ltf", "stbc_ht_ltf"};
+    const size_t row_len = 256;
+    std::vector<int8_t> fields[CSI_LAYOUT_MAX_SEGMENTS];
+    for (std::vector<int8_t> &field : fields) {
+        field.assign(c.rows() * row_len, 0);
+    }
+    size_t unknown = 0;
+    for (size_t i = 0; i < c.rows(); i++) {
+        csi_layout_t layout;
+        if (!csi_layout_init(&layout, c.sig_mode[i], c.bandwidth[i], c.secondary_channel[i], c.stbc[i])
+            || !csi_layout_fit(&layout, (uint16_t) c.row_value_count(i))) {
+            unknown++;
+            continue;
+        }
+        for (int f = 0; f < layout.segment_count; f++) {
+            csi_segment_view_t view;
+            csi_layout_view(&layout, c.row_values(i), (csi_field_t) f, &view);
+            int8_t *row = fields[f].data() + i * row_len;
+            for (int k = -64; k < 64; k++) {
+                csi_view_get(&view, k, &row[(k + 64) * 2], &row[(k + 64) * 2 + 1]);
+            }
+        }
+    }
+    if (unknown > 0) {
+        fprintf(stderr, "%zu rows with a number of values which fits no known layout, exported as 0\n", unknown);
+    }
+    for (int f = 0; f < CSI_LAYOUT_MAX_SEGMENTS; f++) {
+        if (!export_column(dir, names[f], "i8", fields[f])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool export_polar(const std::string &dir, const csi_columns_t &c) {
+    std::vector<float> amplitude(c.csi.size() / 2), phase(c.csi.size() / 2);
+    for (size_t i = 0; i < c.rows(); i++) {
+        int pairs = (int) (c.row_value_count(i) / 2);
+        csi_amplitude_f32(c.row_values(i), pairs, amplitude.data() + c.csi_offset[i] / 2);
+        csi_phase_f32(c.row_values(i), pairs, phase.data() + c.csi_offset[i] / 2);
+    }
+    return export_column(dir, "amplitude", "f32", amplitude) && export_column(dir, "phase", "f32", phase);
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = 0;
+    const char *export_dir = NULL;
+    const char *file_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            export_dir = argv[++i];
+        } else {
+            file_name = argv[i];
+        }
+    }
+    if (file_name == NULL) {
+        fprintf(stderr, "usage: csi_parse [--threads N] [--export DIR] <csi.csv>\n");
+        return 1;
+    }
+
+    csi_columns_t columns;
+    auto start = std::chrono::steady_clock::now();
+    if (!csi_log_parse_file(file_name, threads, &columns)) {
+        fprintf(stderr, "ERROR: cannot read %s\n", file_name);
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    struct stat st;
+    stat(file_name, &st);
+    printf("rows: %zu, malformed lines: %zu, other lines: %zu\n",
+           columns.rows(), columns.malformed_lines, columns.other_lines);
+    printf("parsed %.1f MB in %.3f s (%.1f MB/s)\n", st.st_size / 1e6, seconds, st.st_size / 1e6 / seconds);
+
+    std::map<uint64_t, size_t> frames_per_mac;
+    for (uint64_t mac : columns.mac) {
+        frames_per_mac[mac]++;
+    }
+    for (const auto &entry : frames_per_mac) {
+        uint64_t mac = entry.first;
+        printf("%02X:%02X:%02X:%02X:%02X:%02X %zu frames\n",
+               (unsigned) (mac >> 40) & 0xFF, (unsigned) (mac >> 32) & 0xFF, (unsigned) (mac >> 24) & 0xFF,
+               (unsigned) (mac >> 16) & 0xFF, (unsigned) (mac >> 8) & 0xFF, (unsigned) mac & 0xFF, entry.second);
+    }
+    if (columns.rows() > 0) {
+        int64_t first = columns.real_timestamp_us.front(), last = columns.real_timestamp_us.back();
+        printf("real_timestamp: %s%lld.%06lld .. %s%lld.%06lld\n", first < 0 ? "-" : "", llabs(first) / 1000000,
+               llabs(first) % 1000000, last < 0 ? "-" : "", llabs(last) / 1000000, llabs(last) % 1000000);
+    }
+
+    if (export_dir != NULL && (!export_columns(export_dir, columns) || !export_fields(export_dir, columns)
+                               || !export_polar(export_dir, columns))) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "csi_probe_analyzer.h"
+
+//
+// Per-transmitter probe loss, burst-loss lengths and jitter of a receiver's CSV log (`active_ap` or `passive`
+// with `ESP32 CSI Tool Config > Report probes`), see `csi_probe_analyzer.h`. The log is read once, front to back,
+// so it can be any size, and can also come from a pipe.
+//
+// Build:
+// `g++ -O2 -std=c++17 -o csi_probe_analyze csi_probe_analyze.cc`
+//
+// Run:
+// `./csi_probe_analyze my-experiment-file.csv`
+// `./csi_binary_decode 0.bin | ./csi_probe_analyze`
+//
+
+int main(int argc, char **argv) {
+    const char *file_name = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' || file_name != NULL) {
+            fprintf(stderr, "usage: csi_probe_analyze [log.csv, default stdin]\n");
+            return 1;
+        }
+        file_name = argv[i];
+    }
+
+    FILE *in = stdin;
+    if (file_name != NULL) {
+        in = fopen(file_name, "rb");
+        if (in == NULL) {
+            fprintf(stderr, "ERROR: cannot read %s\n", file_name);
+            return 1;
+        }
+    }
+
+    probe_analyzer_t analyzer;
+    std::string carry;
+    std::vector<char> chunk(1 << 20);
+    size_t n;
+    while ((n = fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+        probe_analyzer_feed(&analyzer, chunk.data(), n, &carry);
+    }
+    probe_analyzer_finish(&analyzer, &carry);
+    probe_analyzer_print(&analyzer, stdout);
+    return 0;
+}
@@ -0,0 +1,433 @@
+#ifndef ESP32_CSI_CSI_PROBE_ANALYZER_H
+#define ESP32_CSI_CSI_PROBE_ANALYZER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <deque>
+#include <map>
+#include <string>
+
+#include "../_components/csi_stats_component.h"
+
+//
+// Loss and timing accounting for probes (`_components/probe_rx_component.h`), in one streaming pass over a
+// receiver's CSV log. Per transmitter MAC:
+//  - probes received, lost, reordered and duplicated, from the probe sequence numbers;
+//  - lengths of runs of consecutive lost probes (burst losses);
+//  - inter-arrival times and RFC 3550 interarrival jitter, from the receiver's `local_timestamp` and the
+//    transmitter's `tx_timestamp_us` (so the two clocks need not be synchronised);
+//  - how many received probes have a `CSI_DATA` row (same MAC and `local_timestamp`). One without was received by
+//    the radio but lost on the CSI path, e.g. dropped from the ring (see the `CSI_DROPPED` totals).
+//
+// Probes the receiver dropped itself (`CSI_PROBE_DROPPED`) are counted as lost, their total is reported separately.
+// Memory is bounded by the number of transmitters, not the length of the log.
+//
+
+// A probe more than this many sequence numbers late has already been counted as lost.
+#define PROBE_REORDER_WINDOW 64
+// `CSI_DATA` rows and probes waiting for their counterpart, per MAC
+#define PROBE_MATCH_PENDING 64
+
+//
+// Sequence number accounting. A sequence number is only declared lost once `PROBE_REORDER_WINDOW` newer ones have
+// been seen, so late probes within the window are counted as reordered, and burst lengths are exact.
+// Numbers before the first one seen do not count.
+//
+struct probe_loss_t {
+    bool started = false;
+    uint32_t next = 0;
+    // bit i is set if `next - 1 - i` has been received
+    uint64_t window = 0;
+    // current run of lost sequence numbers which have left the window
+    uint64_t run = 0;
+
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t reordered = 0;
+    uint64_t duplicates = 0;
+    // arrived after they had been counted as lost
+    uint64_t too_late = 0;
+    uint64_t max_burst = 0;
+    csi_histogram_t bursts;
+
+    probe_loss_t() {
+        csi_histogram_reset(&bursts);
+    }
+
+    void _end_run() {
+        if (run > 0) {
+            csi_histogram_add(&bursts, run > UINT32_MAX ? UINT32_MAX : (uint32_t) run);
+            if (run > max_burst) {
+                max_burst = run;
+            }
+            run = 0;
+        }
+    }
+
+    // `n` sequence numbers leave the window, all of them lost
+    void _retire_lost(uint64_t n) {
+        lost += n;
+        run += n;
+    }
+
+    // the oldest `n` positions leave the window
+    void _advance(uint32_t n) {
+        uint32_t from_window = n < PROBE_REORDER_WINDOW ? n : PROBE_REORDER_WINDOW;
+        for (uint32_t i = 0; i < from_window; i++) {
+            if ((window >> (PROBE_REORDER_WINDOW - 1 - i)) & 1) {
+                _end_run();
+            } else {
+                _retire_lost(1);
+            }
+        }
+        if (n > PROBE_REORDER_WINDOW) {
+            _retire_lost(n - PROBE_REORDER_WINDOW);
+        }
+        window = n >= PROBE_REORDER_WINDOW ? 0 : window << n;
+    }
+
+    /*
+     * Returns false for a probe which is not counted (a duplicate, or one which arrived too late).
+     */
+    bool accept(uint32_t sequence) {
+        if (!started) {
+            started = true;
+            next = sequence + 1;
+            // everything before the first probe counts as received
+            window = ~(uint64_t) 0;
+            received++;
+            return true;
+        }
+
+        int32_t ahead = (int32_t) (sequence - next);
+        if (ahead >= 0) {
+            _advance((uint32_t) ahead + 1);
+            window |= 1;
+            next = sequence + 1;
+            received++;
+            return true;
+        }
+
+        uint32_t age = -(int64_t) ahead - 1;
+        if (age >= PROBE_REORDER_WINDOW) {
+            too_late++;
+            return false;
+        }
+        uint64_t bit = (uint64_t) 1 << age;
+        if (window & bit) {
+            duplicates++;
+            return false;
+        }
+        window |= bit;
+        reordered++;
+        received++;
+        return true;
+    }
+
+    /*
+     * Counts the gaps still in the window as lost. Call once at the end of the log.
+     */
+    void finish() {
+        if (started) {
+            _advance(PROBE_REORDER_WINDOW);
+        }
+        _end_run();
+    }
+};
+
+struct probe_transmitter_t {
+    probe_loss_t loss;
+
+    // of the previous counted probe, in arrival order
+    bool has_previous = false;
+    uint32_t previous_rx_us = 0;
+    int64_t previous_tx_us = 0;
+    csi_histogram_t inter_arrival_us;
+    double jitter_us = 0;
+
+    uint64_t with_csi = 0;
+    uint64_t without_csi = 0;
+    // `local_timestamp`s of probes with no `CSI_DATA` row yet
+    std::deque<uint32_t> pending;
+
+    probe_transmitter_t() {
+        csi_histogram_reset(&inter_arrival_us);
+    }
+};
+
+struct probe_analyzer_t {
+    std::map<uint64_t, probe_transmitter_t> transmitters;
+    // `local_timestamp`s of `CSI_DATA` rows with no probe yet, per MAC
+    std::map<uint64_t, std::deque<uint32_t>> pending_csi;
+
+    uint64_t lines = 0;
+    uint64_t csi_rows = 0;
+    uint64_t probes = 0;
+    uint64_t malformed = 0;
+    uint64_t csi_dropped = 0;
+    uint64_t probe_dropped = 0;
+};
+
+//
+// Field access on a single line, without copying it.
+//
+struct _probe_line_t {
+    const char *p;
+    const char *end;
+};
+
+bool _probe_skip_fields(_probe_line_t *l, int n) {
+    while (n > 0) {
+        const char *comma = (const char *) memchr(l->p, ',', l->end - l->p);
+        if (comma == NULL) {
+            return false;
+        }
+        l->p = comma + 1;
+        n--;
+    }
+    return true;
+}
+
+bool _probe_uint(_probe_line_t *l, uint64_t *out) {
+    const char *p = l->p;
+    uint64_t v = 0;
+    while (p < l->end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+    }
+    if (p == l->p || (p < l->end && *p != ',')) {
+        return false;
+    }
+    *out = v;
+    l->p = p < l->end ? p + 1 : p;
+    return true;
+}
+
+bool _probe_int(_probe_line_t *l, int64_t *out) {
+    bool negative = l->p < l->end && *l->p == '-';
+    if (negative) {
+        l->p++;
+    }
+    uint64_t v;
+    if (!_probe_uint(l, &v)) {
+        return false;
+    }
+    *out = negative ? -(int64_t) v : (int64_t) v;
+    return true;
+}
+
+int _probe_hex(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+bool _probe_mac(_probe_line_t *l, uint64_t *out) {
+    if (l->end - l->p < 17) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < 17; i++) {
+        char ch = l->p[i];
+        if (i % 3 == 2) {
+            if (ch != ':') {
+                return false;
+            }
+            continue;
+        }
+        int digit = _probe_hex(ch);
+        if (digit < 0) {
+            return false;
+        }
+        v = (v << 4) | digit;
+    }
+    l->p += 17;
+    if (l->p < l->end) {
+        if (*l->p != ',') {
+            return false;
+        }
+        l->p++;
+    }
+    *out = v;
+    return true;
+}
+
+bool _probe_starts_with(const char *line, const char *end, const char *prefix) {
+    size_t n = strlen(prefix);
+    return (size_t) (end - line) >= n && memcmp(line, prefix, n) == 0;
+}
+
+// removes `ts` from `q` if it is there
+bool _probe_take(std::deque<uint32_t> *q, uint32_t ts) {
+    for (auto it = q->begin(); it != q->end(); ++it) {
+        if (*it == ts) {
+            q->erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void _probe_analyzer_csi(probe_analyzer_t *a, uint64_t mac, uint32_t ts) {
+    a->csi_rows++;
+    auto t = a->transmitters.find(mac);
+    if (t != a->transmitters.end() && _probe_take(&t->second.pending, ts)) {
+        t->second.with_csi++;
+        return;
+    }
+    std::deque<uint32_t> &q = a->pending_csi[mac];
+    if (q.size() >= PROBE_MATCH_PENDING) {
+        q.pop_front();
+    }
+    q.push_back(ts);
+}
+
+void _probe_analyzer_probe(probe_analyzer_t *a, uint64_t mac, uint32_t rx_us, uint32_t sequence, int64_t tx_us) {
+    a->probes++;
+    probe_transmitter_t &t = a->transmitters[mac];
+    if (!t.loss.accept(sequence)) {
+        return;
+    }
+
+    if (t.has_previous) {
+        uint32_t inter_arrival = rx_us - t.previous_rx_us;
+        csi_histogram_add(&t.inter_arrival_us, inter_arrival);
+        // RFC 3550 section 6.4.1, with the receive clock wrapping every 2^32 us
+        double d = (double) (int32_t) inter_arrival - (double) (tx_us - t.previous_tx_us);
+        t.jitter_us += (fabs(d) - t.jitter_us) / 16;
+    }
+    t.has_previous = true;
+    t.previous_rx_us = rx_us;
+    t.previous_tx_us = tx_us;
+
+    auto csi = a->pending_csi.find(mac);
+    if (csi != a->pending_csi.end() && _probe_take(&csi->second, rx_us)) {
+        t.with_csi++;
+        return;
+    }
+    if (t.pending.size() >= PROBE_MATCH_PENDING) {
+        t.pending.pop_front();
+        t.without_csi++;
+    }
+    t.pending.push_back(rx_us);
+}
+
+/*
+ * Handles one line (without the trailing newline). Lines other than the ones listed at the top are ignored.
+ */
+void probe_analyzer_line(probe_analyzer_t *a, const char *line, const char *end) {
+    a->lines++;
+    _probe_line_t l = {line, end};
+    if (_probe_starts_with(line, end, "CSI_DATA,")) {
+        // type,role,mac,...,local_timestamp is the 19th column
+        uint64_t mac, ts;
+        if (!_probe_skip_fields(&l, 2) || !_probe_mac(&l, &mac) || !_probe_skip_fields(&l, 15)
+            || !_probe_uint(&l, &ts)) {
+            a->malformed++;
+            return;
+        }
+        _probe_analyzer_csi(a, mac, (uint32_t) ts);
+    } else if (_probe_starts_with(line, end, "CSI_PROBE,")) {
+        uint64_t mac, ts, sequence;
+        int64_t tx_us;
+        if (!_probe_skip_fields(&l, 2) || !_probe_mac(&l, &mac) || !_probe_uint(&l, &ts)
+            || !_probe_uint(&l, &sequence) || !_probe_int(&l, &tx_us)) {
+            a->malformed++;
+            return;
+        }
+        _probe_analyzer_probe(a, mac, (uint32_t) ts, (uint32_t) sequence, tx_us);
+    } else if (_probe_starts_with(line, end, "CSI_DROPPED,") || _probe_starts_with(line, end, "CSI_PROBE_DROPPED,")) {
+        // the count since the previous report, so restarts of the receiver add up correctly
+        uint64_t since_last;
+        if (!_probe_skip_fields(&l, 3) || !_probe_uint(&l, &since_last)) {
+            a->malformed++;
+            return;
+        }
+        (line[4] == 'P' ? a->probe_dropped : a->csi_dropped) += since_last;
+    }
+}
+
+/*
+ * Handles a chunk of the log; `carry` keeps a line cut at the end of the chunk until the next call.
+ */
+void probe_analyzer_feed(probe_analyzer_t *a, const char *data, size_t len, std::string *carry) {
+    const char *p = data;
+    const char *end = data + len;
+    while (p < end) {
+        const char *newline = (const char *) memchr(p, '\n', end - p);
+        if (newline == NULL) {
+            carry->append(p, end - p);
+            return;
+        }
+        const char *line = p;
+        const char *line_end = newline;
+        if (!carry->empty()) {
+            carry->append(p, newline - p);
+            line = carry->data();
+            line_end = line + carry->size();
+        }
+        if (line_end > line && line_end[-1] == '\r') {
+            line_end--;
+        }
+        probe_analyzer_line(a, line, line_end);
+        carry->clear();
+        p = newline + 1;
+    }
+}
+
+/*
+ * Call once after the last line: settles the sequence numbers still in the window and the unmatched probes.
+ */
+void probe_analyzer_finish(probe_analyzer_t *a, std::string *carry) {
+    if (!carry->empty()) {
+        probe_analyzer_line(a, carry->data(), carry->data() + carry->size());
+        carry->clear();
+    }
+    for (auto &entry : a->transmitters) {
+        probe_transmitter_t &t = entry.second;
+        t.loss.finish();
+        t.without_csi += t.pending.size();
+        t.pending.clear();
+    }
+}
+
+void probe_analyzer_print(const probe_analyzer_t *a, FILE *f) {
+    fprintf(f, "lines: %llu, CSI rows: %llu, probes: %llu, malformed: %llu, CSI dropped: %llu, "
+               "probes dropped: %llu\n",
+            (unsigned long long) a->lines, (unsigned long long) a->csi_rows, (unsigned long long) a->probes,
+            (unsigned long long) a->malformed, (unsigned long long) a->csi_dropped,
+            (unsigned long long) a->probe_dropped);
+    for (const auto &entry : a->transmitters) {
+        const probe_transmitter_t &t = entry.second;
+        const probe_loss_t &l = t.loss;
+        uint64_t expected = l.received + l.lost;
+        fprintf(f, "%02x:%02x:%02x:%02x:%02x:%02x: %llu received, %llu lost (%.3f%%), %llu reordered, "
+                   "%llu duplicates, %llu too late\n",
+                (unsigned) (entry.first >> 40) & 0xFF, (unsigned) (entry.first >> 32) & 0xFF,
+                (unsigned) (entry.first >> 24) & 0xFF, (unsigned) (entry.first >> 16) & 0xFF,
+                (unsigned) (entry.first >> 8) & 0xFF, (unsigned) entry.first & 0xFF,
+                (unsigned long long) l.received, (unsigned long long) l.lost,
+                expected == 0 ? 0.0 : 100.0 * l.lost / expected, (unsigned long long) l.reordered,
+                (unsigned long long) l.duplicates, (unsigned long long) l.too_late);
+        fprintf(f, "  burst losses: %u, length mean %u, p50 %u, p99 %u, max %llu\n", l.bursts.count,
+                csi_histogram_mean(&l.bursts), csi_histogram_percentile(&l.bursts, 500),
+                csi_histogram_percentile(&l.bursts, 990), (unsigned long long) l.max_burst);
+        const csi_histogram_t &h = t.inter_arrival_us;
+        fprintf(f, "  inter-arrival us: min %u, mean %u, p50 %u, p99 %u, max %u; jitter %.1f us\n",
+                h.count == 0 ? 0 : h.min, csi_histogram_mean(&h), csi_histogram_percentile(&h, 500),
+                csi_histogram_percentile(&h, 990), h.max, t.jitter_us);
+        fprintf(f, "  with CSI row: %llu, without: %llu\n", (unsigned long long) t.with_csi,
+                (unsigned long long) t.without_csi);
+    }
+}
+
+#endif //ESP32_CSI_CSI_PROBE_ANALYZER_H
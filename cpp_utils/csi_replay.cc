@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+
+#include "../_components/nvs_component.h"
+#include "../_components/sd_component.h"
+#include "../_components/csi_component.h"
+#include "../_components/time_component.h"
+#include "../_components/input_component.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "csi_log_parser.h"
+
+//
+// Runs the firmware's CSI path (`csi_init`, `_wifi_csi_cb`, the writer task and the output code) on the host,
+// against the ESP-IDF stand-ins in `host_shim/`, and feeds it the frames of a recorded capture at a fixed rate.
+// CSI output goes to stdout exactly as it would go to the serial port; statistics go to stderr.
+//
+// Build (see CMakeLists.txt):
+// `cmake -S . -B build && cmake --build build`
+//
+// Run:
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 1000 --frames 100000 > /dev/null`
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 0 > replayed.csv`
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 1000 --stats-ms 1000 | grep CSI_STATS`
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 0 --probes | ./build/csi_probe_analyze`
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 0 --filter "RSSI -60; SIG_MODE 1" > filtered.csv`
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 2000 --limit 100:10 --stats-ms 1000 | grep CSI_STATS_LIMIT`
+// `./build/csi_replay ../python_utils/example_csi.csv --rate 1000 --command "50:FORMAT BINARY" | ./build/csi_binary_decode`
+//
+// `--rate 0` delivers frames as fast as the callback accepts them, which shows the highest rate the writer task
+// keeps up with (anything faster shows up as dropped frames). `--stats-ms` sets `csi_stats_interval_ms`.
+// `--probes` also hands every frame to the promiscuous callback as a probe (`CONFIG_CSI_PROBE_TAGS`), numbered
+// from 0, so `CSI_PROBE` lines without a `CSI_DATA` row are frames the CSI path dropped.
+// `--filter` applies a `FILTER:` line (`csi_filter_component.h`) after `csi_init`, as if typed on the serial port.
+// `--limit` and `--decimate` set the per-MAC rate limit and decimation (`csi_rate_limit_component.h`).
+// `--command N:LINE` runs a command (`command_component.h`) before frame N, as if typed on the serial port, and
+// prints the reply to stderr. It can be given more than once.
+//
+
+struct replay_frame_t {
+    wifi_csi_info_t info;
+    std::vector<int8_t> values;
+};
+
+static std::vector<replay_frame_t> load_replay_frames(const csi_columns_t &c) {
+    std::vector<replay_frame_t> frames(c.rows());
+    for (size_t i = 0; i < c.rows(); i++) {
+        replay_frame_t &f = frames[i];
+        memset(&f.info, 0, sizeof(f.info));
+        wifi_pkt_rx_ctrl_t &rx = f.info.rx_ctrl;
+        rx.rssi = c.rssi[i];
+        rx.rate = c.rate[i];
+        rx.sig_mode = c.sig_mode[i];
+        rx.mcs = c.mcs[i];
+        rx.cwb = c.bandwidth[i];
+        rx.smoothing = c.smoothing[i];
+        rx.not_sounding = c.not_sounding[i];
+        rx.aggregation = c.aggregation[i];
+        rx.stbc = c.stbc[i];
+        rx.fec_coding = c.fec_coding[i];
+        rx.sgi = c.sgi[i];
+        rx.noise_floor = c.noise_floor[i];
+        rx.ampdu_cnt = c.ampdu_cnt[i];
+        rx.channel = c.channel[i];
+        rx.secondary_channel = c.secondary_channel[i];
+        rx.timestamp = c.local_timestamp[i];
+        rx.ant = c.ant[i];
+        rx.sig_len = c.sig_len[i];
+        rx.rx_state = c.rx_state[i];
+        for (int b = 0; b < 6; b++) {
+            f.info.mac[b] = c.mac[i] >> (40 - 8 * b);
+        }
+        f.values.assign(c.row_values(i), c.row_values(i) + c.row_value_count(i));
+    }
+    // the buffers only move while the vector is filled
+    for (replay_frame_t &f : frames) {
+        f.info.buf = f.values.data();
+        f.info.len = f.values.size();
+    }
+    return frames;
+}
+
+int main(int argc, char **argv) {
+    const char *file_name = NULL;
+    double rate = 100;
+    uint64_t frame_count = 0;
+    const char *role = "STA";
+    bool probes = false;
+    const char *filter_commands = NULL;
+    std::vector<std::pair<uint64_t, std::string>> commands_at;
+    uint32_t limit_fps = 0, limit_burst = 10, decimate_keep = 1, decimate_every = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frame_count = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--role") == 0 && i + 1 < argc) {
+            role = argv[++i];
+        } else if (strcmp(argv[i], "--stats-ms") == 0 && i + 1 < argc) {
+            csi_stats_interval_ms = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--probes") == 0) {
+            probes = true;
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter_commands = argv[++i];
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%u:%u", &limit_fps, &limit_burst);
+        } else if (strcmp(argv[i], "--decimate") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%u/%u", &decimate_keep, &decimate_every);
+        } else if (strcmp(argv[i], "--command") == 0 && i + 1 < argc) {
+            char *line;
+            uint64_t at = strtoull(argv[++i], &line, 10);
+            commands_at.push_back({at, *line == ':' ? line + 1 : line});
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: csi_replay <csi.csv> [--rate frames/s, 0 = unpaced] [--frames N] [--role NAME] [--stats-ms N] [--probes] [--filter COMMANDS] [--limit FPS[:BURST]] [--decimate KEEP/EVERY] [--command N:LINE]\n");
+            return 1;
+        } else {
+            file_name = argv[i];
+        }
+    }
+    if (file_name == NULL) {
+        fprintf(stderr, "usage: csi_replay <csi.csv> [--rate frames/s, 0 = unpaced] [--frames N] [--role NAME] [--stats-ms N] [--probes] [--filter COMMANDS] [--limit FPS[:BURST]] [--decimate KEEP/EVERY] [--command N:LINE]\n");
+        return 1;
+    }
+
+    csi_columns_t columns;
+    if (!csi_log_parse_file(file_name, 0, &columns) || columns.rows() == 0) {
+        fprintf(stderr, "ERROR: no CSI_DATA rows in %s\n", file_name);
+        return 1;
+    }
+    std::vector<replay_frame_t> frames = load_replay_frames(columns);
+    if (frame_count == 0) {
+        frame_count = frames.size();
+    }
+
+    time_init();
+    nvs_init();
+    sd_init();
+    csi_init((char *) role);
+    if (!csi_rate_limit_configure(&csi_rate_limit, limit_fps, limit_burst, decimate_keep, decimate_every)) {
+        fprintf(stderr, "ERROR: invalid --limit or --decimate\n");
+        return 1;
+    }
+    input_register_commands();
+    if (filter_commands != NULL) {
+        bool ok = csi_filter_command(&csi_filter, filter_commands, &csi_filter_reply);
+        fprintf(stderr, "%.*s", (int) csi_filter_reply.len, csi_filter_reply.buf);
+        if (!ok) {
+            return 1;
+        }
+    }
+    if (probes) {
+        const wifi_promiscuous_filter_t filter = {.filter_mask = WIFI_PROMIS_FILTER_MASK_DATA};
+        esp_wifi_set_promiscuous(true);
+        esp_wifi_set_promiscuous_filter(&filter);
+    }
+    // only the payload and rx_ctrl are read by the callback, so one buffer serves every frame
+    static uint8_t probe_buf[sizeof(wifi_promiscuous_pkt_t) + PROBE_FRAME_MAX_SIZE];
+    wifi_promiscuous_pkt_t *probe_pkt = (wifi_promiscuous_pkt_t *) probe_buf;
+    probe_frame_t probe;
+
+    std::vector<uint32_t> callback_ns(frame_count);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < frame_count; i++) {
+        if (rate > 0) {
+            // absolute deadlines, so a late frame does not delay all the following ones
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds((int64_t) (i * 1e9 / rate)));
+        }
+        for (const auto &command : commands_at) {
+            if (command.first == i) {
+                if (!command_dispatch_line(command.second.c_str(), &input_reply_text, &input_reply)) {
+                    csi_format_str(&input_reply, "Unable to handle input\n");
+                }
+                fprintf(stderr, "%.*s", (int) input_reply.len, input_reply.buf);
+            }
+        }
+        wifi_csi_info_t *info = &frames[i % frames.size()].info;
+        if (probes) {
+            probe_frame_build_data(&probe, PROBE_BROADCAST, info->mac, PROBE_BROADCAST);
+            probe_frame_stamp(&probe, (uint32_t) i, get_steady_clock_timestamp_us());
+            probe_pkt->rx_ctrl = info->rx_ctrl;
+            probe_pkt->rx_ctrl.sig_len = probe.len;
+            memcpy(probe_pkt->payload, probe.data, probe.len);
+            host_wifi_receive_frame(probe_pkt, WIFI_PKT_DATA);
+        }
+        auto before = std::chrono::steady_clock::now();
+        host_wifi_receive_csi(info);
+        callback_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - before).count();
+    }
+    double offer_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // wait for the writer task to drain the ring
+    while (csi_ring.head.load() != csi_ring.tail.load() || probe_rx_ring.head.load() != probe_rx_ring.tail.load()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double drain_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fflush(stdout);
+
+    uint32_t dropped = csi_ring_dropped(&csi_ring);
+    uint32_t rejected = csi_filter.rejected.load();
+    uint32_t limited = csi_rate_limit.dropped.load();
+    std::sort(callback_ns.begin(), callback_ns.end());
+    double mean_ns = 0;
+    for (uint32_t ns : callback_ns) {
+        mean_ns += ns;
+    }
+    mean_ns /= frame_count;
+
+    uint64_t written = frame_count - dropped - rejected - limited;
+    fprintf(stderr, "frames: %llu offered at %.0f frames/s, %llu written, %u filtered out, %u rate limited or "
+                    "decimated, %u dropped (ring of %d slots)\n",
+            (unsigned long long) frame_count, frame_count / offer_seconds, (unsigned long long) written, rejected,
+            limited, dropped, CSI_RING_SLOT_COUNT);
+    fprintf(stderr, "written: %.0f frames/s (including draining the ring)\n", written / drain_seconds);
+    fprintf(stderr, "_wifi_csi_cb: mean %.0f ns, p50 %u ns, p99 %u ns, max %u ns\n", mean_ns,
+            callback_ns[frame_count / 2], callback_ns[frame_count * 99 / 100], callback_ns.back());
+    return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef ESP32_CSI_CSI_SERIAL_PORT_H
+#define ESP32_CSI_CSI_SERIAL_PORT_H
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+//
+// Opens the serial port of an ESP32 the way `idf.py monitor` does: raw, without resetting the ESP32.
+//
+
+speed_t csi_serial_baud(long baud) {
+    switch (baud) {
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 921600:
+            return B921600;
+        case 1000000:
+            return B1000000;
+        case 2000000:
+            return B2000000;
+        default:
+            return B0;
+    }
+}
+
+/*
+ * Returns the file descriptor, or -1 with `errno` set. `flags` are added to those of `open()`, e.g. `O_NONBLOCK`.
+ */
+int csi_serial_open(const char *path, long baud, int flags) {
+    int fd = open(path, O_RDWR | O_NOCTTY | flags);
+    if (fd < 0) {
+        return -1;
+    }
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, csi_serial_baud(baud));
+    cfsetospeed(&tty, csi_serial_baud(baud));
+    tty.c_cflag |= CLOCAL | CREAD;
+    // closing the port must not reset the ESP32 either
+    tty.c_cflag &= ~HUPCL;
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    // DTR and RTS drive EN and IO0 on most boards, released they leave the ESP32 running (like `idf.py monitor`)
+    int lines = TIOCM_DTR | TIOCM_RTS;
+    ioctl(fd, TIOCMBIC, &lines);
+    return fd;
+}
+
+/*
+ * Asks the driver to hand received bytes over straight away instead of collecting them for a few ms (e.g. the 16 ms
+ * latency timer of FTDI adapters). False if the port does not support it, such as a pseudo-terminal.
+ */
+bool csi_serial_low_latency(int fd) {
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+        return false;
+    }
+    serial.flags |= ASYNC_LOW_LATENCY;
+    return ioctl(fd, TIOCSSERIAL, &serial) == 0;
+}
+
+#endif //ESP32_CSI_CSI_SERIAL_PORT_H
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <chrono>
+
+#include "csi_time_server.h"
+
+//
+// Answers the clock sync requests of active_sta stations (`Clock sync interval` in the menuconfig) with this
+// computer's clock, instead of the AP doing it, so stations on different networks (or the computer's own
+// captures) share one time base. Point `Clock sync server IP address` at this computer.
+//
+// Build:
+// `g++ -O2 -std=c++17 -o csi_time_server csi_time_server.cc`
+//
+// Run:
+// `./csi_time_server --port 2224`
+//
+// `--skew-ppm P` and `--offset-us O` answer with a clock running P ppm fast and O us ahead, to see how the
+// stations follow a clock which drifts.
+//
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int) {
+    stop = 1;
+}
+
+int main(int argc, char **argv) {
+    int port = CLOCK_SYNC_PORT;
+    double skew_ppm = 0;
+    long long offset_us = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--skew-ppm") == 0 && i + 1 < argc) {
+            skew_ppm = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--offset-us") == 0 && i + 1 < argc) {
+            offset_us = atoll(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: csi_time_server [--port N] [--skew-ppm P] [--offset-us O]\n");
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "ERROR: cannot listen on port %d (%s)\n", port, strerror(errno));
+        return 1;
+    }
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    // the skew applies from start up, so the clock does not jump
+    auto start = std::chrono::system_clock::now();
+    auto now_us = [&]() {
+        auto now = std::chrono::system_clock::now();
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+        return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count()
+               + offset_us + (int64_t) (elapsed * skew_ppm * 1e-6);
+    };
+    uint64_t answered = 0;
+    auto last_report = std::chrono::steady_clock::now();
+    while (!stop) {
+        if (time_server_answer(fd, now_us, CLOCK_SYNC_FLAG_REAL_TIME_SET)) {
+            answered++;
+        }
+        if (std::chrono::steady_clock::now() - last_report >= std::chrono::seconds(10)) {
+            fprintf(stderr, "%llu requests answered\n", (unsigned long long) answered);
+            last_report = std::chrono::steady_clock::now();
+        }
+    }
+    fprintf(stderr, "%llu requests answered\n", (unsigned long long) answered);
+    close(fd);
+    return 0;
+}
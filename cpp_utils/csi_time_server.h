@@ -0,0 +1,38 @@
+#ifndef ESP32_CSI_CSI_TIME_SERVER_H
+#define ESP32_CSI_CSI_TIME_SERVER_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <functional>
+
+#include "../_components/clock_sync_component.h"
+
+//
+// Answering side of the clock sync exchange (`_components/clock_sync_component.h`), as the AP runs it in
+// `time_sync_server_loop()`, with the clock to answer with passed in.
+//
+
+//
+// Waits for one datagram on `fd` and answers it if it is a clock sync request. False if nothing (or something
+// else) arrived before the socket's receive timeout.
+//
+bool time_server_answer(int fd, const std::function<int64_t()> &now_us, uint8_t flags) {
+    uint8_t request[CLOCK_SYNC_REQUEST_SIZE + 1];
+    uint8_t reply[CLOCK_SYNC_REPLY_SIZE];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(fd, request, sizeof(request), 0, (struct sockaddr *) &from, &from_len);
+    int64_t t2 = now_us();
+    if (n <= 0) {
+        return false;
+    }
+    size_t len = clock_sync_encode_reply(reply, request, n, t2, flags);
+    if (len == 0) {
+        return false;
+    }
+    clock_sync_stamp_reply(reply, now_us());
+    return sendto(fd, reply, len, 0, (const struct sockaddr *) &from, from_len) == (ssize_t) len;
+}
+
+#endif //ESP32_CSI_CSI_TIME_SERVER_H
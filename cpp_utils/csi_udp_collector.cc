@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <vector>
+
+#include "csi_udp_collector.h"
+
+//
+// Receives CSI streamed over UDP (`ESP32 CSI Tool Config > Send CSI data over UDP`) from any number of devices
+// and writes the usual CSV. Lost, reordered and duplicated datagrams are reported per device on stderr
+// every 10 seconds and on exit (Ctrl+C).
+//
+// Build:
+// `g++ -O2 -std=c++17 -o csi_udp_collector csi_udp_collector.cc`
+//
+// Run:
+// `./csi_udp_collector --port 5000 > my-experiment-file.csv`
+// `./csi_udp_collector --port 5000 --out my-experiment-file.csv --idle-exit 30`
+//
+// `--idle-exit S` stops once nothing has been received for S seconds.
+//
+
+#define BATCH 64
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int) {
+    stop = 1;
+}
+
+int main(int argc, char **argv) {
+    int port = 5000;
+    const char *out_name = NULL;
+    int idle_exit = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_name = argv[++i];
+        } else if (strcmp(argv[i], "--idle-exit") == 0 && i + 1 < argc) {
+            idle_exit = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: csi_udp_collector [--port N] [--out file.csv] [--idle-exit seconds]\n");
+            return 1;
+        }
+    }
+
+    udp_collector_t collector;
+    if (out_name != NULL) {
+        collector.out = fopen(out_name, "w");
+        if (collector.out == NULL) {
+            fprintf(stderr, "ERROR: cannot write %s\n", out_name);
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "ERROR: cannot listen on port %d (%s)\n", port, strerror(errno));
+        return 1;
+    }
+    // a burst from several devices must not overflow the socket while a batch is written out
+    int receive_buffer = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+    struct timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    fputs(CSI_CSV_HEADER, collector.out);
+
+    std::vector<uint8_t> buffers(BATCH * UDP_BATCH_MAX_SIZE);
+    struct mmsghdr messages[BATCH];
+    struct iovec iovecs[BATCH];
+    struct sockaddr_in senders[BATCH];
+
+    auto last_stats = std::chrono::steady_clock::now();
+    auto last_data = last_stats;
+    while (!stop) {
+        for (int i = 0; i < BATCH; i++) {
+            iovecs[i].iov_base = buffers.data() + i * UDP_BATCH_MAX_SIZE;
+            iovecs[i].iov_len = UDP_BATCH_MAX_SIZE;
+            memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_name = &senders[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+        }
+
+        // blocks for the first datagram, then takes whatever else is already queued
+        int n = recvmmsg(fd, messages, BATCH, MSG_WAITFORONE, NULL);
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            uint64_t sender = ((uint64_t) ntohl(senders[i].sin_addr.s_addr) << 16) | ntohs(senders[i].sin_port);
+            udp_collector_datagram(&collector, sender, (const uint8_t *) iovecs[i].iov_base, messages[i].msg_len);
+        }
+        if (n > 0) {
+            last_data = now;
+        } else if (idle_exit > 0 && now - last_data >= std::chrono::seconds(idle_exit)) {
+            break;
+        }
+
+        if (now - last_stats >= std::chrono::seconds(10)) {
+            fflush(collector.out);
+            udp_collector_print_stats(&collector, stderr);
+            last_stats = now;
+        }
+    }
+
+    fflush(collector.out);
+    udp_collector_print_stats(&collector, stderr);
+    if (collector.out != stdout) {
+        fclose(collector.out);
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,189 @@
+#ifndef ESP32_CSI_CSI_UDP_COLLECTOR_H
+#define ESP32_CSI_CSI_UDP_COLLECTOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "../_components/csi_format_component.h"
+#include "../_components/csi_binary_component.h"
+#include "../_components/csi_delta_component.h"
+#include "../_components/udp_batch_component.h"
+
+//
+// Receiving side of `_components/udp_stream_component.h`: turns datagrams from any number of devices back into
+// the usual CSV and keeps loss/reordering statistics per device.
+//
+// Records are written in arrival order, so rows of a late datagram appear after newer ones.
+//
+
+//
+// Tracks the datagram sequence numbers of one sender. The last 64 sequence numbers are remembered,
+// which tells late datagrams (counted as lost until they arrive) from duplicates.
+//
+struct udp_sequence_t {
+    bool started = false;
+    uint32_t next = 0;
+    // bit i is set if `next - 1 - i` has been received
+    uint64_t window = 0;
+
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t reordered = 0;
+    uint64_t duplicates = 0;
+
+    /*
+     * Returns false for a duplicate, which should be ignored.
+     */
+    bool accept(uint32_t sequence) {
+        if (!started) {
+            started = true;
+            next = sequence + 1;
+            window = 1;
+            received++;
+            return true;
+        }
+
+        int32_t ahead = (int32_t) (sequence - next);
+        if (ahead >= 0) {
+            lost += ahead;
+            window = ahead + 1 >= 64 ? 0 : window << (ahead + 1);
+            window |= 1;
+            next = sequence + 1;
+            received++;
+            return true;
+        }
+
+        uint32_t age = -ahead - 1;
+        if (age < 64) {
+            uint64_t bit = (uint64_t) 1 << age;
+            if (window & bit) {
+                duplicates++;
+                return false;
+            }
+            window |= bit;
+        }
+        // too old to tell a duplicate from a late datagram, assume late
+        reordered++;
+        if (lost > 0) {
+            lost--;
+        }
+        received++;
+        return true;
+    }
+};
+
+struct udp_source_t {
+    std::string role = "UNKNOWN";
+    udp_sequence_t sequence;
+    // previous frames of compressed records (`CONFIG_CSI_BINARY_DELTA`), allocated by the first one
+    std::unique_ptr<csi_delta_t> delta;
+    uint64_t csi_records = 0;
+    uint64_t dropped_reports = 0;
+    uint64_t undecodable_records = 0;
+};
+
+struct udp_collector_t {
+    FILE *out = stdout;
+    // keyed by sender address (IPv4 address << 16 | port) and session
+    std::map<std::pair<uint64_t, uint32_t>, udp_source_t> sources;
+    uint64_t datagrams = 0;
+    uint64_t malformed_datagrams = 0;
+    uint64_t skipped_bytes = 0;
+    csi_format_buffer_t line;
+};
+
+void _udp_collector_record(udp_collector_t *c, udp_source_t *source, csi_binary_record_t &record) {
+    csi_format_buffer_t *b = &c->line;
+    csi_format_reset(b);
+    if (record.type == CSI_BINARY_RECORD_CSI_DELTA) {
+        if (!source->delta) {
+            source->delta.reset(new csi_delta_t);
+            csi_delta_init(source->delta.get(), 1);
+        }
+        // a lost or late datagram leaves the MAC's records undecodable until its next keyframe
+        if (!csi_delta_decode(source->delta.get(), &record)) {
+            source->undecodable_records++;
+            return;
+        }
+    }
+    if (record.type == CSI_BINARY_RECORD_ROLE) {
+        source->role = record.role;
+        return;
+    } else if (record.type == CSI_BINARY_RECORD_CSI) {
+        csi_format_csv_prefix(b, source->role.c_str(), &record.record);
+        csi_format_csv_values(b, record.values, record.value_count);
+        csi_format_csv_suffix(b);
+        source->csi_records++;
+    } else if (record.type == CSI_BINARY_RECORD_DROPPED) {
+        csi_format_str(b, "CSI_DROPPED,");
+        csi_format_str(b, source->role.c_str());
+        csi_format_char(b, ',');
+        csi_format_uint(b, record.dropped_total);
+        csi_format_char(b, ',');
+        csi_format_uint(b, record.dropped_since_last);
+        csi_format_char(b, '\n');
+        source->dropped_reports++;
+    } else if (record.type == CSI_BINARY_RECORD_TEXT) {
+        fwrite(record.text, 1, record.text_len, c->out);
+        return;
+    }
+    fwrite(b->buf, 1, b->len, c->out);
+}
+
+/*
+ * Handles one received datagram from `sender` (see `udp_collector_t::sources`).
+ */
+void udp_collector_datagram(udp_collector_t *c, uint64_t sender, const uint8_t *data, size_t len) {
+    udp_batch_header_t header;
+    if (!udp_batch_parse_header(data, len, &header)) {
+        c->malformed_datagrams++;
+        return;
+    }
+    c->datagrams++;
+
+    udp_source_t &source = c->sources[std::make_pair(sender, header.session)];
+    if (!source.sequence.accept(header.sequence)) {
+        return;
+    }
+
+    size_t pos = 0;
+    while (pos < header.payload_len) {
+        csi_binary_record_t record;
+        size_t consumed;
+        csi_binary_result_t result = csi_binary_decode(header.payload + pos, header.payload_len - pos, &consumed,
+                                                       &record);
+        if (result == CSI_BINARY_NEED_MORE) {
+            c->skipped_bytes += header.payload_len - pos;
+            break;
+        }
+        if (result == CSI_BINARY_SKIPPED) {
+            c->skipped_bytes += consumed;
+        } else {
+            _udp_collector_record(c, &source, record);
+        }
+        pos += consumed;
+    }
+}
+
+void udp_collector_print_stats(const udp_collector_t *c, FILE *f) {
+    fprintf(f, "datagrams: %llu, malformed: %llu, skipped bytes: %llu\n", (unsigned long long) c->datagrams,
+            (unsigned long long) c->malformed_datagrams, (unsigned long long) c->skipped_bytes);
+    for (const auto &entry : c->sources) {
+        uint64_t sender = entry.first.first;
+        const udp_source_t &s = entry.second;
+        fprintf(f, "%u.%u.%u.%u:%u session %08x (%s): %llu datagrams, %llu lost, %llu reordered, "
+                   "%llu duplicates, %llu CSI records, %llu dropped reports, %llu undecodable records\n",
+                (unsigned) (sender >> 40) & 0xFF, (unsigned) (sender >> 32) & 0xFF, (unsigned) (sender >> 24) & 0xFF,
+                (unsigned) (sender >> 16) & 0xFF, (unsigned) sender & 0xFFFF, entry.first.second, s.role.c_str(),
+                (unsigned long long) s.sequence.received, (unsigned long long) s.sequence.lost,
+                (unsigned long long) s.sequence.reordered,
+                (unsigned long long) s.sequence.duplicates, (unsigned long long) s.csi_records,
+                (unsigned long long) s.dropped_reports, (unsigned long long) s.undecodable_records);
+    }
+}
+
+#endif //ESP32_CSI_CSI_UDP_COLLECTOR_H
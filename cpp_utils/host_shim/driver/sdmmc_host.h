@@ -0,0 +1,14 @@
+#ifndef ESP32_CSI_HOST_SDMMC_HOST_H
+#define ESP32_CSI_HOST_SDMMC_HOST_H
+
+typedef int gpio_num_t;
+
+typedef struct {
+    int slot;
+} sdmmc_host_t;
+
+typedef struct {
+    int dummy;
+} sdmmc_card_t;
+
+#endif //ESP32_CSI_HOST_SDMMC_HOST_H
@@ -0,0 +1,16 @@
+#ifndef ESP32_CSI_HOST_SDSPI_HOST_H
+#define ESP32_CSI_HOST_SDSPI_HOST_H
+
+#include "sdmmc_host.h"
+
+typedef struct {
+    gpio_num_t gpio_miso;
+    gpio_num_t gpio_mosi;
+    gpio_num_t gpio_sck;
+    gpio_num_t gpio_cs;
+} sdspi_slot_config_t;
+
+#define SDSPI_HOST_DEFAULT() sdmmc_host_t{}
+#define SDSPI_SLOT_CONFIG_DEFAULT() sdspi_slot_config_t{}
+
+#endif //ESP32_CSI_HOST_SDSPI_HOST_H
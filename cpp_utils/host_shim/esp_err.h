@@ -0,0 +1,30 @@
+#ifndef ESP32_CSI_HOST_ESP_ERR_H
+#define ESP32_CSI_HOST_ESP_ERR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+
+inline const char *esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+#define ESP_ERROR_CHECK(x) do {                                                           \
+        esp_err_t _err = (x);                                                             \
+        if (_err != ESP_OK) {                                                             \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: %s at %s:%d\n", #x, __FILE__, __LINE__); \
+            abort();                                                                      \
+        }                                                                                 \
+    } while (0)
+
+#endif //ESP32_CSI_HOST_ESP_ERR_H
@@ -0,0 +1,21 @@
+#ifndef ESP32_CSI_HOST_ESP_SYSTEM_H
+#define ESP32_CSI_HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <random>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+inline uint32_t esp_random() {
+    static std::random_device device;
+    return device();
+}
+
+inline void ets_delay_us(uint32_t us) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+#endif //ESP32_CSI_HOST_ESP_SYSTEM_H
@@ -0,0 +1,102 @@
+#ifndef ESP32_CSI_HOST_ESP_TIMER_H
+#define ESP32_CSI_HOST_ESP_TIMER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "esp_err.h"
+
+// microseconds since "boot", i.e. since the first call
+inline int64_t esp_timer_get_time() {
+    static const auto boot = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
+
+//
+// Timers run their callbacks on a thread of their own (one per timer, never joined) instead of the
+// shared esp_timer task.
+//
+
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    int dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct _host_timer_t {
+    esp_timer_create_args_t args;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool armed = false;
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t period_us = 0;
+};
+
+typedef _host_timer_t *esp_timer_handle_t;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    esp_timer_handle_t timer = new _host_timer_t();
+    timer->args = *args;
+    *out = timer;
+    std::thread([timer]() {
+        std::unique_lock<std::mutex> lock(timer->mutex);
+        while (true) {
+            if (!timer->armed) {
+                timer->changed.wait(lock);
+                continue;
+            }
+            if (timer->changed.wait_until(lock, timer->deadline) != std::cv_status::timeout
+                || std::chrono::steady_clock::now() < timer->deadline) {
+                continue;
+            }
+            if (timer->period_us > 0) {
+                timer->deadline += std::chrono::microseconds(timer->period_us);
+            } else {
+                timer->armed = false;
+            }
+            lock.unlock();
+            timer->args.callback(timer->args.arg);
+            lock.lock();
+        }
+    }).detach();
+    return ESP_OK;
+}
+
+inline esp_err_t _host_timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_us);
+    timer->period_us = period_us;
+    timer->changed.notify_one();
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return _host_timer_start(timer, timeout_us, 0);
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return _host_timer_start(timer, period_us, period_us);
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (!timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    timer->changed.notify_one();
+    return ESP_OK;
+}
+
+#endif //ESP32_CSI_HOST_ESP_TIMER_H
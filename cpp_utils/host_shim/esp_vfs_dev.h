@@ -0,0 +1,17 @@
+#ifndef ESP32_CSI_HOST_ESP_VFS_DEV_H
+#define ESP32_CSI_HOST_ESP_VFS_DEV_H
+
+typedef enum {
+    ESP_LINE_ENDINGS_CRLF,
+    ESP_LINE_ENDINGS_CR,
+    ESP_LINE_ENDINGS_LF,
+} esp_line_endings_t;
+
+// stdout never translates line endings on the host
+inline void esp_vfs_dev_uart_port_set_tx_line_endings(int uart_num, esp_line_endings_t mode) {
+}
+
+inline void esp_vfs_dev_uart_use_driver(int uart_num) {
+}
+
+#endif //ESP32_CSI_HOST_ESP_VFS_DEV_H
@@ -0,0 +1,22 @@
+#ifndef ESP32_CSI_HOST_ESP_VFS_FAT_H
+#define ESP32_CSI_HOST_ESP_VFS_FAT_H
+
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "driver/sdmmc_host.h"
+#include "driver/sdspi_host.h"
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+} esp_vfs_fat_sdmmc_mount_config_t;
+
+// there is never a card on the host
+inline esp_err_t esp_vfs_fat_sdmmc_mount(const char *base_path, const sdmmc_host_t *host, const void *slot_config,
+                                         const esp_vfs_fat_sdmmc_mount_config_t *mount_config, sdmmc_card_t **card) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+#endif //ESP32_CSI_HOST_ESP_VFS_FAT_H
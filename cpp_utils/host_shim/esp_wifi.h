@@ -0,0 +1,213 @@
+#ifndef ESP32_CSI_HOST_ESP_WIFI_H
+#define ESP32_CSI_HOST_ESP_WIFI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_err.h"
+
+//
+// CSI and frame injection part of the Wi-Fi driver API (ESP-IDF v4.3 layouts). The "driver" is whoever calls
+// `host_wifi_receive_csi`, e.g. `cpp_utils/csi_replay.cc`, and whatever is installed as `host_wifi_tx`.
+//
+
+#define ESP_ERR_WIFI_NOT_CONNECT 0x300F
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP,
+} wifi_interface_t;
+
+typedef enum {
+    WIFI_SECOND_CHAN_NONE = 0,
+    WIFI_SECOND_CHAN_ABOVE,
+    WIFI_SECOND_CHAN_BELOW,
+} wifi_second_chan_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    wifi_second_chan_t second;
+    int8_t rssi;
+} wifi_ap_record_t;
+
+typedef struct {
+    signed rssi: 8;
+    unsigned rate: 5;
+    unsigned : 1;
+    unsigned sig_mode: 2;
+    unsigned : 16;
+    unsigned mcs: 7;
+    unsigned cwb: 1;
+    unsigned : 16;
+    unsigned smoothing: 1;
+    unsigned not_sounding: 1;
+    unsigned : 1;
+    unsigned aggregation: 1;
+    unsigned stbc: 2;
+    unsigned fec_coding: 1;
+    unsigned sgi: 1;
+    signed noise_floor: 8;
+    unsigned ampdu_cnt: 8;
+    unsigned channel: 4;
+    unsigned secondary_channel: 4;
+    unsigned : 8;
+    unsigned timestamp: 32;
+    unsigned : 32;
+    unsigned : 31;
+    unsigned ant: 1;
+    unsigned sig_len: 12;
+    unsigned : 12;
+    unsigned rx_state: 8;
+} wifi_pkt_rx_ctrl_t;
+
+typedef struct {
+    wifi_pkt_rx_ctrl_t rx_ctrl;
+    uint8_t mac[6];
+    bool first_word_invalid;
+    int8_t *buf;
+    uint16_t len;
+} wifi_csi_info_t;
+
+typedef struct {
+    bool lltf_en;
+    bool htltf_en;
+    bool stbc_htltf2_en;
+    bool ltf_merge_en;
+    bool channel_filter_en;
+    bool manu_scale;
+    uint8_t shift;
+} wifi_csi_config_t;
+
+typedef void (*wifi_csi_cb_t)(void *ctx, wifi_csi_info_t *data);
+
+typedef enum {
+    WIFI_PKT_MGMT,
+    WIFI_PKT_CTRL,
+    WIFI_PKT_DATA,
+    WIFI_PKT_MISC,
+} wifi_promiscuous_pkt_type_t;
+
+typedef struct {
+    wifi_pkt_rx_ctrl_t rx_ctrl;
+    uint8_t payload[0];
+} wifi_promiscuous_pkt_t;
+
+#define WIFI_PROMIS_FILTER_MASK_MGMT (1)
+#define WIFI_PROMIS_FILTER_MASK_CTRL (1 << 1)
+#define WIFI_PROMIS_FILTER_MASK_DATA (1 << 2)
+
+typedef struct {
+    uint32_t filter_mask;
+} wifi_promiscuous_filter_t;
+
+typedef void (*wifi_promiscuous_cb_t)(void *buf, wifi_promiscuous_pkt_type_t type);
+
+struct _host_wifi_t {
+    bool csi_enabled = false;
+    wifi_csi_config_t csi_config = {};
+    wifi_csi_cb_t csi_cb = NULL;
+    void *csi_ctx = NULL;
+    bool promiscuous = false;
+    wifi_promiscuous_filter_t promiscuous_filter = {};
+    wifi_promiscuous_cb_t promiscuous_cb = NULL;
+    uint8_t mac[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+    uint8_t channel = 1;
+    // set to pretend to be associated with this AP
+    bool associated = false;
+    wifi_ap_record_t ap = {};
+    // receives every injected frame, if set
+    esp_err_t (*tx)(wifi_interface_t ifx, const void *buffer, int len) = NULL;
+};
+
+inline _host_wifi_t &_host_wifi() {
+    static _host_wifi_t wifi;
+    return wifi;
+}
+
+inline esp_err_t esp_wifi_set_csi(bool en) {
+    _host_wifi().csi_enabled = en;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_csi_config(const wifi_csi_config_t *config) {
+    _host_wifi().csi_config = *config;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_csi_rx_cb(wifi_csi_cb_t cb, void *ctx) {
+    _host_wifi().csi_cb = cb;
+    _host_wifi().csi_ctx = ctx;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_promiscuous(bool en) {
+    _host_wifi().promiscuous = en;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_promiscuous_filter(const wifi_promiscuous_filter_t *filter) {
+    _host_wifi().promiscuous_filter = *filter;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb) {
+    _host_wifi().promiscuous_cb = cb;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) {
+    memcpy(mac, _host_wifi().mac, 6);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second) {
+    _host_wifi().channel = primary;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap) {
+    if (!_host_wifi().associated) {
+        return ESP_ERR_WIFI_NOT_CONNECT;
+    }
+    *ap = _host_wifi().ap;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_wifi_80211_tx(wifi_interface_t ifx, const void *buffer, int len, bool en_sys_seq) {
+    _host_wifi_t &wifi = _host_wifi();
+    return wifi.tx != NULL ? wifi.tx(ifx, buffer, len) : ESP_OK;
+}
+
+/*
+ * Hands a received frame to the registered CSI callback, like the Wi-Fi driver task does.
+ * Returns false if CSI is disabled or no callback is registered.
+ */
+inline bool host_wifi_receive_csi(wifi_csi_info_t *info) {
+    _host_wifi_t &wifi = _host_wifi();
+    if (!wifi.csi_enabled || wifi.csi_cb == NULL) {
+        return false;
+    }
+    wifi.csi_cb(wifi.csi_ctx, info);
+    return true;
+}
+
+/*
+ * Hands a received frame (`pkt->payload`, `pkt->rx_ctrl.sig_len` bytes) to the promiscuous callback.
+ * Returns false if promiscuous mode is off, no callback is registered or the filter rejects the frame type.
+ */
+inline bool host_wifi_receive_frame(wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type) {
+    _host_wifi_t &wifi = _host_wifi();
+    uint32_t mask = type == WIFI_PKT_MGMT ? WIFI_PROMIS_FILTER_MASK_MGMT
+                                          : (type == WIFI_PKT_DATA ? WIFI_PROMIS_FILTER_MASK_DATA
+                                                                   : WIFI_PROMIS_FILTER_MASK_CTRL);
+    if (!wifi.promiscuous || wifi.promiscuous_cb == NULL || !(wifi.promiscuous_filter.filter_mask & mask)) {
+        return false;
+    }
+    wifi.promiscuous_cb(pkt, type);
+    return true;
+}
+
+#endif //ESP32_CSI_HOST_ESP_WIFI_H
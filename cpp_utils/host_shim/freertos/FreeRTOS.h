@@ -0,0 +1,39 @@
+#ifndef ESP32_CSI_HOST_FREERTOS_H
+#define ESP32_CSI_HOST_FREERTOS_H
+
+//
+// FreeRTOS on top of std::thread, just enough for the `_components/` headers.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <sys/time.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+
+// 1 tick = 1 ms, like CONFIG_FREERTOS_HZ=1000
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+
+inline std::chrono::steady_clock::time_point _host_deadline(TickType_t ticks) {
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+}
+
+#endif //ESP32_CSI_HOST_FREERTOS_H
@@ -0,0 +1,6 @@
+#ifndef ESP32_CSI_HOST_EVENT_GROUPS_H
+#define ESP32_CSI_HOST_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+#endif //ESP32_CSI_HOST_EVENT_GROUPS_H
@@ -0,0 +1,61 @@
+#ifndef ESP32_CSI_HOST_SEMPHR_H
+#define ESP32_CSI_HOST_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+//
+// Mutexes and binary semaphores as a counting semaphore with a limit.
+//
+
+struct _host_semaphore_t {
+    std::mutex mutex;
+    std::condition_variable available;
+    uint32_t count;
+    uint32_t max_count;
+};
+
+typedef _host_semaphore_t *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t s = new _host_semaphore_t();
+    s->count = 1;
+    s->max_count = 1;
+    return s;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    SemaphoreHandle_t s = new _host_semaphore_t();
+    s->count = 0;
+    s->max_count = 1;
+    return s;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(s->mutex);
+    auto ready = [&]() { return s->count > 0; };
+    if (ticks == portMAX_DELAY) {
+        s->available.wait(lock, ready);
+    } else if (!s->available.wait_until(lock, _host_deadline(ticks), ready)) {
+        return pdFALSE;
+    }
+    s->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        if (s->count >= s->max_count) {
+            return pdFALSE;
+        }
+        s->count++;
+    }
+    s->available.notify_one();
+    return pdTRUE;
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t s) {
+    delete s;
+}
+
+#endif //ESP32_CSI_HOST_SEMPHR_H
@@ -0,0 +1,83 @@
+#ifndef ESP32_CSI_HOST_TASK_H
+#define ESP32_CSI_HOST_TASK_H
+
+#include "FreeRTOS.h"
+
+//
+// Tasks are detached threads; priorities and cores are ignored. Task notifications behave like the
+// FreeRTOS counting variant used through `xTaskNotifyGive` / `ulTaskNotifyTake`.
+//
+
+struct _host_task_t {
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+};
+
+typedef _host_task_t *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+inline TaskHandle_t &_host_current_task() {
+    // threads which were not created through xTaskCreate* (e.g. main) get a task object of their own
+    static thread_local _host_task_t own_task;
+    static thread_local TaskHandle_t current = &own_task;
+    return current;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                          void *parameters, UBaseType_t priority, TaskHandle_t *created,
+                                          BaseType_t core) {
+    TaskHandle_t task = new _host_task_t();
+    if (created != NULL) {
+        *created = task;
+    }
+    std::thread([=]() {
+        _host_current_task() = task;
+        function(parameters);
+    }).detach();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+                              UBaseType_t priority, TaskHandle_t *created) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, created, 0);
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return _host_current_task();
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline TickType_t xTaskGetTickCount() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    TaskHandle_t task = _host_current_task();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    auto ready = [&]() { return task->notifications > 0; };
+    if (ticks == portMAX_DELAY) {
+        task->notified.wait(lock, ready);
+    } else {
+        task->notified.wait_until(lock, _host_deadline(ticks), ready);
+    }
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+#endif //ESP32_CSI_HOST_TASK_H
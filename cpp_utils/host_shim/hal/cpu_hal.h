@@ -0,0 +1,15 @@
+#ifndef ESP32_CSI_HOST_CPU_HAL_H
+#define ESP32_CSI_HOST_CPU_HAL_H
+
+#include <stdint.h>
+#include <chrono>
+
+#include "sdkconfig.h"
+
+// "cycles" of a 1000 MHz CPU (CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ), i.e. nanoseconds, wrapping like CCOUNT
+inline uint32_t cpu_hal_get_cycle_count() {
+    return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif //ESP32_CSI_HOST_CPU_HAL_H
@@ -0,0 +1,14 @@
+#ifndef ESP32_CSI_HOST_NVS_FLASH_H
+#define ESP32_CSI_HOST_NVS_FLASH_H
+
+#include "esp_err.h"
+
+inline esp_err_t nvs_flash_init() {
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_flash_erase() {
+    return ESP_OK;
+}
+
+#endif //ESP32_CSI_HOST_NVS_FLASH_H
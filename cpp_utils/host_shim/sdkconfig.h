@@ -0,0 +1,33 @@
+#ifndef ESP32_CSI_HOST_SDKCONFIG_H
+#define ESP32_CSI_HOST_SDKCONFIG_H
+
+//
+// Stand-in for the `sdkconfig.h` generated by `idf.py menuconfig`, with the defaults of the Kconfig files.
+// The CMake options in `cpp_utils/CMakeLists.txt` change the ones guarded by `#ifndef`.
+//
+
+#define CONFIG_ESP_CONSOLE_UART_NUM 0
+#define CONFIG_ESP_CONSOLE_UART_BAUDRATE 921600
+#define CONFIG_ESPTOOLPY_MONITOR_BAUD 921600
+// `hal/cpu_hal.h` counts nanoseconds
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 1000
+
+#define CONFIG_SHOULD_COLLECT_CSI 1
+#define CONFIG_SEND_CSI_TO_SERIAL 1
+
+#ifndef CONFIG_CSI_OUTPUT_FORMAT_BINARY
+#define CONFIG_CSI_OUTPUT_FORMAT_CSV 1
+#endif
+
+#ifndef CONFIG_CSI_RING_SLOTS
+#define CONFIG_CSI_RING_SLOTS 16
+#endif
+
+#ifndef CONFIG_CSI_STATS_INTERVAL_MS
+#define CONFIG_CSI_STATS_INTERVAL_MS 0
+#endif
+
+// off on the devices by default; here it only takes effect once `csi_replay --probes` enables promiscuous mode
+#define CONFIG_CSI_PROBE_TAGS 1
+
+#endif //ESP32_CSI_HOST_SDKCONFIG_H
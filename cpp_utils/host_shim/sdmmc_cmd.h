@@ -0,0 +1,11 @@
+#ifndef ESP32_CSI_HOST_SDMMC_CMD_H
+#define ESP32_CSI_HOST_SDMMC_CMD_H
+
+#include <stdio.h>
+
+#include "driver/sdmmc_host.h"
+
+inline void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card) {
+}
+
+#endif //ESP32_CSI_HOST_SDMMC_CMD_H
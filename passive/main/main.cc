@@ -15,6 +15,7 @@
 #include "../../_components/csi_component.h"
 #include "../../_components/time_component.h"
 #include "../../_components/input_component.h"
+#include "../../_components/channel_hop_component.h"
 
 #ifdef CONFIG_WIFI_CHANNEL
 #define WIFI_CHANNEL CONFIG_WIFI_CHANNEL
@@ -22,6 +23,18 @@
 #define WIFI_CHANNEL 6
 #endif
 
+#ifdef CONFIG_CHANNEL_HOP_TABLE
+#define CHANNEL_HOP_TABLE CONFIG_CHANNEL_HOP_TABLE
+#else
+#define CHANNEL_HOP_TABLE ""
+#endif
+
+#ifdef CONFIG_CHANNEL_HOP_DWELL_MS
+#define CHANNEL_HOP_DWELL_MS CONFIG_CHANNEL_HOP_DWELL_MS
+#else
+#define CHANNEL_HOP_DWELL_MS 200
+#endif
+
 #ifdef CONFIG_SHOULD_COLLECT_CSI
 #define SHOULD_COLLECT_CSI 1
 #else
@@ -46,6 +59,12 @@
 #define SEND_CSI_TO_SD 0
 #endif
 
+#ifdef CONFIG_CSI_PROBE_TAGS
+#define CSI_PROBE_TAGS 1
+#else
+#define CSI_PROBE_TAGS 0
+#endif
+
 void config_print() {
     printf("\n\n\n\n\n\n\n\n");
     printf("-----------------------\n");
@@ -57,10 +76,24 @@ void config_print() {
     printf("IDF_VER: %s\n", IDF_VER);
     printf("-----------------------\n");
     printf("WIFI_CHANNEL: %d\n", WIFI_CHANNEL);
+    printf("CHANNEL_HOP_TABLE: %s\n", CHANNEL_HOP_TABLE);
+    printf("CHANNEL_HOP_DWELL_MS: %d\n", CHANNEL_HOP_DWELL_MS);
     printf("SHOULD_COLLECT_CSI: %d\n", SHOULD_COLLECT_CSI);
     printf("SHOULD_COLLECT_ONLY_LLTF: %d\n", SHOULD_COLLECT_ONLY_LLTF);
+    printf("CSI_COLLECT_SEGMENTS: %d\n", CSI_COLLECT_SEGMENTS);
     printf("SEND_CSI_TO_SERIAL: %d\n", SEND_CSI_TO_SERIAL);
     printf("SEND_CSI_TO_SD: %d\n", SEND_CSI_TO_SD);
+    printf("CSI_STATS_INTERVAL_MS: %u\n", (unsigned) csi_stats_interval_ms);
+    printf("CSI_FILTER_RULES: %s\n", CSI_FILTER_RULES);
+    printf("CSI_RATE_LIMIT_FPS: %d\n", CSI_RATE_LIMIT_FPS);
+    printf("CSI_RATE_LIMIT_BURST: %d\n", CSI_RATE_LIMIT_BURST);
+    printf("CSI_DECIMATE: %d/%d\n", CSI_DECIMATE_KEEP, CSI_DECIMATE_EVERY);
+    printf("CSI_FEATURES: %d\n", CSI_FEATURES_MODE);
+    printf("CSI_FEATURES_GROUP: %d\n", CSI_FEATURES_GROUP);
+    printf("CSI_FEATURES_SUMMARY_MS: %d\n", CSI_FEATURES_SUMMARY_MS);
+    printf("CSI_FEATURES_MOTION_THRESHOLD_PPM: %d\n", CSI_FEATURES_MOTION_THRESHOLD_PPM);
+    printf("CSI_BINARY_DELTA: %d (keyframe every %d)\n", CSI_BINARY_DELTA, CSI_DELTA_KEYFRAME_EVERY);
+    printf("CSI_PROBE_TAGS: %d\n", CSI_PROBE_TAGS);
     printf("-----------------------\n");
     printf("\n\n\n\n\n\n\n\n");
 }
@@ -71,8 +104,9 @@ void passive_init() {
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_NULL));
     ESP_ERROR_CHECK(esp_wifi_start());
 
+    // probes sent as action frames are management frames
     const wifi_promiscuous_filter_t filt = {
-            .filter_mask = WIFI_PROMIS_FILTER_MASK_DATA
+            .filter_mask = WIFI_PROMIS_FILTER_MASK_DATA | (CSI_PROBE_TAGS ? WIFI_PROMIS_FILTER_MASK_MGMT : 0)
     };
 
     int curChannel = WIFI_CHANNEL;
@@ -84,9 +118,14 @@ void passive_init() {
 
 extern "C" void app_main(void) {
     config_print();
+    time_init();
     nvs_init();
     sd_init();
     passive_init();
     csi_init((char *) "PASSIVE");
+    if (strlen(CHANNEL_HOP_TABLE) > 0 && !channel_hop_start(CHANNEL_HOP_TABLE, CHANNEL_HOP_DWELL_MS)) {
+        printf("ERROR: invalid CHANNEL_HOP_TABLE \"%s\", staying on channel %d\n", CHANNEL_HOP_TABLE, WIFI_CHANNEL);
+    }
+    channel_hop_register_command(CHANNEL_HOP_DWELL_MS);
     input_loop();
 }